@@ -0,0 +1,18 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Shared by the gps_bench sources (Google Benchmark)
+
+// Appends frames synthetic logs of msg_id to stream, count observations,
+// satellites or channels each (ignored by the other logs), one epoch
+// (200 ms) apart
+void BuildLogStream(uint16_t msg_id, int count, int frames, std::vector<uint8_t>* stream);
+
+// Parse benchmark over a capture recorded with the record parameter
+void RegisterCaptureBenchmark(const std::string& path);
+
+#endif // BENCH_H
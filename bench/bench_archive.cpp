@@ -0,0 +1,177 @@
+// Log archive: the cost of append() on the reader thread, the rows per
+// second a chunk encodes at, and an indexed query against a full scan of an
+// hour of RANGE rows (1 Hz, 40 satellites x 2 signals)
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <benchmark/benchmark.h>
+
+#include "log_archive.h"
+#include "satellite_table.h"
+
+// GPS week 2200 in ms since the GPS epoch
+#define BENCH_START_MS      (2200*604800000.0)
+#define BENCH_CHUNK_ROWS    4096
+#define BENCH_SATELLITES    40
+#define BENCH_SECONDS       3600
+
+// RANGE row of PRN prn, signal 0 or 1, at second t
+static void RangeRow(int t, int prn, int signal, double* row)
+{
+    row[0] = BENCH_START_MS + t*1000.0;
+    row[1] = prn;
+    row[2] = 0x00000C04 | signal << 21;
+    row[3] = 2.2e7 + 1000.0*prn + 0.731*t + 1.2*signal;
+    row[4] = static_cast<float>(0.05 + 0.001*prn);
+    row[5] = -1.15e8 - 3.84*t + prn;
+    row[6] = static_cast<float>(0.004);
+    row[7] = static_cast<float>(-1234.5 + 0.01*t);
+    row[8] = static_cast<float>(40.0 + 0.1*prn - 4.0*signal + std::sin(t*0.01));
+    row[9] = static_cast<float>(t);
+    row[10] = 0;
+}
+
+static std::string TempPath(const char* name)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/%s_%d.arc", name, static_cast<int>(getpid()));
+    return path;
+}
+
+// Time per append() with the writer keeping up. Every half ring the ring is
+// drained, untimed: an empty appendEncoded() waits for the queued chunks.
+static void BM_ArchiveAppend(benchmark::State& state)
+{
+    std::string path = TempPath("bench_archive_append");
+    ArchiveEncoder empty(BENCH_CHUNK_ROWS);
+    std::vector<double> rows(BENCH_SATELLITES*2*11);
+    for(int i = 0; i < BENCH_SATELLITES*2; ++i)
+        RangeRow(0, 1 + i/2, i & 1, &rows[i*11]);
+    {
+        ArchiveWriter writer(path, BENCH_CHUNK_ROWS);
+        uint64_t appended = 0;
+        for(auto _ : state)
+        {
+            writer.append(ARCHIVE_RANGE, &rows[(appended % (BENCH_SATELLITES*2))*11]);
+            if(++appended % (BENCH_CHUNK_ROWS*ARCHIVE_QUEUE_CHUNKS/2) == 0)
+            {
+                state.PauseTiming();
+                writer.appendEncoded(empty);
+                state.ResumeTiming();
+            }
+        }
+        if(writer.dropped() != 0)
+            state.SkipWithError("rows dropped");
+    }
+    unlink(path.c_str());
+}
+BENCHMARK(BM_ArchiveAppend);
+
+// What the writer thread does per chunk. items: rows per second encoded.
+static void BM_ArchiveEncode(benchmark::State& state)
+{
+    std::vector<double> rows(BENCH_CHUNK_ROWS*11);
+    for(int i = 0; i < BENCH_CHUNK_ROWS; ++i)
+        RangeRow(i/(BENCH_SATELLITES*2), 1 + (i/2) % BENCH_SATELLITES, i & 1, &rows[i*11]);
+    size_t bytes = 0;
+    for(auto _ : state)
+    {
+        ArchiveEncoder encoder(BENCH_CHUNK_ROWS);
+        for(int i = 0; i < BENCH_CHUNK_ROWS; ++i)
+            encoder.append(ARCHIVE_RANGE, &rows[i*11]);
+        benchmark::DoNotOptimize(encoder.data().data());
+        bytes = encoder.data().size();
+    }
+    state.SetItemsProcessed(state.iterations()*BENCH_CHUNK_ROWS);
+    state.counters["bytes_per_row"] = static_cast<double>(bytes)/BENCH_CHUNK_ROWS;
+}
+BENCHMARK(BM_ArchiveEncode)->Unit(benchmark::kMicrosecond);
+
+// An hour of RANGE rows, written once
+static const ArchiveReader& HourArchive()
+{
+    static std::string path;
+    if(path.empty())
+    {
+        path = TempPath("bench_archive_hour");
+        ArchiveEncoder encoder(BENCH_CHUNK_ROWS);
+        double row[11];
+        for(int t = 0; t < BENCH_SECONDS; ++t)
+            for(int i = 0; i < BENCH_SATELLITES*2; ++i)
+            {
+                RangeRow(t, 1 + i/2, i & 1, row);
+                encoder.append(ARCHIVE_RANGE, row);
+            }
+        encoder.flush();
+        ArchiveWriter writer(path, BENCH_CHUNK_ROWS);
+        writer.appendEncoded(encoder);
+    }
+    static ArchiveReader reader(path);
+    unlink(path.c_str());
+    return reader;
+}
+
+// C/N0 of PRN 12 over 5 minutes in the middle of the hour
+static ArchiveQuery Prn12Query()
+{
+    ArchiveQuery query;
+    query.table = ARCHIVE_RANGE;
+    query.first_ms = BENCH_START_MS + 1800*1000.0;
+    query.last_ms = BENCH_START_MS + 2099*1000.0;
+    query.prn = 12;
+    query.system = SYSTEM_GPS;
+    query.columns.push_back(0);
+    query.columns.push_back(ArchiveFindColumn(ARCHIVE_RANGE, "c_no"));
+    return query;
+}
+
+// Chunks picked by the index, only the time, PRN and projected columns decoded
+static void BM_ArchiveQuery(benchmark::State& state)
+{
+    const ArchiveReader& reader = HourArchive();
+    ArchiveQuery query = Prn12Query();
+    ArchiveResult result;
+    for(auto _ : state)
+    {
+        result = ArchiveResult();
+        if(reader.query(query, &result) != 600)
+            state.SkipWithError("wrong row count");
+    }
+    state.counters["chunks_read"] = result.chunks_read;
+    state.counters["chunks_skipped"] = result.chunks_skipped;
+}
+BENCHMARK(BM_ArchiveQuery)->Unit(benchmark::kMicrosecond);
+
+// The same rows the way a replay finds them: every chunk decoded, every
+// row tested
+static void BM_ArchiveFullScan(benchmark::State& state)
+{
+    const ArchiveReader& reader = HourArchive();
+    ArchiveQuery query = Prn12Query();
+    ArchiveQuery all = query;
+    all.first_ms = 0;
+    all.last_ms = INT64_MAX;
+    all.prn = -1;
+    all.system = -1;
+    all.columns.push_back(1);
+    ArchiveResult result;
+    for(auto _ : state)
+    {
+        result = ArchiveResult();
+        reader.query(all, &result);
+        size_t found = 0;
+        for(size_t i = 0; i < result.rows; ++i)
+        {
+            double time = result.columns[0][i];
+            found += result.columns[2][i] == query.prn && time >= query.first_ms && time <= query.last_ms;
+        }
+        if(found != 600)
+            state.SkipWithError("wrong row count");
+    }
+    state.counters["chunks_read"] = result.chunks_read;
+}
+BENCHMARK(BM_ArchiveFullScan)->Unit(benchmark::kMicrosecond);
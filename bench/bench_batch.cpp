@@ -0,0 +1,82 @@
+// gps/cart at 100 Hz: bytes on the wire and the cost to build and serialize
+// each fix as its own GpsXYZ against GpsXYZBatch messages of batch_size fixes
+
+#include <cmath>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <ros/serialization.h>
+
+#include "solution_batch.h"
+
+#define BENCH_FIXES     1000
+
+// Fix i, the sigmas changing every sigma_every fixes
+static novatel_gps::GpsXYZ Fix(int i, int sigma_every)
+{
+    novatel_gps::GpsXYZ fix;
+    fix.header.frame_id = "gps_frame";
+    fix.header.stamp.fromSec(1.7e9 + i*0.01);
+    fix.position.position.x = 4e6 + i*0.013;
+    fix.position.position.y = -4.4e6 + std::sin(i*0.01);
+    fix.position.position.z = -1.7e6 + i*1e-3;
+    fix.velocity.velocity.x = 1.3;
+    fix.velocity.velocity.y = std::cos(i*0.01);
+    fix.velocity.velocity.z = -0.01*i;
+    int k = i/sigma_every;
+    for(int j = 0; j < 3; ++j)
+    {
+        fix.position.covariance[4*j] = static_cast<float>(0.01 + 0.001*((k + j) % 7));
+        fix.velocity.covariance[4*j] = static_cast<float>(0.002 + 0.0001*((k + j) % 5));
+    }
+    return fix;
+}
+
+static std::vector<novatel_gps::GpsXYZ> Fixes(int sigma_every)
+{
+    std::vector<novatel_gps::GpsXYZ> fixes;
+    for(int i = 0; i < BENCH_FIXES; ++i)
+        fixes.push_back(Fix(i, sigma_every));
+    return fixes;
+}
+
+// Each fix serialized as roscpp publishes it, TCPROS length included.
+// Argument: fixes between sigma changes.
+static void BM_CartPerFix(benchmark::State& state)
+{
+    std::vector<novatel_gps::GpsXYZ> fixes = Fixes(state.range(0));
+    size_t bytes = 0;
+    for(auto _ : state)
+    {
+        bytes = 0;
+        for(size_t i = 0; i < fixes.size(); ++i)
+            bytes += ros::serialization::serializeMessage(fixes[i]).num_bytes;
+    }
+    state.SetItemsProcessed(state.iterations()*BENCH_FIXES);
+    state.counters["bytes_per_fix"] = static_cast<double>(bytes)/BENCH_FIXES;
+}
+BENCHMARK(BM_CartPerFix)->Arg(1)->Arg(BENCH_FIXES);
+
+// The same fixes through SolutionBatch, a message serialized per batch.
+// Arguments: batch_size, fixes between sigma changes.
+static void BM_CartBatch(benchmark::State& state)
+{
+    std::vector<novatel_gps::GpsXYZ> fixes = Fixes(state.range(1));
+    SolutionBatch batch;
+    batch.configure(state.range(0), 0.0);
+    novatel_gps::GpsXYZBatch message;
+    message.header.frame_id = "gps_frame";
+    size_t bytes = 0;
+    for(auto _ : state)
+    {
+        bytes = 0;
+        for(size_t i = 0; i < fixes.size(); ++i)
+            if(batch.add(fixes[i]))
+            {
+                batch.take(&message);
+                bytes += ros::serialization::serializeMessage(message).num_bytes;
+            }
+    }
+    state.SetItemsProcessed(state.iterations()*BENCH_FIXES);
+    state.counters["bytes_per_fix"] = static_cast<double>(bytes)/BENCH_FIXES;
+}
+BENCHMARK(BM_CartBatch)->Args({10, 1})->Args({10, BENCH_FIXES})->Args({50, 1})->Args({50, BENCH_FIXES});
@@ -0,0 +1,108 @@
+// Compact RANGE messages: encode and decode time per epoch and the bytes per
+// observation, for key intervals 1, 10 and 60. 82 observations an epoch:
+// GPS 1-20, Galileo 1-11 (sharing PRN numbers with GPS) and GLONASS 38-47,
+// two signals each.
+
+#include <cmath>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "compact_observations.h"
+
+#define BENCH_EPOCHS        600
+
+static novatel_gps::RangeInformation Observation(int system, int prn, uint32_t signal, int t)
+{
+    novatel_gps::RangeInformation obs;
+    obs.prn_slot = prn;
+    obs.ch_tr_status = 0x00000C00 | (static_cast<uint32_t>(system) << 16) | (signal << 21);
+    double rho = 2.0e7 + 2.5e5*(prn % 32) + 1.0e5*system + (300.0 + 10.0*(prn % 32))*t +
+                 3.0*std::sin(0.1*t + prn);
+    double wavelength = CarrierWavelength(obs.ch_tr_status);
+    obs.psr = rho + 0.3*std::cos(1.7*t + signal + prn);
+    obs.psr_std = static_cast<float>(0.05 + 0.001*prn);
+    obs.adr = -rho/wavelength;
+    obs.adr_std = 0.004f;
+    obs.doppler = static_cast<float>(-(300.0 + 10.0*(prn % 32))/wavelength + 0.02*std::sin(2.3*t + prn));
+    obs.c_no = static_cast<float>(40.0 + 0.1*(prn % 32) + std::sin(0.01*t));
+    obs.locktime = static_cast<float>(100.0 + t);
+    obs.slip = 0;
+    return obs;
+}
+
+static std::vector<novatel_gps::Range> Epochs()
+{
+    std::vector<novatel_gps::Range> epochs(BENCH_EPOCHS);
+    for(int t = 0; t < BENCH_EPOCHS; ++t)
+    {
+        std::vector<novatel_gps::RangeInformation>& ranges = epochs[t].ranges;
+        for(int prn = 1; prn <= 20; ++prn)
+        {
+            ranges.push_back(Observation(SYSTEM_GPS, prn, 0, t));
+            ranges.push_back(Observation(SYSTEM_GPS, prn, 9, t));
+        }
+        for(int prn = 1; prn <= 11; ++prn)
+        {
+            ranges.push_back(Observation(SYSTEM_GALILEO, prn, 2, t));
+            ranges.push_back(Observation(SYSTEM_GALILEO, prn, 12, t));
+        }
+        for(int slot = 38; slot <= 47; ++slot)
+        {
+            ranges.push_back(Observation(SYSTEM_GLONASS, slot, 0, t));
+            ranges.push_back(Observation(SYSTEM_GLONASS, slot, 1, t));
+        }
+        epochs[t].obs = ranges.size();
+    }
+    return epochs;
+}
+
+static novatel_gps::MsgHeader Header(int t)
+{
+    novatel_gps::MsgHeader header;
+    header.gps_week = 2200;
+    header.gps_ms = 345600000 + 1000*t;
+    return header;
+}
+
+// Argument: key interval. bytes_per_obs: data bytes over observations.
+static void BM_CompactEncode(benchmark::State& state)
+{
+    std::vector<novatel_gps::Range> epochs = Epochs();
+    novatel_gps::CompactRange compact;
+    size_t bytes = 0, observations = 0;
+    for(auto _ : state)
+    {
+        CompactEncoder encoder(state.range(0));
+        bytes = observations = 0;
+        for(int t = 0; t < BENCH_EPOCHS; ++t)
+        {
+            encoder.encode(Header(t), epochs[t], &compact);
+            bytes += compact.data.size();
+            observations += compact.observations;
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*BENCH_EPOCHS);
+    state.counters["bytes_per_obs"] = static_cast<double>(bytes)/observations;
+}
+BENCHMARK(BM_CompactEncode)->Arg(1)->Arg(10)->Arg(60)->Unit(benchmark::kMicrosecond);
+
+// Argument: key interval. Fails unless every epoch decodes exactly.
+static void BM_CompactDecode(benchmark::State& state)
+{
+    std::vector<novatel_gps::Range> epochs = Epochs();
+    std::vector<novatel_gps::CompactRange> compact(BENCH_EPOCHS);
+    CompactEncoder encoder(state.range(0));
+    for(int t = 0; t < BENCH_EPOCHS; ++t)
+        encoder.encode(Header(t), epochs[t], &compact[t]);
+
+    novatel_gps::Range range;
+    for(auto _ : state)
+    {
+        CompactDecoder decoder;
+        for(int t = 0; t < BENCH_EPOCHS; ++t)
+            if(!decoder.decode(compact[t], &range) || range.ranges[7].psr != epochs[t].ranges[7].psr)
+                state.SkipWithError("decode failed");
+    }
+    state.SetItemsProcessed(state.iterations()*BENCH_EPOCHS);
+}
+BENCHMARK(BM_CompactDecode)->Arg(1)->Arg(10)->Arg(60)->Unit(benchmark::kMicrosecond);
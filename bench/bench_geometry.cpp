@@ -0,0 +1,73 @@
+// Satellite geometry per SATXYZ epoch, every direction recomputed against the
+// incremental tolerance, over a full GPS constellation (SATXYZ lists GPS
+// satellites only, at most 32)
+
+#include <cmath>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "geodesy.h"
+#include "satellite_geometry.h"
+
+#define BENCH_SATELLITES    32
+// Precomputed 1 Hz epochs cycled by each benchmark
+#define BENCH_EPOCHS        600
+#define ORBIT_RADIUS        26560e3
+#define ORBIT_PERIOD        43082.0
+
+// SATXYZ records of circular orbits in six 55 deg planes, t seconds into the
+// pass
+static void Constellation(double t, novatel_gps::SatXYZInformation* satellites)
+{
+    for(int i = 0; i < BENCH_SATELLITES; ++i)
+    {
+        double inclination = 55.0*DEG2RAD;
+        double node = (i % 6)*60.0*DEG2RAD;
+        double u = (i/6)*45.0*DEG2RAD + i*0.3 + t*2.0*M_PI/ORBIT_PERIOD;
+        double x = ORBIT_RADIUS*std::cos(u);
+        double y = ORBIT_RADIUS*std::sin(u);
+
+        satellites[i].prn_slot = i + 1;
+        satellites[i].position.x = x*std::cos(node) - y*std::cos(inclination)*std::sin(node);
+        satellites[i].position.y = x*std::sin(node) + y*std::cos(inclination)*std::cos(node);
+        satellites[i].position.z = y*std::sin(inclination);
+    }
+}
+
+// epoch: time per SATXYZ, the table updates, update() and fill() as in the
+// driver. recomputed: share of the directions recomputed, 1 with no
+// tolerance.
+static void BM_Geometry(benchmark::State& state)
+{
+    double tolerance = state.range(0)/100.0;
+    double receiver[3];
+    LlaToEcef(45.0*DEG2RAD, 10.0*DEG2RAD, 100.0, receiver);
+
+    std::vector<novatel_gps::SatXYZInformation> epochs(BENCH_EPOCHS*BENCH_SATELLITES);
+    for(int i = 0; i < BENCH_EPOCHS; ++i)
+        Constellation(i, &epochs[i*BENCH_SATELLITES]);
+
+    SatelliteTable table;
+    GeometryEngine engine;
+    engine.configure(5.0, tolerance);
+    novatel_gps::SatelliteGeometry geometry;
+    int64_t updates = 0, recomputed = 0;
+    for(auto _ : state)
+    {
+        const novatel_gps::SatXYZInformation* satellites = &epochs[(updates % BENCH_EPOCHS)*BENCH_SATELLITES];
+        table.beginSatXYZ();
+        for(int i = 0; i < BENCH_SATELLITES; ++i)
+            table.update(satellites[i]);
+        engine.update(table, receiver);
+        engine.fill(&geometry);
+        benchmark::DoNotOptimize(geometry.pdop);
+        recomputed += engine.recomputed();
+        updates++;
+    }
+
+    state.SetItemsProcessed(updates*BENCH_SATELLITES);
+    state.counters["epoch"] = benchmark::Counter(updates, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["recomputed"] = static_cast<double>(recomputed)/(updates*BENCH_SATELLITES);
+}
+// Tolerance in hundredths of a degree: 0 (every direction), 0.05 deg
+BENCHMARK(BM_Geometry)->ArgName("tolerance_cdeg")->Arg(0)->Arg(5);
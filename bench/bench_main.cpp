@@ -0,0 +1,26 @@
+// Benchmarks of the driver's hot paths, no port or ROS master needed.
+// Captures recorded with the record parameter are added with --capture FILE;
+// the --benchmark_* flags (filter, repetitions, format) apply as usual.
+
+#include <cstdio>
+#include <cstring>
+#include <benchmark/benchmark.h>
+
+#include "bench.h"
+
+int main(int argc, char* argv[])
+{
+    benchmark::Initialize(&argc, argv);
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            RegisterCaptureBenchmark(argv[++i]);
+        else
+        {
+            printf("usage: gps_bench [--capture FILE]... [--benchmark_filter REGEX] [--benchmark_*]\n");
+            return 1;
+        }
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,181 @@
+// Parser benchmarks: frame sync, CRC, header and decode() of each log type
+// through GPS::parse(), and the getData() message fills, over synthetic
+// frames (frame_builder.h) and recorded captures.
+
+#include <cstdio>
+#include <memory>
+#include <benchmark/benchmark.h>
+
+#include "bench.h"
+#include "capture.h"
+#include "crc32.h"
+#include "frame_builder.h"
+#include "novatel_gps.h"
+
+// Frames per synthetic stream, parsed in full by each iteration
+#define BENCH_FRAMES        64
+#define BENCH_WEEK          2200
+#define BENCH_START_MS      345600000
+#define BENCH_EPOCH_MS      200
+// Not a log the driver decodes: sync, CRC and header only
+#define BENCH_UNKNOWN_LOG   1
+
+void BuildLogStream(uint16_t msg_id, int count, int frames, std::vector<uint8_t>* stream)
+{
+    double position[3] = { 4115000.0, -4550000.0, -1722000.0 };
+    double velocity[3] = { 0.1, -0.2, 0.05 };
+    double attitude[3] = { 1.0, -2.0, 90.0 };
+    double gravity[3] = { 0.0, 0.0, 9.80665/100.0 };
+
+    std::vector<uint8_t> body;
+    for(int i = 0; i < frames; ++i)
+    {
+        uint32_t ms = BENCH_START_MS + i*BENCH_EPOCH_MS;
+        switch(msg_id)
+        {
+            case 241:   BuildBestXYZBody(position, velocity, &body);                    break;
+            case 42:    BuildBestPosBody(-15.765824, -47.872109, 1024.0, &body);        break;
+            case 43:    BuildRangeBody(count, i, &body);                                break;
+            case 140:   BuildRangeCmpBody(count, i, &body);                             break;
+            case 270:   BuildSatXYZBody(count, i, &body);                               break;
+            case 83:    BuildTrackStatBody(count, i, &body);                            break;
+            case 507:
+            case 508:   BuildInsPvaBody(BENCH_WEEK, ms/1000.0, -15.765824, -47.872109, 1024.0,
+                                        velocity, attitude, &body);                     break;
+            case 812:
+            case 813:   BuildCorrImuDataBody(BENCH_WEEK, ms/1000.0, velocity, gravity, &body); break;
+            default:    body.assign(count, 0);                                          break;
+        }
+
+        if(msg_id == 508 || msg_id == 813)
+            BuildShortFrame(msg_id, body, BENCH_WEEK, ms, stream);
+        else
+            BuildFrame(msg_id, body, BENCH_WEEK, ms, stream);
+    }
+}
+
+// Time per frame next to the bytes and frames per second
+static void CountFrames(benchmark::State& state, int64_t frames, size_t bytes)
+{
+    state.SetItemsProcessed(frames);
+    state.SetBytesProcessed(state.iterations()*bytes);
+    state.counters["frame"] = benchmark::Counter(frames, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+static void BM_Crc(benchmark::State& state)
+{
+    std::vector<uint8_t> block(state.range(0), 0x5A);
+    uint32_t crc = 0;
+    for(auto _ : state)
+    {
+        crc ^= CalculateBlockCRC32(block.size(), block.data());
+        benchmark::DoNotOptimize(crc);
+    }
+    state.SetBytesProcessed(state.iterations()*block.size());
+}
+// Header and body of BESTXYZ and of RANGE with 24 and 64 observations
+BENCHMARK(BM_Crc)->Arg(140)->Arg(1088)->Arg(2848);
+
+// Sync, length and CRC check of every frame, nothing decoded
+static void BM_FrameSync(benchmark::State& state, uint16_t msg_id, int count)
+{
+    std::vector<uint8_t> stream;
+    BuildLogStream(msg_id, count, BENCH_FRAMES, &stream);
+    int64_t frames = 0;
+    for(auto _ : state)
+    {
+        for(size_t pos = CaptureNextFrame(stream.data(), stream.size(), 0); pos < stream.size(); frames++)
+            pos = CaptureNextFrame(stream.data(), stream.size(), pos + 1);
+    }
+    CountFrames(state, frames, stream.size());
+}
+BENCHMARK_CAPTURE(BM_FrameSync, BESTXYZ, 241, 0);
+BENCHMARK_CAPTURE(BM_FrameSync, RANGE_24, 43, 24);
+
+// GPS::parse(): parseByte() for every byte, then decode() of each frame
+static void BM_Parse(benchmark::State& state, uint16_t msg_id, int count)
+{
+    std::vector<uint8_t> stream;
+    BuildLogStream(msg_id, count, BENCH_FRAMES, &stream);
+    GPS gps;
+    int64_t frames = 0;
+    for(auto _ : state)
+        frames += gps.parse(stream.data(), stream.size(), GPS::FrameCallback());
+    if(frames != state.iterations()*BENCH_FRAMES)
+        state.SkipWithError("frames were not decoded");
+    CountFrames(state, frames, stream.size());
+}
+// Header only, bodies the size of BESTXYZ and RANGE with 24 observations
+BENCHMARK_CAPTURE(BM_Parse, HEADER_112, BENCH_UNKNOWN_LOG, 112);
+BENCHMARK_CAPTURE(BM_Parse, HEADER_1060, BENCH_UNKNOWN_LOG, 1060);
+BENCHMARK_CAPTURE(BM_Parse, BESTXYZ, 241, 0);
+BENCHMARK_CAPTURE(BM_Parse, BESTPOS, 42, 0);
+BENCHMARK_CAPTURE(BM_Parse, RANGE_8, 43, 8);
+BENCHMARK_CAPTURE(BM_Parse, RANGE_24, 43, 24);
+BENCHMARK_CAPTURE(BM_Parse, RANGE_64, 43, 64);
+BENCHMARK_CAPTURE(BM_Parse, RANGECMP_8, 140, 8);
+BENCHMARK_CAPTURE(BM_Parse, RANGECMP_24, 140, 24);
+BENCHMARK_CAPTURE(BM_Parse, RANGECMP_64, 140, 64);
+BENCHMARK_CAPTURE(BM_Parse, SATXYZ_12, 270, 12);
+BENCHMARK_CAPTURE(BM_Parse, TRACKSTAT_24, 83, 24);
+BENCHMARK_CAPTURE(BM_Parse, INSPVA, 507, 0);
+BENCHMARK_CAPTURE(BM_Parse, INSPVAS, 508, 0);
+BENCHMARK_CAPTURE(BM_Parse, CORRIMUDATA, 812, 0);
+BENCHMARK_CAPTURE(BM_Parse, CORRIMUDATAS, 813, 0);
+
+// The getData() fills behind receiveDataFromGPS() and the stream callbacks,
+// after one epoch of BESTXYZ, BESTPOS, RANGE, SATXYZ and TRACKSTAT
+template <typename M>
+static void BM_Fill(benchmark::State& state)
+{
+    std::vector<uint8_t> stream;
+    BuildLogStream(241, 0, 1, &stream);
+    BuildLogStream(42, 0, 1, &stream);
+    BuildLogStream(43, 24, 1, &stream);
+    BuildLogStream(270, 12, 1, &stream);
+    BuildLogStream(83, 24, 1, &stream);
+    GPS gps;
+    gps.parse(stream.data(), stream.size(), GPS::FrameCallback());
+
+    M message;
+    for(auto _ : state)
+    {
+        gps.getData(&message);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK_TEMPLATE(BM_Fill, novatel_gps::GpsXYZ);
+BENCHMARK_TEMPLATE(BM_Fill, sensor_msgs::NavSatFix);
+BENCHMARK_TEMPLATE(BM_Fill, novatel_gps::LogAll);
+BENCHMARK_TEMPLATE(BM_Fill, novatel_gps::SatelliteStateArray);
+
+void RegisterCaptureBenchmark(const std::string& path)
+{
+    std::shared_ptr<std::vector<uint8_t> > data(new std::vector<uint8_t>());
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file)
+    {
+        uint8_t block[65536];
+        size_t n;
+        while((n = fread(block, 1, sizeof(block), file)) > 0)
+            data->insert(data->end(), block, block + n);
+        fclose(file);
+    }
+
+    std::string name = "BM_Capture/" + path.substr(path.rfind('/') + 1);
+    benchmark::RegisterBenchmark(name.c_str(), [data, path](benchmark::State& state)
+    {
+        if(data->empty())
+        {
+            state.SkipWithError(("cannot read " + path).c_str());
+            return;
+        }
+        int64_t frames = 0;
+        for(auto _ : state)
+        {
+            GPS gps;
+            frames += gps.parse(data->data(), data->size(), GPS::FrameCallback());
+        }
+        CountFrames(state, frames, data->size());
+    })->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,73 @@
+// RANGE against RANGECMP: decode time per observation and the link bytes
+// each costs, over the same synthetic observations (frame_builder.h)
+
+#include <cmath>
+#include <benchmark/benchmark.h>
+
+#include "bench.h"
+#include "novatel_gps.h"
+
+#define BENCH_FRAMES        64
+// Bytes per second of a 115200 baud 8N1 link
+#define BENCH_LINK_RATE     (115200/10)
+
+// Decoded RANGE of one frame of msg_id
+static novatel_gps::Range DecodeOne(uint16_t msg_id, int obs)
+{
+    std::vector<uint8_t> stream;
+    BuildLogStream(msg_id, obs, 1, &stream);
+    GPS gps;
+    gps.parse(stream.data(), stream.size(), GPS::FrameCallback());
+    novatel_gps::LogAll logs;
+    gps.getData(&logs);
+    return logs.range_log;
+}
+
+// RANGECMP decodes to RANGE within its resolution (1/128 m, 1/256 cycle)
+static bool SameObservations(int obs)
+{
+    novatel_gps::Range full = DecodeOne(43, obs);
+    novatel_gps::Range packed = DecodeOne(140, obs);
+    if(full.obs != obs || packed.obs != obs)
+        return false;
+    for(int i = 0; i < obs; ++i)
+    {
+        const novatel_gps::RangeInformation& a = full.ranges[i];
+        const novatel_gps::RangeInformation& b = packed.ranges[i];
+        if(a.prn_slot != b.prn_slot || a.ch_tr_status != b.ch_tr_status ||
+           std::fabs(a.psr - b.psr) > 1.0/128.0 || std::fabs(a.adr - b.adr) > 1.0/256.0 ||
+           std::fabs(a.doppler - b.doppler) > 1.0/256.0)
+            return false;
+    }
+    return true;
+}
+
+// frame, obs: time per frame and per observation. link_bytes_per_obs: frame
+// bytes (header and CRC included) over observations. epochs_at_115200: epochs
+// per second of this log alone that fit a 115200 baud link.
+static void BM_RangeDecode(benchmark::State& state, uint16_t msg_id)
+{
+    int obs = state.range(0);
+    if(!SameObservations(obs))
+    {
+        state.SkipWithError("RANGECMP does not decode to RANGE");
+        return;
+    }
+
+    std::vector<uint8_t> stream;
+    BuildLogStream(msg_id, obs, BENCH_FRAMES, &stream);
+    GPS gps;
+    int64_t frames = 0;
+    for(auto _ : state)
+        frames += gps.parse(stream.data(), stream.size(), GPS::FrameCallback());
+
+    double frame_bytes = static_cast<double>(stream.size())/BENCH_FRAMES;
+    state.SetBytesProcessed(state.iterations()*stream.size());
+    state.SetItemsProcessed(frames*obs);
+    state.counters["frame"] = benchmark::Counter(frames, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["obs"] = benchmark::Counter(frames*obs, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["link_bytes_per_obs"] = frame_bytes/obs;
+    state.counters["epochs_at_115200"] = BENCH_LINK_RATE/frame_bytes;
+}
+BENCHMARK_CAPTURE(BM_RangeDecode, RANGE, 43)->Arg(8)->Arg(16)->Arg(24)->Arg(32)->Arg(64);
+BENCHMARK_CAPTURE(BM_RangeDecode, RANGECMP, 140)->Arg(8)->Arg(16)->Arg(24)->Arg(32)->Arg(64);
@@ -0,0 +1,131 @@
+// RINEX writer: the cost of push() on the reader thread and the epochs per
+// second the writer thread sustains, 40 satellites x 2 signals per epoch
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <benchmark/benchmark.h>
+
+#include "rinex_writer.h"
+
+#define BENCH_OBSERVATIONS  80
+#define BENCH_WEEK          2200
+// Epochs written by each writer throughput iteration (100 s at 20 Hz)
+#define BENCH_RINEX_EPOCHS  2000
+
+static std::vector<novatel_gps::RangeInformation> Observations()
+{
+    std::vector<novatel_gps::RangeInformation> ranges(BENCH_OBSERVATIONS);
+    for(int i = 0; i < BENCH_OBSERVATIONS; ++i)
+    {
+        // 20 GPS, 10 Galileo, 10 GLONASS satellites on two signals each
+        int s = i/2;
+        uint32_t system = (s < 20) ? 0 : (s < 30) ? 3 : 1;
+        uint32_t signal = (i & 1) ? ((system == 3) ? 12 : (system == 1) ? 1 : 9) : ((system == 3) ? 2 : 0);
+        ranges[i].prn_slot = (system == 1) ? 38 + s - 30 : (system == 3) ? 1 + s - 20 : 1 + s;
+        ranges[i].ch_tr_status = 0x00000C00 | (system << 16) | (signal << 21);
+        ranges[i].psr = 2.2e7 + 1000.0*i;
+        ranges[i].adr = -1.1e8 - 1000.0*i;
+        ranges[i].doppler = -1234.5;
+        ranges[i].c_no = 45.0;
+        ranges[i].slip = 0;
+    }
+    return ranges;
+}
+
+static std::string TempDirectory()
+{
+    char path[] = "/tmp/bench_rinex_XXXXXX";
+    return mkdtemp(path) ? path : "";
+}
+
+// Removes the directory and its files, returns the bytes they held
+static uint64_t RemoveDirectory(const std::string& directory)
+{
+    uint64_t bytes = 0;
+    DIR* dir = opendir(directory.c_str());
+    if(dir)
+    {
+        while(struct dirent* entry = readdir(dir))
+        {
+            if(entry->d_name[0] == '.')
+                continue;
+            std::string path = directory + "/" + entry->d_name;
+            struct stat st;
+            if(stat(path.c_str(), &st) == 0)
+                bytes += st.st_size;
+            unlink(path.c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(directory.c_str());
+    return bytes;
+}
+
+// Time per push() with the writer keeping up: the wait for the queue to
+// drain every half ring is not timed. The writer sets the wall time, so the
+// iterations are fixed rather than grown to the minimum CPU time.
+static void BM_RinexPush(benchmark::State& state)
+{
+    std::string directory = TempDirectory();
+    std::vector<novatel_gps::RangeInformation> ranges = Observations();
+    double approx[3] = { 4115000.0, -4550000.0, -1722000.0 };
+    {
+        RinexWriter writer(directory, "bench");
+        uint64_t pushed = 0;
+        for(auto _ : state)
+        {
+            writer.push(BENCH_WEEK, 345600.0 + pushed*0.05, ranges.data(), BENCH_OBSERVATIONS, approx);
+            if(++pushed % (RINEX_QUEUE_EPOCHS/2) == 0)
+            {
+                state.PauseTiming();
+                while(writer.stats().epochs + RINEX_QUEUE_EPOCHS/2 < pushed)
+                    std::this_thread::yield();
+                state.ResumeTiming();
+            }
+        }
+        if(writer.stats().dropped != 0)
+            state.SkipWithError("epochs dropped");
+    }
+    RemoveDirectory(directory);
+}
+BENCHMARK(BM_RinexPush)->Iterations(10000);
+
+// Wall time to push and write BENCH_RINEX_EPOCHS epochs, pushing as fast as
+// the queue allows, file closed included. epochs: epochs per second written.
+static void BM_RinexWriter(benchmark::State& state)
+{
+    std::vector<novatel_gps::RangeInformation> ranges = Observations();
+    double approx[3] = { 4115000.0, -4550000.0, -1722000.0 };
+    uint64_t bytes = 0, dropped = 0;
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        std::string directory = TempDirectory();
+        state.ResumeTiming();
+        {
+            RinexWriter writer(directory, "bench");
+            for(uint64_t pushed = 0; pushed < BENCH_RINEX_EPOCHS; ++pushed)
+            {
+                while(writer.stats().epochs + RINEX_QUEUE_EPOCHS - 1 <= pushed)
+                    std::this_thread::yield();
+                writer.push(BENCH_WEEK, 345600.0 + pushed*0.05, ranges.data(), BENCH_OBSERVATIONS, approx);
+            }
+            while(writer.stats().epochs < BENCH_RINEX_EPOCHS)
+                std::this_thread::yield();
+            dropped += writer.stats().dropped;
+        }
+        state.PauseTiming();
+        bytes += RemoveDirectory(directory);
+        state.ResumeTiming();
+    }
+    if(dropped != 0)
+        state.SkipWithError("epochs dropped");
+    state.SetBytesProcessed(bytes);
+    state.counters["epochs"] = benchmark::Counter(state.iterations()*BENCH_RINEX_EPOCHS, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_RinexWriter)->UseRealTime()->Unit(benchmark::kMillisecond);
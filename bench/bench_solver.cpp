@@ -0,0 +1,75 @@
+// PointSolver::solve() per epoch over the GPS satellites in view of a full
+// constellation, warm (from the previous fix, as in the driver) and cold
+
+#include <cmath>
+#include <benchmark/benchmark.h>
+
+#include "geodesy.h"
+#include "point_solver.h"
+
+#define ORBIT_RADIUS        26560e3
+#define ORBIT_PERIOD        43082.0
+
+// SATXYZ and RANGE of the satellites above the horizon, ranges without the
+// Sagnac term or noise: the solver still iterates the same way
+static void Epoch(const double receiver[3], SatelliteTable* table)
+{
+    double radius = std::sqrt(receiver[0]*receiver[0] + receiver[1]*receiver[1] + receiver[2]*receiver[2]);
+    table->beginSatXYZ();
+    table->beginRange();
+    for(int i = 0; i < 32; ++i)
+    {
+        double inclination = 55.0*DEG2RAD;
+        double node = (i % 6)*60.0*DEG2RAD;
+        double u = (i/6)*0.8 + i*0.37 + 1000.0*2.0*M_PI/ORBIT_PERIOD;
+        double x = ORBIT_RADIUS*std::cos(u);
+        double y = ORBIT_RADIUS*std::sin(u);
+
+        novatel_gps::SatXYZInformation satellite;
+        satellite.prn_slot = i + 1;
+        satellite.position.x = x*std::cos(node) - y*std::cos(inclination)*std::sin(node);
+        satellite.position.y = x*std::sin(node) + y*std::cos(inclination)*std::cos(node);
+        satellite.position.z = y*std::sin(inclination);
+
+        double d[3] = { satellite.position.x - receiver[0], satellite.position.y - receiver[1],
+                        satellite.position.z - receiver[2] };
+        double range = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        if(d[0]*receiver[0] + d[1]*receiver[1] + d[2]*receiver[2] < 0.0)
+            continue;
+
+        novatel_gps::RangeInformation observation;
+        observation.prn_slot = i + 1;
+        observation.ch_tr_status = 0x00000400;      // GPS L1 C/A, phase locked
+        observation.psr = range + 1234.5;
+        observation.psr_std = 1.0 + (i % 3);
+        table->update(satellite);
+        table->update(observation);
+    }
+}
+
+// solve: time per epoch. satellites: GPS ranges used.
+static void BM_PointSolve(benchmark::State& state, bool warm)
+{
+    double receiver[3];
+    LlaToEcef(-15.765824*DEG2RAD, -47.872109*DEG2RAD, 1050.0, receiver);
+    SatelliteTable table;
+    Epoch(receiver, &table);
+
+    PointSolver solver;
+    PointFix fix;
+    int64_t solved = 0;
+    for(auto _ : state)
+    {
+        if(!warm)
+            solver = PointSolver();
+        solved += solver.solve(table, &fix);
+        benchmark::DoNotOptimize(fix.position);
+    }
+    if(solved != state.iterations())
+        state.SkipWithError("no solution");
+    state.counters["solve"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["satellites"] = fix.satellites;
+    state.counters["iterations"] = fix.iterations;
+}
+BENCHMARK_CAPTURE(BM_PointSolve, warm, true);
+BENCHMARK_CAPTURE(BM_PointSolve, cold, false);
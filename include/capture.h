@@ -0,0 +1,128 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Raw receiver captures: <name> holds the bytes exactly as read from the port,
+// <name>.idx a header followed by one CaptureIndexEntry per decoded frame.
+
+#define CAPTURE_INDEX_MAGIC     "NVTLIDX"
+#define CAPTURE_INDEX_VERSION   1
+
+struct CaptureIndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+};
+
+struct CaptureIndexEntry
+{
+    uint64_t offset;    // Frame start in the capture
+    int64_t stamp_ns;   // Host time (CLOCK_REALTIME) the frame's last byte was read
+    uint16_t msg_id;
+    uint16_t length;    // Header + body + CRC
+    uint32_t reserved;
+};
+
+// File written through a shared mapping, so an append is a memcpy and
+// write-back is left to the kernel. Only a window of one chunk is mapped;
+// a background thread extends the file, maps and populates the next window
+// and unmaps the previous one, so the writer only switches pointers and at
+// most two chunks are resident (and locked, under mlockall) at a time.
+// chunk must be a multiple of the page size.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    bool open(const std::string& path, size_t chunk);
+    bool append(const void* data, size_t size);
+    void close();
+    size_t size() const { return size_; }
+
+private:
+    // Window at file offset base_, mapped and populated
+    uint8_t* mapWindow(size_t base);
+    bool advance();
+    void prepareLoop();
+
+    int fd_;
+    size_t size_;
+    size_t chunk_;
+
+    // Written by the appending thread only
+    uint8_t* window_;
+    size_t base_;
+
+    // Shared with the background thread
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    uint8_t* next_;             // Window at base_ + chunk_, NULL until mapped
+    uint8_t* retired_;          // Window to unmap
+    bool failed_;
+    bool stop_;
+    std::thread thread_;
+};
+
+class CaptureRecorder
+{
+public:
+    // Throws std::runtime_error if the files cannot be created
+    explicit CaptureRecorder(const std::string& path);
+    ~CaptureRecorder();
+
+    bool write(const uint8_t* data, size_t size);
+    bool addFrame(uint64_t offset, int64_t stamp_ns, uint16_t msg_id, uint16_t length);
+    void close();
+
+private:
+    MappedFile data_;
+    MappedFile index_;
+};
+
+// Serves a capture as if it came from the port. With an index, bytes are
+// released when the frames they end were received, scaled by speed
+// (1 = real time, 2 = twice as fast); speed <= 0 replays as fast as possible.
+class CaptureReplay
+{
+public:
+    // Throws std::runtime_error if the capture cannot be opened
+    CaptureReplay(const std::string& path, double speed);
+    ~CaptureReplay();
+
+    // Bytes copied, 0 when nothing is due within timeout_us, -1 at the end
+    int read(uint8_t* buffer, int size, int timeout_us);
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    const CaptureIndexEntry* index() const { return index_; }
+    size_t entries() const { return entries_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    const uint8_t* index_map_;
+    size_t index_map_size_;
+    const CaptureIndexEntry* index_;
+    size_t entries_;
+
+    double speed_;
+    size_t pos_;
+    size_t next_;
+    int64_t start_ns_;
+};
+
+// Offset of the first frame at or after pos with a valid sync, length and CRC,
+// size if there is none. Splits a capture on frame starts for decoding the
+// parts in parallel (gps_decode).
+size_t CaptureNextFrame(const uint8_t* data, size_t size, size_t pos);
+
+// CLOCK_REALTIME in nanoseconds
+int64_t CaptureClockNs();
+
+#endif // CAPTURE_H
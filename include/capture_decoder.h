@@ -0,0 +1,88 @@
+#ifndef CAPTURE_DECODER_H
+#define CAPTURE_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "novatel_gps/GpsXYZ.h"
+#include "novatel_gps/LogAll.h"
+#include "capture.h"
+#include "log_archive.h"
+
+// Decodes a capture in parallel for gps_decode. The capture is cut into parts
+// of a fixed size on verified frame starts; each part gets a fresh GPS that
+// first decodes the bytes before it (the warm-up, output discarded) so the
+// state carried between epochs, such as the cycle-slip detector's, is the one
+// a single pass would have. Parts are handed out in capture order, so the
+// output does not depend on the number of threads.
+
+struct CaptureDecodeOptions
+{
+    int threads;
+    size_t part;            // Bytes
+    size_t warmup;          // Bytes
+    int chunk_rows;
+    // Outputs to produce
+    bool bag;
+    bool csv;
+    bool archive;
+    std::string frame_id;   // Of the bag messages
+};
+
+// Decoding starts at warmup, output at begin; all three are frame starts
+struct CapturePart
+{
+    size_t warmup;
+    size_t begin;
+    size_t end;
+};
+
+// Archive rows as CSV lines, one text per table, formatted like gps_archive
+class CsvSink : public ArchiveSink
+{
+public:
+    bool append(int table, const double* values);
+
+    std::string text[ARCHIVE_TABLES];
+};
+
+// What one part decoded. The parser's archive rows go to the encoder and/or
+// the CSV text.
+struct CapturePartOutput : public ArchiveSink
+{
+    bool append(int table, const double* values);
+
+    std::unique_ptr<ArchiveEncoder> archive;
+    std::unique_ptr<CsvSink> csv;
+    // Bag messages as gps_node publishes them: cart per BESTXYZ, all per
+    // RANGE/RANGECMP; topic_all[i] says which vector the i-th comes from
+    std::vector<bool> topic_all;
+    std::vector<novatel_gps::GpsXYZ> cart;
+    std::vector<novatel_gps::LogAll> all;
+    uint64_t frames;
+    uint64_t crc_errors;
+};
+
+// Writes one part's output; false if that failed
+typedef std::function<bool(const CapturePartOutput& output)> CapturePartWriter;
+
+// Parts of options.part bytes, each boundary moved forward to the next frame
+// start. The warm-up start is found the same way from options.warmup bytes
+// before the part, so boundaries depend only on the capture and the sizes.
+std::vector<CapturePart> SplitCapture(const uint8_t* data, size_t size, const CaptureDecodeOptions& options);
+
+void DecodeCapturePart(const CaptureReplay& capture, const CapturePart& part,
+                       const CaptureDecodeOptions& options, CapturePartOutput* output);
+
+// Decodes the parts on options.threads threads and passes their outputs to
+// write on the calling thread, in part order. Workers stay at most two parts
+// per thread ahead of the one being written, which bounds the decoded output
+// held in memory. False if a write failed.
+bool DecodeCapture(const CaptureReplay& capture, const std::vector<CapturePart>& parts,
+                   const CaptureDecodeOptions& options, const CapturePartWriter& write);
+
+#endif // CAPTURE_DECODER_H
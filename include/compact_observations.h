@@ -0,0 +1,90 @@
+#ifndef COMPACT_OBSERVATIONS_H
+#define COMPACT_OBSERVATIONS_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "novatel_gps/MsgHeader.h"
+#include "novatel_gps/Range.h"
+#include "novatel_gps/TrackStat.h"
+#include "novatel_gps/CompactRange.h"
+#include "novatel_gps/CompactTrackStat.h"
+#include "satellite_table.h"
+
+// Delta coding of RANGE and TRACKSTAT for narrow links (CompactRange.msg,
+// CompactTrackStat.msg). Encoder and decoder keep the same state, the values
+// of the previous epochs per satellite and signal (RANGE) or per channel
+// (TRACKSTAT), and code every value as the zigzag varint of its bit pattern
+// minus a prediction from that state, so decoding is exact. Fixed-size
+// state, O(1) per observation.
+
+// Latest values of one satellite and signal, or one channel. Two epochs of the
+// predicted fields for a linear prediction.
+struct CompactTrack
+{
+    uint64_t psr[2];
+    uint64_t adr[2];
+    uint32_t doppler[2];
+    uint32_t locktime[2];
+    uint32_t psr_std;           // cn0 for TRACKSTAT
+    uint32_t adr_std;           // psr_res for TRACKSTAT
+    uint32_t c_no;              // psr_weight for TRACKSTAT
+    uint32_t ch_tr_status;      // Of the channel, TRACKSTAT only
+    uint32_t reject;
+    int16_t prn;
+    uint8_t history;            // Consecutive epochs in the arrays, up to 2
+    uint32_t sequence;          // Message that last updated it
+};
+
+// State shared by the encoder and the decoder, emptied by key messages
+class CompactState
+{
+public:
+    CompactState();
+
+protected:
+    void resetRange();
+    void resetTrackStat();
+
+    // RANGE: ch_tr_status per PRN/slot number and order within the epoch
+    // (the system is in the word itself), the rest per satellite
+    // (SatelliteIndex(), satellites outside the table share the last entry)
+    // and signal slot
+    uint32_t status_[MAX_PRN_SLOT][MAX_SIGNALS];
+    CompactTrack range_[MAX_SATELLITES + 1][MAX_SIGNALS];
+    std::vector<CompactTrack> channels_;
+    uint32_t range_sequence_;
+    uint32_t track_sequence_;
+};
+
+class CompactEncoder : public CompactState
+{
+public:
+    // A key message every key_interval messages (1: all of them)
+    explicit CompactEncoder(int key_interval);
+
+    void encode(const novatel_gps::MsgHeader& header, const novatel_gps::Range& range,
+                novatel_gps::CompactRange* output);
+    void encode(const novatel_gps::MsgHeader& header, const novatel_gps::TrackStat& tracking,
+                novatel_gps::CompactTrackStat* output);
+
+private:
+    uint32_t key_interval_;
+};
+
+// Messages must be given in order. After a lost or malformed message decode()
+// returns false until the next key message; output is then incomplete.
+class CompactDecoder : public CompactState
+{
+public:
+    CompactDecoder();
+
+    bool decode(const novatel_gps::CompactRange& input, novatel_gps::Range* output);
+    bool decode(const novatel_gps::CompactTrackStat& input, novatel_gps::TrackStat* output);
+
+private:
+    bool range_synced_;
+    bool track_synced_;
+};
+
+#endif // COMPACT_OBSERVATIONS_H
@@ -0,0 +1,102 @@
+#ifndef CORRECTIONS_H
+#define CORRECTIONS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+// RTCM3 CRC-24Q over len bytes
+uint32_t CalculateCRC24Q(const uint8_t* data, size_t len);
+
+// Splits an RTCM3 byte stream into whole messages (0xD3, 10 bit length,
+// payload, CRC-24Q). Bytes outside valid messages are skipped.
+class RtcmFramer
+{
+public:
+    typedef std::function<void(const uint8_t* message, size_t size)> MessageCallback;
+
+    RtcmFramer() : crc_errors_(0) {}
+    void feed(const uint8_t* data, size_t size, const MessageCallback& callback);
+    uint32_t crcErrors() const { return crc_errors_; }
+
+private:
+    std::vector<uint8_t> buffer_;
+    uint32_t crc_errors_;
+};
+
+struct CorrectionStats
+{
+    uint64_t messages;          // Written to the port
+    uint64_t bytes;
+    uint64_t dropped_stale;     // Older than max_age when their turn came
+    uint64_t dropped_overflow;  // Pushed out of a full queue
+    size_t queue_messages;
+    size_t queue_bytes;
+    double last_age;            // Seconds from arrival to written, last message
+    double max_age;             // Largest since the last stats() call
+};
+
+// Writes correction messages to the receiver port from its own thread, so
+// the reader never waits on it. The queue is bounded: when full the oldest
+// message goes, and messages older than max_age are dropped unsent since
+// stale corrections only hurt the RTK solution.
+class CorrectionWriter
+{
+public:
+    CorrectionWriter(int fd, double max_age, size_t max_queue_bytes);
+    ~CorrectionWriter();
+
+    void push(const uint8_t* message, size_t size);
+    CorrectionStats stats();
+
+private:
+    struct Message
+    {
+        std::vector<uint8_t> data;
+        int64_t arrival_ns;
+    };
+
+    void run();
+    bool writeAll(const uint8_t* data, size_t size);
+
+    int fd_;
+    int64_t max_age_ns_;
+    size_t max_queue_bytes_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Message> queue_;
+    size_t queue_bytes_;
+    CorrectionStats stats_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+// Reads corrections from tcp://host:port, udp://:port or file:///path and
+// feeds them to a writer. Sockets, named pipes and devices are reopened when
+// they close; a regular file is read once, its end is the end of the stream.
+class CorrectionSource
+{
+public:
+    CorrectionSource(const std::string& url, CorrectionWriter* writer);
+    ~CorrectionSource();
+
+private:
+    void run();
+    int connect();
+
+    std::string url_;
+    CorrectionWriter* writer_;
+    RtcmFramer framer_;
+    bool regular_file_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+#endif // CORRECTIONS_H
@@ -0,0 +1,9 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+
+// NovAtel CRC-32 of a block (the value is sent little-endian after the log)
+uint32_t CalculateBlockCRC32(uint32_t ulCount, const uint8_t *ucBuffer);
+
+#endif // CRC32_H
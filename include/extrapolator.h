@@ -0,0 +1,58 @@
+#ifndef EXTRAPOLATOR_H
+#define EXTRAPOLATOR_H
+
+#include <stdint.h>
+#include <mutex>
+
+#include "solution_history.h"
+
+// BESTXYZ propagated to a later host time
+struct ExtrapolatedPose
+{
+    double host_time;           // Time the pose is for (CLOCK_REALTIME, s)
+    double gps_time;
+    double age;                 // Seconds since the fix it comes from
+    double position[3];         // ECEF (m)
+    double velocity[3];
+    double position_var[3];     // m^2
+    double velocity_var[3];     // (m/s)^2
+    uint16_t position_type;
+};
+
+// Propagates the latest fix forward by its velocity, for consumers running
+// faster than the receiver. BESTXYZ velocities are averages that lag the
+// position by the reported latency, so the velocity is first brought forward
+// to the fix time with the acceleration seen between the last two fixes.
+// Variances grow with the elapsed time as for a constant velocity model
+// driven by white acceleration noise. Each fix replaces the state, nothing is
+// filtered across fixes. Fixed size and allocation-free; thread-safe.
+class PoseExtrapolator
+{
+public:
+    PoseExtrapolator();
+
+    // max_age: longest propagation (s); accel_noise: acceleration sigma (m/s^2)
+    void configure(double max_age, double accel_noise);
+
+    // A computed BESTXYZ; velocity_latency is its BXYZ_VLATE (s)
+    void addFix(const SolutionSample& fix, double velocity_latency, int64_t receive_ns);
+    // Stops output until the next computed fix
+    void invalidate();
+
+    // Pose at host time stamp_ns; false with no fix or one older than max_age
+    bool at(int64_t stamp_ns, ExtrapolatedPose* out) const;
+
+private:
+    mutable std::mutex mutex_;
+    double max_age_;
+    double accel_var_;
+
+    SolutionSample fix_;
+    bool valid_;
+    double previous_time_;
+    double previous_velocity_[3];
+    bool have_previous_;
+    HostClockOffset host_offset_;
+};
+
+#endif // EXTRAPOLATOR_H
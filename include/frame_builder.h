@@ -0,0 +1,33 @@
+#ifndef FRAME_BUILDER_H
+#define FRAME_BUILDER_H
+
+#include <stdint.h>
+#include <vector>
+
+// Synthetic NovAtel binary logs with valid CRCs, laid out as in the Firmware
+// Reference Manual. Used to feed the parser without a receiver attached.
+
+// Appends a long (28 byte) header frame: header + body + CRC
+void BuildFrame(uint16_t msg_id, const std::vector<uint8_t>& body, uint16_t week, uint32_t ms,
+                std::vector<uint8_t>* frame);
+
+// Appends a short (12 byte) header frame, bodies must be under 256 bytes
+void BuildShortFrame(uint16_t msg_id, const std::vector<uint8_t>& body, uint16_t week, uint32_t ms,
+                     std::vector<uint8_t>* frame);
+
+// Log bodies. The observation logs are filled with plausible pseudo-random
+// values that depend only on seed, so the same arguments give the same bytes.
+void BuildBestXYZBody(const double position[3], const double velocity[3], std::vector<uint8_t>* body);
+void BuildBestPosBody(double latitude, double longitude, double height, std::vector<uint8_t>* body);
+void BuildRangeBody(int obs, uint32_t seed, std::vector<uint8_t>* body);
+void BuildRangeCmpBody(int obs, uint32_t seed, std::vector<uint8_t>* body);
+void BuildSatXYZBody(int sats, uint32_t seed, std::vector<uint8_t>* body);
+void BuildTrackStatBody(int channels, uint32_t seed, std::vector<uint8_t>* body);
+
+// SPAN logs; velocity is north/east/up, attitude roll/pitch/azimuth (deg)
+void BuildInsPvaBody(uint32_t week, double seconds, double latitude, double longitude, double height,
+                     const double velocity[3], const double attitude[3], std::vector<uint8_t>* body);
+void BuildCorrImuDataBody(uint32_t week, double seconds, const double angular[3], const double linear[3],
+                          std::vector<uint8_t>* body);
+
+#endif // FRAME_BUILDER_H
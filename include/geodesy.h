@@ -0,0 +1,33 @@
+#ifndef GEODESY_H
+#define GEODESY_H
+
+// WGS84 ellipsoid
+#define WGS84_A     6378137.0
+#define WGS84_F     (1.0/298.257223563)
+#define WGS84_E2    (WGS84_F*(2.0 - WGS84_F))
+
+#define DEG2RAD     (M_PI/180.0)
+#define RAD2DEG     (180.0/M_PI)
+
+// Geodetic (rad, rad, m) to ECEF (m)
+void LlaToEcef(double lat, double lon, double h, double ecef[3]);
+
+// ECEF (m) to geodetic (rad, rad, m), closed form (Vermeille 2004): no
+// iteration, well under a micrometre from the surface up to orbit altitudes.
+// Not valid within ~43 km of the Earth's centre.
+void EcefToLla(const double ecef[3], double* lat, double* lon, double* h);
+
+// Rotation from ECEF to the local East-North-Up frame at (lat, lon), row major
+void EnuRotation(double lat, double lon, double R[9]);
+
+// ECEF point to ENU coordinates about origin_ecef, R from EnuRotation()
+void EcefToEnu(const double ecef[3], const double origin_ecef[3], const double R[9], double enu[3]);
+
+// R*C*R^T for 3x3 row-major matrices, e.g. an ECEF covariance into ENU
+void RotateCovariance(const double R[9], const double C[9], double out[9]);
+
+// SPAN attitude (deg) to an ENU quaternion (x, y, z, w). Azimuth is clockwise
+// from north, the vehicle frame is x right, y forward, z up.
+void AttitudeToQuaternion(double roll, double pitch, double azimuth, double q[4]);
+
+#endif // GEODESY_H
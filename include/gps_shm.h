@@ -0,0 +1,119 @@
+#ifndef GPS_SHM_H
+#define GPS_SHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* --------------------------------------------------------------------------
+Shared-memory solution ring (POSIX shm, /dev/shm/<name>), usable from C.
+
+The segment is a GpsShmHeader followed by capacity GpsShmSolution slots. The
+driver is the only writer: solution n goes to slot n % capacity under a
+per-slot seqlock (sequence odd while it is written), then header.count
+becomes n + 1. Readers never block the writer and never wait on it; a read
+that overlaps a write is detected and retried a bounded number of times.
+
+Any change to the structures below bumps GPS_SHM_VERSION; fields are only
+ever added in the reserved space.
+-------------------------------------------------------------------------- */
+
+#define GPS_SHM_MAGIC       0x4D485347u     /* "GSHM" in memory order */
+#define GPS_SHM_VERSION     1
+#define GPS_SHM_DEFAULT     "/novatel_gps"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct GpsShmHeader
+{
+    uint32_t magic;             /* GPS_SHM_MAGIC, written last by the creator */
+    uint16_t version;           /* GPS_SHM_VERSION */
+    uint16_t header_size;       /* sizeof(GpsShmHeader) */
+    uint32_t slot_size;         /* sizeof(GpsShmSolution) */
+    uint32_t capacity;          /* Slots in the ring */
+    int32_t writer_pid;
+    uint32_t active;            /* Cleared when the writer closes the segment */
+    uint64_t count;             /* Solutions published, the latest is index count - 1 */
+    uint8_t reserved[32];
+} GpsShmHeader;
+
+typedef struct GpsShmSolution
+{
+    uint64_t sequence;          /* Seqlock, odd while the slot is being written */
+    uint64_t index;             /* Solution number */
+    int64_t receive_ns;         /* Host CLOCK_REALTIME when the frame's last byte was read */
+    int64_t publish_ns;         /* Host CLOCK_REALTIME when it was written here */
+    uint32_t gps_week;
+    uint32_t gps_ms;
+    uint16_t msg_id;            /* Log that produced this update, BESTXYZ (241) or BESTPOS (42) */
+    uint16_t position_status;   /* Solution status of that log */
+    uint16_t position_type;
+    uint16_t velocity_status;
+    uint16_t velocity_type;
+    uint8_t satellites_tracked;
+    uint8_t satellites_used;
+    uint32_t reserved0;
+
+    /* Latest BESTXYZ */
+    double position[3];         /* ECEF (m) */
+    double velocity[3];         /* ECEF (m/s) */
+    float position_sigma[3];
+    float velocity_sigma[3];
+
+    /* Latest BESTPOS */
+    double latitude;            /* deg */
+    double longitude;           /* deg */
+    double height;              /* m above mean sea level */
+    float latitude_sigma;       /* m */
+    float longitude_sigma;
+    float height_sigma;
+    uint32_t reserved1;
+
+    uint8_t reserved[24];
+} GpsShmSolution;
+
+/* A mapped segment, writer or reader side */
+typedef struct GpsShm
+{
+    int fd;
+    size_t size;
+    GpsShmHeader* header;
+    GpsShmSolution* slots;
+    int writer;
+    char name[64];
+} GpsShm;
+
+/* Writer. Replaces any segment of that name (readers of the old one see
+   active == 0). Return 0 or -errno. */
+int GpsShmCreate(GpsShm* shm, const char* name, uint32_t capacity);
+
+/* Stamps solution (sequence, index, publish_ns) and makes it the latest */
+void GpsShmPublish(GpsShm* shm, GpsShmSolution* solution);
+
+/* Reader. Returns 0, -errno, or -EPROTO for a layout/version mismatch
+   (-EAGAIN while the writer is still initialising the segment). */
+int GpsShmOpen(GpsShm* shm, const char* name);
+
+/* Unmaps; the writer also marks the segment inactive and unlinks it */
+void GpsShmClose(GpsShm* shm);
+
+/* Solutions published so far, a cheap change check for pollers */
+uint64_t GpsShmCount(const GpsShm* shm);
+
+/* Copies the latest solution. Returns 1, 0 if none yet, -EAGAIN if the
+   writer lapped the reader on every attempt. */
+int GpsShmReadLatest(const GpsShm* shm, GpsShmSolution* out);
+
+/* Copies up to max of the most recent solutions, newest first, stopping
+   at the first that has been overwritten. Returns the number copied. */
+int GpsShmReadHistory(const GpsShm* shm, GpsShmSolution* out, int max);
+
+/* 1 while the writer is attached and its process exists */
+int GpsShmWriterAlive(const GpsShm* shm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GPS_SHM_H */
@@ -0,0 +1,45 @@
+#ifndef HATCH_FILTER_H
+#define HATCH_FILTER_H
+
+#include <stdint.h>
+
+#include "novatel_gps/RangeInformation.h"
+#include "satellite_table.h"
+
+// Hatch carrier smoothing of the pseudorange of every satellite (system and
+// PRN, SatelliteIndex()) and signal slot:
+//   P_n = psr/n + (n - 1)/n * (P_n-1 + phase change since the last epoch)
+// with n growing to the window. Restarts from the raw pseudorange on any
+// slip flag (see slip_detector.h), so update() must see the flags. Single
+// frequency: the ionosphere makes code and carrier diverge, which biases the
+// output by about the window times the ionospheric rate. Fixed size, O(1)
+// per observation, no allocation.
+class HatchFilter
+{
+public:
+    HatchFilter();
+
+    // window: most observations averaged, 0 or 1 passes psr through
+    void configure(int window);
+
+    // gps_time: epoch of the RANGE log, a repeated epoch is ignored
+    void update(const novatel_gps::RangeInformation& range, double gps_time);
+
+    // Latest smoothed pseudorange of range's satellite and signal; length
+    // (optional) is the observations averaged
+    double smoothed(const novatel_gps::RangeInformation& range, int* length = NULL) const;
+
+private:
+    struct Smoothing
+    {
+        double psr;         // Smoothed (m)
+        double phase;       // Latest carrier phase (m)
+        double time;        // GPS seconds of the latest update
+        int length;
+    };
+
+    Smoothing filters_[MAX_SATELLITES][MAX_SIGNALS];    // By SatelliteIndex()
+    int window_;
+};
+
+#endif // HATCH_FILTER_H
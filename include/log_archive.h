@@ -0,0 +1,260 @@
+#ifndef LOG_ARCHIVE_H
+#define LOG_ARCHIVE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// Columnar archive of decoded logs, one table per log with a fixed schema.
+// The file is a header, then chunks of up to chunk_rows rows of one table
+// each, then (after a clean close) an index of the chunks and a trailer.
+// Each chunk stores its columns one after the other with their end offsets
+// up front, so a reader maps the file, picks chunks by their time range and
+// satellite mask and decodes only the columns it needs. Integers are delta coded
+// as zigzag varints, floats and doubles XORed with the previous value of the
+// column and stored without their zero bytes. Without a trailer (writer
+// killed) the index is rebuilt by walking the chunks and checking their CRC.
+// Little-endian, as written by the host.
+
+#define ARCHIVE_MAGIC           "NVTLARC"
+#define ARCHIVE_INDEX_MAGIC     "NVTLAIX"
+#define ARCHIVE_VERSION         2
+#define ARCHIVE_CHUNK_MAGIC     0x4b4e4843      // "CHNK"
+// One bit per satellite (SatelliteIndex(), the system from ch_tr_status,
+// SATXYZ is GPS); satellites outside the table share bit MAX_SATELLITES
+#define ARCHIVE_SATELLITE_WORDS 4
+// Full chunks queued between the reader and the writer thread
+#define ARCHIVE_QUEUE_CHUNKS    8
+
+enum ArchiveTable
+{
+    ARCHIVE_BESTXYZ,
+    ARCHIVE_RANGE,          // RANGE and RANGECMP
+    ARCHIVE_TRACKSTAT,
+    ARCHIVE_SATXYZ,
+    ARCHIVE_TABLES
+};
+
+enum ArchiveType
+{
+    ARCHIVE_INT,            // Up to 64 bits, delta + zigzag varint
+    ARCHIVE_FLOAT,          // XOR of the 32 bit patterns
+    ARCHIVE_DOUBLE          // XOR of the 64 bit patterns
+};
+
+struct ArchiveColumn
+{
+    const char* name;
+    ArchiveType type;
+};
+
+// Column 0 is "time" (ms since the GPS epoch); per-satellite logs have
+// "prn_slot" as column 1
+struct ArchiveSchema
+{
+    const char* name;
+    int columns;
+    const ArchiveColumn* column;
+    bool satellites;
+};
+
+const ArchiveSchema& ArchiveTableSchema(int table);
+// Table or column index by name, -1 if there is none
+int ArchiveFindTable(const std::string& name);
+int ArchiveFindColumn(int table, const std::string& name);
+
+struct ArchiveFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+// Followed by uint32 column end offsets (from the end of the offsets) and the
+// column data
+struct ArchiveChunkHeader
+{
+    uint32_t magic;
+    uint16_t table;
+    uint16_t columns;
+    uint32_t rows;
+    uint32_t size;                      // Whole chunk, header included
+    int64_t first_ms;                   // Time span of the rows
+    int64_t last_ms;
+    uint64_t satellite_mask[ARCHIVE_SATELLITE_WORDS];
+    uint32_t crc;                       // NovAtel CRC-32 of what follows the header
+    uint32_t reserved;
+};
+
+struct ArchiveIndexEntry
+{
+    uint64_t offset;                    // Chunk header in the file
+    uint32_t table;
+    uint32_t rows;
+    int64_t first_ms;
+    int64_t last_ms;
+    uint64_t satellite_mask[ARCHIVE_SATELLITE_WORDS];
+};
+
+struct ArchiveTrailer
+{
+    uint64_t index_offset;
+    uint64_t entries;
+    char magic[8];
+};
+
+// Formats a value of a column the way gps_archive prints it: time as
+// WEEK:SECONDS, integers without decimals, floats and doubles with enough
+// digits to read them back. Returns the snprintf() result.
+int ArchiveFormatValue(int table, int column, double value, char* text, size_t size);
+
+// Where GPS::archiveLog() puts the rows of each decoded log
+class ArchiveSink
+{
+public:
+    virtual ~ArchiveSink() {}
+    // values: one per column of the table's schema, in order. False once the
+    // sink has failed.
+    virtual bool append(int table, const double* values) = 0;
+};
+
+// Encodes chunks into memory instead of a file, so several threads can each
+// encode part of a capture (gps_decode) and the blocks be written in order
+// with ArchiveWriter::appendEncoded(). Index offsets are into data().
+class ArchiveEncoder : public ArchiveSink
+{
+public:
+    explicit ArchiveEncoder(int chunk_rows);
+
+    bool append(int table, const double* values);
+    // Encodes the partial chunks
+    void flush();
+
+    const std::vector<uint8_t>& data() const { return data_; }
+    const std::vector<ArchiveIndexEntry>& index() const { return index_; }
+    uint64_t rows() const { return rows_; }
+
+private:
+    size_t chunk_rows_;
+    std::vector<double> filling_[ARCHIVE_TABLES];   // Column-major
+    size_t filled_[ARCHIVE_TABLES];
+    std::vector<uint8_t> data_;
+    std::vector<ArchiveIndexEntry> index_;
+    uint64_t rows_;
+};
+
+// Buffers rows per table; a full chunk is swapped into a fixed ring and a
+// background thread encodes it and writes it with one write(), so appending
+// is a copy of the row. Chunks arriving with the ring full are dropped and
+// counted. append() is for a single thread (the reader).
+class ArchiveWriter : public ArchiveSink
+{
+public:
+    // Throws std::runtime_error if the file cannot be created
+    ArchiveWriter(const std::string& path, int chunk_rows);
+    // Writes the partial chunks and the index
+    ~ArchiveWriter();
+
+    // False once a write has failed, the archive then stays truncated at the
+    // last chunk
+    bool append(int table, const double* values);
+    // Writes the encoder's chunks after those queued so far, waiting for them
+    // instead of dropping; from the appending thread
+    bool appendEncoded(const ArchiveEncoder& encoder);
+    void close();
+
+    uint64_t rows() const { return rows_; }
+    uint64_t bytes() const { return bytes_; }
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    struct Chunk
+    {
+        int table;
+        size_t rows;
+        std::vector<double> values;     // Column-major, chunk_rows per column
+    };
+
+    bool queue(Chunk* chunk, bool wait);
+    void run();
+    bool writeChunk(const Chunk& chunk);
+    bool write(const void* data, size_t size);
+
+    size_t chunk_rows_;
+    std::atomic<bool> failed_;
+    std::atomic<uint64_t> rows_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> dropped_;
+
+    // Reader thread: the chunk being filled per table
+    Chunk filling_[ARCHIVE_TABLES];
+
+    // Single producer, single consumer: slots [tail_, head_) are queued
+    std::vector<Chunk> ring_;
+    uint64_t head_;
+    uint64_t tail_;
+    bool running_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    // Writer thread
+    int fd_;
+    std::vector<uint8_t> encoded_;
+    std::vector<ArchiveIndexEntry> index_;
+    std::thread thread_;
+};
+
+// Rows of one table with first_ms <= time <= last_ms, prn_slot == prn unless
+// prn < 0 and of satellite system (SATELLITE_SYSTEM) unless system < 0,
+// projected on columns
+struct ArchiveQuery
+{
+    int table;
+    int64_t first_ms;
+    int64_t last_ms;
+    int prn;
+    int system;
+    std::vector<int> columns;
+};
+
+struct ArchiveResult
+{
+    std::vector<std::vector<double> > columns;     // One per projected column
+    size_t rows;
+    size_t chunks_read;
+    size_t chunks_skipped;                      // By the index, not decoded
+
+    ArchiveResult() : rows(0), chunks_read(0), chunks_skipped(0) {}
+};
+
+// Read-only mapping of an archive. Queries are const and may run concurrently.
+class ArchiveReader
+{
+public:
+    // Throws std::runtime_error if the file is missing or not an archive
+    explicit ArchiveReader(const std::string& path);
+    ~ArchiveReader();
+
+    const std::vector<ArchiveIndexEntry>& index() const { return index_; }
+    // True when the trailer was missing and the index came from a scan
+    bool recovered() const { return recovered_; }
+    size_t size() const { return size_; }
+
+    // Appends the matching rows to result, returns how many
+    size_t query(const ArchiveQuery& query, ArchiveResult* result) const;
+
+private:
+    bool loadIndex();
+    void scan();
+
+    const uint8_t* map_;
+    size_t size_;
+    std::vector<ArchiveIndexEntry> index_;
+    bool recovered_;
+};
+
+#endif // LOG_ARCHIVE_H
@@ -3,29 +3,174 @@
 
 #include <vector>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
 
 #include "ros/ros.h"
 #include "sensor_msgs/NavSatFix.h"
+#include "sensor_msgs/Imu.h"
+#include "nav_msgs/Odometry.h"
+#include "geometry_msgs/PoseWithCovarianceStamped.h"
 #include "novatel_gps/GpsXYZ.h"
 #include "novatel_gps/MsgHeader.h"
 #include "novatel_gps/SatXYZ.h"
 #include "novatel_gps/TrackStat.h"
 #include "novatel_gps/Range.h"
 #include "novatel_gps/LogAll.h"
+#include "novatel_gps/SatelliteStateArray.h"
+#include "satellite_table.h"
+#include "satellite_geometry.h"
+#include "point_solver.h"
+#include "slip_detector.h"
+#include "hatch_filter.h"
+#include "rinex_writer.h"
+#include "log_archive.h"
+#include "novatel_gps/SmoothedRanges.h"
+#include "novatel_gps/PointSolution.h"
+#include "capture.h"
+#include "realtime.h"
+#include "gps_shm.h"
+#include "solution_history.h"
+#include "extrapolator.h"
 
 // Serial Port Headers (serialcom-termios)
 #include "serialcom.h"
 
+// Unpacks a channel tracking status word
+void DecodeTrackingStatus(uint32_t status, novatel_gps::TrackingStatus& ts);
+
+// A single LOG request sent to the receiver at start-up
+struct LogRequest
+{
+    std::string name;       // Log name without format suffix, e.g. BESTXYZ
+    std::string trigger;    // ONNEW, ONCHANGED, ONTIME or ONCE
+    double period;          // ONTIME period in seconds (<= 0 uses 1/rate)
+    double offset;          // ONTIME offset in seconds
+    int priority;           // Lower values are requested (and output) first
+};
+
+// Serial port latency settings, applied after the port is opened at its final baud rate
+struct PortTuning
+{
+    bool low_latency;       // Set ASYNC_LOW_LATENCY on the tty
+    int latency_timer;      // FTDI latency timer in ms (1-255), < 0 leaves it
+    int vmin;               // termios VMIN, < 0 leaves it
+    int vtime;              // termios VTIME in 1/10 s, < 0 leaves it
+    bool nonblocking;       // Open the port O_NONBLOCK
+
+    PortTuning() : low_latency(false), latency_timer(-1), vmin(-1), vtime(-1), nonblocking(false) {}
+};
+
+// Numeric parameter as a double; YAML writes whole numbers (rate: 20) as ints,
+// which a plain static_cast<double> rejects with an XmlRpcException
+double ToDouble(XmlRpc::XmlRpcValue& value);
+
+// Parses a `logs` parameter list, e.g. [{name: BESTXYZ, trigger: ONNEW, priority: 0}, ...]
+bool ParseLogRequests(XmlRpc::XmlRpcValue& logs, std::vector<LogRequest>* requests);
+
 class GPS
 {
 public:
+    // Called from the reader thread after each decoded frame
+    typedef std::function<void(uint16_t msg_id)> FrameCallback;
+
     GPS();
     void init(int log_id);
     void init(int log_id, std::string port, double rate);
     void close();
+    void setLogRequests(const std::vector<LogRequest>& logs);
+    void setBaudRate(int baud);
+    void setImuRate(double rate);
+    void setPortTuning(const PortTuning& tuning);
+    // Scheduling of the reader thread started by startReading()
+    void setReaderTuning(const ThreadTuning& tuning);
+    // Receiver port (COM2, ...) switched to RTCMV3 input at the end of init()
+    // for injected corrections, and back to NOVATEL by close(); empty for
+    // none. COM1, the command port, is refused: it would stop taking commands.
+    void setCorrectionInput(const std::string& port);
     void receiveDataFromGPS(sensor_msgs::NavSatFix*);
     void receiveDataFromGPS(novatel_gps::GpsXYZ*);
     void receiveDataFromGPS(novatel_gps::LogAll*, novatel_gps::GpsXYZ*);
+
+    // Streaming: decode on a reader thread and call back per frame,
+    // the getData() overloads then fill messages from the latest logs
+    void startReading(FrameCallback callback);
+    void stopReading();
+
+    // Decodes a block of raw receiver bytes (partial frames carry over to the
+    // next call), calling callback after each frame. Returns the frames decoded.
+    int parse(const uint8_t* data, size_t size, const FrameCallback& callback);
+
+    // For callers doing their own I/O on fd(): records (if enabled) and parses
+    // bytes read at stamp_ns (CLOCK_REALTIME)
+    int fd() const { return gps_SerialPortConfig_.fd; }
+    int receive(const uint8_t* data, size_t size, int64_t stamp_ns, const FrameCallback& callback);
+
+    // Counters, safe to read from any thread
+    uint64_t frameCount() const { return frames_; }
+    uint64_t byteCount() const { return bytes_; }
+    uint32_t crcErrors() const { return crc_errors_; }
+    // Bytes given to the parser so far and the latest frame's header; in a
+    // frame callback, where the frame ends and its header
+    uint64_t streamPosition() const { return stream_pos_; }
+    const novatel_gps::MsgHeader& header() const { return msg_header_; }
+
+    // Raw capture of everything read from the port; call before init()
+    void startRecording(const std::string& path);
+    // Read a capture instead of the port, init() then skips the receiver setup
+    void openReplay(const std::string& path, double speed);
+    // Publish BESTXYZ/BESTPOS solutions to a shared-memory ring (gps_shm.h);
+    // throws std::runtime_error if the segment cannot be created
+    void publishSharedMemory(const std::string& name, int capacity);
+    // Keep the last capacity BESTXYZ solutions for queries by time (0 disables)
+    void setHistory(size_t capacity, double max_gap);
+    // Thread-safe, for in-process users such as nodelets
+    const SolutionHistory& history() const { return history_; }
+    // Convert every BESTXYZ to geodetic and ENU coordinates (getGeodetic(),
+    // getData(PoseWithCovarianceStamped)), so BESTPOS is not needed
+    void setGeodetic(bool enable);
+    // ENU origin (deg, deg, m above the ellipsoid); default is the first fix
+    void setEnuOrigin(double latitude, double longitude, double height);
+    // Azimuth/elevation and DOP after every SATXYZ (see satellite_geometry.h)
+    void setGeometry(double elevation_mask, double tolerance);
+    // Cycle-slip thresholds for the RangeInformation slip flags (see
+    // slip_detector.h): cycles, m, s
+    void setSlipThresholds(double doppler, double geometry_free, double max_gap);
+    // Hatch smoothing of every RANGE/RANGECMP pseudorange over window
+    // observations, for getData(SmoothedRanges); 0 disables it
+    void setHatchWindow(int window);
+    // RINEX 3 observation files of every RANGE/RANGECMP, one per hour (see
+    // rinex_writer.h); throws std::runtime_error if directory is not writable
+    void writeRinex(const std::string& directory, const std::string& marker);
+    // Columnar archive of every BESTXYZ, RANGE/RANGECMP, TRACKSTAT and SATXYZ
+    // (see log_archive.h); throws std::runtime_error if path cannot be created
+    void writeArchive(const std::string& path, int chunk_rows);
+    // Same rows to a sink owned by the caller (NULL stops), instead of a file
+    void setArchiveSink(ArchiveSink* sink);
+    // Own single-point solution on each epoch with both RANGE (or RANGECMP) and
+    // SATXYZ (see point_solver.h), checked against BESTXYZ of the same epoch
+    // when that is more than integrity_threshold (m) away
+    void setPointSolution(double elevation_mask, double integrity_threshold);
+    // Incremented by each point solution, valid or not
+    uint32_t pointSolutions() const { return point_count_; }
+    // Feed BESTXYZ fixes to a PoseExtrapolator (see extrapolator.h)
+    void setExtrapolation(double max_age, double accel_noise);
+    const PoseExtrapolator& extrapolator() const { return extrapolator_; }
+
+    void getData(sensor_msgs::NavSatFix*);
+    void getData(novatel_gps::GpsXYZ*);
+    void getData(novatel_gps::LogAll*);
+    void getData(novatel_gps::SatelliteStateArray*);
+    void getData(sensor_msgs::Imu*);
+    void getData(nav_msgs::Odometry*);
+    void getData(geometry_msgs::PoseWithCovarianceStamped*);
+    void getData(novatel_gps::SatelliteGeometry*);
+    void getData(novatel_gps::PointSolution*);
+    void getData(novatel_gps::SmoothedRanges*);
+    // NavSatFix from the latest BESTXYZ (see setGeodetic())
+    void getGeodetic(sensor_msgs::NavSatFix*);
     ~GPS();
 
     /* Log Message IDs */
@@ -34,13 +179,38 @@ public:
     const int RANGE     = 43;
     const int SATXYZ    = 270;
     const int TRACKSTAT = 83;
+    const int RANGECMP  = 140;
+    const int INSPVA        = 507;
+    const int INSPVAS       = 508;
+    const int CORRIMUDATA   = 812;
+    const int CORRIMUDATAS  = 813;
 
 private:
     int readDataFromReceiver();
+    int readBytes(uint8_t* buffer, int size, int timeout_us);
+    int readReplay(uint8_t* buffer, int size, int timeout_us);
+    void received(const uint8_t* data, int size, int64_t stamp_ns);
+    void publishSolution();
+    void recordSolution();
+    void convertXYZ();
+    void updateGeometry();
+    void solvePoint();
+    void finishRange();
+    void archiveLog();
+    void readLoop();
+    bool parseByte(uint8_t data_read);
+    void resetParser();
+    void decodeHeader(const uint8_t* frame);
     void configure();
+    void tunePort();
+    void enableCorrectionInput();
+    void requestLogs(int log_id);
+    std::vector<LogRequest> defaultLogRequests(int log_id);
     void command(const char* command);
     int getApproxTime();
-    void decode(uint16_t msg_id);
+    // False, the log left as it was, when a RANGE, RANGECMP, TRACKSTAT or
+    // SATXYZ record count does not fit in the size bytes of payload
+    bool decode(const uint8_t* data, uint32_t size);
     void throwSerialComException(int);
     void waitReceiveInit();
 
@@ -48,14 +218,70 @@ private:
     novatel_gps::SatXYZ satellites_;
     novatel_gps::TrackStat tracking_;
     novatel_gps::Range pseudorange_;
+    SatelliteTable satellite_table_;
+    SlipDetector slip_detector_;
+    HatchFilter hatch_filter_;
+    bool hatch_;
+    double range_epoch_;        // GPS seconds of the latest RANGE/RANGECMP
+    std::unique_ptr<RinexWriter> rinex_;
+    std::unique_ptr<ArchiveWriter> archive_;
+    ArchiveSink* archive_sink_;     // archive_ or the caller's, NULL when off
+    GeometryEngine geometry_engine_;
+    bool geometry_;
+
+    // Point solution; epochs (GPS seconds) of the latest RANGE, SATXYZ and
+    // computed BESTXYZ, point_time_ is the last epoch solved
+    PointSolver point_solver_;
+    PointFix point_fix_;
+    bool point_;
+    double point_threshold_;
+    double range_time_;
+    double satxyz_time_;
+    double xyz_time_;
+    double point_time_;
+    double point_difference_;
+    uint32_t point_count_;
 
     std::string serial_port_;
+    std::vector<LogRequest> log_requests_;
     // GPS data packet
     const int GPS_PACKET_SIZE;
     std::vector<uint8_t> gps_data_;
 
+    // Frame parser state, kept across reads
+    int parse_state_;
+    int parse_pos_;
+    int hdr_len_;
+    uint16_t msg_len_;
+    std::atomic<uint32_t> crc_errors_;
+    std::atomic<uint64_t> frames_;
+    std::atomic<uint64_t> bytes_;
+
+    // Serial receive buffer and reader thread
+    std::vector<uint8_t> rx_buf_;
+    int rx_pos_;
+    int rx_len_;
+    std::thread reader_thread_;
+    std::atomic<bool> reading_;
+    FrameCallback frame_callback_;
+
+    // Capture/replay; stream_pos_ counts parsed bytes to place frames in the capture
+    std::unique_ptr<CaptureRecorder> recorder_;
+    std::unique_ptr<CaptureReplay> replay_;
+    bool replay_done_;
+    uint64_t stream_pos_;
+    uint64_t record_base_;
+    int64_t rx_stamp_ns_;
+
+    // Shared-memory output, header is NULL when disabled
+    GpsShm shm_;
+    GpsShmSolution shm_solution_;
+
+    SolutionHistory history_;
+    PoseExtrapolator extrapolator_;
+    bool extrapolate_;
+
     uint8_t time_stat_;
-    double status_;
     uint16_t position_status_;    // TO DO: implement gps_state, gps_p_status, v_status
     uint16_t velocity_status_;
     uint16_t velocity_type_;
@@ -77,12 +303,45 @@ private:
     std::vector<double> velocity_;
     std::vector<double> sigma_position_;
     std::vector<double> sigma_velocity_;
+    float velocity_latency_;
 
     uint32_t number_satellites_;
     double x_;
     double y_;
     double z_;
 
+    // INS solution (deg, m, m/s north/east/up, deg roll/pitch/azimuth)
+    double ins_latitude_;
+    double ins_longitude_;
+    double ins_height_;
+    std::vector<double> ins_velocity_;
+    std::vector<double> ins_attitude_;
+    uint32_t ins_status_;
+
+    // Corrected IMU increments per sample (pitch/roll/yaw, lateral/longitudinal/vertical)
+    std::vector<double> imu_angular_;
+    std::vector<double> imu_linear_;
+    double imu_rate_;
+    PortTuning port_tuning_;
+    ThreadTuning reader_tuning_;
+    std::string correction_port_;
+
+    // BESTXYZ converted: geodetic (deg, deg, m), covariance in the ENU frame
+    // at the fix and ENU position/covariance about enu_origin_
+    bool geodetic_;
+    double xyz_geodetic_[3];
+    double xyz_geodetic_cov_[9];
+    double xyz_enu_[3];
+    double xyz_enu_cov_[9];
+    std::vector<double> enu_origin_;
+    std::vector<double> enu_rotation_;
+    bool have_enu_origin_;
+
+    // Local ENU frame for odometry
+    std::vector<double> ins_origin_;
+    std::vector<double> ins_enu_rotation_;
+    bool have_ins_origin_;
+
     enum HEADER_ORDER
     {
         // Header byte order/format
@@ -122,6 +381,7 @@ private:
     int MAX_BYTES;
     int rate_;
     SERIALPORTCONFIG gps_SerialPortConfig_;
+    bool port_open_;
 
     // GPS week
     unsigned long gps_week_, gps_week_1024_;
@@ -131,7 +391,9 @@ private:
     int D_SYNC0;
     int D_SYNC1;
     int D_SYNC2;
+    int D_SYNC2_SHORT;
     int D_HDR_LEN;
+    int D_SHORT_HDR_LEN;
 
     /* Message Header */
     uint16_t D_HDR;
@@ -147,6 +409,11 @@ private:
     uint16_t D_RCV_ST;
     uint16_t D_RCV_SW_V;
 
+    /* Short Message Header */
+    uint16_t D_SHORT_MSG_LEN;
+    uint16_t D_SHORT_G_WEEK;
+    uint16_t D_SHORT_G_MS;
+
     /* BESTPOS */
     int BESTPOS_SOLSTAT;
     int BESTPOS_POSTYPE;
@@ -232,6 +499,35 @@ private:
     int RANGE_TRKSTART;
     int RANGE_OFFSET;
 
+    /* RANGECMP */
+    int RANGECMP_OBS;
+    int RANGECMP_REC;
+    int RANGECMP_OFFSET;
+
+    /* INSPVA */
+    int INSPVA_WEEK;
+    int INSPVA_SECONDS;
+    int INSPVA_LAT;
+    int INSPVA_LON;
+    int INSPVA_HGT;
+    int INSPVA_NVEL;
+    int INSPVA_EVEL;
+    int INSPVA_UVEL;
+    int INSPVA_ROLL;
+    int INSPVA_PITCH;
+    int INSPVA_AZIMUTH;
+    int INSPVA_STATUS;
+
+    /* CORRIMUDATA */
+    int CORRIMU_WEEK;
+    int CORRIMU_SECONDS;
+    int CORRIMU_PITCHRATE;
+    int CORRIMU_ROLLRATE;
+    int CORRIMU_YAWRATE;
+    int CORRIMU_LATACC;
+    int CORRIMU_LONACC;
+    int CORRIMU_VERTACC;
+
     // Multi-byte sizes
     int S_MSG_ID;
     int S_MSG_LEN;
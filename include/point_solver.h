@@ -0,0 +1,62 @@
+#ifndef POINT_SOLVER_H
+#define POINT_SOLVER_H
+
+#include <stdint.h>
+
+#include "satellite_table.h"
+
+// Position and the receiver clock
+#define SOLVER_UNKNOWNS     4
+
+// A pseudorange ready for the solver
+struct SolverObservation
+{
+    double satellite[3];        // ECEF at transmission (SATXYZ)
+    double range;               // Corrected pseudorange (m)
+    double weight;              // 1/psr_std^2
+};
+
+struct PointFix
+{
+    bool valid;
+    double position[3];         // ECEF (m)
+    double covariance[9];       // m^2
+    double clock;               // Receiver clock offset against GPS time (m)
+    int satellites;
+    int iterations;
+    double residual_rms;        // m
+};
+
+// Weighted least-squares position and clock from the GPS L1 pseudoranges of
+// the latest RANGE and the SATXYZ of the same epoch. SATXYZ only lists GPS
+// satellites, so the ranges of the other constellations, QZSS included, have
+// no position and are not used:
+//   psr + clk_corr - ion_corr - trop_corr = |sat - rx| + clock
+// with the satellite rotated by the Earth's rotation over the signal travel
+// time (Sagnac). Observations are weighted by psr_std; satellites TRACKSTAT
+// rejected (when TRACKSTAT is current) or below the elevation mask are left
+// out. Gauss-Newton from the previous fix, Cholesky on the 4x4 normal matrix.
+// Fixed size, no allocation.
+class PointSolver
+{
+public:
+    PointSolver();
+
+    // elevation_mask: deg, applied once the estimate is near the surface
+    void configure(double elevation_mask);
+
+    // Call once RANGE and SATXYZ of one epoch are in the table
+    bool solve(const SatelliteTable& table, PointFix* fix);
+
+private:
+    int collect(const SatelliteTable& table);
+
+    SolverObservation observations_[MAX_SATELLITES];
+    int count_;
+
+    double sin_mask_;
+    double position_[3];        // Last converged position, the next initial guess
+    bool have_position_;
+};
+
+#endif // POINT_SOLVER_H
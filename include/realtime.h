@@ -0,0 +1,31 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Scheduling of one thread. Policy is "other" (leave as is), "fifo" or "rr".
+struct ThreadTuning
+{
+    std::string policy;
+    int priority;               // 1-99 for fifo/rr
+    std::vector<int> cpus;      // Empty leaves the affinity
+
+    ThreadTuning() : policy("other"), priority(0) {}
+};
+
+// Applies tuning to the calling thread. Missing privileges (no CAP_SYS_NICE or
+// RLIMIT_RTPRIO) only warn; returns false if anything was not applied.
+bool ApplyThreadTuning(const ThreadTuning& tuning, const char* name);
+
+// mlockall(MCL_CURRENT | MCL_FUTURE), warns on failure
+bool LockMemory();
+
+// Touches size bytes of the calling thread's stack so it is resident
+void PrefaultStack(size_t size);
+
+// Logs the overshoot of samples periodic clock_nanosleep wake-ups
+void MeasureWakeupLatency(int samples, long period_ns, const char* name);
+
+#endif // REALTIME_H
@@ -0,0 +1,102 @@
+#ifndef RINEX_WRITER_H
+#define RINEX_WRITER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "novatel_gps/RangeInformation.h"
+
+// Observations of one RANGE log kept for the file
+#define RINEX_MAX_OBSERVATIONS  256
+// Epochs queued between the reader and the writer thread
+#define RINEX_QUEUE_EPOCHS      128
+
+struct RinexStats
+{
+    uint64_t epochs;            // Written
+    uint64_t bytes;
+    uint64_t files;
+    uint64_t dropped;           // Epochs lost to a full queue or a file that could not be created
+    uint64_t write_errors;      // Failed file creations and writes
+};
+
+// RINEX 3.04 mixed observation files from RANGE/RANGECMP logs, one per GPS
+// hour (<directory>/<MARKER>00XXX_R_<YYYYDDDHH>00_01H_00U_MO.rnx). push()
+// copies the epoch into a fixed ring; a background thread formats it into a
+// large buffer that is written out once it holds RINEX_FLUSH_BYTES, at a
+// file change, or every few seconds, so the reader never waits on the disk.
+// Per signal: C (psr), L (-adr, cycles), D (Doppler), S (C/N0); the phase
+// LLI has bit 0 on any slip flag and bit 1 while the half-cycle ambiguity is
+// unresolved (parity unknown). Epochs are in GPS time.
+class RinexWriter
+{
+public:
+    // Throws std::runtime_error if the directory is not writable
+    RinexWriter(const std::string& directory, const std::string& marker);
+    // Writes out what is queued
+    ~RinexWriter();
+
+    // From the reader thread after the slip flags are set; approx is the
+    // latest receiver position for the next header (0 if unknown)
+    void push(uint16_t gps_week, double gps_seconds, const novatel_gps::RangeInformation* ranges,
+              int count, const double approx[3]);
+    RinexStats stats();
+
+private:
+    struct Observation
+    {
+        double psr;
+        double adr;
+        float doppler;
+        float c_no;
+        uint32_t ch_tr_status;
+        int16_t prn_slot;
+        uint8_t slip;
+    };
+
+    struct Epoch
+    {
+        uint16_t gps_week;
+        double gps_seconds;
+        double approx[3];
+        int count;
+        std::vector<Observation> observations;
+    };
+
+    void run();
+    // False when the epoch's file could not be created
+    bool writeEpoch(Epoch& epoch);
+    bool openFile(const Epoch& epoch);
+    void writeHeader(const Epoch& epoch);
+    void closeFile();
+    void flush();
+    void append(const char* format, ...);
+
+    std::string directory_;
+    std::string marker_;
+
+    // Single producer, single consumer: slots [tail_, head_) are queued
+    std::vector<Epoch> ring_;
+    uint64_t head_;
+    uint64_t tail_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<bool> running_;
+    RinexStats stats_;
+
+    // Writer thread only
+    int fd_;
+    int64_t hour_;              // GPS hour of the open file
+    std::vector<char> buffer_;
+    size_t used_;
+    int64_t flushed_ns_;
+
+    std::thread thread_;
+};
+
+#endif // RINEX_WRITER_H
@@ -0,0 +1,69 @@
+#ifndef SATELLITE_GEOMETRY_H
+#define SATELLITE_GEOMETRY_H
+
+#include <stdint.h>
+
+#include "novatel_gps/SatelliteGeometry.h"
+#include "satellite_table.h"
+
+// Direction to one satellite, cached between epochs
+struct SatelliteDirection
+{
+    double position[3];         // Satellite ECEF the direction was computed for
+    double range;               // m
+    double los[3];              // Unit vector receiver to satellite, ENU
+    float azimuth;              // deg
+    float elevation;            // deg
+    uint32_t generation;        // Last SATXYZ generation the satellite was in
+};
+
+struct Dop
+{
+    double gdop;
+    double pdop;
+    double hdop;
+    double vdop;
+    double tdop;
+};
+
+// Azimuth, elevation and DOP of the satellites in the latest SATXYZ. A
+// satellite's direction is recomputed only when it has moved by more than
+// tolerance (rad) as seen from the receiver, or when the receiver has moved;
+// the DOP comes from a fixed-size 4x4 normal matrix over the cached
+// directions. No allocation.
+class GeometryEngine
+{
+public:
+    GeometryEngine();
+
+    // mask: elevation mask (deg); tolerance: angle (deg) a satellite may move
+    // before its direction is recomputed, 0 recomputes every epoch
+    void configure(double mask, double tolerance);
+
+    // Call after each SATXYZ. Returns the satellites above the mask.
+    int update(const SatelliteTable& table, const double receiver[3]);
+
+    const Dop& dop() const { return dop_; }
+    // Directions recomputed by the last update()
+    int recomputed() const { return recomputed_; }
+    void fill(novatel_gps::SatelliteGeometry* output) const;
+
+private:
+    void computeDirection(const double position[3], SatelliteDirection* d);
+    void computeDop();
+
+    SatelliteDirection directions_[MAX_SATELLITES];   // By SatelliteIndex()
+    uint32_t generation_;
+    int count_;
+    int used_;
+    int recomputed_;
+
+    double mask_;
+    double tolerance2_;
+    double receiver_[3];
+    double rotation_[9];
+    bool have_receiver_;
+    Dop dop_;
+};
+
+#endif // SATELLITE_GEOMETRY_H
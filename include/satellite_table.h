@@ -0,0 +1,142 @@
+#ifndef SATELLITE_TABLE_H
+#define SATELLITE_TABLE_H
+
+#include <stdint.h>
+
+#include "novatel_gps/RangeInformation.h"
+#include "novatel_gps/SatXYZInformation.h"
+#include "novatel_gps/TrackStatChannel.h"
+#include "novatel_gps/SatelliteStateArray.h"
+
+#define MAX_PRN_SLOT    256
+#define MAX_SIGNALS     4
+
+// Satellite systems, bits 16-18 of the channel tracking status word
+enum SATELLITE_SYSTEM
+{
+    SYSTEM_GPS,
+    SYSTEM_GLONASS,
+    SYSTEM_SBAS,
+    SYSTEM_GALILEO,
+    SYSTEM_BEIDOU,
+    SYSTEM_QZSS,
+    SYSTEM_NAVIC,
+    SYSTEM_OTHER,
+};
+
+// Entries of the per-satellite tables. NovAtel reuses PRN numbers across
+// systems (GPS 1-32, Galileo 1-36, BeiDou 1-63, NavIC 1-14), so satellites
+// are keyed by system and PRN/slot, each system with its own range of
+// entries (see SatelliteIndex()).
+#define MAX_SATELLITES  225
+
+// Signal slots of a satellite entry
+enum SIGNAL_SLOT
+{
+    SIGNAL_L1,      //  L1 C/A, Galileo E1, BeiDou B1I
+    SIGNAL_L2,      //  L2 P / P codeless / GLONASS L2
+    SIGNAL_L2C,     //  L2C
+    SIGNAL_OTHER,   //  L5 and anything else
+};
+
+#define SPEED_OF_LIGHT  299792458.0
+
+// Signal slot from a channel tracking status word
+int SignalSlot(uint32_t ch_tr_status);
+
+// Satellite system from a channel tracking status word
+inline int SatelliteSystem(uint32_t ch_tr_status)
+{
+    return (ch_tr_status >> 16) & 0x7;
+}
+
+// Table entry of a satellite, -1 if prn_slot is outside the PRN/slot range
+// of its system (GLONASS 38-68, SBAS 120-158, QZSS 193-202) or the system
+// is SYSTEM_OTHER
+int SatelliteIndex(int system, int prn_slot);
+// System and PRN/slot of a table entry
+void SatelliteOf(int index, int* system, int* prn_slot);
+
+// Nominal carrier wavelength (m) from a channel tracking status word. GLONASS
+// uses the centre frequency, which is close enough to resolve ADR rollovers
+// and, as L1 and L2 are off by the same factor, for L1-L2 combinations.
+double CarrierWavelength(uint32_t ch_tr_status);
+
+// RANGE observation of one signal
+struct SignalState
+{
+    double psr;
+    double adr;
+    float psr_std;
+    float adr_std;
+    float doppler;
+    float c_no;
+    float locktime;
+    uint32_t ch_tr_status;
+    uint8_t slip;           // RangeInformation SLIP_* flags
+    uint32_t generation;
+};
+
+struct SatelliteState
+{
+    int system;
+    int prn_slot;
+
+    SignalState signal[MAX_SIGNALS];
+
+    // SATXYZ, which only lists GPS satellites
+    double position[3];
+    double clk_corr;
+    double ion_corr;
+    double trop_corr;
+    uint32_t satxyz_generation;
+
+    // TRACKSTAT, L1 channel
+    uint32_t ch_tr_status;
+    float cn0;
+    float locktime;
+    float psr_res;
+    float psr_weight;
+    uint32_t reject;
+    uint32_t trackstat_generation;
+};
+
+// Fixed-size table of per-satellite state indexed by system and PRN/slot
+// (SatelliteIndex()). Each decoded record updates its entry in O(1) and
+// stamps it with the generation (count) of the log it came from, so consumers
+// can tell current fields from stale ones.
+class SatelliteTable
+{
+public:
+    SatelliteTable();
+
+    // Call once per log before its records
+    void beginRange()       { range_generation_++; }
+    void beginSatXYZ()      { satxyz_generation_++; }
+    void beginTrackStat()   { trackstat_generation_++; }
+
+    void update(const novatel_gps::RangeInformation& range);
+    void update(const novatel_gps::SatXYZInformation& satellite);
+    void update(const novatel_gps::TrackStatChannel& channel);
+
+    // NULL if the satellite has no entry
+    const SatelliteState* find(int system, int prn_slot) const;
+    // index < MAX_SATELLITES
+    const SatelliteState& entry(int index) const { return satellites_[index]; }
+
+    uint32_t rangeGeneration() const        { return range_generation_; }
+    uint32_t satxyzGeneration() const       { return satxyz_generation_; }
+    uint32_t trackstatGeneration() const    { return trackstat_generation_; }
+
+    // Joined view of the satellites in the latest RANGE log
+    void fill(novatel_gps::SatelliteStateArray* output) const;
+
+private:
+    SatelliteState satellites_[MAX_SATELLITES];
+
+    uint32_t range_generation_;
+    uint32_t satxyz_generation_;
+    uint32_t trackstat_generation_;
+};
+
+#endif // SATELLITE_TABLE_H
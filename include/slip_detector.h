@@ -0,0 +1,77 @@
+#ifndef SLIP_DETECTOR_H
+#define SLIP_DETECTOR_H
+
+#include <stdint.h>
+
+#include "novatel_gps/RangeInformation.h"
+#include "satellite_table.h"
+
+// Streaming cycle-slip detection over RANGE/RANGECMP observations. Keeps the
+// previous phase of every satellite (system and PRN, SatelliteIndex()) and
+// signal slot and flags each observation
+// (RangeInformation SLIP_* bits) from:
+//  - locktime going back or restarting within the gap, or no phase lock
+//  - a change of the half-cycle added flag
+//  - ADR off the previous ADR plus the mean Doppler over the gap (NovAtel
+//    ADR advances with the Doppler)
+//  - a jump in the L1 - L2 geometry-free phase, checked once all the
+//    signals of an epoch are in
+// O(1) per observation in fixed-size arrays, no allocation.
+class SlipDetector
+{
+public:
+    SlipDetector();
+
+    // doppler_threshold: cycles, gf_threshold: m, both for a 1 s gap and
+    // scaled up with longer ones; max_gap: s, beyond it only locktime is
+    // checked
+    void configure(double doppler_threshold, double gf_threshold, double max_gap);
+
+    // Per RANGE log: beginEpoch(), update() for each observation, endEpoch(),
+    // then flags() for each observation
+    void beginEpoch(double gps_time);
+    void update(const novatel_gps::RangeInformation& range);
+    void endEpoch();
+    uint8_t flags(const novatel_gps::RangeInformation& range) const;
+
+private:
+    // Adds a satellite (SatelliteIndex()) to those of the current epoch
+    void see(int index);
+
+    struct PhaseTrack
+    {
+        double adr;             // cycles
+        double time;            // GPS seconds
+        float doppler;          // Hz
+        float locktime;         // s
+        uint32_t ch_tr_status;
+        uint32_t epoch;         // Epoch of the latest observation
+        uint8_t flags;          // Of the latest observation
+        bool locked;            // Latest observation had phase lock
+    };
+
+    // Geometry-free phase of a satellite, between L1 and gf_signal
+    struct GeometryFree
+    {
+        double value;           // m
+        double time;
+        int signal;             // -1 when there is none
+    };
+
+    // By SatelliteIndex()
+    PhaseTrack tracks_[MAX_SATELLITES][MAX_SIGNALS];
+    GeometryFree geometry_free_[MAX_SATELLITES];
+
+    // Satellites seen in the current epoch
+    int16_t epoch_satellites_[MAX_SATELLITES];
+    uint32_t seen_[MAX_SATELLITES];
+    int epoch_count_;
+    uint32_t epoch_;
+    double time_;
+
+    double doppler_threshold_;
+    double gf_threshold_;
+    double max_gap_;
+};
+
+#endif // SLIP_DETECTOR_H
@@ -0,0 +1,44 @@
+#ifndef SOLUTION_BATCH_H
+#define SOLUTION_BATCH_H
+
+#include <stddef.h>
+
+#include "novatel_gps/GpsXYZ.h"
+#include "novatel_gps/GpsXYZBatch.h"
+
+// Collects consecutive GpsXYZ fixes into a GpsXYZBatch: every sample's stamp,
+// position and velocity, the covariance diagonals only when they changed
+// (the rest of GpsXYZ's covariances are zero). The arrays keep their
+// capacity from one batch to the next, so adding a fix does not allocate.
+class SolutionBatch
+{
+public:
+    SolutionBatch();
+
+    // Up to size fixes per batch, fewer once the first is max_latency (s)
+    // old (0: no limit)
+    void configure(int size, double max_latency);
+
+    // True when the batch is full with fix
+    bool add(const novatel_gps::GpsXYZ& fix);
+    // True when the first fix is max_latency old at now
+    bool due(const ros::Time& now) const;
+    size_t size() const { return samples_; }
+
+    // Moves the batch into output and starts the next one; output's
+    // header.frame_id is left to the caller
+    void take(novatel_gps::GpsXYZBatch* output);
+
+private:
+    novatel_gps::GpsXYZBatch batch_;
+    size_t samples_;
+    size_t size_;
+    double max_latency_;
+    float covariance_[6];       // Latest entry of the batch
+};
+
+// Sample i of a batch as the GpsXYZ it came from (frame_id included); false
+// if there is no such sample
+bool BatchSample(const novatel_gps::GpsXYZBatch& batch, size_t i, novatel_gps::GpsXYZ* fix);
+
+#endif // SOLUTION_BATCH_H
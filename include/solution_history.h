@@ -0,0 +1,84 @@
+#ifndef SOLUTION_HISTORY_H
+#define SOLUTION_HISTORY_H
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+
+#define GPS_SECONDS_IN_WEEK     604800.0
+
+// Samples of receive - GPS time kept for the host clock offset estimate
+#define HOST_OFFSET_WINDOW      64
+
+// Host minus GPS time from the receive times of solutions: receive time is
+// GPS time + offset + a latency that is never negative, so the smallest
+// difference over the last HOST_OFFSET_WINDOW solutions (the least-delayed
+// delivery) tracks the offset. Includes the leap seconds and that smallest
+// output and serial latency.
+class HostClockOffset
+{
+public:
+    HostClockOffset() : count_(0), offset_(0.0) {}
+    void add(double gps_time, int64_t receive_ns);
+    void reset() { count_ = 0; }
+    // 0 until the first solution
+    double offset() const { return offset_; }
+
+private:
+    double samples_[HOST_OFFSET_WINDOW];
+    size_t count_;
+    double offset_;
+};
+
+// One BESTXYZ solution (ECEF), or a value interpolated between two
+struct SolutionSample
+{
+    double gps_time;            // Seconds since the GPS epoch
+    double host_time;           // Host time (CLOCK_REALTIME, s) of gps_time, from the offset estimate
+    double position[3];
+    double velocity[3];
+    double position_var[3];     // m^2
+    double velocity_var[3];     // (m/s)^2
+    uint16_t position_status;
+    uint16_t position_type;
+};
+
+// Fixed-capacity, time-ordered ring of solutions with O(log n) lookup by GPS
+// time or host time. Host times are mapped to GPS time with HostClockOffset.
+// Thread-safe, the reader thread adds while other threads query.
+class SolutionHistory
+{
+public:
+    explicit SolutionHistory(size_t capacity = 0);
+
+    // Drops the history and sets its size; 0 disables it
+    void resize(size_t capacity);
+    // Longest gap between solutions that is interpolated over (s)
+    void setMaxGap(double max_gap);
+
+    // receive_ns: host time (CLOCK_REALTIME) the solution's frame was read
+    void add(const SolutionSample& sample, int64_t receive_ns);
+
+    // Interpolates at t; false (with a reason) outside the history or across a gap
+    bool atGpsTime(double t, SolutionSample* out, const char** reason = NULL) const;
+    bool atHostTime(double t, SolutionSample* out, const char** reason = NULL) const;
+
+    // Host minus GPS time (s), includes the leap seconds; 0 until the first solution
+    double hostOffset() const;
+    size_t size() const;
+    size_t capacity() const { return ring_.size(); }
+
+private:
+    const SolutionSample& at(size_t i) const { return ring_[(begin_ + i) % ring_.size()]; }
+    bool interpolate(double t, SolutionSample* out, const char** reason) const;
+
+    mutable std::mutex mutex_;
+    std::vector<SolutionSample> ring_;
+    size_t begin_;
+    size_t count_;
+    double max_gap_;
+
+    HostClockOffset host_offset_;
+};
+
+#endif // SOLUTION_HISTORY_H
@@ -0,0 +1,81 @@
+#!/usr/bin/env python
+"""Byte-to-publish latency of gps/cart against the gps_sim send log.
+
+Start the simulator and the driver first:
+    roslaunch novatel_gps sim.launch
+then run:
+    rosrun novatel_gps latency_harness.py _duration:=60 _send_log:=/tmp/gps_sim_send.csv
+
+The simulator puts the frame sequence number in the BESTXYZ X coordinate, so
+each GpsXYZ is matched to the time its last byte was written to the pty. Both
+clocks are the host's CLOCK_REALTIME. The latency includes this subscriber's
+own deserialization, which is small next to the serial path.
+
+Without a ROS master, gps_latency measures the same path up to the message
+fill (no publish) against the same send log.
+"""
+
+import csv
+import time
+
+import rospy
+from novatel_gps.msg import GpsXYZ
+
+SIM_X0 = 4115000.0
+BESTXYZ = 241
+
+received = {}
+
+
+def callback_cart(msg):
+    now_ns = int(time.time() * 1e9)
+    seq = int(round(msg.position.position.x - SIM_X0))
+    received.setdefault(seq, now_ns)
+
+
+def percentile(values, p):
+    k = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[k]
+
+
+def main():
+    rospy.init_node('gps_latency_harness', anonymous=True)
+    duration = rospy.get_param('~duration', 60.0)
+    send_log = rospy.get_param('~send_log', '/tmp/gps_sim_send.csv')
+    # Frames sent this close to the end may still be in flight
+    grace = rospy.get_param('~grace', 1.0)
+
+    rospy.Subscriber('/gps/cart', GpsXYZ, callback_cart, queue_size=1000, tcp_nodelay=True)
+
+    rospy.loginfo('waiting for the first message')
+    while not received and not rospy.is_shutdown():
+        time.sleep(0.1)
+    start_ns = int(time.time() * 1e9)
+    time.sleep(duration)
+    end_ns = int(time.time() * 1e9)
+
+    sent = {}
+    with open(send_log) as f:
+        for row in csv.DictReader(f):
+            if int(row['msg_id']) == BESTXYZ:
+                sent[int(row['seq'])] = int(row['send_ns'])
+
+    window = [s for s, t in sent.items() if start_ns <= t <= end_ns - grace * 1e9]
+    if not window:
+        rospy.logerr('no frames sent in the measurement window, check %s', send_log)
+        return
+
+    latencies = sorted((received[s] - sent[s]) / 1e3 for s in window if s in received)
+    lost = len(window) - len(latencies)
+
+    print('frames sent     %d' % len(window))
+    print('frames lost     %d (%.3f%%)' % (lost, 100.0 * lost / len(window)))
+    if latencies:
+        print('latency p50     %.1f us' % percentile(latencies, 50))
+        print('latency p99     %.1f us' % percentile(latencies, 99))
+        print('latency p99.9   %.1f us' % percentile(latencies, 99.9))
+        print('latency max     %.1f us' % latencies[-1])
+
+
+if __name__ == '__main__':
+    main()
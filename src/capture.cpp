@@ -0,0 +1,352 @@
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "capture.h"
+#include "crc32.h"
+
+#define CAPTURE_CHUNK   (16*1024*1024)
+// Longest frame the parser accepts (GPS_PACKET_SIZE)
+#define CAPTURE_MAX_FRAME   4096
+
+int64_t CaptureClockNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+static int64_t MonotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+// Read-only mapping of a whole file, NULL (and size 0) if missing or empty
+static const uint8_t* MapReadOnly(const std::string& path, size_t* size)
+{
+    *size = 0;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED)
+            *size = st.st_size;
+    }
+    ::close(fd);
+    return (map == MAP_FAILED) ? NULL : static_cast<const uint8_t*>(map);
+}
+
+/*************************** MappedFile ***************************/
+
+MappedFile::MappedFile() :
+    fd_(-1), size_(0), chunk_(0), window_(NULL), base_(0),
+    next_(NULL), retired_(NULL), failed_(false), stop_(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path, size_t chunk)
+{
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd_ < 0)
+        return false;
+
+    chunk_ = chunk;
+    size_ = 0;
+    base_ = 0;
+    failed_ = false;
+    stop_ = false;
+    if(ftruncate(fd_, chunk_) != 0 || !(window_ = mapWindow(0)))
+    {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    thread_ = std::thread(&MappedFile::prepareLoop, this);
+    return true;
+}
+
+uint8_t* MappedFile::mapWindow(size_t base)
+{
+    // Populate up front so appends do not page fault in the reader
+    void* map = mmap(NULL, chunk_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, base);
+    return (map == MAP_FAILED) ? NULL : static_cast<uint8_t*>(map);
+}
+
+void MappedFile::prepareLoop()
+{
+    // Runs only when the writer does not need the CPU; populating a window
+    // must not preempt it on a shared core
+    struct sched_param param;
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(true)
+    {
+        cond_.wait(lock, [this] { return stop_ || retired_ || (!next_ && !failed_); });
+        if(stop_)
+            break;
+
+        uint8_t* retired = retired_;
+        retired_ = NULL;
+        size_t base = base_ + chunk_;
+        bool map_next = !next_ && !failed_;
+        lock.unlock();
+
+        if(retired)
+            munmap(retired, chunk_);
+
+        uint8_t* next = NULL;
+        if(map_next && ftruncate(fd_, base + chunk_) == 0)
+            next = mapWindow(base);
+
+        lock.lock();
+        if(map_next)
+        {
+            next_ = next;
+            failed_ = !next;
+            cond_.notify_all();
+        }
+    }
+}
+
+bool MappedFile::advance()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // Only waits if the writer outran the background thread by a whole chunk
+    cond_.wait(lock, [this] { return next_ || failed_; });
+    if(!next_)
+        return false;
+
+    retired_ = window_;
+    window_ = next_;
+    next_ = NULL;
+    base_ += chunk_;
+    cond_.notify_all();
+    return true;
+}
+
+bool MappedFile::append(const void* data, size_t size)
+{
+    if(fd_ < 0)
+        return false;
+
+    // A block may span the end of the window
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while(size > 0)
+    {
+        if(size_ == base_ + chunk_ && !advance())
+            return false;
+
+        size_t n = std::min(size, base_ + chunk_ - size_);
+        memcpy(window_ + (size_ - base_), bytes, n);
+        size_ += n;
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(fd_ < 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        cond_.notify_all();
+    }
+    if(thread_.joinable())
+        thread_.join();
+
+    uint8_t* maps[3] = { window_, next_, retired_ };
+    for(int i = 0; i < 3; ++i)
+    {
+        if(maps[i])
+            munmap(maps[i], chunk_);
+    }
+    window_ = next_ = retired_ = NULL;
+
+    // Drop the unused tail of the mapped chunks
+    if(ftruncate(fd_, size_) != 0)
+        size_ = 0;
+    ::close(fd_);
+    fd_ = -1;
+}
+
+/*************************** CaptureRecorder ***************************/
+
+CaptureRecorder::CaptureRecorder(const std::string& path)
+{
+    if(!data_.open(path, CAPTURE_CHUNK) || !index_.open(path + ".idx", CAPTURE_CHUNK/8))
+        throw std::runtime_error("could not create capture " + path);
+
+    CaptureIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_INDEX_MAGIC, sizeof(CAPTURE_INDEX_MAGIC));
+    header.version = CAPTURE_INDEX_VERSION;
+    header.entry_size = sizeof(CaptureIndexEntry);
+    index_.append(&header, sizeof(header));
+}
+
+CaptureRecorder::~CaptureRecorder()
+{
+    close();
+}
+
+bool CaptureRecorder::write(const uint8_t* data, size_t size)
+{
+    return data_.append(data, size);
+}
+
+bool CaptureRecorder::addFrame(uint64_t offset, int64_t stamp_ns, uint16_t msg_id, uint16_t length)
+{
+    CaptureIndexEntry entry;
+    entry.offset = offset;
+    entry.stamp_ns = stamp_ns;
+    entry.msg_id = msg_id;
+    entry.length = length;
+    entry.reserved = 0;
+    return index_.append(&entry, sizeof(entry));
+}
+
+void CaptureRecorder::close()
+{
+    data_.close();
+    index_.close();
+}
+
+/*************************** CaptureReplay ***************************/
+
+CaptureReplay::CaptureReplay(const std::string& path, double speed) :
+    index_map_(NULL),
+    index_map_size_(0),
+    index_(NULL),
+    entries_(0),
+    speed_(speed),
+    pos_(0),
+    next_(0),
+    start_ns_(0)
+{
+    data_ = MapReadOnly(path, &size_);
+    if(!data_)
+        throw std::runtime_error("could not open capture " + path);
+
+    // Without a usable index the capture is replayed as fast as possible
+    index_map_ = MapReadOnly(path + ".idx", &index_map_size_);
+    if(index_map_ && index_map_size_ >= sizeof(CaptureIndexHeader))
+    {
+        const CaptureIndexHeader* header = reinterpret_cast<const CaptureIndexHeader*>(index_map_);
+        if(memcmp(header->magic, CAPTURE_INDEX_MAGIC, sizeof(CAPTURE_INDEX_MAGIC)) == 0 &&
+           header->entry_size == sizeof(CaptureIndexEntry))
+        {
+            index_ = reinterpret_cast<const CaptureIndexEntry*>(index_map_ + sizeof(CaptureIndexHeader));
+            entries_ = (index_map_size_ - sizeof(CaptureIndexHeader))/sizeof(CaptureIndexEntry);
+        }
+    }
+}
+
+CaptureReplay::~CaptureReplay()
+{
+    munmap(const_cast<uint8_t*>(data_), size_);
+    if(index_map_)
+        munmap(const_cast<uint8_t*>(index_map_), index_map_size_);
+}
+
+int CaptureReplay::read(uint8_t* buffer, int size, int timeout_us)
+{
+    if(pos_ >= size_)
+        return -1;
+
+    size_t end = size_;
+    if(speed_ > 0.0 && entries_ > 0)
+    {
+        int64_t now = MonotonicNs();
+        if(start_ns_ == 0)
+            start_ns_ = now;
+
+        // Release every frame whose (scaled) receive time has passed
+        double elapsed = (now - start_ns_)*speed_;
+        while(next_ < entries_ && index_[next_].stamp_ns - index_[0].stamp_ns <= elapsed)
+            next_++;
+
+        if(next_ < entries_)
+            end = (next_ > 0) ? index_[next_ - 1].offset + index_[next_ - 1].length : 0;
+
+        if(end <= pos_)
+        {
+            // Nothing due yet, wait for the next frame or the timeout
+            int64_t due = start_ns_ + static_cast<int64_t>((index_[next_].stamp_ns - index_[0].stamp_ns)/speed_);
+            int64_t wait = std::min<int64_t>(due - now, static_cast<int64_t>(timeout_us)*1000);
+            if(wait > 0)
+                std::this_thread::sleep_for( std::chrono::nanoseconds(wait) );
+            return 0;
+        }
+    }
+
+    size_t n = std::min<size_t>(size, end - pos_);
+    memcpy(buffer, data_ + pos_, n);
+    pos_ += n;
+    return n;
+}
+
+size_t CaptureNextFrame(const uint8_t* data, size_t size, size_t pos)
+{
+    for(; pos + 12 <= size; ++pos)
+    {
+        const uint8_t* p = data + pos;
+        if(p[0] != 0xAA || p[1] != 0x44 || (p[2] != 0x12 && p[2] != 0x13))
+            continue;
+
+        // Long header: its length at 3, the message length at 8; short
+        // header: 12 bytes, the message length at 3
+        size_t header, length;
+        if(p[2] == 0x12)
+        {
+            uint16_t msg_len;
+            memcpy(&msg_len, p + 8, sizeof(msg_len));
+            header = p[3];
+            length = msg_len;
+            if(header != 28)
+                continue;
+        }
+        else
+        {
+            header = 12;
+            length = p[3];
+        }
+        size_t frame = header + length + 4;
+        if(length == 0 || frame > CAPTURE_MAX_FRAME || pos + frame > size)
+            continue;
+
+        uint32_t crc;
+        memcpy(&crc, p + header + length, sizeof(crc));
+        if(CalculateBlockCRC32(header + length, p) == crc)
+            return pos;
+    }
+    return size;
+}
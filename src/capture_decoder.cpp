@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <ros/ros.h>
+
+#include "novatel_gps.h"
+#include "capture_decoder.h"
+
+#define GPS_EPOCH_UNIX      315964800LL     // 1980-01-06 00:00:00
+
+bool CsvSink::append(int table, const double* values)
+{
+    std::string& out = text[table];
+    char value[64];
+    for(int c = 0; c < ArchiveTableSchema(table).columns; ++c)
+    {
+        ArchiveFormatValue(table, c, values[c], value, sizeof(value));
+        if(c > 0)
+            out += ',';
+        out += value;
+    }
+    out += '\n';
+    return true;
+}
+
+bool CapturePartOutput::append(int table, const double* values)
+{
+    if(archive)
+        archive->append(table, values);
+    if(csv)
+        csv->append(table, values);
+    return true;
+}
+
+std::vector<CapturePart> SplitCapture(const uint8_t* data, size_t size, const CaptureDecodeOptions& options)
+{
+    std::vector<size_t> starts;
+    starts.push_back(0);
+    for(size_t pos = options.part; pos < size; pos += options.part)
+    {
+        size_t start = CaptureNextFrame(data, size, pos);
+        if(start >= size)
+            break;
+        starts.push_back(start);
+        pos = start;
+    }
+
+    std::vector<CapturePart> parts(starts.size());
+    for(size_t i = 0; i < starts.size(); ++i)
+    {
+        parts[i].begin = starts[i];
+        parts[i].end = (i + 1 < starts.size()) ? starts[i + 1] : size;
+        parts[i].warmup = (starts[i] > options.warmup) ?
+                          std::min(CaptureNextFrame(data, size, starts[i] - options.warmup), starts[i]) : 0;
+    }
+    return parts;
+}
+
+// Host time the frame ending at end was read, from the capture index; GPS
+// time (without leap seconds) for a capture without one
+static ros::Time FrameStamp(const CaptureReplay& capture, size_t* cursor, uint64_t end,
+                            const novatel_gps::MsgHeader& header)
+{
+    const CaptureIndexEntry* index = capture.index();
+    while(*cursor < capture.entries() && index[*cursor].offset + index[*cursor].length < end)
+        (*cursor)++;
+    ros::Time stamp;
+    if(*cursor < capture.entries() && index[*cursor].offset + index[*cursor].length == end)
+        stamp.fromNSec(index[*cursor].stamp_ns);
+    else
+        stamp.fromNSec((GPS_EPOCH_UNIX + header.gps_week*604800LL)*1000000000LL + header.gps_ms*1000000LL);
+    return stamp;
+}
+
+void DecodeCapturePart(const CaptureReplay& capture, const CapturePart& part,
+                       const CaptureDecodeOptions& options, CapturePartOutput* output)
+{
+    const uint8_t* data = capture.data();
+    GPS gps;
+    gps.parse(data + part.warmup, part.begin - part.warmup, GPS::FrameCallback());
+    uint64_t warmup_frames = gps.frameCount();
+    uint32_t warmup_errors = gps.crcErrors();
+
+    if(options.archive)
+        output->archive.reset(new ArchiveEncoder(options.chunk_rows));
+    if(options.csv)
+        output->csv.reset(new CsvSink());
+    if(output->archive || output->csv)
+        gps.setArchiveSink(output);
+
+    size_t cursor = 0;
+    if(capture.entries() > 0)
+    {
+        // First index entry of the part
+        const CaptureIndexEntry* index = capture.index();
+        size_t lo = 0, hi = capture.entries();
+        while(lo < hi)
+        {
+            size_t mid = (lo + hi)/2;
+            if(index[mid].offset < part.begin)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        cursor = lo;
+    }
+
+    GPS::FrameCallback callback;
+    if(options.bag)
+        callback = [&](uint16_t msg_id)
+        {
+            bool all = (msg_id == gps.RANGE || msg_id == gps.RANGECMP);
+            if(msg_id != gps.BESTXYZ && !all)
+                return;
+            ros::Time stamp = FrameStamp(capture, &cursor, part.warmup + gps.streamPosition(), gps.header());
+            output->topic_all.push_back(all);
+            if(all)
+            {
+                output->all.push_back(novatel_gps::LogAll());
+                gps.getData(&output->all.back());
+                output->all.back().header.stamp = stamp;
+                output->all.back().header.frame_id = options.frame_id;
+            }
+            else
+            {
+                output->cart.push_back(novatel_gps::GpsXYZ());
+                gps.getData(&output->cart.back());
+                output->cart.back().header.stamp = stamp;
+                output->cart.back().header.frame_id = options.frame_id;
+            }
+        };
+    gps.parse(data + part.begin, part.end - part.begin, callback);
+
+    if(output->archive)
+        output->archive->flush();
+    output->frames = gps.frameCount() - warmup_frames;
+    output->crc_errors = gps.crcErrors() - warmup_errors;
+}
+
+bool DecodeCapture(const CaptureReplay& capture, const std::vector<CapturePart>& parts,
+                   const CaptureDecodeOptions& options, const CapturePartWriter& write)
+{
+    std::vector<std::unique_ptr<CapturePartOutput> > outputs(parts.size());
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t next = 0, written = 0;
+    int threads = std::max(options.threads, 1);
+    size_t ahead = 2*threads;
+
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; ++t)
+        workers.push_back(std::thread([&]()
+        {
+            while(true)
+            {
+                size_t k;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    while(next < parts.size() && next >= written + ahead)
+                        cv.wait(lock);
+                    if(next >= parts.size())
+                        return;
+                    k = next++;
+                }
+                std::unique_ptr<CapturePartOutput> output(new CapturePartOutput());
+                DecodeCapturePart(capture, parts[k], options, output.get());
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    outputs[k].swap(output);
+                }
+                cv.notify_all();
+            }
+        }));
+
+    bool ok = true;
+    for(size_t k = 0; k < parts.size(); ++k)
+    {
+        std::unique_ptr<CapturePartOutput> output;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!outputs[k])
+                cv.wait(lock);
+            output.swap(outputs[k]);
+        }
+
+        ok = write(*output) && ok;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            written++;
+        }
+        cv.notify_all();
+    }
+    for(size_t t = 0; t < workers.size(); ++t)
+        workers[t].join();
+    return ok;
+}
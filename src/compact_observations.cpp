@@ -0,0 +1,470 @@
+#include <cstring>
+#include <algorithm>
+
+#include "compact_observations.h"
+#include "novatel_gps.h"
+
+// Observations per message the counts can hold
+#define COMPACT_MAX_ITEMS   65535
+
+static inline uint64_t Bits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline uint32_t Bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline double Double(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline float Float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline uint64_t ZigZag(uint64_t v)
+{
+    return (v << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(v) >> 63);
+}
+
+static inline uint32_t ZigZag(uint32_t v)
+{
+    return (v << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(v) >> 31);
+}
+
+static inline uint64_t UnZigZag(uint64_t v)
+{
+    return (v >> 1) ^ (0 - (v & 1));
+}
+
+static inline void PutVarint(std::vector<uint8_t>& data, uint64_t v)
+{
+    while(v >= 0x80)
+    {
+        data.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(v));
+}
+
+static inline bool GetVarint(const std::vector<uint8_t>& data, size_t& pos, uint64_t* v)
+{
+    uint64_t value = 0;
+    for(int shift = 0; shift < 64 && pos < data.size(); shift += 7)
+    {
+        uint8_t byte = data[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+        {
+            *v = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Values of the last two epochs: a linear prediction (order 2), the last one
+// (order 1) or none
+template <typename T>
+static inline T Predict(const T* last, int order)
+{
+    if(order >= 2)
+        return 2*last[0] - last[1];
+    return order == 1 ? last[0] : 0;
+}
+
+template <typename T>
+static inline void Push(T* last, T value)
+{
+    last[1] = last[0];
+    last[0] = value;
+}
+
+// Prediction order of a track for a message: 2 after two consecutive epochs,
+// 1 when it missed some, 0 when it is empty
+static inline int Order(const CompactTrack& track, uint32_t sequence)
+{
+    if(track.history == 0)
+        return 0;
+    return track.sequence + 1 == sequence ? track.history : 1;
+}
+
+static inline void Advance(CompactTrack& track, uint32_t sequence)
+{
+    bool consecutive = track.history > 0 && track.sequence + 1 == sequence;
+    track.history = consecutive ? 2 : 1;
+    track.sequence = sequence;
+}
+
+static inline void Put(std::vector<uint8_t>& data, uint64_t* last, uint64_t value, int order)
+{
+    PutVarint(data, ZigZag(static_cast<uint64_t>(value - Predict(last, order))));
+    Push(last, value);
+}
+
+static inline void Put(std::vector<uint8_t>& data, uint32_t* last, uint32_t value, int order)
+{
+    PutVarint(data, ZigZag(static_cast<uint32_t>(value - Predict(last, order))));
+    Push(last, value);
+}
+
+// Single-value fields, against the last epoch
+static inline void PutDelta(std::vector<uint8_t>& data, uint32_t& last, uint32_t value, int order)
+{
+    PutVarint(data, ZigZag(static_cast<uint32_t>(value - (order ? last : 0))));
+    last = value;
+}
+
+static inline bool Get(const std::vector<uint8_t>& data, size_t& pos, uint64_t* last, int order, uint64_t* value)
+{
+    uint64_t v;
+    if(!GetVarint(data, pos, &v))
+        return false;
+    *value = Predict(last, order) + UnZigZag(v);
+    Push(last, *value);
+    return true;
+}
+
+static inline bool Get(const std::vector<uint8_t>& data, size_t& pos, uint32_t* last, int order, uint32_t* value)
+{
+    uint64_t v;
+    if(!GetVarint(data, pos, &v) || v > 0xFFFFFFFFULL)
+        return false;
+    *value = Predict(last, order) + static_cast<uint32_t>(UnZigZag(v));
+    Push(last, *value);
+    return true;
+}
+
+static inline bool GetDelta(const std::vector<uint8_t>& data, size_t& pos, uint32_t& last, int order, uint32_t* value)
+{
+    uint64_t v;
+    if(!GetVarint(data, pos, &v) || v > 0xFFFFFFFFULL)
+        return false;
+    *value = (order ? last : 0) + static_cast<uint32_t>(UnZigZag(v));
+    last = *value;
+    return true;
+}
+
+static inline bool GetXor(const std::vector<uint8_t>& data, size_t& pos, uint32_t& last, uint32_t* value)
+{
+    uint64_t v;
+    if(!GetVarint(data, pos, &v) || v > 0xFFFFFFFFULL)
+        return false;
+    *value = last ^ static_cast<uint32_t>(v);
+    last = *value;
+    return true;
+}
+
+// PRNs out of the table share its last entry, which costs compression only
+static inline int PrnIndex(int prn)
+{
+    return prn < 0 || prn >= MAX_PRN_SLOT ? MAX_PRN_SLOT - 1 : prn;
+}
+
+// Entry of range_ for a satellite: GPS and Galileo PRN 5 are different
+// satellites on the same signal slot. Satellites outside the table share the
+// last entry, as above.
+static inline int TrackIndex(uint32_t ch_tr_status, int prn)
+{
+    int index = SatelliteIndex(SatelliteSystem(ch_tr_status), prn);
+    return index < 0 ? MAX_SATELLITES : index;
+}
+
+CompactState::CompactState() :
+    range_sequence_(0),
+    track_sequence_(0)
+{
+    resetRange();
+}
+
+void CompactState::resetRange()
+{
+    memset(status_, 0, sizeof(status_));
+    memset(range_, 0, sizeof(range_));
+}
+
+void CompactState::resetTrackStat()
+{
+    channels_.clear();
+}
+
+CompactEncoder::CompactEncoder(int key_interval) :
+    key_interval_(std::max(key_interval, 1))
+{
+}
+
+/* --------------------------------------------------------------------------
+Per observation: PRN difference, ch_tr_status XOR, psr, psr_std, adr,
+adr_std, doppler, c_no, locktime, slip
+-------------------------------------------------------------------------- */
+void CompactEncoder::encode(const novatel_gps::MsgHeader& header, const novatel_gps::Range& range,
+                            novatel_gps::CompactRange* output)
+{
+    uint32_t sequence = range_sequence_++;
+    bool key = sequence % key_interval_ == 0;
+    if(key)
+        resetRange();
+
+    size_t n = std::min(range.ranges.size(), static_cast<size_t>(COMPACT_MAX_ITEMS));
+    output->gps_week = header.gps_week;
+    output->gps_ms = header.gps_ms;
+    output->sequence = sequence;
+    output->key = key;
+    output->observations = n;
+
+    std::vector<uint8_t>& data = output->data;
+    data.clear();
+    data.reserve(24*n);
+
+    uint8_t count[MAX_PRN_SLOT];
+    memset(count, 0, sizeof(count));
+    int previous = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        const novatel_gps::RangeInformation& obs = range.ranges[i];
+        PutVarint(data, ZigZag(static_cast<uint32_t>(obs.prn_slot - previous)));
+        previous = obs.prn_slot;
+
+        int prn = PrnIndex(obs.prn_slot);
+        int k = std::min<int>(count[prn]++, MAX_SIGNALS - 1);
+        PutVarint(data, obs.ch_tr_status ^ status_[prn][k]);
+        status_[prn][k] = obs.ch_tr_status;
+
+        CompactTrack& track = range_[TrackIndex(obs.ch_tr_status, obs.prn_slot)][SignalSlot(obs.ch_tr_status)];
+        int order = Order(track, sequence);
+        Put(data, track.psr, Bits(obs.psr), order);
+        PutDelta(data, track.psr_std, Bits(obs.psr_std), order);
+        Put(data, track.adr, Bits(obs.adr), order);
+        PutDelta(data, track.adr_std, Bits(obs.adr_std), order);
+        Put(data, track.doppler, Bits(obs.doppler), order);
+        PutDelta(data, track.c_no, Bits(obs.c_no), order);
+        Put(data, track.locktime, Bits(obs.locktime), order);
+        data.push_back(obs.slip);
+        Advance(track, sequence);
+    }
+}
+
+/* --------------------------------------------------------------------------
+Per channel: PRN difference, ch_tr_status and reject XOR, psr, doppler, cn0,
+locktime, psr_res, psr_weight
+-------------------------------------------------------------------------- */
+void CompactEncoder::encode(const novatel_gps::MsgHeader& header, const novatel_gps::TrackStat& tracking,
+                            novatel_gps::CompactTrackStat* output)
+{
+    uint32_t sequence = track_sequence_++;
+    bool key = sequence % key_interval_ == 0;
+    if(key)
+        resetTrackStat();
+
+    size_t n = std::min(tracking.channel.size(), static_cast<size_t>(COMPACT_MAX_ITEMS));
+    output->gps_week = header.gps_week;
+    output->gps_ms = header.gps_ms;
+    output->sequence = sequence;
+    output->key = key;
+    output->solution_status = tracking.solution_status.solution_status;
+    output->position_type = tracking.position_type.position_type;
+    output->cutoff = tracking.cutoff;
+    output->channels = n;
+    if(channels_.size() < n)
+        channels_.resize(n, CompactTrack());
+
+    std::vector<uint8_t>& data = output->data;
+    data.clear();
+    data.reserve(20*n);
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        const novatel_gps::TrackStatChannel& channel = tracking.channel[i];
+        CompactTrack& track = channels_[i];
+        PutVarint(data, ZigZag(static_cast<uint32_t>(channel.prn_slot - track.prn)));
+        if(channel.prn_slot != track.prn)
+            track.history = 0;
+        track.prn = channel.prn_slot;
+        PutVarint(data, channel.ch_tr_status ^ track.ch_tr_status);
+        track.ch_tr_status = channel.ch_tr_status;
+        PutVarint(data, channel.reject ^ track.reject);
+        track.reject = channel.reject;
+
+        int order = Order(track, sequence);
+        Put(data, track.psr, Bits(channel.psr), order);
+        Put(data, track.doppler, Bits(channel.doppler), order);
+        PutDelta(data, track.psr_std, Bits(channel.cn0), order);
+        Put(data, track.locktime, Bits(channel.locktime), order);
+        PutDelta(data, track.adr_std, Bits(channel.psr_res), order);
+        PutDelta(data, track.c_no, Bits(channel.psr_weight), order);
+        Advance(track, sequence);
+    }
+}
+
+CompactDecoder::CompactDecoder() :
+    range_synced_(false),
+    track_synced_(false)
+{
+}
+
+bool CompactDecoder::decode(const novatel_gps::CompactRange& input, novatel_gps::Range* output)
+{
+    if(input.key)
+    {
+        resetRange();
+        range_synced_ = true;
+    }
+    else if(!range_synced_ || input.sequence != range_sequence_)
+    {
+        range_synced_ = false;
+        return false;
+    }
+    uint32_t sequence = input.sequence;
+    range_sequence_ = sequence + 1;
+
+    const std::vector<uint8_t>& data = input.data;
+    size_t pos = 0;
+    output->obs = input.observations;
+    output->ranges.resize(input.observations);
+
+    uint8_t count[MAX_PRN_SLOT];
+    memset(count, 0, sizeof(count));
+    int previous = 0;
+    bool ok = true;
+    for(size_t i = 0; ok && i < input.observations; ++i)
+    {
+        novatel_gps::RangeInformation& obs = output->ranges[i];
+        uint64_t v;
+        if(!GetVarint(data, pos, &v) || v > 0xFFFFFFFFULL)
+        {
+            ok = false;
+            break;
+        }
+        obs.prn_slot = static_cast<int16_t>(previous + static_cast<int32_t>(UnZigZag(v)));
+        previous = obs.prn_slot;
+
+        int prn = PrnIndex(obs.prn_slot);
+        int k = std::min<int>(count[prn]++, MAX_SIGNALS - 1);
+        if(!GetXor(data, pos, status_[prn][k], &obs.ch_tr_status))
+        {
+            ok = false;
+            break;
+        }
+        DecodeTrackingStatus(obs.ch_tr_status, obs.tracking_status);
+
+        CompactTrack& track = range_[TrackIndex(obs.ch_tr_status, obs.prn_slot)][SignalSlot(obs.ch_tr_status)];
+        int order = Order(track, sequence);
+        uint64_t psr, adr;
+        uint32_t psr_std, adr_std, doppler, c_no, locktime;
+        ok = Get(data, pos, track.psr, order, &psr) &&
+             GetDelta(data, pos, track.psr_std, order, &psr_std) &&
+             Get(data, pos, track.adr, order, &adr) &&
+             GetDelta(data, pos, track.adr_std, order, &adr_std) &&
+             Get(data, pos, track.doppler, order, &doppler) &&
+             GetDelta(data, pos, track.c_no, order, &c_no) &&
+             Get(data, pos, track.locktime, order, &locktime) &&
+             pos < data.size();
+        if(!ok)
+            break;
+        obs.psr = Double(psr);
+        obs.psr_std = Float(psr_std);
+        obs.adr = Double(adr);
+        obs.adr_std = Float(adr_std);
+        obs.doppler = Float(doppler);
+        obs.c_no = Float(c_no);
+        obs.locktime = Float(locktime);
+        obs.slip = data[pos++];
+        Advance(track, sequence);
+    }
+
+    if(!ok || pos != data.size())
+    {
+        range_synced_ = false;
+        return false;
+    }
+    return true;
+}
+
+bool CompactDecoder::decode(const novatel_gps::CompactTrackStat& input, novatel_gps::TrackStat* output)
+{
+    if(input.key)
+    {
+        resetTrackStat();
+        track_synced_ = true;
+    }
+    else if(!track_synced_ || input.sequence != track_sequence_)
+    {
+        track_synced_ = false;
+        return false;
+    }
+    uint32_t sequence = input.sequence;
+    track_sequence_ = sequence + 1;
+
+    const std::vector<uint8_t>& data = input.data;
+    size_t pos = 0;
+    output->solution_status.solution_status = input.solution_status;
+    output->position_type.position_type = input.position_type;
+    output->cutoff = input.cutoff;
+    output->channels = input.channels;
+    output->channel.resize(input.channels);
+    if(channels_.size() < input.channels)
+        channels_.resize(input.channels, CompactTrack());
+
+    bool ok = true;
+    for(size_t i = 0; ok && i < input.channels; ++i)
+    {
+        novatel_gps::TrackStatChannel& channel = output->channel[i];
+        CompactTrack& track = channels_[i];
+        uint64_t v;
+        if(!GetVarint(data, pos, &v) || v > 0xFFFFFFFFULL)
+        {
+            ok = false;
+            break;
+        }
+        channel.prn_slot = static_cast<int16_t>(track.prn + static_cast<int32_t>(UnZigZag(v)));
+        if(channel.prn_slot != track.prn)
+            track.history = 0;
+        track.prn = channel.prn_slot;
+        if(!GetXor(data, pos, track.ch_tr_status, &channel.ch_tr_status) ||
+           !GetXor(data, pos, track.reject, &channel.reject))
+        {
+            ok = false;
+            break;
+        }
+        DecodeTrackingStatus(channel.ch_tr_status, channel.tracking_status);
+
+        int order = Order(track, sequence);
+        uint64_t psr;
+        uint32_t doppler, cn0, locktime, psr_res, psr_weight;
+        ok = Get(data, pos, track.psr, order, &psr) &&
+             Get(data, pos, track.doppler, order, &doppler) &&
+             GetDelta(data, pos, track.psr_std, order, &cn0) &&
+             Get(data, pos, track.locktime, order, &locktime) &&
+             GetDelta(data, pos, track.adr_std, order, &psr_res) &&
+             GetDelta(data, pos, track.c_no, order, &psr_weight);
+        if(!ok)
+            break;
+        channel.psr = Double(psr);
+        channel.doppler = Float(doppler);
+        channel.cn0 = Float(cn0);
+        channel.locktime = Float(locktime);
+        channel.psr_res = Float(psr_res);
+        channel.psr_weight = Float(psr_weight);
+        Advance(track, sequence);
+    }
+
+    if(!ok || pos != data.size())
+    {
+        track_synced_ = false;
+        return false;
+    }
+    return true;
+}
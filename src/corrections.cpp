@@ -0,0 +1,330 @@
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "ros/ros.h"
+#include "corrections.h"
+
+#define CRC24Q_POLYNOMIAL   0x1864CFB
+#define RTCM3_PREAMBLE      0xD3
+
+static int64_t MonotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+/* --------------------------------------------------------------------------
+CRC-24Q (RTCM 10403, Qualcomm), bit by bit: corrections are a few kB/s
+-------------------------------------------------------------------------- */
+uint32_t CalculateCRC24Q(const uint8_t* data, size_t len)
+{
+    uint32_t crc = 0;
+    for(size_t i = 0; i < len; ++i)
+    {
+        crc ^= static_cast<uint32_t>(data[i]) << 16;
+        for(int j = 0; j < 8; ++j)
+        {
+            crc <<= 1;
+            if(crc & 0x1000000)
+                crc ^= CRC24Q_POLYNOMIAL;
+        }
+    }
+    return crc & 0xFFFFFF;
+}
+
+/*************************** RtcmFramer ***************************/
+
+void RtcmFramer::feed(const uint8_t* data, size_t size, const MessageCallback& callback)
+{
+    buffer_.insert(buffer_.end(), data, data + size);
+
+    size_t pos = 0;
+    while(true)
+    {
+        // Preamble
+        while(pos < buffer_.size() && buffer_[pos] != RTCM3_PREAMBLE)
+            pos++;
+        if(buffer_.size() - pos < 3)
+            break;
+        if(buffer_[pos + 1] & 0xFC)
+        {
+            // The six bits before the length are reserved, zero
+            pos++;
+            continue;
+        }
+
+        size_t length = ((buffer_[pos + 1] & 0x03) << 8) | buffer_[pos + 2];
+        size_t total = 3 + length + 3;
+        if(buffer_.size() - pos < total)
+            break;
+
+        const uint8_t* m = &buffer_[pos];
+        uint32_t crc = (m[total - 3] << 16) | (m[total - 2] << 8) | m[total - 1];
+        if(CalculateCRC24Q(m, total - 3) == crc)
+        {
+            callback(m, total);
+            pos += total;
+        }
+        else
+        {
+            // False preamble or corrupted message, resync on the next byte
+            crc_errors_++;
+            pos++;
+        }
+    }
+    buffer_.erase(buffer_.begin(), buffer_.begin() + pos);
+}
+
+/*************************** CorrectionWriter ***************************/
+
+CorrectionWriter::CorrectionWriter(int fd, double max_age, size_t max_queue_bytes) :
+    fd_(fd),
+    max_age_ns_(static_cast<int64_t>(max_age*1e9)),
+    max_queue_bytes_(max_queue_bytes),
+    queue_bytes_(0),
+    running_(true)
+{
+    memset(&stats_, 0, sizeof(stats_));
+    thread_ = std::thread(&CorrectionWriter::run, this);
+}
+
+CorrectionWriter::~CorrectionWriter()
+{
+    running_ = false;
+    cv_.notify_all();
+    thread_.join();
+}
+
+void CorrectionWriter::push(const uint8_t* message, size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(Message());
+        queue_.back().data.assign(message, message + size);
+        queue_.back().arrival_ns = MonotonicNs();
+        queue_bytes_ += size;
+
+        // Backpressure: the newest corrections are the useful ones
+        while(queue_bytes_ > max_queue_bytes_ && queue_.size() > 1)
+        {
+            queue_bytes_ -= queue_.front().data.size();
+            queue_.pop_front();
+            stats_.dropped_overflow++;
+        }
+    }
+    cv_.notify_one();
+}
+
+CorrectionStats CorrectionWriter::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    CorrectionStats stats = stats_;
+    stats.queue_messages = queue_.size();
+    stats.queue_bytes = queue_bytes_;
+    stats_.max_age = 0.0;
+    return stats;
+}
+
+void CorrectionWriter::run()
+{
+    Message message;
+    while(running_)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while(queue_.empty() && running_)
+                cv_.wait(lock);
+            if(!running_)
+                return;
+
+            message.data.swap(queue_.front().data);
+            message.arrival_ns = queue_.front().arrival_ns;
+            queue_bytes_ -= message.data.size();
+            queue_.pop_front();
+
+            if(MonotonicNs() - message.arrival_ns > max_age_ns_)
+            {
+                stats_.dropped_stale++;
+                continue;
+            }
+        }
+
+        bool ok = writeAll(message.data.data(), message.data.size());
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(ok)
+        {
+            stats_.messages++;
+            stats_.bytes += message.data.size();
+            stats_.last_age = (MonotonicNs() - message.arrival_ns)/1e9;
+            stats_.max_age = std::max(stats_.max_age, stats_.last_age);
+        }
+    }
+}
+
+bool CorrectionWriter::writeAll(const uint8_t* data, size_t size)
+{
+    // The port may be non-blocking (shared with the reader), wait for room
+    while(size > 0 && running_)
+    {
+        ssize_t n = ::write(fd_, data, size);
+        if(n > 0)
+        {
+            data += n;
+            size -= n;
+            continue;
+        }
+        if(n < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            ROS_ERROR("correction write failed: %s", strerror(errno));
+            return false;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = fd_;
+        pfd.events = POLLOUT;
+        poll(&pfd, 1, 100);
+    }
+    return size == 0;
+}
+
+/*************************** CorrectionSource ***************************/
+
+CorrectionSource::CorrectionSource(const std::string& url, CorrectionWriter* writer) :
+    url_(url),
+    writer_(writer),
+    regular_file_(false),
+    running_(true)
+{
+    thread_ = std::thread(&CorrectionSource::run, this);
+}
+
+CorrectionSource::~CorrectionSource()
+{
+    running_ = false;
+    thread_.join();
+}
+
+int CorrectionSource::connect()
+{
+    if(url_.compare(0, 7, "file://") == 0)
+    {
+        int fd = ::open(url_.substr(7).c_str(), O_RDONLY | O_NONBLOCK);
+        if(fd < 0)
+        {
+            ROS_ERROR("could not open corrections %s: %s", url_.c_str(), strerror(errno));
+            return fd;
+        }
+        struct stat st;
+        regular_file_ = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode));
+        return fd;
+    }
+
+    bool tcp = (url_.compare(0, 6, "tcp://") == 0);
+    bool udp = (url_.compare(0, 6, "udp://") == 0);
+    size_t colon = url_.rfind(':');
+    if((!tcp && !udp) || colon < 6)
+    {
+        ROS_ERROR("unsupported corrections source %s (tcp://host:port, udp://:port or file:///path)", url_.c_str());
+        running_ = false;
+        return -1;
+    }
+    std::string host = url_.substr(6, colon - 6);
+    std::string port = url_.substr(colon + 1);
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = tcp ? SOCK_STREAM : SOCK_DGRAM;
+    hints.ai_flags = udp ? AI_PASSIVE : 0;
+    if(getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &res) != 0)
+    {
+        ROS_ERROR("could not resolve corrections source %s", url_.c_str());
+        return -1;
+    }
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    bool ok = (fd >= 0);
+    if(ok && tcp)
+    {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        ok = (::connect(fd, res->ai_addr, res->ai_addrlen) == 0);
+    }
+    else if(ok)
+    {
+        ok = (bind(fd, res->ai_addr, res->ai_addrlen) == 0);
+    }
+    freeaddrinfo(res);
+
+    if(!ok)
+    {
+        ROS_ERROR("could not open corrections source %s: %s", url_.c_str(), strerror(errno));
+        if(fd >= 0)
+            ::close(fd);
+        return -1;
+    }
+    ROS_INFO("Reading corrections from %s", url_.c_str());
+    return fd;
+}
+
+void CorrectionSource::run()
+{
+    uint8_t buffer[4096];
+    RtcmFramer::MessageCallback push = std::bind(&CorrectionWriter::push, writer_,
+                                                 std::placeholders::_1, std::placeholders::_2);
+
+    while(running_)
+    {
+        int fd = connect();
+        if(fd < 0)
+        {
+            // Retry, the caster may come back
+            for(int i = 0; i < 50 && running_; ++i)
+                std::this_thread::sleep_for( std::chrono::milliseconds(100) );
+            continue;
+        }
+
+        while(running_)
+        {
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            if(poll(&pfd, 1, 100) <= 0)
+                continue;
+
+            ssize_t n = ::read(fd, buffer, sizeof(buffer));
+            if(n > 0)
+            {
+                framer_.feed(buffer, n, push);
+            }
+            else if(n == 0 && regular_file_)
+            {
+                // Read once: reopening would inject the same corrections again
+                ROS_INFO("corrections file %s read to the end", url_.c_str());
+                running_ = false;
+            }
+            else if(n == 0 || (errno != EAGAIN && errno != EINTR))
+            {
+                ROS_WARN("corrections source %s closed, reconnecting", url_.c_str());
+                break;
+            }
+        }
+        ::close(fd);
+        if(running_)
+            std::this_thread::sleep_for( std::chrono::milliseconds(100) );
+    }
+}
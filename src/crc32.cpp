@@ -0,0 +1,59 @@
+#include "crc32.h"
+
+/*************************** CRC functions (Firmware Reference Manual, p.32 + APN-030 Rev 1 Application Note) ***************************/
+
+#define CRC32_POLYNOMIAL    0xEDB88320L
+
+/* --------------------------------------------------------------------------
+Calculate a CRC value to be used by CRC calculation functions.
+-------------------------------------------------------------------------- */
+static uint32_t CRC32Value(int i)
+{
+    int j;
+    uint32_t ulCRC;
+    ulCRC = i;
+
+    for ( j = 8 ; j > 0; j-- )
+    {
+        if ( ulCRC & 1 )
+            ulCRC = ( ulCRC >> 1 ) ^ CRC32_POLYNOMIAL;
+        else
+            ulCRC >>= 1;
+    }
+    return ulCRC;
+}
+
+// CRC32Value() of every byte, built on first use
+struct CRC32Table
+{
+    uint32_t value[256];
+
+    CRC32Table()
+    {
+        for(int i = 0; i < 256; ++i)
+            value[i] = CRC32Value(i);
+    }
+};
+
+static const uint32_t* CRC32Values()
+{
+    static const CRC32Table table;
+    return table.value;
+}
+
+/* --------------------------------------------------------------------------
+Calculates the CRC-32 of a block of data all at once
+-------------------------------------------------------------------------- */
+uint32_t CalculateBlockCRC32
+(
+    uint32_t ulCount,  /* Number of bytes in the data block */
+    const uint8_t *ucBuffer /* Data block */
+)
+{
+    const uint32_t* table = CRC32Values();
+    uint32_t ulCRC = 0;
+
+    while ( ulCount-- != 0 )
+        ulCRC = ( ( ulCRC >> 8 ) & 0x00FFFFFFL ) ^ table[ ( ulCRC ^ *ucBuffer++ ) & 0xff ];
+    return( ulCRC );
+}
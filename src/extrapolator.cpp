@@ -0,0 +1,84 @@
+#include "extrapolator.h"
+
+// Fixes further apart than this give no usable acceleration
+#define MAX_ACCEL_INTERVAL  1.0
+
+PoseExtrapolator::PoseExtrapolator() :
+    max_age_(1.0),
+    accel_var_(1.0),
+    fix_(),
+    valid_(false),
+    previous_time_(0.0),
+    have_previous_(false)
+{
+}
+
+void PoseExtrapolator::configure(double max_age, double accel_noise)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_age_ = max_age;
+    accel_var_ = accel_noise*accel_noise;
+}
+
+void PoseExtrapolator::addFix(const SolutionSample& fix, double velocity_latency, int64_t receive_ns)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(valid_ && fix.gps_time <= fix_.gps_time)
+        return;     // Repeated epoch
+
+    double dt = fix.gps_time - previous_time_;
+    bool accel = have_previous_ && dt > 0.0 && dt <= MAX_ACCEL_INTERVAL;
+
+    fix_ = fix;
+    for(int i = 0; i < 3; ++i)
+    {
+        // The reported velocity is the one of velocity_latency seconds ago
+        if(accel)
+            fix_.velocity[i] += (fix.velocity[i] - previous_velocity_[i])/dt*velocity_latency;
+        fix_.velocity_var[i] += accel_var_*velocity_latency*velocity_latency;
+        previous_velocity_[i] = fix.velocity[i];
+    }
+    previous_time_ = fix.gps_time;
+    have_previous_ = true;
+    valid_ = true;
+
+    host_offset_.add(fix.gps_time, receive_ns);
+}
+
+void PoseExtrapolator::invalidate()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    valid_ = false;
+    have_previous_ = false;
+}
+
+bool PoseExtrapolator::at(int64_t stamp_ns, ExtrapolatedPose* out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!valid_)
+        return false;
+
+    double host_time = stamp_ns/1e9;
+    double gps_time = host_time - host_offset_.offset();
+
+    // Slightly negative right after a fix when it came in with the least latency
+    double tau = gps_time - fix_.gps_time;
+    if(tau < 0.0)
+        tau = 0.0;
+    if(tau > max_age_)
+        return false;
+
+    double tau2 = tau*tau;
+    for(int i = 0; i < 3; ++i)
+    {
+        out->position[i] = fix_.position[i] + fix_.velocity[i]*tau;
+        out->velocity[i] = fix_.velocity[i];
+        out->position_var[i] = fix_.position_var[i] + fix_.velocity_var[i]*tau2 + accel_var_*tau2*tau2/4.0;
+        out->velocity_var[i] = fix_.velocity_var[i] + accel_var_*tau2;
+    }
+    out->host_time = host_time;
+    out->gps_time = gps_time;
+    out->age = tau;
+    out->position_type = fix_.position_type;
+    return true;
+}
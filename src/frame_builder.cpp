@@ -0,0 +1,289 @@
+#include <cstring>
+#include <cmath>
+
+#include "frame_builder.h"
+#include "crc32.h"
+
+#define SPEED_OF_LIGHT      299792458.0
+#define L1_WAVELENGTH       (SPEED_OF_LIGHT / 1575.42e6)
+#define L2_WAVELENGTH       (SPEED_OF_LIGHT / 1227.60e6)
+#define ADR_ROLLOVER        8388608.0
+
+// Channel tracking status words of a locked GPS L1 C/A and L2 P codeless channel
+#define TRKSTAT_L1          0x08109C04
+#define TRKSTAT_L2          0x01309C0B
+
+template <typename T>
+static void Put(std::vector<uint8_t>* body, int offset, T value)
+{
+    memcpy(&(*body)[offset], &value, sizeof(T));
+}
+
+// Numerical Recipes LCG, good enough for test data
+static double Uniform(uint32_t* state, double lo, double hi)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (*state / 4294967296.0);
+}
+
+/* --------------------------------------------------------------------------
+Inverse of the RANGECMP ExtractBits: ORs a len bit field into little-endian
+64 bit words starting at bit start.
+-------------------------------------------------------------------------- */
+static void PutBits(uint64_t* words, int start, int len, uint64_t value)
+{
+    int w = start >> 6;
+    int s = start & 63;
+    value &= (len == 64) ? ~0ULL : ((1ULL << len) - 1);
+    words[w] |= value << s;
+    if(s + len > 64)
+        words[w + 1] |= value >> (64 - s);
+}
+
+// One observation per signal, L1 and L2 of each satellite in turn
+struct Observation
+{
+    uint16_t prn;
+    uint32_t ch_tr_status;
+    double psr;
+    double adr;
+    float psr_std;
+    float adr_std;
+    float doppler;
+    float c_no;
+    float locktime;
+};
+
+static Observation SyntheticObservation(int i, uint32_t seed)
+{
+    uint32_t state = seed + (i/2)*7919u;
+    Observation o;
+    o.prn = 1 + (i/2) % 32;
+    o.ch_tr_status = (i % 2) ? TRKSTAT_L2 : TRKSTAT_L1;
+    o.psr = Uniform(&state, 2.0e7, 2.6e7);
+    o.doppler = Uniform(&state, -4000.0, 4000.0);
+    o.c_no = Uniform(&state, 30.0, 50.0);
+    o.locktime = Uniform(&state, 0.0, 10000.0);
+    o.psr_std = Uniform(&state, 0.05, 1.0);
+    o.adr_std = 0.0059f;
+    if(i % 2)
+    {
+        o.doppler *= 1227.60/1575.42;
+        o.c_no -= 6.0;
+    }
+    o.adr = -o.psr / ((i % 2) ? L2_WAVELENGTH : L1_WAVELENGTH) + Uniform(&state, -10.0, 10.0);
+    return o;
+}
+
+/*************************** Frames ***************************/
+
+void BuildFrame(uint16_t msg_id, const std::vector<uint8_t>& body, uint16_t week, uint32_t ms,
+                std::vector<uint8_t>* frame)
+{
+    // Message Header, Firmware Reference Manual pg. 23
+    std::vector<uint8_t> header(28, 0);
+    header[0] = 0xAA;
+    header[1] = 0x44;
+    header[2] = 0x12;
+    header[3] = 28;
+    Put<uint16_t>(&header, 4, msg_id);
+    Put<uint16_t>(&header, 8, body.size());
+    header[13] = 180;       // FINESTEERING
+    Put<uint16_t>(&header, 14, week);
+    Put<uint32_t>(&header, 16, ms);
+
+    size_t start = frame->size();
+    frame->insert(frame->end(), header.begin(), header.end());
+    frame->insert(frame->end(), body.begin(), body.end());
+
+    uint32_t crc = CalculateBlockCRC32(frame->size() - start, &(*frame)[start]);
+    for(int k = 0; k < 4; ++k)
+        frame->push_back((crc >> (8*k)) & 0xFF);
+}
+
+void BuildShortFrame(uint16_t msg_id, const std::vector<uint8_t>& body, uint16_t week, uint32_t ms,
+                     std::vector<uint8_t>* frame)
+{
+    // Short Message Header, Firmware Reference Manual pg. 24
+    std::vector<uint8_t> header(12, 0);
+    header[0] = 0xAA;
+    header[1] = 0x44;
+    header[2] = 0x13;
+    header[3] = static_cast<uint8_t>(body.size());
+    Put<uint16_t>(&header, 4, msg_id);
+    Put<uint16_t>(&header, 6, week);
+    Put<uint32_t>(&header, 8, ms);
+
+    size_t start = frame->size();
+    frame->insert(frame->end(), header.begin(), header.end());
+    frame->insert(frame->end(), body.begin(), body.end());
+
+    uint32_t crc = CalculateBlockCRC32(frame->size() - start, &(*frame)[start]);
+    for(int k = 0; k < 4; ++k)
+        frame->push_back((crc >> (8*k)) & 0xFF);
+}
+
+/*************************** Log bodies ***************************/
+
+void BuildBestXYZBody(const double position[3], const double velocity[3], std::vector<uint8_t>* body)
+{
+    // BESTXYZ Log, Firmware Reference Manual pg. 264
+    body->assign(112, 0);
+    Put<uint32_t>(body, 4, 16);         // SINGLE
+    for(int k = 0; k < 3; ++k)
+    {
+        Put<double>(body, 8 + 8*k, position[k]);
+        Put<float>(body, 32 + 4*k, 1.5f);
+        Put<double>(body, 52 + 8*k, velocity[k]);
+        Put<float>(body, 76 + 4*k, 0.05f);
+    }
+    Put<uint32_t>(body, 48, 8);         // DOPPLER_VELOCITY
+    Put<float>(body, 92, 0.15f);        // Velocity latency
+    (*body)[104] = 12;
+    (*body)[105] = 10;
+}
+
+void BuildBestPosBody(double latitude, double longitude, double height, std::vector<uint8_t>* body)
+{
+    // BESTPOS Log, Firmware Reference Manual pg. 256
+    body->assign(72, 0);
+    Put<uint32_t>(body, 4, 16);         // SINGLE
+    Put<double>(body, 8, latitude);
+    Put<double>(body, 16, longitude);
+    Put<double>(body, 24, height);
+    Put<uint32_t>(body, 36, 61);        // WGS84
+    Put<float>(body, 40, 1.2f);
+    Put<float>(body, 44, 1.0f);
+    Put<float>(body, 48, 2.5f);
+    (*body)[64] = 12;
+    (*body)[65] = 10;
+}
+
+void BuildRangeBody(int obs, uint32_t seed, std::vector<uint8_t>* body)
+{
+    // RANGE Log, Firmware Reference Manual pg. 403
+    body->assign(4 + 44*obs, 0);
+    Put<uint32_t>(body, 0, obs);
+
+    for(int i = 0; i < obs; ++i)
+    {
+        Observation o = SyntheticObservation(i, seed);
+        int b = 4 + 44*i;
+        Put<uint16_t>(body, b, o.prn);
+        Put<double>(body, b + 4, o.psr);
+        Put<float>(body, b + 12, o.psr_std);
+        Put<double>(body, b + 16, o.adr);
+        Put<float>(body, b + 24, o.adr_std);
+        Put<float>(body, b + 28, o.doppler);
+        Put<float>(body, b + 32, o.c_no);
+        Put<float>(body, b + 36, o.locktime);
+        Put<uint32_t>(body, b + 40, o.ch_tr_status);
+    }
+}
+
+void BuildRangeCmpBody(int obs, uint32_t seed, std::vector<uint8_t>* body)
+{
+    // RANGECMP Log, Firmware Reference Manual pg. 407
+    body->assign(4 + 24*obs, 0);
+    Put<uint32_t>(body, 0, obs);
+
+    for(int i = 0; i < obs; ++i)
+    {
+        Observation o = SyntheticObservation(i, seed);
+        double adr = o.adr - ADR_ROLLOVER * std::floor(o.adr / ADR_ROLLOVER + 0.5);
+
+        uint64_t words[3] = { 0, 0, 0 };
+        PutBits(words, 0, 32, o.ch_tr_status);
+        PutBits(words, 32, 28, static_cast<int64_t>(std::floor(o.doppler*256.0 + 0.5)));
+        PutBits(words, 60, 36, static_cast<uint64_t>(o.psr*128.0 + 0.5));
+        PutBits(words, 96, 32, static_cast<int64_t>(std::floor(adr*256.0 + 0.5)));
+        PutBits(words, 128, 4, 3);      // 0.169 m
+        PutBits(words, 132, 4, 2);      // 0.0059 cycles
+        PutBits(words, 136, 8, o.prn);
+        PutBits(words, 144, 21, static_cast<uint64_t>(o.locktime*32.0));
+        PutBits(words, 165, 5, static_cast<uint64_t>(o.c_no - 20.0));
+        memcpy(&(*body)[4 + 24*i], words, sizeof(words));
+    }
+}
+
+void BuildSatXYZBody(int sats, uint32_t seed, std::vector<uint8_t>* body)
+{
+    // SATXYZ Log, Firmware Reference Manual pg. 562
+    body->assign(12 + 68*sats, 0);
+    Put<uint32_t>(body, 8, sats);
+
+    for(int i = 0; i < sats; ++i)
+    {
+        uint32_t state = seed + i*104729u;
+        double az = Uniform(&state, 0.0, 2.0*M_PI);
+        double z = Uniform(&state, -0.9, 0.9);
+        double r = 26560.0e3;
+
+        int b = 12 + 68*i;
+        Put<uint32_t>(body, b, 1 + i % 32);
+        Put<double>(body, b + 4, r*std::sqrt(1.0 - z*z)*std::cos(az));
+        Put<double>(body, b + 12, r*std::sqrt(1.0 - z*z)*std::sin(az));
+        Put<double>(body, b + 20, r*z);
+        Put<double>(body, b + 28, Uniform(&state, -1.0e5, 1.0e5));
+        Put<double>(body, b + 36, Uniform(&state, 1.0, 10.0));
+        Put<double>(body, b + 44, Uniform(&state, 2.0, 20.0));
+    }
+}
+
+void BuildTrackStatBody(int channels, uint32_t seed, std::vector<uint8_t>* body)
+{
+    // TRACKSTAT Log, Firmware Reference Manual pg. 568
+    body->assign(16 + 40*channels, 0);
+    Put<uint32_t>(body, 4, 16);         // SINGLE
+    Put<float>(body, 8, 5.0f);
+    Put<int32_t>(body, 12, channels);
+
+    for(int i = 0; i < channels; ++i)
+    {
+        Observation o = SyntheticObservation(i, seed);
+        uint32_t state = seed + i;
+
+        int b = 16 + 40*i;
+        Put<int16_t>(body, b, o.prn);
+        Put<uint32_t>(body, b + 4, o.ch_tr_status);
+        Put<double>(body, b + 8, o.psr);
+        Put<float>(body, b + 16, o.doppler);
+        Put<float>(body, b + 20, o.c_no);
+        Put<float>(body, b + 24, o.locktime);
+        Put<float>(body, b + 28, Uniform(&state, -5.0, 5.0));
+        Put<uint32_t>(body, b + 32, 0);     // GOOD
+        Put<float>(body, b + 36, Uniform(&state, 0.1, 1.0));
+    }
+}
+
+void BuildInsPvaBody(uint32_t week, double seconds, double latitude, double longitude, double height,
+                     const double velocity[3], const double attitude[3], std::vector<uint8_t>* body)
+{
+    // INSPVA Log, SPAN Firmware Reference Manual
+    body->assign(88, 0);
+    Put<uint32_t>(body, 0, week);
+    Put<double>(body, 4, seconds);
+    Put<double>(body, 12, latitude);
+    Put<double>(body, 20, longitude);
+    Put<double>(body, 28, height);
+    for(int k = 0; k < 3; ++k)
+    {
+        Put<double>(body, 36 + 8*k, velocity[k]);
+        Put<double>(body, 60 + 8*k, attitude[k]);
+    }
+    Put<uint32_t>(body, 84, 3);         // INS_SOLUTION_GOOD
+}
+
+void BuildCorrImuDataBody(uint32_t week, double seconds, const double angular[3], const double linear[3],
+                          std::vector<uint8_t>* body)
+{
+    // CORRIMUDATA Log, SPAN Firmware Reference Manual
+    body->assign(60, 0);
+    Put<uint32_t>(body, 0, week);
+    Put<double>(body, 4, seconds);
+    for(int k = 0; k < 3; ++k)
+    {
+        Put<double>(body, 12 + 8*k, angular[k]);
+        Put<double>(body, 36 + 8*k, linear[k]);
+    }
+}
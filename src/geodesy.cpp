@@ -0,0 +1,84 @@
+#include <cmath>
+#include "geodesy.h"
+
+void LlaToEcef(double lat, double lon, double h, double ecef[3])
+{
+    double sin_lat = std::sin(lat);
+    double cos_lat = std::cos(lat);
+    double N = WGS84_A / std::sqrt(1.0 - WGS84_E2*sin_lat*sin_lat);
+
+    ecef[0] = (N + h)*cos_lat*std::cos(lon);
+    ecef[1] = (N + h)*cos_lat*std::sin(lon);
+    ecef[2] = (N*(1.0 - WGS84_E2) + h)*sin_lat;
+}
+
+void EcefToLla(const double ecef[3], double* lat, double* lon, double* h)
+{
+    const double e4 = WGS84_E2*WGS84_E2;
+    double x = ecef[0], y = ecef[1], z = ecef[2];
+    double rho = std::sqrt(x*x + y*y);
+
+    double p = rho*rho/(WGS84_A*WGS84_A);
+    double q = (1.0 - WGS84_E2)*z*z/(WGS84_A*WGS84_A);
+    double r = (p + q - e4)/6.0;
+    double s = e4*p*q/(4.0*r*r*r);
+    double t = std::cbrt(1.0 + s + std::sqrt(s*(2.0 + s)));
+    double u = r*(1.0 + t + 1.0/t);
+    double v = std::sqrt(u*u + e4*q);
+    double w = WGS84_E2*(u + v - q)/(2.0*v);
+    double k = std::sqrt(u + v + w*w) - w;
+    double D = k*rho/(k + WGS84_E2);
+    double Dz = std::sqrt(D*D + z*z);
+
+    *lat = 2.0*std::atan2(z, D + Dz);
+    *lon = std::atan2(y, x);
+    *h = (k + WGS84_E2 - 1.0)/k*Dz;
+}
+
+void EnuRotation(double lat, double lon, double R[9])
+{
+    double sin_lat = std::sin(lat), cos_lat = std::cos(lat);
+    double sin_lon = std::sin(lon), cos_lon = std::cos(lon);
+
+    // East
+    R[0] = -sin_lon;            R[1] = cos_lon;             R[2] = 0.0;
+    // North
+    R[3] = -sin_lat*cos_lon;    R[4] = -sin_lat*sin_lon;    R[5] = cos_lat;
+    // Up
+    R[6] = cos_lat*cos_lon;     R[7] = cos_lat*sin_lon;     R[8] = sin_lat;
+}
+
+void EcefToEnu(const double ecef[3], const double origin_ecef[3], const double R[9], double enu[3])
+{
+    double d[3] = { ecef[0] - origin_ecef[0], ecef[1] - origin_ecef[1], ecef[2] - origin_ecef[2] };
+
+    for(int i = 0; i < 3; ++i)
+        enu[i] = R[3*i]*d[0] + R[3*i + 1]*d[1] + R[3*i + 2]*d[2];
+}
+
+void RotateCovariance(const double R[9], const double C[9], double out[9])
+{
+    double RC[9];
+    for(int i = 0; i < 3; ++i)
+        for(int j = 0; j < 3; ++j)
+            RC[3*i + j] = R[3*i]*C[j] + R[3*i + 1]*C[3 + j] + R[3*i + 2]*C[6 + j];
+
+    for(int i = 0; i < 3; ++i)
+        for(int j = 0; j < 3; ++j)
+            out[3*i + j] = RC[3*i]*R[3*j] + RC[3*i + 1]*R[3*j + 1] + RC[3*i + 2]*R[3*j + 2];
+}
+
+void AttitudeToQuaternion(double roll, double pitch, double azimuth, double q[4])
+{
+    // SPAN rotation order is z (-azimuth, to make it counter-clockwise), x (pitch), y (roll)
+    double hz = -azimuth*DEG2RAD/2.0, hx = pitch*DEG2RAD/2.0, hy = roll*DEG2RAD/2.0;
+    double cz = std::cos(hz), sz = std::sin(hz);
+    double cx = std::cos(hx), sx = std::sin(hx);
+    double cy = std::cos(hy), sy = std::sin(hy);
+
+    // q = qz * qx * qy
+    q[0] = cz*sx*cy - sz*cx*sy;
+    q[1] = cz*cx*sy + sz*sx*cy;
+    q[2] = sz*cx*cy + cz*sx*sy;
+    q[3] = cz*cx*cy - sz*sx*sy;
+}
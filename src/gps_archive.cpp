@@ -0,0 +1,251 @@
+// Log archive query tool: summarises an archive written by the driver
+// (archive parameter) or prints the rows of one log between two GPS times as
+// CSV, decoding only the selected columns. Also an example of the
+// log_archive.h reader API.
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <strings.h>
+#include <time.h>
+
+#include "log_archive.h"
+#include "satellite_table.h"
+
+#define GPS_EPOCH_UNIX      315964800LL     // 1980-01-06 00:00:00
+#define WEEK_MS             604800000LL
+
+static int64_t MonotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+// WEEK:SECONDS or YYYY-MM-DDTHH:MM:SS[.s] (GPS time) to ms since the GPS epoch
+static bool ParseTime(const char* text, int64_t* ms)
+{
+    int week;
+    double seconds;
+    char end;
+    if(sscanf(text, "%d:%lf%c", &week, &seconds, &end) == 2)
+    {
+        *ms = week*WEEK_MS + static_cast<int64_t>(seconds*1000.0 + 0.5);
+        return true;
+    }
+
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    double second;
+    if(sscanf(text, "%d-%d-%dT%d:%d:%lf", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &second) != 6)
+        return false;
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    int64_t whole = static_cast<int64_t>(timegm(&t)) - GPS_EPOCH_UNIX;
+    *ms = whole*1000 + static_cast<int64_t>(second*1000.0 + 0.5);
+    return true;
+}
+
+// RINEX system letters and names, by SATELLITE_SYSTEM
+static const struct
+{
+    char letter;
+    const char* name;
+} SYSTEMS[] = {
+    { 'G', "GPS" }, { 'R', "GLONASS" }, { 'S', "SBAS" }, { 'E', "GALILEO" },
+    { 'C', "BEIDOU" }, { 'J', "QZSS" }, { 'I', "NAVIC" },
+};
+#define SYSTEM_COUNT    static_cast<int>(sizeof(SYSTEMS)/sizeof(SYSTEMS[0]))
+
+// GPS, GALILEO, ... or the RINEX letter G, E, ...
+static bool ParseSystem(const std::string& text, int* system)
+{
+    for(int s = 0; s < SYSTEM_COUNT; ++s)
+        if(strcasecmp(text.c_str(), SYSTEMS[s].name) == 0 ||
+           (text.size() == 1 && toupper(text[0]) == SYSTEMS[s].letter))
+        {
+            *system = s;
+            return true;
+        }
+    return false;
+}
+
+// N (any system) or G05, E05, R38, ...: the RINEX letter and the NovAtel PRN/slot
+static bool ParseSatellite(const char* text, int* system, int* prn)
+{
+    char* end;
+    if(isalpha(text[0]))
+    {
+        if(!ParseSystem(std::string(1, text[0]), system))
+            return false;
+        text++;
+    }
+    *prn = strtol(text, &end, 10);
+    return end != text && *end == 0 && *prn >= 0;
+}
+
+static void PrintTime(int64_t ms)
+{
+    printf("%d:%.3f", static_cast<int>(ms/WEEK_MS), (ms % WEEK_MS)/1000.0);
+}
+
+static void Summary(const ArchiveReader& reader)
+{
+    printf("gps_archive: %.1f MB, %zu chunks%s\n", reader.size()/1e6, reader.index().size(),
+           reader.recovered() ? " (no index, recovered by scanning)" : "");
+    for(int t = 0; t < ARCHIVE_TABLES; ++t)
+    {
+        uint64_t rows = 0, chunks = 0;
+        int64_t first = INT64_MAX, last = INT64_MIN;
+        for(size_t i = 0; i < reader.index().size(); ++i)
+        {
+            const ArchiveIndexEntry& entry = reader.index()[i];
+            if(static_cast<int>(entry.table) != t)
+                continue;
+            rows += entry.rows;
+            chunks++;
+            first = std::min(first, entry.first_ms);
+            last = std::max(last, entry.last_ms);
+        }
+        printf("  %-10s %10" PRIu64 " rows %6" PRIu64 " chunks", ArchiveTableSchema(t).name, rows, chunks);
+        if(chunks > 0)
+        {
+            printf("  ");
+            PrintTime(first);
+            printf(" - ");
+            PrintTime(last);
+        }
+        printf("\n");
+    }
+}
+
+static void Usage()
+{
+    printf("usage: gps_archive FILE [--log NAME [--from T] [--to T] [--system S] [--prn N] [--columns A,B,...]\n"
+           "                  [--count]]\n"
+           "  without --log prints what the archive holds\n"
+           "  --log      BESTXYZ, RANGE, TRACKSTAT or SATXYZ, printed as CSV\n"
+           "  --from/to  GPS time WEEK:SECONDS or YYYY-MM-DDTHH:MM:SS (inclusive)\n"
+           "  --system   only GPS, GLONASS, SBAS, GALILEO, BEIDOU, QZSS or NAVIC (or G, R, S, E, C, J, I)\n"
+           "  --prn      only this PRN/slot, of any system (N) or one (G05, E05, R38, ...)\n"
+           "  --columns  columns to print (all by default, time is WEEK:SECONDS)\n"
+           "  --count    print the number of rows instead\n");
+}
+
+int main(int argc, char* argv[])
+{
+    std::string path, log, columns;
+    ArchiveQuery query;
+    query.first_ms = INT64_MIN;
+    query.last_ms = INT64_MAX;
+    query.prn = -1;
+    query.system = -1;
+    bool count = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool value = i + 1 < argc;
+
+        if(arg == "--log" && value)
+            log = argv[++i];
+        else if(arg == "--from" && value && ParseTime(argv[i + 1], &query.first_ms))
+            i++;
+        else if(arg == "--to" && value && ParseTime(argv[i + 1], &query.last_ms))
+            i++;
+        else if(arg == "--system" && value && ParseSystem(argv[i + 1], &query.system))
+            i++;
+        else if(arg == "--prn" && value && ParseSatellite(argv[i + 1], &query.system, &query.prn))
+            i++;
+        else if(arg == "--columns" && value)
+            columns = argv[++i];
+        else if(arg == "--count")
+            count = true;
+        else if(path.empty() && arg[0] != '-')
+            path = arg;
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+    if(path.empty())
+    {
+        Usage();
+        return 1;
+    }
+
+    try
+    {
+        int64_t open_ns = MonotonicNs();
+        ArchiveReader reader(path);
+        if(log.empty())
+        {
+            Summary(reader);
+            return 0;
+        }
+
+        query.table = ArchiveFindTable(log);
+        if(query.table < 0)
+        {
+            printf("gps_archive: unknown log %s\n", log.c_str());
+            return 1;
+        }
+        const ArchiveSchema& schema = ArchiveTableSchema(query.table);
+        for(size_t begin = 0; !count && begin <= columns.size() && !columns.empty(); )
+        {
+            size_t end = columns.find(',', begin);
+            if(end == std::string::npos)
+                end = columns.size();
+            int c = ArchiveFindColumn(query.table, columns.substr(begin, end - begin));
+            if(c < 0)
+            {
+                printf("gps_archive: %s has no column %s\n", schema.name, columns.substr(begin, end - begin).c_str());
+                return 1;
+            }
+            query.columns.push_back(c);
+            begin = end + 1;
+        }
+        if(!count && query.columns.empty())
+            for(int c = 0; c < schema.columns; ++c)
+                query.columns.push_back(c);
+
+        ArchiveResult result;
+        int64_t query_ns = MonotonicNs();
+        reader.query(query, &result);
+        int64_t done_ns = MonotonicNs();
+
+        if(count)
+            printf("%zu\n", result.rows);
+        else
+        {
+            for(size_t k = 0; k < query.columns.size(); ++k)
+                printf("%s%s", k ? "," : "", schema.column[query.columns[k]].name);
+            printf("\n");
+            for(size_t i = 0; i < result.rows; ++i)
+            {
+                for(size_t k = 0; k < query.columns.size(); ++k)
+                {
+                    char text[64];
+                    ArchiveFormatValue(query.table, query.columns[k], result.columns[k][i], text, sizeof(text));
+                    printf("%s%s", k ? "," : "", text);
+                }
+                printf("\n");
+            }
+        }
+        fprintf(stderr, "gps_archive: %zu rows from %zu chunks (%zu skipped by the index), open %.2f ms, query %.2f ms\n",
+                result.rows, result.chunks_read, result.chunks_skipped, (query_ns - open_ns)/1e6, (done_ns - query_ns)/1e6);
+    }
+    catch(const std::runtime_error& e)
+    {
+        printf("gps_archive: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,227 @@
+// Offline decoder: decodes a capture (record parameter) on every core with the
+// driver's own parser and writes the logs to a bag, CSV files or a log
+// archive. How the capture is split so that the output does not depend on the
+// number of threads is described in capture_decoder.h.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+
+#include "capture_decoder.h"
+
+static int64_t MonotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+struct Options
+{
+    std::string capture;
+    std::string bag;
+    std::string csv;
+    std::string archive;
+    CaptureDecodeOptions decode;
+};
+
+// Per table CSV files in a directory, written in part order
+class CsvFiles
+{
+public:
+    explicit CsvFiles(const std::string& directory)
+    {
+        mkdir(directory.c_str(), 0755);
+        std::fill(file_, file_ + ARCHIVE_TABLES, static_cast<FILE*>(NULL));
+        for(int t = 0; t < ARCHIVE_TABLES; ++t)
+        {
+            const ArchiveSchema& schema = ArchiveTableSchema(t);
+            std::string path = directory + "/" + schema.name + ".csv";
+            file_[t] = fopen(path.c_str(), "w");
+            if(!file_[t])
+            {
+                std::string error = strerror(errno);
+                close();
+                throw std::runtime_error("could not create " + path + ": " + error);
+            }
+            for(int c = 0; c < schema.columns; ++c)
+                fprintf(file_[t], "%s%s", c ? "," : "", schema.column[c].name);
+            fprintf(file_[t], "\n");
+        }
+    }
+    ~CsvFiles()
+    {
+        close();
+    }
+    bool write(const CsvSink& sink)
+    {
+        bool ok = true;
+        for(int t = 0; t < ARCHIVE_TABLES; ++t)
+            ok = fwrite(sink.text[t].data(), 1, sink.text[t].size(), file_[t]) == sink.text[t].size() && ok;
+        return ok;
+    }
+
+private:
+    void close()
+    {
+        for(int t = 0; t < ARCHIVE_TABLES; ++t)
+            if(file_[t])
+                fclose(file_[t]);
+    }
+
+    FILE* file_[ARCHIVE_TABLES];
+};
+
+static void Usage()
+{
+    printf("usage: gps_decode CAPTURE [--bag FILE] [--csv DIR] [--archive FILE] [--threads N]\n"
+           "                  [--part MB] [--warmup KB] [--chunk-rows N] [--frame-id ID]\n"
+           "  --bag         /gps/cart (BESTXYZ) and /gps/all (RANGE epochs) as gps_node publishes them\n"
+           "  --csv         BESTXYZ.csv, RANGE.csv, TRACKSTAT.csv and SATXYZ.csv in DIR\n"
+           "  --archive     log archive, as the archive parameter (see gps_archive)\n"
+           "  --threads     decoding threads (default: all cores)\n"
+           "  --part        bytes per part in MB (default 32); the output depends on it, not on --threads\n"
+           "  --warmup      bytes decoded before each part to rebuild the decoder state, in KB (default 1024)\n"
+           "  --chunk-rows  archive rows per chunk (default 4096)\n"
+           "  --frame-id    header frame_id of the bag messages (default gps_frame)\n");
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    options.decode.frame_id = "gps_frame";
+    options.decode.threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    options.decode.part = 32*1024*1024;
+    options.decode.warmup = 1024*1024;
+    options.decode.chunk_rows = 4096;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool value = i + 1 < argc;
+
+        if(arg == "--bag" && value)
+            options.bag = argv[++i];
+        else if(arg == "--csv" && value)
+            options.csv = argv[++i];
+        else if(arg == "--archive" && value)
+            options.archive = argv[++i];
+        else if(arg == "--threads" && value)
+            options.decode.threads = std::max(atoi(argv[++i]), 1);
+        else if(arg == "--part" && value)
+            options.decode.part = std::max(atof(argv[++i]), 0.001)*1024*1024;
+        else if(arg == "--warmup" && value)
+            options.decode.warmup = std::max(atof(argv[++i]), 0.0)*1024;
+        else if(arg == "--chunk-rows" && value)
+            options.decode.chunk_rows = std::max(atoi(argv[++i]), 1);
+        else if(arg == "--frame-id" && value)
+            options.decode.frame_id = argv[++i];
+        else if(options.capture.empty() && arg[0] != '-')
+            options.capture = arg;
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+    if(options.capture.empty() || (options.bag.empty() && options.csv.empty() && options.archive.empty()))
+    {
+        Usage();
+        return 1;
+    }
+    options.decode.bag = !options.bag.empty();
+    options.decode.csv = !options.csv.empty();
+    options.decode.archive = !options.archive.empty();
+
+    ros::Time::init();
+    try
+    {
+        int64_t start_ns = MonotonicNs();
+        CaptureReplay capture(options.capture, 0.0);
+        std::vector<CapturePart> parts = SplitCapture(capture.data(), capture.size(), options.decode);
+
+        std::unique_ptr<rosbag::Bag> bag;
+        std::unique_ptr<CsvFiles> csv;
+        std::unique_ptr<ArchiveWriter> archive;
+        if(!options.bag.empty())
+            bag.reset(new rosbag::Bag(options.bag, rosbag::bagmode::Write));
+        if(!options.csv.empty())
+            csv.reset(new CsvFiles(options.csv));
+        if(!options.archive.empty())
+            archive.reset(new ArchiveWriter(options.archive, options.decode.chunk_rows));
+
+        uint64_t frames = 0, crc_errors = 0, messages = 0, rows = 0;
+        // Time spent writing on this thread, which does not scale with threads
+        int64_t writing_ns = 0;
+        bool ok = DecodeCapture(capture, parts, options.decode, [&](const CapturePartOutput& output)
+        {
+            int64_t write_ns = MonotonicNs();
+            bool written = true;
+            frames += output.frames;
+            crc_errors += output.crc_errors;
+            if(archive)
+            {
+                written = archive->appendEncoded(*output.archive) && written;
+                rows += output.archive->rows();
+            }
+            if(csv)
+                written = csv->write(*output.csv) && written;
+            if(bag)
+            {
+                size_t c = 0, a = 0;
+                for(size_t i = 0; i < output.topic_all.size(); ++i)
+                {
+                    if(output.topic_all[i])
+                    {
+                        bag->write("/gps/all", output.all[a].header.stamp, output.all[a]);
+                        a++;
+                    }
+                    else
+                    {
+                        bag->write("/gps/cart", output.cart[c].header.stamp, output.cart[c]);
+                        c++;
+                    }
+                }
+                messages += output.topic_all.size();
+            }
+            writing_ns += MonotonicNs() - write_ns;
+            return written;
+        });
+
+        if(archive)
+            archive->close();
+        if(bag)
+            bag->close();
+        csv.reset();
+
+        double seconds = (MonotonicNs() - start_ns)/1e9;
+        fprintf(stderr, "gps_decode: %.1f MB in %zu parts, %d threads: %llu frames (%llu CRC errors), "
+                "%llu bag messages, %llu archive rows in %.2f s (%.1f MB/s, writing %.2f s)\n",
+                capture.size()/1e6, parts.size(), options.decode.threads, (unsigned long long)frames,
+                (unsigned long long)crc_errors, (unsigned long long)messages, (unsigned long long)rows,
+                seconds, capture.size()/1e6/seconds, writing_ns/1e9);
+        if(!ok)
+        {
+            fprintf(stderr, "gps_decode: writing the output failed\n");
+            return 1;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        fprintf(stderr, "gps_decode: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,265 @@
+// Byte-to-callback latency of the driver against the gps_sim send log,
+// without a ROS master. Opens the port with the driver's own init(), decodes
+// on its reader thread (startReading(), as gps_node stream mode does) and
+// fills the message gps_node would publish for each frame. Each frame is then
+// matched to the time gps_sim wrote its last byte by log id and GPS time.
+// Both clocks are the host's CLOCK_REALTIME.
+//
+// The ROS publish itself is not included; latency_harness.py measures the
+// whole path through gps_node when a ROS master is available.
+//
+//   gps_sim --link /tmp/novatel_sim --send-log /tmp/gps_sim_send.csv &
+//   gps_latency --port /tmp/novatel_sim --send-log /tmp/gps_sim_send.csv
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <time.h>
+
+#include "novatel_gps.h"
+
+// Frames sent this close to the end may still be in flight (s)
+#define LATENCY_GRACE       1.0
+
+struct Arrival
+{
+    uint16_t msg_id;
+    uint16_t week;
+    uint32_t ms;
+    int64_t ns;
+};
+
+static int64_t RealtimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+static uint64_t FrameKey(uint16_t msg_id, uint16_t week, uint32_t ms)
+{
+    return (static_cast<uint64_t>(msg_id) << 48) | (static_cast<uint64_t>(week) << 32) | ms;
+}
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+    size_t k = std::min(sorted.size() - 1, static_cast<size_t>(p/100.0*(sorted.size() - 1) + 0.5));
+    return sorted[k];
+}
+
+static void Usage()
+{
+    printf("usage: gps_latency [--port PATH] [--baud BPS] [--rate HZ] [--log NAME[@HZ]]...\n"
+           "                   [--duration S] [--skip S] [--send-log FILE]\n"
+           "                   [--low-latency] [--latency-timer MS] [--vmin N] [--vtime N] [--nonblocking]\n"
+           "  --port      driver port, the gps_sim link (/tmp/novatel_sim)\n"
+           "  --baud      baud rate set by the driver (115200)\n"
+           "  --rate      driver rate, sets the read timeout and the default ONTIME period (20)\n"
+           "  --log       log to request, ONNEW or ONTIME at HZ; repeat for several (BESTXYZ)\n"
+           "  --duration  seconds measured after the first frame (30)\n"
+           "  --skip      seconds of sent frames ignored at the start (2)\n"
+           "  --send-log  gps_sim send log (/tmp/gps_sim_send.csv)\n"
+           "  the remaining options are the driver's port tuning parameters (see gps.yaml)\n");
+}
+
+int main(int argc, char* argv[])
+{
+    std::string port = "/tmp/novatel_sim";
+    std::string send_log = "/tmp/gps_sim_send.csv";
+    int baud = 115200;
+    double rate = 20.0;
+    double duration = 30.0;
+    double skip = 2.0;
+    std::vector<LogRequest> logs;
+    PortTuning tuning;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool value = i + 1 < argc;
+
+        if(arg == "--port" && value)
+            port = argv[++i];
+        else if(arg == "--baud" && value)
+            baud = atoi(argv[++i]);
+        else if(arg == "--rate" && value)
+            rate = atof(argv[++i]);
+        else if(arg == "--log" && value)
+        {
+            std::string spec = argv[++i];
+            size_t at = spec.find('@');
+            LogRequest request;
+            request.name = spec.substr(0, at);
+            request.trigger = (at == std::string::npos) ? "ONNEW" : "ONTIME";
+            request.period = (at == std::string::npos) ? 0.0 : 1.0/atof(spec.c_str() + at + 1);
+            request.offset = 0.0;
+            request.priority = logs.size();
+            logs.push_back(request);
+        }
+        else if(arg == "--duration" && value)
+            duration = atof(argv[++i]);
+        else if(arg == "--skip" && value)
+            skip = atof(argv[++i]);
+        else if(arg == "--send-log" && value)
+            send_log = argv[++i];
+        else if(arg == "--low-latency")
+            tuning.low_latency = true;
+        else if(arg == "--latency-timer" && value)
+            tuning.latency_timer = atoi(argv[++i]);
+        else if(arg == "--vmin" && value)
+            tuning.vmin = atoi(argv[++i]);
+        else if(arg == "--vtime" && value)
+            tuning.vtime = atoi(argv[++i]);
+        else if(arg == "--nonblocking")
+            tuning.nonblocking = true;
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if(logs.empty())
+    {
+        LogRequest request;
+        request.name = "BESTXYZ";
+        request.trigger = "ONNEW";
+        request.period = 0.0;
+        request.offset = 0.0;
+        request.priority = 0;
+        logs.push_back(request);
+    }
+
+    // Room for every frame, so the reader thread does not allocate
+    double frame_rate = 0.0;
+    for(size_t i = 0; i < logs.size(); ++i)
+        frame_rate += (logs[i].period > 0.0) ? 1.0/logs[i].period : rate;
+    std::vector<Arrival> arrivals;
+    arrivals.reserve(static_cast<size_t>(2.0*frame_rate*(duration + skip + 30.0)));
+
+    GPS gps;
+    gps.setBaudRate(baud);
+    gps.setPortTuning(tuning);
+    gps.setLogRequests(logs);
+
+    novatel_gps::GpsXYZ xyz;
+    sensor_msgs::NavSatFix fix;
+    novatel_gps::LogAll log_all;
+    novatel_gps::SatelliteStateArray satellites;
+    nav_msgs::Odometry odometry;
+    sensor_msgs::Imu imu;
+
+    try
+    {
+        gps.init(gps.BESTXYZ, port, rate);
+    }
+    catch(std::exception& e)
+    {
+        fprintf(stderr, "gps_latency: %s: %s\n", port.c_str(), e.what());
+        return 1;
+    }
+
+    // The message gps_node would publish for this frame, then the stamp
+    gps.startReading([&](uint16_t msg_id)
+    {
+        if(msg_id == gps.BESTXYZ)
+            gps.getData(&xyz);
+        else if(msg_id == gps.BESTPOS)
+            gps.getData(&fix);
+        else if(msg_id == gps.RANGE || msg_id == gps.RANGECMP)
+        {
+            gps.getData(&log_all);
+            gps.getData(&satellites);
+        }
+        else if(msg_id == gps.INSPVA || msg_id == gps.INSPVAS)
+            gps.getData(&odometry);
+        else if(msg_id == gps.CORRIMUDATA || msg_id == gps.CORRIMUDATAS)
+            gps.getData(&imu);
+
+        Arrival arrival;
+        arrival.ns = RealtimeNs();
+        arrival.msg_id = msg_id;
+        arrival.week = gps.header().gps_week;
+        arrival.ms = gps.header().gps_ms;
+        if(arrivals.size() < arrivals.capacity())
+            arrivals.push_back(arrival);
+    });
+
+    for(int i = 0; i < 100 && gps.frameCount() == 0; ++i)
+        std::this_thread::sleep_for( std::chrono::milliseconds(100) );
+    if(gps.frameCount() == 0)
+    {
+        fprintf(stderr, "gps_latency: no frames from %s\n", port.c_str());
+        gps.stopReading();
+        gps.close();
+        return 1;
+    }
+    int64_t start_ns = RealtimeNs();
+    std::this_thread::sleep_for( std::chrono::duration<double>(skip + duration + LATENCY_GRACE) );
+    int64_t end_ns = RealtimeNs();
+    gps.stopReading();
+    gps.close();
+
+    std::unordered_map<uint64_t, int64_t> received;
+    for(size_t i = 0; i < arrivals.size(); ++i)
+        received.insert(std::make_pair(FrameKey(arrivals[i].msg_id, arrivals[i].week, arrivals[i].ms), arrivals[i].ns));
+
+    FILE* file = fopen(send_log.c_str(), "r");
+    if(!file)
+    {
+        perror(send_log.c_str());
+        return 1;
+    }
+
+    // Latencies (us) and sent frames per log id within the window
+    std::map<uint16_t, std::vector<double> > latencies;
+    std::map<uint16_t, unsigned long> sent;
+    int64_t first_ns = start_ns + static_cast<int64_t>(skip*1e9);
+    int64_t last_ns = end_ns - static_cast<int64_t>(LATENCY_GRACE*1e9);
+    char line[256];
+    while(fgets(line, sizeof(line), file))
+    {
+        unsigned seq, msg_id, week, ms;
+        unsigned long bytes;
+        long long send_ns;
+        if(sscanf(line, "%u,%u,%lu,%lld,%u,%u", &seq, &msg_id, &bytes, &send_ns, &week, &ms) != 6)
+            continue;
+        if(send_ns < first_ns || send_ns > last_ns)
+            continue;
+
+        sent[msg_id]++;
+        std::unordered_map<uint64_t, int64_t>::const_iterator it = received.find(FrameKey(msg_id, week, ms));
+        if(it != received.end())
+            latencies[msg_id].push_back((it->second - send_ns)/1e3);
+    }
+    fclose(file);
+
+    if(sent.empty())
+    {
+        fprintf(stderr, "gps_latency: no frames sent in the measurement window, check %s\n", send_log.c_str());
+        return 1;
+    }
+
+    double window = (last_ns - first_ns)/1e9;
+    printf("%.1f s window, %lu bytes, %u CRC errors\n", window, (unsigned long)gps.byteCount(), gps.crcErrors());
+    printf("%6s %8s %8s %8s %10s %10s %10s %10s\n", "msg_id", "Hz", "sent", "lost", "p50 us", "p99 us", "p99.9 us", "max us");
+    for(std::map<uint16_t, unsigned long>::const_iterator it = sent.begin(); it != sent.end(); ++it)
+    {
+        std::vector<double>& values = latencies[it->first];
+        std::sort(values.begin(), values.end());
+        printf("%6u %8.1f %8lu %8lu", it->first, values.size()/window, it->second, it->second - values.size());
+        if(!values.empty())
+            printf(" %10.1f %10.1f %10.1f %10.1f", Percentile(values, 50), Percentile(values, 99),
+                   Percentile(values, 99.9), values.back());
+        printf("\n");
+    }
+    return 0;
+}
@@ -4,10 +4,27 @@
 // ROS
 #include <ros/ros.h>
 #include <sensor_msgs/NavSatFix.h>
+#include <sensor_msgs/Imu.h>
+#include <nav_msgs/Odometry.h>
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
 #include <novatel_gps/GpsXYZ.h>
 #include <novatel_gps/LogAll.h>
+#include <novatel_gps/SatelliteStateArray.h>
+#include <novatel_gps/RTCM.h>
+#include <novatel_gps/GetSolutionAt.h>
+#include <novatel_gps/SatelliteGeometry.h>
+#include <novatel_gps/PointSolution.h>
+#include <novatel_gps/SmoothedRanges.h>
+#include <novatel_gps/GpsXYZBatch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <time.h>
 
 #include "novatel_gps.h"
+#include "corrections.h"
+#include "solution_batch.h"
+#include "compact_observations.h"
 
 class GpsNode
 {
@@ -16,12 +33,16 @@ private:
     sensor_msgs::NavSatFix gps_reading_;
     novatel_gps::GpsXYZ gps_xyz_reading_;
     novatel_gps::LogAll log;
+    novatel_gps::SatelliteStateArray satellites_;
+    sensor_msgs::Imu imu_reading_;
+    nav_msgs::Odometry odom_reading_;
 
     std::string port;
 
     ros::NodeHandle node_handle_;
     ros::NodeHandle private_node_handle_;
-    ros::Publisher gps_data_pub_, gps_data_pub_logall_;
+    ros::Publisher gps_data_pub_, gps_data_pub_logall_, gps_data_pub_sats_;
+    ros::Publisher imu_pub_, odom_pub_;
 
     bool running;
 
@@ -30,15 +51,102 @@ private:
     std::string error_status_;
 
     int log_id_;
+    std::vector<std::string> log_names_;
+    bool stream_;
+    int baud_;
+    double imu_rate_;
+    std::string record_;
+    std::string replay_;
+    double replay_speed_;
+    ThreadTuning publisher_tuning_;
+    bool lock_memory_;
+    // NavSatFix and ENU pose converted from BESTXYZ
+    bool geodetic_;
+    ros::Publisher xyz_fix_pub_, pose_pub_;
+    sensor_msgs::NavSatFix xyz_fix_;
+    geometry_msgs::PoseWithCovarianceStamped pose_;
+
+    // Azimuth/elevation and DOP after each SATXYZ
+    bool geometry_;
+    ros::Publisher geometry_pub_;
+    novatel_gps::SatelliteGeometry geometry_msg_;
+
+    // Hatch-smoothed pseudoranges after each RANGE/RANGECMP
+    int hatch_window_;
+    ros::Publisher smoothed_pub_;
+    novatel_gps::SmoothedRanges smoothed_msg_;
+
+    std::string rinex_directory_;
+    std::string rinex_marker_;
+
+    // Columnar log archive (log_archive.h), empty disables it
+    std::string archive_;
+    int archive_chunk_rows_;
+
+    // Driver's own single-point solution, published once per solved epoch
+    bool point_solution_;
+    ros::Publisher point_pub_;
+    novatel_gps::PointSolution point_msg_;
+    uint32_t point_count_;
+
+    std::string shm_name_;
+    int shm_capacity_;
+
+    // Solution history served by solution_at
+    int history_size_;
+    double history_max_gap_;
+    ros::ServiceServer solution_srv_;
+
+    // Extrapolated output between fixes
+    double extrapolate_rate_;
+    double extrapolate_max_age_;
+    double extrapolate_accel_noise_;
+    ros::Publisher extrapolated_pub_;
+    novatel_gps::GpsXYZ extrapolated_;
+    std::thread extrapolate_thread_;
+    std::atomic<bool> extrapolating_;
+
+    // Batches of the gps/cart fixes, batch_size_ <= 1 disables them
+    int batch_size_;
+    double batch_max_latency_;
+    SolutionBatch solution_batch_;
+    ros::Publisher batch_pub_;
+    novatel_gps::GpsXYZBatch batch_msg_;
+
+    // Delta-coded RANGE/TRACKSTAT of the LogAll set for narrow links
+    bool compact_;
+    int compact_key_interval_;
+    std::unique_ptr<CompactEncoder> compact_encoder_;
+    ros::Publisher compact_range_pub_, compact_track_pub_;
+    novatel_gps::CompactRange compact_range_;
+    novatel_gps::CompactTrackStat compact_track_;
+
+    // RTCM injection
+    bool corrections_;
+    std::string rtcm_port_;
+    std::string rtcm_device_;
+    int rtcm_baud_;
+    SERIALPORTCONFIG rtcm_serial_;
+    bool rtcm_serial_open_;
+    std::string rtcm_topic_;
+    std::string rtcm_source_;
+    double rtcm_max_age_;
+    int rtcm_queue_bytes_;
+    std::unique_ptr<CorrectionWriter> correction_writer_;
+    std::unique_ptr<CorrectionSource> correction_source_;
+    RtcmFramer rtcm_framer_;
+    ros::Subscriber rtcm_sub_;
+    ros::Timer rtcm_timer_;
 
     std::string frameid_;
+    std::string odom_frameid_;
 
     double desired_freq_;
     double rate_;
 
 public:
     GpsNode(ros::NodeHandle n) : node_handle_(n), private_node_handle_("~"),
-    slow_count_(0), desired_freq_(20)
+    slow_count_(0), extrapolating_(false), rtcm_serial_open_(false), desired_freq_(20)
     {
         ros::NodeHandle gps_node_handle(node_handle_, "gps");
         private_node_handle_.param("port", port, std::string("/dev/ttyUSB0"));
@@ -46,6 +154,121 @@ public:
         // TODO: Remove magical number.
         private_node_handle_.param("log", log_id_, gps.BESTXYZ);
         private_node_handle_.param("rate", rate_, desired_freq_);
+        private_node_handle_.param("stream", stream_, false);
+        private_node_handle_.param("baud", baud_, 115200);
+        private_node_handle_.param("imu_rate", imu_rate_, 100.0);
+        private_node_handle_.param("odom_frame_id", odom_frameid_, std::string("enu"));
+        private_node_handle_.param("record", record_, std::string());
+        private_node_handle_.param("replay", replay_, std::string());
+        private_node_handle_.param("replay_speed", replay_speed_, 1.0);
+        PortTuning tuning;
+        private_node_handle_.param("low_latency", tuning.low_latency, false);
+        private_node_handle_.param("latency_timer", tuning.latency_timer, -1);
+        private_node_handle_.param("vmin", tuning.vmin, -1);
+        private_node_handle_.param("vtime", tuning.vtime, -1);
+        private_node_handle_.param("nonblocking", tuning.nonblocking, false);
+        gps.setPortTuning(tuning);
+
+        ThreadTuning reader;
+        loadThreadTuning("reader", &reader);
+        loadThreadTuning("publisher", &publisher_tuning_);
+        gps.setReaderTuning(reader);
+        private_node_handle_.param("lock_memory", lock_memory_, false);
+        private_node_handle_.param("geodetic", geodetic_, false);
+        geodetic_ = geodetic_ && log_id_ != gps.BESTPOS;
+        gps.setGeodetic(geodetic_);
+        std::vector<double> origin;
+        if(private_node_handle_.getParam("enu_origin", origin))
+        {
+            if(origin.size() == 3)
+                gps.setEnuOrigin(origin[0], origin[1], origin[2]);
+            else
+                ROS_ERROR("enu_origin must be [latitude, longitude, height], using the first fix");
+        }
+        private_node_handle_.param("geometry", geometry_, false);
+        if(geometry_)
+        {
+            double mask, tolerance;
+            private_node_handle_.param("elevation_mask", mask, 5.0);
+            private_node_handle_.param("geometry_tolerance", tolerance, 0.05);
+            gps.setGeometry(mask, tolerance);
+        }
+        double slip_doppler, slip_geometry_free, slip_max_gap;
+        private_node_handle_.param("slip_doppler_threshold", slip_doppler, 2.0);
+        private_node_handle_.param("slip_geometry_free_threshold", slip_geometry_free, 0.05);
+        private_node_handle_.param("slip_max_gap", slip_max_gap, 5.0);
+        gps.setSlipThresholds(slip_doppler, slip_geometry_free, slip_max_gap);
+        private_node_handle_.param("hatch_window", hatch_window_, 0);
+        gps.setHatchWindow(hatch_window_);
+        private_node_handle_.param("rinex_directory", rinex_directory_, std::string());
+        private_node_handle_.param("rinex_marker", rinex_marker_, std::string("NOVA"));
+        private_node_handle_.param("archive", archive_, std::string());
+        private_node_handle_.param("archive_chunk_rows", archive_chunk_rows_, 4096);
+        private_node_handle_.param("point_solution", point_solution_, false);
+        if(point_solution_)
+        {
+            double mask, threshold;
+            private_node_handle_.param("point_elevation_mask", mask, 10.0);
+            private_node_handle_.param("point_integrity_threshold", threshold, 30.0);
+            gps.setPointSolution(mask, threshold);
+        }
+        point_count_ = 0;
+        private_node_handle_.param("shm_name", shm_name_, std::string());
+        private_node_handle_.param("shm_capacity", shm_capacity_, 256);
+        private_node_handle_.param("history_size", history_size_, 1200);
+        private_node_handle_.param("history_max_gap", history_max_gap_, 1.0);
+        gps.setHistory(std::max(history_size_, 0), history_max_gap_);
+        private_node_handle_.param("extrapolate_rate", extrapolate_rate_, 0.0);
+        private_node_handle_.param("extrapolate_max_age", extrapolate_max_age_, 0.5);
+        private_node_handle_.param("extrapolate_accel_noise", extrapolate_accel_noise_, 2.0);
+        if(extrapolate_rate_ > 0)
+            gps.setExtrapolation(extrapolate_max_age_, extrapolate_accel_noise_);
+        private_node_handle_.param("batch_size", batch_size_, 0);
+        private_node_handle_.param("batch_max_latency", batch_max_latency_, 0.1);
+        private_node_handle_.param("compact", compact_, false);
+        private_node_handle_.param("compact_key_interval", compact_key_interval_, 10);
+
+        private_node_handle_.param("corrections", corrections_, false);
+        private_node_handle_.param("rtcm_port", rtcm_port_, std::string("COM2"));
+        private_node_handle_.param("rtcm_device", rtcm_device_, std::string());
+        private_node_handle_.param("rtcm_baud", rtcm_baud_, 115200);
+        private_node_handle_.param("rtcm_topic", rtcm_topic_, std::string("rtcm"));
+        private_node_handle_.param("rtcm_source", rtcm_source_, std::string());
+        private_node_handle_.param("rtcm_max_age", rtcm_max_age_, 2.0);
+        private_node_handle_.param("rtcm_queue_bytes", rtcm_queue_bytes_, 8192);
+        if(corrections_ && (rtcm_port_ == "COM1" || rtcm_device_.empty()))
+        {
+            ROS_ERROR("corrections need rtcm_port, a receiver port other than COM1, and rtcm_device, the serial "
+                      "device wired to it; corrections disabled");
+            corrections_ = false;
+        }
+        gps.setCorrectionInput((corrections_ && replay_.empty()) ? rtcm_port_ : std::string());
+        loadLogRequests();
+        gps.setBaudRate(baud_);
+        gps.setImuRate(imu_rate_);
+
+        // INS logs come at 100-200 Hz, too fast for the polled loop
+        bool ins = requested("INSPVA") || requested("INSPVAS");
+        bool imu = requested("CORRIMUDATA") || requested("CORRIMUDATAS");
+        if((ins || imu) && !stream_)
+        {
+            ROS_INFO("INS logs requested, enabling stream mode");
+            stream_ = true;
+        }
+        // Replay is paced by the capture, not by `rate`
+        if(!replay_.empty())
+            stream_ = true;
+        if(ins)
+        {
+            odom_pub_ = gps_node_handle.advertise<nav_msgs::Odometry>("odom", 10);
+            odom_reading_.header.frame_id = odom_frameid_;
+            odom_reading_.child_frame_id = frameid_;
+        }
+        if(imu)
+        {
+            imu_pub_ = gps_node_handle.advertise<sensor_msgs::Imu>("imu", 10);
+            imu_reading_.header.frame_id = frameid_;
+        }
 
         if(log_id_ == gps.BESTPOS)
         {
@@ -65,18 +288,160 @@ public:
         {
             gps_data_pub_ = gps_node_handle.advertise<novatel_gps::GpsXYZ>("cart", 10);
             gps_data_pub_logall_ = gps_node_handle.advertise<novatel_gps::LogAll>("all", 10);
+            gps_data_pub_sats_ = gps_node_handle.advertise<novatel_gps::SatelliteStateArray>("satellites", 10);
+            satellites_.header.frame_id = frameid_;
         }
 
+        if(geodetic_)
+        {
+            xyz_fix_pub_ = gps_node_handle.advertise<sensor_msgs::NavSatFix>("fix", 10);
+            pose_pub_ = gps_node_handle.advertise<geometry_msgs::PoseWithCovarianceStamped>("pose", 10);
+            xyz_fix_.header.frame_id = frameid_;
+            xyz_fix_.status.service = sensor_msgs::NavSatStatus::SERVICE_GPS;
+            pose_.header.frame_id = odom_frameid_;
+        }
+        if(geometry_)
+        {
+            geometry_pub_ = gps_node_handle.advertise<novatel_gps::SatelliteGeometry>("geometry", 10);
+            geometry_msg_.header.frame_id = frameid_;
+        }
+        if(hatch_window_ > 0)
+        {
+            smoothed_pub_ = gps_node_handle.advertise<novatel_gps::SmoothedRanges>("smoothed_ranges", 10);
+            smoothed_msg_.header.frame_id = frameid_;
+            // Sized for a full RANGE log up front
+            smoothed_msg_.system.reserve(MAX_SATELLITES*MAX_SIGNALS);
+            smoothed_msg_.prn_slot.reserve(MAX_SATELLITES*MAX_SIGNALS);
+            smoothed_msg_.signal.reserve(MAX_SATELLITES*MAX_SIGNALS);
+            smoothed_msg_.psr.reserve(MAX_SATELLITES*MAX_SIGNALS);
+            smoothed_msg_.length.reserve(MAX_SATELLITES*MAX_SIGNALS);
+        }
+        if(point_solution_)
+        {
+            point_pub_ = gps_node_handle.advertise<novatel_gps::PointSolution>("point_solution", 10);
+            point_msg_.header.frame_id = frameid_;
+        }
+        if(extrapolate_rate_ > 0)
+        {
+            extrapolated_pub_ = gps_node_handle.advertise<novatel_gps::GpsXYZ>("cart_extrapolated", 10);
+            extrapolated_.header.frame_id = frameid_;
+        }
+        if(batch_size_ > 1 && log_id_ != gps.BESTPOS)
+        {
+            batch_pub_ = gps_node_handle.advertise<novatel_gps::GpsXYZBatch>("cart_batch", 10);
+            batch_msg_.header.frame_id = frameid_;
+            solution_batch_.configure(batch_size_, batch_max_latency_);
+        }
+        if(compact_ && log_id_ == -1)
+        {
+            compact_range_pub_ = gps_node_handle.advertise<novatel_gps::CompactRange>("range_compact", 10);
+            compact_track_pub_ = gps_node_handle.advertise<novatel_gps::CompactTrackStat>("trackstat_compact", 10);
+            compact_range_.header.frame_id = frameid_;
+            compact_track_.header.frame_id = frameid_;
+            compact_encoder_.reset(new CompactEncoder(compact_key_interval_));
+        }
+        if(history_size_ > 0)
+            solution_srv_ = gps_node_handle.advertiseService("solution_at", &GpsNode::solutionAt, this);
         // calibrate_serv_ = gps_node_handle.advertiseService("calibrate", &GpsNode::calibrate, this);
         running = false;
     }
 
+    // Reads the optional `logs` list, e.g. [{name: BESTXYZ, trigger: ONNEW, priority: 0}, ...]
+    void loadLogRequests()
+    {
+        XmlRpc::XmlRpcValue logs;
+        std::vector<LogRequest> requests;
+        if(!private_node_handle_.getParam("logs", logs) || !ParseLogRequests(logs, &requests))
+            return;
+
+        for(size_t i = 0; i < requests.size(); ++i)
+            log_names_.push_back(requests[i].name);
+        gps.setLogRequests(requests);
+    }
+
+    // <prefix>_policy (other, fifo, rr), <prefix>_priority and <prefix>_cpus (list of CPU ids)
+    void loadThreadTuning(const std::string& prefix, ThreadTuning* tuning)
+    {
+        private_node_handle_.param(prefix + "_policy", tuning->policy, std::string("other"));
+        private_node_handle_.param(prefix + "_priority", tuning->priority, 0);
+
+        XmlRpc::XmlRpcValue cpus;
+        if(private_node_handle_.getParam(prefix + "_cpus", cpus) && cpus.getType() == XmlRpc::XmlRpcValue::TypeArray)
+        {
+            for(int i = 0; i < cpus.size(); ++i)
+                tuning->cpus.push_back(static_cast<int>(cpus[i]));
+        }
+    }
+
+    bool solutionAt(novatel_gps::GetSolutionAt::Request& req, novatel_gps::GetSolutionAt::Response& res)
+    {
+        const SolutionHistory& history = gps.history();
+        SolutionSample sample;
+        const char* reason = "";
+        if(req.gps_time > 0)
+            res.success = history.atGpsTime(req.gps_time, &sample, &reason);
+        else
+            res.success = history.atHostTime(req.stamp.toSec(), &sample, &reason);
+
+        res.host_offset = history.hostOffset();
+        if(!res.success)
+        {
+            res.message = reason;
+            return true;
+        }
+
+        res.solution.header.stamp.fromSec(sample.host_time);
+        res.solution.header.frame_id = frameid_;
+        fillXYZ(sample.position, sample.velocity, sample.position_var, sample.velocity_var, &res.solution);
+        res.gps_time = sample.gps_time;
+        return true;
+    }
+
+    // ECEF position and velocity with their variances (m^2, (m/s)^2) into a
+    // GpsXYZ. Standard deviations go on the diagonal, as gps/cart carries them.
+    static void fillXYZ(const double position[3], const double velocity[3], const double position_var[3],
+                        const double velocity_var[3], novatel_gps::GpsXYZ* xyz)
+    {
+        xyz->position.position.x = position[0];
+        xyz->position.position.y = position[1];
+        xyz->position.position.z = position[2];
+        xyz->velocity.velocity.x = velocity[0];
+        xyz->velocity.velocity.y = velocity[1];
+        xyz->velocity.velocity.z = velocity[2];
+        for(int i = 0; i < 3; ++i)
+        {
+            xyz->position.covariance[4*i] = std::sqrt(position_var[i]);
+            xyz->velocity.covariance[4*i] = std::sqrt(velocity_var[i]);
+        }
+    }
+
+    bool requested(const std::string& name) const
+    {
+        return std::find(log_names_.begin(), log_names_.end(), name) != log_names_.end();
+    }
+
     void start()
     {
         try
         {
+            if(!replay_.empty())
+                gps.openReplay(replay_, replay_speed_);
+            else if(!record_.empty())
+                gps.startRecording(record_);
+            if(!shm_name_.empty())
+                gps.publishSharedMemory(shm_name_, shm_capacity_);
+            if(!rinex_directory_.empty())
+                gps.writeRinex(rinex_directory_, rinex_marker_);
+            if(!archive_.empty())
+                gps.writeArchive(archive_, archive_chunk_rows_);
             gps.init(log_id_, port, rate_);
             ROS_INFO("GPS initialized...");
+            startCorrections();
+            if(extrapolate_rate_ > 0)
+            {
+                extrapolating_ = true;
+                extrapolate_thread_ = std::thread(&GpsNode::extrapolateLoop, this);
+            }
         }
         catch(const std::exception& e)
         {
@@ -92,31 +457,185 @@ public:
 
     bool spin()
     {
-        ros::Rate r(rate_);
+        // Before the reader thread exists, so its stack and buffers are locked too
+        if(lock_memory_)
+            LockMemory();
+
         start();
-        while(ros::ok())
+        if(stream_)
         {
-            publishData();
-            ros::spinOnce();
-            r.sleep();
+            if(publisher_tuning_.policy != "other" || !publisher_tuning_.cpus.empty())
+                ROS_WARN("publisher_* parameters are ignored in stream mode, messages are published by the reader thread");
+
+            // Frames are published from the reader thread as soon as they are decoded
+            gps.startReading(std::bind(&GpsNode::publishFrame, this, std::placeholders::_1));
+            ros::spin();
+        }
+        else
+        {
+            ApplyThreadTuning(publisher_tuning_, "publisher");
+            ros::Rate r(rate_);
+            while(ros::ok())
+            {
+                publishData();
+                ros::spinOnce();
+                r.sleep();
+            }
         }
         stop();
+        return true;
+    }
+
+    void publishFrame(uint16_t msg_id)
+    {
+        ros::Time stamp = ros::Time::now();
+        if(batch_pub_ && solution_batch_.due(stamp))
+            publishBatch();
+        if(msg_id == gps.BESTXYZ && (log_id_ == gps.BESTXYZ || log_id_ == -1))
+        {
+            gps.getData(&gps_xyz_reading_);
+            gps_xyz_reading_.header.stamp = stamp;
+            gps_data_pub_.publish(gps_xyz_reading_);
+            batchFix(gps_xyz_reading_);
+            publishGeodetic(stamp);
+        }
+        else if(msg_id == gps.BESTPOS && log_id_ == gps.BESTPOS)
+        {
+            gps.getData(&gps_reading_);
+            gps_reading_.header.stamp = stamp;
+            gps_data_pub_.publish(gps_reading_);
+        }
+        else if((msg_id == gps.RANGE || msg_id == gps.RANGECMP) && log_id_ == -1)
+        {
+            // RANGE closes an epoch of the LogAll set
+            gps.getData(&log);
+            log.header.stamp = stamp;
+            gps_data_pub_logall_.publish(log);
+            publishCompact(stamp);
+
+            gps.getData(&satellites_);
+            satellites_.header.stamp = stamp;
+            gps_data_pub_sats_.publish(satellites_);
+        }
+        else if(msg_id == gps.SATXYZ && geometry_)
+        {
+            gps.getData(&geometry_msg_);
+            geometry_msg_.header.stamp = stamp;
+            geometry_pub_.publish(geometry_msg_);
+        }
+        else if((msg_id == gps.INSPVA || msg_id == gps.INSPVAS) && odom_pub_)
+        {
+            gps.getData(&odom_reading_);
+            odom_reading_.header.stamp = stamp;
+            odom_pub_.publish(odom_reading_);
+        }
+        else if((msg_id == gps.CORRIMUDATA || msg_id == gps.CORRIMUDATAS) && imu_pub_)
+        {
+            gps.getData(&imu_reading_);
+            imu_reading_.header.stamp = stamp;
+            imu_pub_.publish(imu_reading_);
+        }
+        if((msg_id == gps.RANGE || msg_id == gps.RANGECMP) && hatch_window_ > 0)
+            publishSmoothedRanges(stamp);
+        publishPointSolution(stamp);
+    }
+
+    // Adds a fix published on cart to the batch, publishing it when full
+    void batchFix(const novatel_gps::GpsXYZ& fix)
+    {
+        if(batch_pub_ && solution_batch_.add(fix))
+            publishBatch();
+    }
+
+    void publishBatch()
+    {
+        solution_batch_.take(&batch_msg_);
+        batch_pub_.publish(batch_msg_);
+    }
+
+    // RANGE and TRACKSTAT of the LogAll set just published
+    void publishCompact(const ros::Time& stamp)
+    {
+        if(!compact_encoder_)
+            return;
+        compact_encoder_->encode(log.msg_header, log.range_log, &compact_range_);
+        compact_range_.header.stamp = stamp;
+        compact_range_pub_.publish(compact_range_);
+        if(log.track_log.channel.empty())
+            return;
+        compact_encoder_->encode(log.msg_header, log.track_log, &compact_track_);
+        compact_track_.header.stamp = stamp;
+        compact_track_pub_.publish(compact_track_);
+    }
+
+    void publishSmoothedRanges(const ros::Time& stamp)
+    {
+        gps.getData(&smoothed_msg_);
+        smoothed_msg_.header.stamp = stamp;
+        smoothed_pub_.publish(smoothed_msg_);
+    }
+
+    void publishPointSolution(const ros::Time& stamp)
+    {
+        if(!point_solution_ || gps.pointSolutions() == point_count_)
+            return;
+        point_count_ = gps.pointSolutions();
+        gps.getData(&point_msg_);
+        point_msg_.header.stamp = stamp;
+        point_pub_.publish(point_msg_);
     }
 
     void publishData()
     {
         getData();
+        if(batch_pub_ && solution_batch_.due(ros::Time::now()))
+            publishBatch();
         if(log_id_ == gps.BESTPOS)
             gps_data_pub_.publish(gps_reading_);
         else if(log_id_ == gps.BESTXYZ)
+        {
             gps_data_pub_.publish(gps_xyz_reading_);
+            batchFix(gps_xyz_reading_);
+            publishGeodetic(gps_xyz_reading_.header.stamp);
+        }
         else
         {
             gps_data_pub_.publish(gps_xyz_reading_);
+            batchFix(gps_xyz_reading_);
+            publishGeodetic(gps_xyz_reading_.header.stamp);
             gps_data_pub_logall_.publish(log);
+            publishCompact(log.header.stamp);
+
+            gps.getData(&satellites_);
+            satellites_.header.stamp = log.header.stamp;
+            gps_data_pub_sats_.publish(satellites_);
+
+            if(geometry_)
+            {
+                gps.getData(&geometry_msg_);
+                geometry_msg_.header.stamp = log.header.stamp;
+                geometry_pub_.publish(geometry_msg_);
+            }
+            if(hatch_window_ > 0)
+                publishSmoothedRanges(log.header.stamp);
+            publishPointSolution(log.header.stamp);
         }
     }
 
+    void publishGeodetic(const ros::Time& stamp)
+    {
+        if(!geodetic_)
+            return;
+
+        gps.getGeodetic(&xyz_fix_);
+        xyz_fix_.header.stamp = stamp;
+        xyz_fix_pub_.publish(xyz_fix_);
+
+        gps.getData(&pose_);
+        pose_.header.stamp = stamp;
+        pose_pub_.publish(pose_);
+    }
+
     void getData()
     {
         if(log_id_ == gps.BESTPOS)
@@ -140,8 +659,89 @@ public:
         }
     }
 
+    void startCorrections()
+    {
+        if(!corrections_ || !replay_.empty())
+            return;
+
+        int err = serialcom_init(&rtcm_serial_, 1, (char*)rtcm_device_.c_str(), rtcm_baud_);
+        if(err != SERIALCOM_SUCCESS)
+        {
+            ROS_ERROR("corrections: could not open %s (%d), corrections disabled", rtcm_device_.c_str(), err);
+            return;
+        }
+        rtcm_serial_open_ = true;
+
+        // Written from their own thread to the receiver's correction port
+        correction_writer_.reset(new CorrectionWriter(rtcm_serial_.fd, rtcm_max_age_, rtcm_queue_bytes_));
+        ros::NodeHandle gps_node_handle(node_handle_, "gps");
+        rtcm_sub_ = gps_node_handle.subscribe(rtcm_topic_, 100, &GpsNode::rtcmCallback, this,
+                                              ros::TransportHints().tcpNoDelay());
+        if(!rtcm_source_.empty())
+            correction_source_.reset(new CorrectionSource(rtcm_source_, correction_writer_.get()));
+        rtcm_timer_ = node_handle_.createTimer(ros::Duration(10.0), &GpsNode::reportCorrections, this);
+    }
+
+    void rtcmCallback(const novatel_gps::RTCM::ConstPtr& msg)
+    {
+        rtcm_framer_.feed(msg->message.data(), msg->message.size(),
+                          std::bind(&CorrectionWriter::push, correction_writer_.get(), std::placeholders::_1, std::placeholders::_2));
+    }
+
+    void reportCorrections(const ros::TimerEvent&)
+    {
+        CorrectionStats s = correction_writer_->stats();
+        ROS_INFO("Corrections: %lu messages (%lu bytes) sent, age %.3f s (max %.3f s), queue %zu messages (%zu bytes), "
+                 "dropped %lu stale %lu overflow, %u CRC errors",
+                 (unsigned long)s.messages, (unsigned long)s.bytes, s.last_age, s.max_age, s.queue_messages, s.queue_bytes,
+                 (unsigned long)s.dropped_stale, (unsigned long)s.dropped_overflow, rtcm_framer_.crcErrors());
+    }
+
+    /* ----------------------------------------------------------------------
+    Publishes the last fix propagated to the current time at extrapolate_rate,
+    on absolute deadlines so the period does not drift with the work done
+    ---------------------------------------------------------------------- */
+    void extrapolateLoop()
+    {
+        long period_ns = static_cast<long>(1e9/extrapolate_rate_);
+        struct timespec next;
+        clock_gettime(CLOCK_MONOTONIC, &next);
+        ExtrapolatedPose pose;
+
+        while(extrapolating_)
+        {
+            next.tv_nsec += period_ns;
+            while(next.tv_nsec >= 1000000000L)
+            {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+            if(!gps.extrapolator().at(CaptureClockNs(), &pose))
+                continue;
+
+            extrapolated_.header.stamp.fromSec(pose.host_time);
+            fillXYZ(pose.position, pose.velocity, pose.position_var, pose.velocity_var, &extrapolated_);
+            extrapolated_pub_.publish(extrapolated_);
+        }
+    }
+
     void stop()
     {
+        extrapolating_ = false;
+        if(extrapolate_thread_.joinable())
+            extrapolate_thread_.join();
+
+        // Sources feed the writer, the writer uses the port
+        correction_source_.reset();
+        correction_writer_.reset();
+        if(rtcm_serial_open_)
+        {
+            serialcom_close(&rtcm_serial_);
+            rtcm_serial_open_ = false;
+        }
+
         try
         {
             gps.close();
@@ -0,0 +1,236 @@
+#include <cstring>
+#include <cerrno>
+#include <cstddef>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gps_shm.h"
+
+// The layout is shared with other processes and compilers, keep it fixed
+static_assert(sizeof(GpsShmHeader) == 64, "GpsShmHeader layout changed");
+static_assert(sizeof(GpsShmSolution) == 192, "GpsShmSolution layout changed");
+static_assert(offsetof(GpsShmHeader, count) == 24, "GpsShmHeader layout changed");
+static_assert(offsetof(GpsShmSolution, position) == 56, "GpsShmSolution layout changed");
+static_assert(offsetof(GpsShmSolution, latitude) == 128, "GpsShmSolution layout changed");
+
+// Attempts before a read gives up, only reached if the writer laps the reader
+#define GPS_SHM_READ_TRIES  4
+
+static int64_t RealtimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+static void ResetHandle(GpsShm* shm)
+{
+    memset(shm, 0, sizeof(*shm));
+    shm->fd = -1;
+}
+
+/* --------------------------------------------------------------------------
+Copies slot into out if no write overlapped the copy and it holds solution
+index. The payload copy races with the writer by design, the sequence check
+discards torn copies.
+-------------------------------------------------------------------------- */
+static bool ReadSlot(const GpsShmSolution* slot, uint64_t index, GpsShmSolution* out)
+{
+    uint64_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if(before & 1)
+        return false;
+
+    memcpy(out, slot, sizeof(*out));
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t after = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    return before == after && out->sequence == before && out->index == index;
+}
+
+/*************************** Writer ***************************/
+
+int GpsShmCreate(GpsShm* shm, const char* name, uint32_t capacity)
+{
+    ResetHandle(shm);
+    if(capacity < 2 || strlen(name) >= sizeof(shm->name))
+        return -EINVAL;
+
+    // A new segment rather than reusing one, so old readers are never handed a
+    // ring that is being reinitialised under them
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0)
+        return -errno;
+
+    size_t size = sizeof(GpsShmHeader) + static_cast<size_t>(capacity)*sizeof(GpsShmSolution);
+    void* map = MAP_FAILED;
+    if(ftruncate(fd, size) == 0)
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+    {
+        int err = errno;
+        ::close(fd);
+        shm_unlink(name);
+        return -err;
+    }
+
+    // Pages are zeroed by ftruncate, so every slot starts with an even sequence
+    mlock(map, size);
+    shm->fd = fd;
+    shm->size = size;
+    shm->header = static_cast<GpsShmHeader*>(map);
+    shm->slots = reinterpret_cast<GpsShmSolution*>(shm->header + 1);
+    shm->writer = 1;
+    strcpy(shm->name, name);
+
+    GpsShmHeader* header = shm->header;
+    header->version = GPS_SHM_VERSION;
+    header->header_size = sizeof(GpsShmHeader);
+    header->slot_size = sizeof(GpsShmSolution);
+    header->capacity = capacity;
+    header->writer_pid = getpid();
+    header->active = 1;
+    header->count = 0;
+    __atomic_store_n(&header->magic, GPS_SHM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void GpsShmPublish(GpsShm* shm, GpsShmSolution* solution)
+{
+    GpsShmHeader* header = shm->header;
+    uint64_t index = header->count;
+    GpsShmSolution* slot = &shm->slots[index % header->capacity];
+
+    uint64_t sequence = slot->sequence;
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    solution->sequence = sequence + 2;
+    solution->index = index;
+    solution->publish_ns = RealtimeNs();
+    memcpy(reinterpret_cast<uint8_t*>(slot) + sizeof(uint64_t),
+           reinterpret_cast<const uint8_t*>(solution) + sizeof(uint64_t),
+           sizeof(GpsShmSolution) - sizeof(uint64_t));
+
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->count, index + 1, __ATOMIC_RELEASE);
+}
+
+/*************************** Reader ***************************/
+
+int GpsShmOpen(GpsShm* shm, const char* name)
+{
+    ResetHandle(shm);
+    if(strlen(name) >= sizeof(shm->name))
+        return -EINVAL;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0)
+        return -errno;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(GpsShmHeader))
+    {
+        ::close(fd);
+        return -EAGAIN;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+    {
+        int err = errno;
+        ::close(fd);
+        return -err;
+    }
+
+    const GpsShmHeader* header = static_cast<const GpsShmHeader*>(map);
+    int err = 0;
+    if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != GPS_SHM_MAGIC)
+        err = -EAGAIN;
+    else if(header->version != GPS_SHM_VERSION || header->header_size != sizeof(GpsShmHeader) ||
+            header->slot_size != sizeof(GpsShmSolution) || header->capacity < 2 ||
+            sizeof(GpsShmHeader) + static_cast<size_t>(header->capacity)*sizeof(GpsShmSolution) > static_cast<size_t>(st.st_size))
+        err = -EPROTO;
+
+    if(err != 0)
+    {
+        munmap(map, st.st_size);
+        ::close(fd);
+        return err;
+    }
+
+    shm->fd = fd;
+    shm->size = st.st_size;
+    shm->header = static_cast<GpsShmHeader*>(map);
+    shm->slots = reinterpret_cast<GpsShmSolution*>(shm->header + 1);
+    shm->writer = 0;
+    strcpy(shm->name, name);
+    return 0;
+}
+
+void GpsShmClose(GpsShm* shm)
+{
+    if(!shm->header)
+        return;
+
+    if(shm->writer)
+    {
+        __atomic_store_n(&shm->header->active, 0, __ATOMIC_RELEASE);
+        shm_unlink(shm->name);
+    }
+    munmap(shm->header, shm->size);
+    ::close(shm->fd);
+    ResetHandle(shm);
+}
+
+uint64_t GpsShmCount(const GpsShm* shm)
+{
+    return __atomic_load_n(&shm->header->count, __ATOMIC_ACQUIRE);
+}
+
+int GpsShmReadLatest(const GpsShm* shm, GpsShmSolution* out)
+{
+    const GpsShmHeader* header = shm->header;
+    for(int i = 0; i < GPS_SHM_READ_TRIES; ++i)
+    {
+        uint64_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+        if(count == 0)
+            return 0;
+
+        uint64_t index = count - 1;
+        if(ReadSlot(&shm->slots[index % header->capacity], index, out))
+            return 1;
+    }
+    return -EAGAIN;
+}
+
+int GpsShmReadHistory(const GpsShm* shm, GpsShmSolution* out, int max)
+{
+    const GpsShmHeader* header = shm->header;
+    uint64_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+
+    // The slot after the latest is the next to be written, leave it out
+    uint64_t available = count < header->capacity - 1 ? count : header->capacity - 1;
+
+    int n = 0;
+    while(n < max && static_cast<uint64_t>(n) < available)
+    {
+        uint64_t index = count - 1 - n;
+        if(!ReadSlot(&shm->slots[index % header->capacity], index, &out[n]))
+            break;
+        n++;
+    }
+    return n;
+}
+
+int GpsShmWriterAlive(const GpsShm* shm)
+{
+    const GpsShmHeader* header = shm->header;
+    if(!__atomic_load_n(&header->active, __ATOMIC_ACQUIRE))
+        return 0;
+    return kill(header->writer_pid, 0) == 0 || errno == EPERM;
+}
@@ -0,0 +1,194 @@
+// Shared-memory solution reader: prints fixes published by the driver
+// (shm_name), dumps the recent history, or measures publish-to-read latency
+// by busy-polling the ring. Also an example of the gps_shm.h reader API.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gps_shm.h"
+
+static volatile sig_atomic_t running = 1;
+
+static void HandleSignal(int)
+{
+    running = 0;
+}
+
+static int64_t RealtimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+static void Print(const GpsShmSolution& s)
+{
+    printf("%llu week %u ms %u id %u status %u type %u sv %u/%u  xyz %.3f %.3f %.3f (%.3f %.3f %.3f)"
+           "  llh %.8f %.8f %.3f  age %.1f us\n",
+           (unsigned long long)s.index, s.gps_week, s.gps_ms, s.msg_id, s.position_status, s.position_type,
+           s.satellites_used, s.satellites_tracked,
+           s.position[0], s.position[1], s.position[2],
+           s.position_sigma[0], s.position_sigma[1], s.position_sigma[2],
+           s.latitude, s.longitude, s.height, (RealtimeNs() - s.publish_ns)/1e3);
+}
+
+// Waits for the driver to create the segment
+static bool Attach(GpsShm* shm, const std::string& name)
+{
+    bool waiting = false;
+    while(running)
+    {
+        int err = GpsShmOpen(shm, name.c_str());
+        if(err == 0 && !GpsShmWriterAlive(shm))
+        {
+            // Left behind by a driver that did not shut down cleanly
+            GpsShmClose(shm);
+            err = -ESRCH;
+        }
+        if(err == 0)
+        {
+            printf("gps_shm_reader: %s, %u slots, writer pid %d\n", name.c_str(), shm->header->capacity, shm->header->writer_pid);
+            return true;
+        }
+        if(err == -EPROTO)
+        {
+            printf("gps_shm_reader: %s has an incompatible layout (version %d expected)\n", name.c_str(), GPS_SHM_VERSION);
+            return false;
+        }
+        if(!waiting)
+            printf("gps_shm_reader: waiting for %s (%s)\n", name.c_str(), strerror(-err));
+        waiting = true;
+        usleep(100000);
+    }
+    return false;
+}
+
+static double Percentile(std::vector<double>& v, double p)
+{
+    size_t i = std::min(v.size() - 1, static_cast<size_t>(p*v.size()));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+static void Latency(GpsShm* shm, int samples)
+{
+    std::vector<double> publish_to_read, receive_to_read;
+    publish_to_read.reserve(samples);
+    receive_to_read.reserve(samples);
+
+    uint64_t seen = GpsShmCount(shm);
+    uint64_t missed = 0;
+    GpsShmSolution s;
+    while(running && static_cast<int>(publish_to_read.size()) < samples)
+    {
+        uint64_t count = GpsShmCount(shm);
+        if(count == seen)
+            continue;
+
+        int64_t now = RealtimeNs();
+        if(GpsShmReadLatest(shm, &s) == 1)
+        {
+            publish_to_read.push_back((now - s.publish_ns)/1e3);
+            receive_to_read.push_back((now - s.receive_ns)/1e3);
+        }
+        missed += count - seen - 1;
+        seen = count;
+    }
+    if(publish_to_read.empty())
+        return;
+
+    printf("gps_shm_reader: %zu solutions, %llu skipped\n", publish_to_read.size(), (unsigned long long)missed);
+    printf("  publish -> read  p50 %.2f us  p99 %.2f us  p99.9 %.2f us  max %.2f us\n",
+           Percentile(publish_to_read, 0.5), Percentile(publish_to_read, 0.99),
+           Percentile(publish_to_read, 0.999), *std::max_element(publish_to_read.begin(), publish_to_read.end()));
+    printf("  receive -> read  p50 %.2f us  p99 %.2f us  p99.9 %.2f us  max %.2f us\n",
+           Percentile(receive_to_read, 0.5), Percentile(receive_to_read, 0.99),
+           Percentile(receive_to_read, 0.999), *std::max_element(receive_to_read.begin(), receive_to_read.end()));
+}
+
+static void Usage()
+{
+    printf("usage: gps_shm_reader [--name NAME] [--history N] [--latency N]\n"
+           "  --name     shared memory segment (/novatel_gps)\n"
+           "  --history  print the last N solutions and exit\n"
+           "  --latency  busy-poll N solutions and report publish/receive to read latency\n");
+}
+
+int main(int argc, char* argv[])
+{
+    std::string name = GPS_SHM_DEFAULT;
+    int history = 0;
+    int latency = 0;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool value = i + 1 < argc;
+
+        if(arg == "--name" && value)
+            name = argv[++i];
+        else if(arg == "--history" && value)
+            history = atoi(argv[++i]);
+        else if(arg == "--latency" && value)
+            latency = atoi(argv[++i]);
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    GpsShm shm;
+    if(!Attach(&shm, name))
+        return 1;
+
+    if(history > 0)
+    {
+        std::vector<GpsShmSolution> solutions(history);
+        int n = GpsShmReadHistory(&shm, solutions.data(), history);
+        for(int i = n - 1; i >= 0; --i)
+            Print(solutions[i]);
+    }
+    else if(latency > 0)
+    {
+        Latency(&shm, latency);
+    }
+    else
+    {
+        uint64_t seen = 0;
+        GpsShmSolution s;
+        while(running)
+        {
+            if(!GpsShmWriterAlive(&shm))
+            {
+                // The driver restarted or exited, follow the new segment
+                GpsShmClose(&shm);
+                if(!Attach(&shm, name))
+                    return 1;
+                seen = 0;
+            }
+
+            uint64_t count = GpsShmCount(&shm);
+            if(count != seen && GpsShmReadLatest(&shm, &s) == 1)
+            {
+                Print(s);
+                seen = count;
+            }
+            usleep(1000);
+        }
+    }
+
+    GpsShmClose(&shm);
+    return 0;
+}
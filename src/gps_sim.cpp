@@ -0,0 +1,416 @@
+// Receiver simulator: plays the receiver side of a pseudo-terminal so the
+// driver can run without hardware. It answers the driver's commands, emits
+// the requested binary logs with valid CRCs at the line rate of the given
+// baud and writes a send log used to measure end-to-end latency.
+//
+// BESTXYZ frames carry a sequence number in the X coordinate (SIM_X0 + seq)
+// so that a subscriber can match every published message to its send time.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame_builder.h"
+
+#define SIM_X0              4115000.0
+#define SIM_Y0              -4550000.0
+#define SIM_Z0              -1722000.0
+#define SIM_LATITUDE        -15.765824
+#define SIM_LONGITUDE       -47.872109
+#define SIM_HEIGHT          1024.0
+#define GPS_EPOCH_OFFSET    315964800       // 1980-01-06 in Unix time
+#define GPS_LEAP_SECONDS    18
+
+struct SimLog
+{
+    std::string name;
+    uint16_t msg_id;
+    bool short_header;
+    int64_t period_ns;      // 0 for ONCE
+    int64_t next_ns;
+};
+
+struct SimConfig
+{
+    std::string link;
+    std::string send_log;
+    int baud;
+    double rate;
+    int obs;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void HandleSignal(int)
+{
+    running = 0;
+}
+
+static int64_t ClockNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+static void SleepUntil(int64_t monotonic_ns)
+{
+    struct timespec ts;
+    ts.tv_sec = monotonic_ns / 1000000000LL;
+    ts.tv_nsec = monotonic_ns % 1000000000LL;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && running)
+        ;
+}
+
+static bool LookupLog(const std::string& name, uint16_t* msg_id, bool* short_header)
+{
+    static const struct { const char* name; uint16_t id; bool short_header; } logs[] = {
+        { "BESTPOS", 42, false },       { "RANGE", 43, false },
+        { "TRACKSTAT", 83, false },     { "RANGECMP", 140, false },
+        { "BESTXYZ", 241, false },      { "SATXYZ", 270, false },
+        { "INSPVA", 507, false },       { "INSPVAS", 508, true },
+        { "CORRIMUDATA", 812, false },  { "CORRIMUDATAS", 813, true },
+    };
+
+    for(size_t i = 0; i < sizeof(logs)/sizeof(logs[0]); ++i)
+    {
+        if(name == logs[i].name)
+        {
+            *msg_id = logs[i].id;
+            *short_header = logs[i].short_header;
+            return true;
+        }
+    }
+    return false;
+}
+
+class ReceiverSim
+{
+public:
+    ReceiverSim(const SimConfig& config) :
+        config_(config), master_(-1), slave_(-1), send_log_(NULL),
+        line_free_ns_(0), seq_(0), sent_(0), dropped_(0)
+    {
+    }
+
+    ~ReceiverSim()
+    {
+        if(send_log_)
+            fclose(send_log_);
+        if(!config_.link.empty())
+            unlink(config_.link.c_str());
+        if(slave_ >= 0)
+            close(slave_);
+        if(master_ >= 0)
+            close(master_);
+    }
+
+    bool open()
+    {
+        master_ = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if(master_ < 0 || grantpt(master_) != 0 || unlockpt(master_) != 0)
+        {
+            perror("posix_openpt");
+            return false;
+        }
+        const char* name = ptsname(master_);
+
+        // Holding the slave open keeps the master usable while the driver
+        // closes and reopens the port to change baud rate
+        slave_ = ::open(name, O_RDWR | O_NOCTTY);
+        if(slave_ < 0)
+        {
+            perror("open slave");
+            return false;
+        }
+
+        // Binary frames must pass untouched (no echo, no CR/LF translation)
+        struct termios tio;
+        tcgetattr(slave_, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave_, TCSANOW, &tio);
+
+        unlink(config_.link.c_str());
+        if(symlink(name, config_.link.c_str()) != 0)
+        {
+            perror("symlink");
+            return false;
+        }
+
+        if(!config_.send_log.empty())
+        {
+            send_log_ = fopen(config_.send_log.c_str(), "w");
+            if(!send_log_)
+            {
+                perror("send log");
+                return false;
+            }
+            // Line buffered so a harness can read it while frames are sent
+            setvbuf(send_log_, NULL, _IOLBF, 0);
+            fprintf(send_log_, "seq,msg_id,bytes,send_ns,week,ms\n");
+        }
+
+        printf("gps_sim: %s -> %s, %d baud\n", config_.link.c_str(), name, config_.baud);
+        fflush(stdout);
+        return true;
+    }
+
+    void run()
+    {
+        while(running)
+        {
+            // Wait for commands until the next log is due
+            int64_t now = ClockNs(CLOCK_MONOTONIC);
+            int64_t next = now + 100000000LL;
+            for(size_t i = 0; i < logs_.size(); ++i)
+                next = std::min(next, logs_[i].next_ns);
+
+            struct pollfd pfd;
+            pfd.fd = master_;
+            pfd.events = POLLIN;
+            int timeout_ms = (next > now) ? static_cast<int>((next - now)/1000000) : 0;
+            if(poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN))
+            {
+                readCommands();
+                continue;
+            }
+
+            // poll() only has millisecond resolution
+            SleepUntil(next);
+
+            now = ClockNs(CLOCK_MONOTONIC);
+            for(size_t i = 0; i < logs_.size(); ++i)
+            {
+                SimLog& log = logs_[i];
+                if(log.next_ns > now)
+                    continue;
+
+                emit(log);
+                if(log.period_ns > 0)
+                {
+                    // Stay on the original schedule, skipping epochs the line could not carry
+                    while(log.next_ns <= now)
+                        log.next_ns += log.period_ns;
+                }
+                else
+                {
+                    logs_.erase(logs_.begin() + i--);
+                }
+            }
+        }
+
+        printf("gps_sim: %lu frames sent, %lu dropped\n", sent_, dropped_);
+    }
+
+private:
+    void readCommands()
+    {
+        char buf[256];
+        ssize_t n;
+        while((n = ::read(master_, buf, sizeof(buf))) > 0)
+        {
+            for(ssize_t i = 0; i < n; ++i)
+            {
+                if(buf[i] == '\r' || buf[i] == '\n')
+                {
+                    if(!line_.empty())
+                        command(line_);
+                    line_.clear();
+                }
+                else
+                {
+                    line_ += buf[i];
+                }
+            }
+        }
+    }
+
+    void command(const std::string& line)
+    {
+        std::istringstream in(line);
+        std::string cmd;
+        in >> cmd;
+        printf("gps_sim: %s\n", line.c_str());
+        fflush(stdout);
+
+        if(cmd == "LOG")
+        {
+            std::string name, trigger;
+            double period = 0.0, offset = 0.0;
+            in >> name >> trigger >> period >> offset;
+
+            // Binary logs only, the driver always asks for <NAME>B
+            if(!name.empty() && name[name.size() - 1] == 'B')
+                name.erase(name.size() - 1);
+
+            SimLog log;
+            log.name = name;
+            if(!LookupLog(name, &log.msg_id, &log.short_header))
+            {
+                printf("gps_sim: unsupported log %s\n", name.c_str());
+                reply("<ERROR:Invalid Message. Field = 2");
+                return;
+            }
+
+            if(trigger == "ONTIME" && period > 0.0)
+                log.period_ns = static_cast<int64_t>(period*1e9);
+            else if(trigger == "ONNEW" || trigger == "ONCHANGED")
+                log.period_ns = static_cast<int64_t>(1e9/config_.rate);
+            else
+                log.period_ns = 0;
+
+            int64_t now = ClockNs(CLOCK_MONOTONIC);
+            log.next_ns = (log.period_ns > 0) ? now - now % log.period_ns + log.period_ns +
+                          static_cast<int64_t>(offset*1e9) : now;
+            logs_.push_back(log);
+        }
+        else if(cmd == "UNLOGALL")
+        {
+            logs_.clear();
+        }
+        reply("<OK");
+    }
+
+    void reply(const char* text)
+    {
+        std::string line = std::string(text) + "\r\n";
+        if(::write(master_, line.data(), line.size()) < 0)
+            dropped_++;
+    }
+
+    void emit(const SimLog& log)
+    {
+        // GPS time of this epoch
+        int64_t gps_ns = ClockNs(CLOCK_REALTIME) - (GPS_EPOCH_OFFSET - GPS_LEAP_SECONDS)*1000000000LL;
+        uint16_t week = gps_ns / (604800LL*1000000000LL);
+        uint32_t ms = (gps_ns / 1000000LL) % (604800LL*1000LL);
+
+        double position[3] = { SIM_X0 + seq_, SIM_Y0, SIM_Z0 };
+        double zero[3] = { 0.0, 0.0, 0.0 };
+        double attitude[3] = { 0.0, 0.0, 90.0 };
+        double gravity[3] = { 0.0, 0.0, 9.80665/100.0 };
+
+        switch(log.msg_id)
+        {
+            case 241:   BuildBestXYZBody(position, zero, &body_);                                   break;
+            case 42:    BuildBestPosBody(SIM_LATITUDE, SIM_LONGITUDE, SIM_HEIGHT, &body_);          break;
+            case 43:    BuildRangeBody(config_.obs, seq_, &body_);                                  break;
+            case 140:   BuildRangeCmpBody(config_.obs, seq_, &body_);                               break;
+            case 270:   BuildSatXYZBody(config_.obs/2, seq_, &body_);                               break;
+            case 83:    BuildTrackStatBody(config_.obs, seq_, &body_);                              break;
+            case 507:
+            case 508:   BuildInsPvaBody(week, ms/1000.0, SIM_LATITUDE, SIM_LONGITUDE, SIM_HEIGHT,
+                                        zero, attitude, &body_);                                    break;
+            case 812:
+            case 813:   BuildCorrImuDataBody(week, ms/1000.0, zero, gravity, &body_);               break;
+        }
+
+        frame_.clear();
+        if(log.short_header)
+            BuildShortFrame(log.msg_id, body_, week, ms, &frame_);
+        else
+            BuildFrame(log.msg_id, body_, week, ms, &frame_);
+
+        // Start after the previous frame, write when the last byte would have
+        // left a real UART (10 bits per byte)
+        int64_t now = ClockNs(CLOCK_MONOTONIC);
+        int64_t start = std::max(now, line_free_ns_);
+        int64_t done = start + (config_.baud > 0 ? static_cast<int64_t>(frame_.size()*10*1e9/config_.baud) : 0);
+        SleepUntil(done);
+        line_free_ns_ = done;
+
+        // Stamped before the write: on a loaded or single-core host the
+        // driver may decode the frame before write() returns here
+        int64_t send_ns = ClockNs(CLOCK_REALTIME);
+        ssize_t n = ::write(master_, frame_.data(), frame_.size());
+        if(n != static_cast<ssize_t>(frame_.size()))
+        {
+            // Driver not reading, the pty buffer is full
+            dropped_++;
+        }
+        else
+        {
+            sent_++;
+            if(send_log_)
+                fprintf(send_log_, "%u,%u,%zu,%lld,%u,%u\n", seq_, log.msg_id, frame_.size(), (long long)send_ns, week, ms);
+        }
+        seq_++;
+    }
+
+    SimConfig config_;
+    int master_;
+    int slave_;
+    FILE* send_log_;
+    std::vector<SimLog> logs_;
+    std::string line_;
+    std::vector<uint8_t> body_;
+    std::vector<uint8_t> frame_;
+    int64_t line_free_ns_;
+    uint32_t seq_;
+    unsigned long sent_;
+    unsigned long dropped_;
+};
+
+static void Usage()
+{
+    printf("usage: gps_sim [--link PATH] [--baud BPS] [--rate HZ] [--obs N] [--send-log FILE]\n"
+           "  --link      symlink to the pty slave, use it as the driver port (/tmp/novatel_sim)\n"
+           "  --baud      line rate used to pace frames, 0 disables pacing (115200)\n"
+           "  --rate      rate of ONNEW/ONCHANGED logs (20)\n"
+           "  --obs       observations per RANGE/RANGECMP/TRACKSTAT log (24)\n"
+           "  --send-log  CSV of seq,msg_id,bytes,send_ns,week,ms for every frame sent\n");
+}
+
+int main(int argc, char* argv[])
+{
+    SimConfig config;
+    config.link = "/tmp/novatel_sim";
+    config.baud = 115200;
+    config.rate = 20.0;
+    config.obs = 24;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool value = i + 1 < argc;
+
+        // roslaunch appends __name:=, __log:= remappings
+        if(arg.compare(0, 2, "__") == 0)
+            continue;
+        else if(arg == "--link" && value)
+            config.link = argv[++i];
+        else if(arg == "--baud" && value)
+            config.baud = atoi(argv[++i]);
+        else if(arg == "--rate" && value)
+            config.rate = atof(argv[++i]);
+        else if(arg == "--obs" && value)
+            config.obs = atoi(argv[++i]);
+        else if(arg == "--send-log" && value)
+            config.send_log = argv[++i];
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    ReceiverSim sim(config);
+    if(!sim.open())
+        return 1;
+    sim.run();
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <cstring>
+
+#include "hatch_filter.h"
+
+HatchFilter::HatchFilter() :
+    window_(100)
+{
+    memset(filters_, 0, sizeof(filters_));
+}
+
+void HatchFilter::configure(int window)
+{
+    window_ = (window > 1) ? window : 1;
+}
+
+void HatchFilter::update(const novatel_gps::RangeInformation& range, double gps_time)
+{
+    int index = SatelliteIndex(SatelliteSystem(range.ch_tr_status), range.prn_slot);
+    if(index < 0)
+        return;
+
+    Smoothing& f = filters_[index][SignalSlot(range.ch_tr_status)];
+    if(f.length > 0 && gps_time == f.time)
+        return;
+    // NovAtel ADR is the negative carrier phase
+    double phase = -range.adr*CarrierWavelength(range.ch_tr_status);
+
+    if(range.slip != 0 || f.length == 0)
+    {
+        f.psr = range.psr;
+        f.length = 1;
+    }
+    else
+    {
+        if(f.length < window_)
+            f.length++;
+        double n = f.length;
+        f.psr = range.psr/n + (n - 1.0)/n*(f.psr + phase - f.phase);
+    }
+    f.phase = phase;
+    f.time = gps_time;
+}
+
+double HatchFilter::smoothed(const novatel_gps::RangeInformation& range, int* length) const
+{
+    int index = SatelliteIndex(SatelliteSystem(range.ch_tr_status), range.prn_slot);
+    if(index < 0)
+    {
+        if(length)
+            *length = 0;
+        return range.psr;
+    }
+
+    const Smoothing& f = filters_[index][SignalSlot(range.ch_tr_status)];
+    if(length)
+        *length = f.length;
+    return f.psr;
+}
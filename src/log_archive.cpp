@@ -0,0 +1,788 @@
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "log_archive.h"
+#include "satellite_table.h"
+#include "crc32.h"
+
+// Most columns of any schema, sizes the per-chunk column offsets
+#define ARCHIVE_MAX_COLUMNS     32
+// Worst case bytes per encoded value (10 byte varint)
+#define ARCHIVE_MAX_VALUE       10
+
+static const ArchiveColumn BESTXYZ_COLUMNS[] = {
+    { "time", ARCHIVE_INT },
+    { "position_status", ARCHIVE_INT },
+    { "position_type", ARCHIVE_INT },
+    { "x", ARCHIVE_DOUBLE },
+    { "y", ARCHIVE_DOUBLE },
+    { "z", ARCHIVE_DOUBLE },
+    { "sigma_x", ARCHIVE_FLOAT },
+    { "sigma_y", ARCHIVE_FLOAT },
+    { "sigma_z", ARCHIVE_FLOAT },
+    { "velocity_status", ARCHIVE_INT },
+    { "velocity_type", ARCHIVE_INT },
+    { "vx", ARCHIVE_DOUBLE },
+    { "vy", ARCHIVE_DOUBLE },
+    { "vz", ARCHIVE_DOUBLE },
+    { "sigma_vx", ARCHIVE_FLOAT },
+    { "sigma_vy", ARCHIVE_FLOAT },
+    { "sigma_vz", ARCHIVE_FLOAT },
+    { "velocity_latency", ARCHIVE_FLOAT },
+    { "satellites_tracked", ARCHIVE_INT },
+    { "satellites_used", ARCHIVE_INT },
+};
+
+static const ArchiveColumn RANGE_COLUMNS[] = {
+    { "time", ARCHIVE_INT },
+    { "prn_slot", ARCHIVE_INT },
+    { "ch_tr_status", ARCHIVE_INT },
+    { "psr", ARCHIVE_DOUBLE },
+    { "psr_std", ARCHIVE_FLOAT },
+    { "adr", ARCHIVE_DOUBLE },
+    { "adr_std", ARCHIVE_FLOAT },
+    { "doppler", ARCHIVE_FLOAT },
+    { "c_no", ARCHIVE_FLOAT },
+    { "locktime", ARCHIVE_FLOAT },
+    { "slip", ARCHIVE_INT },
+};
+
+static const ArchiveColumn TRACKSTAT_COLUMNS[] = {
+    { "time", ARCHIVE_INT },
+    { "prn_slot", ARCHIVE_INT },
+    { "ch_tr_status", ARCHIVE_INT },
+    { "psr", ARCHIVE_DOUBLE },
+    { "doppler", ARCHIVE_FLOAT },
+    { "cn0", ARCHIVE_FLOAT },
+    { "locktime", ARCHIVE_FLOAT },
+    { "psr_res", ARCHIVE_FLOAT },
+    { "reject", ARCHIVE_INT },
+    { "psr_weight", ARCHIVE_FLOAT },
+};
+
+static const ArchiveColumn SATXYZ_COLUMNS[] = {
+    { "time", ARCHIVE_INT },
+    { "prn_slot", ARCHIVE_INT },
+    { "x", ARCHIVE_DOUBLE },
+    { "y", ARCHIVE_DOUBLE },
+    { "z", ARCHIVE_DOUBLE },
+    { "clk_corr", ARCHIVE_DOUBLE },
+    { "ion_corr", ARCHIVE_DOUBLE },
+    { "trop_corr", ARCHIVE_DOUBLE },
+};
+
+#define COLUMNS(c) static_cast<int>(sizeof(c)/sizeof(c[0])), c
+
+static const ArchiveSchema SCHEMAS[ARCHIVE_TABLES] = {
+    { "BESTXYZ", COLUMNS(BESTXYZ_COLUMNS), false },
+    { "RANGE", COLUMNS(RANGE_COLUMNS), true },
+    { "TRACKSTAT", COLUMNS(TRACKSTAT_COLUMNS), true },
+    { "SATXYZ", COLUMNS(SATXYZ_COLUMNS), true },
+};
+
+const ArchiveSchema& ArchiveTableSchema(int table)
+{
+    return SCHEMAS[table];
+}
+
+int ArchiveFindTable(const std::string& name)
+{
+    for(int t = 0; t < ARCHIVE_TABLES; ++t)
+        if(name == SCHEMAS[t].name)
+            return t;
+    return -1;
+}
+
+int ArchiveFindColumn(int table, const std::string& name)
+{
+    for(int c = 0; c < SCHEMAS[table].columns; ++c)
+        if(name == SCHEMAS[table].column[c].name)
+            return c;
+    return -1;
+}
+
+// Column of the channel tracking status word (RANGE, TRACKSTAT), -1 when
+// the log has none (SATXYZ, GPS only)
+static int StatusColumn(const ArchiveSchema& schema)
+{
+    return schema.satellites && schema.columns > 2 && strcmp(schema.column[2].name, "ch_tr_status") == 0 ? 2 : -1;
+}
+
+static void SetSatellite(uint64_t* mask, int system, int prn)
+{
+    int bit = SatelliteIndex(system, prn);
+    if(bit < 0)
+        bit = MAX_SATELLITES;
+    mask[bit/64] |= 1ULL << (bit % 64);
+}
+
+// Bits of the satellites a query selects: its PRN in every system (or the
+// one asked for), or every satellite of the system
+static void QueryMask(const ArchiveQuery& query, uint64_t* mask)
+{
+    memset(mask, 0, ARCHIVE_SATELLITE_WORDS*sizeof(uint64_t));
+    for(int system = 0; system <= SYSTEM_OTHER; ++system)
+    {
+        if(query.system >= 0 && system != query.system)
+            continue;
+        if(query.prn >= 0)
+        {
+            SetSatellite(mask, system, query.prn);
+            continue;
+        }
+        for(int index = 0; index < MAX_SATELLITES; ++index)
+        {
+            int of, prn;
+            SatelliteOf(index, &of, &prn);
+            if(of == system)
+                SetSatellite(mask, system, prn);
+        }
+        mask[MAX_SATELLITES/64] |= 1ULL << (MAX_SATELLITES % 64);
+    }
+}
+
+static bool MaskIntersects(const uint64_t* a, const uint64_t* b)
+{
+    for(int w = 0; w < ARCHIVE_SATELLITE_WORDS; ++w)
+        if(a[w] & b[w])
+            return true;
+    return false;
+}
+
+/* --------------------------------------------------------------------------
+Column codecs. Integers: zigzag of the difference to the previous value as a
+little-endian base-128 varint, so a constant time or slowly changing status
+is one byte. Floating point: the bit pattern XORed with the previous one,
+stored as a byte (leading zero bytes << 4 | trailing zero bytes) and the
+bytes in between; a repeated value is the control byte alone.
+-------------------------------------------------------------------------- */
+static uint8_t* EncodeColumn(ArchiveType type, const double* values, size_t rows, uint8_t* p)
+{
+    if(type == ARCHIVE_INT)
+    {
+        int64_t previous = 0;
+        for(size_t i = 0; i < rows; ++i)
+        {
+            int64_t v = static_cast<int64_t>(values[i]);
+            int64_t d = v - previous;
+            uint64_t z = (static_cast<uint64_t>(d) << 1) ^ static_cast<uint64_t>(d >> 63);
+            previous = v;
+            while(z >= 0x80)
+            {
+                *p++ = static_cast<uint8_t>(z) | 0x80;
+                z >>= 7;
+            }
+            *p++ = static_cast<uint8_t>(z);
+        }
+    }
+    else if(type == ARCHIVE_DOUBLE)
+    {
+        uint64_t previous = 0;
+        for(size_t i = 0; i < rows; ++i)
+        {
+            uint64_t bits;
+            memcpy(&bits, &values[i], sizeof(bits));
+            uint64_t x = bits ^ previous;
+            previous = bits;
+            if(x == 0)
+            {
+                *p++ = 8 << 4;
+                continue;
+            }
+            int lz = __builtin_clzll(x)/8, tz = __builtin_ctzll(x)/8;
+            *p++ = static_cast<uint8_t>(lz << 4 | tz);
+            x >>= 8*tz;
+            memcpy(p, &x, 8 - lz - tz);
+            p += 8 - lz - tz;
+        }
+    }
+    else
+    {
+        uint32_t previous = 0;
+        for(size_t i = 0; i < rows; ++i)
+        {
+            float f = static_cast<float>(values[i]);
+            uint32_t bits;
+            memcpy(&bits, &f, sizeof(bits));
+            uint32_t x = bits ^ previous;
+            previous = bits;
+            if(x == 0)
+            {
+                *p++ = 4 << 4;
+                continue;
+            }
+            int lz = __builtin_clz(x)/8, tz = __builtin_ctz(x)/8;
+            *p++ = static_cast<uint8_t>(lz << 4 | tz);
+            x >>= 8*tz;
+            memcpy(p, &x, 4 - lz - tz);
+            p += 4 - lz - tz;
+        }
+    }
+    return p;
+}
+
+// False if the data ends early or is malformed
+static bool DecodeColumn(ArchiveType type, const uint8_t* p, const uint8_t* end, size_t rows, double* out)
+{
+    if(type == ARCHIVE_INT)
+    {
+        int64_t previous = 0;
+        for(size_t i = 0; i < rows; ++i)
+        {
+            uint64_t z = 0;
+            int shift = 0;
+            while(true)
+            {
+                if(p == end || shift > 63)
+                    return false;
+                uint8_t b = *p++;
+                z |= static_cast<uint64_t>(b & 0x7F) << shift;
+                if(!(b & 0x80))
+                    break;
+                shift += 7;
+            }
+            previous += static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+            out[i] = static_cast<double>(previous);
+        }
+    }
+    else if(type == ARCHIVE_DOUBLE)
+    {
+        uint64_t previous = 0;
+        for(size_t i = 0; i < rows; ++i)
+        {
+            if(p == end)
+                return false;
+            int lz = *p >> 4, tz = *p & 0x0F;
+            int n = 8 - lz - tz;
+            p++;
+            if(n < 0 || p + n > end)
+                return false;
+            uint64_t x = 0;
+            memcpy(&x, p, n);
+            p += n;
+            if(n > 0)
+                previous ^= x << (8*tz);
+            memcpy(&out[i], &previous, sizeof(double));
+        }
+    }
+    else
+    {
+        uint32_t previous = 0;
+        for(size_t i = 0; i < rows; ++i)
+        {
+            if(p == end)
+                return false;
+            int lz = *p >> 4, tz = *p & 0x0F;
+            int n = 4 - lz - tz;
+            p++;
+            if(n < 0 || p + n > end)
+                return false;
+            uint32_t x = 0;
+            memcpy(&x, p, n);
+            p += n;
+            if(n > 0)
+                previous ^= x << (8*tz);
+            float f;
+            memcpy(&f, &previous, sizeof(f));
+            out[i] = f;
+        }
+    }
+    return true;
+}
+
+// Column c of a chunk whose column data starts at data
+static bool DecodeChunkColumn(ArchiveType type, int c, const uint8_t* data, const uint32_t* ends,
+                              const uint8_t* chunk_end, size_t rows, std::vector<double>* out)
+{
+    const uint8_t* begin = data + ((c > 0) ? ends[c - 1] : 0);
+    const uint8_t* end = data + ends[c];
+    out->resize(rows);
+    return begin <= end && end <= chunk_end && DecodeColumn(type, begin, end, rows, out->data());
+}
+
+/* --------------------------------------------------------------------------
+Appends one chunk of rows rows to out: header, column end offsets and the
+encoded columns, each stride values apart in values (column-major). entry
+gets the chunk's index entry with its offset in out.
+-------------------------------------------------------------------------- */
+static void EncodeChunk(int table, const double* values, size_t stride, size_t rows,
+                        std::vector<uint8_t>* out, ArchiveIndexEntry* entry)
+{
+    const ArchiveSchema& schema = SCHEMAS[table];
+    size_t start = out->size();
+    size_t offsets = start + sizeof(ArchiveChunkHeader);
+    out->resize(offsets + schema.columns*sizeof(uint32_t) + schema.columns*rows*ARCHIVE_MAX_VALUE);
+
+    ArchiveChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ARCHIVE_CHUNK_MAGIC;
+    header.table = table;
+    header.columns = schema.columns;
+    header.rows = rows;
+    header.first_ms = header.last_ms = static_cast<int64_t>(values[0]);
+    for(size_t i = 1; i < rows; ++i)
+    {
+        header.first_ms = std::min(header.first_ms, static_cast<int64_t>(values[i]));
+        header.last_ms = std::max(header.last_ms, static_cast<int64_t>(values[i]));
+    }
+    if(schema.satellites)
+    {
+        int status = StatusColumn(schema);
+        for(size_t i = 0; i < rows; ++i)
+        {
+            int system = status < 0 ? SYSTEM_GPS : SatelliteSystem(static_cast<uint32_t>(values[status*stride + i]));
+            SetSatellite(header.satellite_mask, system, static_cast<int>(values[stride + i]));
+        }
+    }
+
+    uint8_t* data = &(*out)[offsets + schema.columns*sizeof(uint32_t)];
+    uint8_t* p = data;
+    for(int c = 0; c < schema.columns; ++c)
+    {
+        p = EncodeColumn(schema.column[c].type, values + c*stride, rows, p);
+        uint32_t end = p - data;
+        memcpy(&(*out)[offsets + c*sizeof(uint32_t)], &end, sizeof(end));
+    }
+    header.size = p - &(*out)[start];
+    header.crc = CalculateBlockCRC32(header.size - sizeof(header), &(*out)[offsets]);
+    memcpy(&(*out)[start], &header, sizeof(header));
+    out->resize(start + header.size);
+
+    entry->offset = start;
+    entry->table = table;
+    entry->rows = rows;
+    entry->first_ms = header.first_ms;
+    entry->last_ms = header.last_ms;
+    memcpy(entry->satellite_mask, header.satellite_mask, sizeof(entry->satellite_mask));
+}
+
+int ArchiveFormatValue(int table, int column, double value, char* text, size_t size)
+{
+    if(column == 0)
+    {
+        int64_t ms = static_cast<int64_t>(value);
+        return snprintf(text, size, "%d:%.3f", static_cast<int>(ms/604800000LL), (ms % 604800000LL)/1000.0);
+    }
+    if(SCHEMAS[table].column[column].type == ARCHIVE_INT)
+        return snprintf(text, size, "%.0f", value);
+    if(SCHEMAS[table].column[column].type == ARCHIVE_FLOAT)
+        return snprintf(text, size, "%.7g", value);
+    return snprintf(text, size, "%.17g", value);
+}
+
+/*************************** ArchiveEncoder ***************************/
+
+ArchiveEncoder::ArchiveEncoder(int chunk_rows) :
+    chunk_rows_(std::max(chunk_rows, 1)),
+    rows_(0)
+{
+    for(int t = 0; t < ARCHIVE_TABLES; ++t)
+    {
+        filling_[t].resize(SCHEMAS[t].columns*chunk_rows_);
+        filled_[t] = 0;
+    }
+}
+
+bool ArchiveEncoder::append(int table, const double* values)
+{
+    double* column = filling_[table].data() + filled_[table];
+    for(int c = 0; c < SCHEMAS[table].columns; ++c)
+        column[c*chunk_rows_] = values[c];
+    rows_++;
+
+    if(++filled_[table] == chunk_rows_)
+    {
+        index_.push_back(ArchiveIndexEntry());
+        EncodeChunk(table, filling_[table].data(), chunk_rows_, chunk_rows_, &data_, &index_.back());
+        filled_[table] = 0;
+    }
+    return true;
+}
+
+void ArchiveEncoder::flush()
+{
+    for(int t = 0; t < ARCHIVE_TABLES; ++t)
+        if(filled_[t] > 0)
+        {
+            index_.push_back(ArchiveIndexEntry());
+            EncodeChunk(t, filling_[t].data(), chunk_rows_, filled_[t], &data_, &index_.back());
+            filled_[t] = 0;
+        }
+}
+
+/*************************** ArchiveWriter ***************************/
+
+ArchiveWriter::ArchiveWriter(const std::string& path, int chunk_rows) :
+    chunk_rows_(std::max(chunk_rows, 1)),
+    failed_(false),
+    rows_(0),
+    bytes_(0),
+    dropped_(0),
+    ring_(ARCHIVE_QUEUE_CHUNKS),
+    head_(0),
+    tail_(0),
+    running_(true)
+{
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd_ < 0)
+        throw std::runtime_error("could not create archive " + path + ": " + strerror(errno));
+
+    // Every buffer fits the widest table, they change hands when queued
+    int widest = 0;
+    for(int t = 0; t < ARCHIVE_TABLES; ++t)
+        widest = std::max(widest, SCHEMAS[t].columns);
+    for(int t = 0; t < ARCHIVE_TABLES; ++t)
+    {
+        filling_[t].table = t;
+        filling_[t].rows = 0;
+        filling_[t].values.resize(widest*chunk_rows_);
+    }
+    for(size_t i = 0; i < ring_.size(); ++i)
+        ring_[i].values.resize(widest*chunk_rows_);
+
+    ArchiveFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    header.version = ARCHIVE_VERSION;
+    write(&header, sizeof(header));
+
+    thread_ = std::thread(&ArchiveWriter::run, this);
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    close();
+}
+
+bool ArchiveWriter::append(int table, const double* values)
+{
+    if(failed_)
+        return false;
+
+    Chunk& chunk = filling_[table];
+    double* column = chunk.values.data() + chunk.rows;
+    for(int c = 0; c < SCHEMAS[table].columns; ++c)
+        column[c*chunk_rows_] = values[c];
+    rows_++;
+
+    if(++chunk.rows == chunk_rows_)
+        queue(&chunk, false);
+    return !failed_;
+}
+
+// Swaps chunk into the ring (it gets back a written buffer); with the ring
+// full it waits if asked to, else drops the rows
+bool ArchiveWriter::queue(Chunk* chunk, bool wait)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(wait && head_ - tail_ >= ring_.size() && !failed_)
+            cv_.wait(lock);
+        if(head_ - tail_ >= ring_.size())
+        {
+            dropped_ += chunk->rows;
+            chunk->rows = 0;
+            return false;
+        }
+
+        Chunk& slot = ring_[head_ % ring_.size()];
+        slot.table = chunk->table;
+        slot.rows = chunk->rows;
+        slot.values.swap(chunk->values);
+        chunk->rows = 0;
+        head_++;
+    }
+    cv_.notify_all();
+    return true;
+}
+
+void ArchiveWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(true)
+    {
+        if(head_ == tail_)
+        {
+            if(!running_)
+                break;
+            cv_.wait(lock);
+            continue;
+        }
+
+        // The slot is ours until tail_ moves past it
+        const Chunk& chunk = ring_[tail_ % ring_.size()];
+        lock.unlock();
+        if(!failed_)
+            writeChunk(chunk);
+        lock.lock();
+        tail_++;
+        cv_.notify_all();
+    }
+}
+
+bool ArchiveWriter::writeChunk(const Chunk& chunk)
+{
+    ArchiveIndexEntry entry;
+    encoded_.clear();
+    EncodeChunk(chunk.table, chunk.values.data(), chunk_rows_, chunk.rows, &encoded_, &entry);
+    entry.offset = bytes_;
+    if(!write(encoded_.data(), encoded_.size()))
+        return false;
+    index_.push_back(entry);
+    return true;
+}
+
+bool ArchiveWriter::appendEncoded(const ArchiveEncoder& encoder)
+{
+    // No other producer, so with the ring empty the writer thread is idle
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(head_ != tail_)
+        cv_.wait(lock);
+
+    uint64_t base = bytes_;
+    if(failed_ || !write(encoder.data().data(), encoder.data().size()))
+        return false;
+    for(size_t i = 0; i < encoder.index().size(); ++i)
+    {
+        index_.push_back(encoder.index()[i]);
+        index_.back().offset += base;
+    }
+    rows_ += encoder.rows();
+    return true;
+}
+
+bool ArchiveWriter::write(const void* data, size_t size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t done = 0;
+    while(!failed_ && done < size)
+    {
+        ssize_t n = ::write(fd_, p + done, size - done);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            failed_ = true;
+        else
+            done += n;
+    }
+    bytes_ += done;
+    return !failed_;
+}
+
+void ArchiveWriter::close()
+{
+    if(fd_ < 0)
+        return;
+
+    for(int t = 0; t < ARCHIVE_TABLES; ++t)
+        if(filling_[t].rows > 0)
+            queue(&filling_[t], true);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+    // Without the trailer readers fall back to scanning the chunks
+    ArchiveTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.index_offset = bytes_;
+    trailer.entries = index_.size();
+    memcpy(trailer.magic, ARCHIVE_INDEX_MAGIC, sizeof(ARCHIVE_INDEX_MAGIC));
+    if(!index_.empty())
+        write(index_.data(), index_.size()*sizeof(ArchiveIndexEntry));
+    write(&trailer, sizeof(trailer));
+
+    ::close(fd_);
+    fd_ = -1;
+}
+
+/*************************** ArchiveReader ***************************/
+
+ArchiveReader::ArchiveReader(const std::string& path) :
+    map_(NULL),
+    size_(0),
+    recovered_(false)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("could not open archive " + path + ": " + strerror(errno));
+
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(ArchiveFileHeader)))
+    {
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED)
+        {
+            map_ = static_cast<const uint8_t*>(map);
+            size_ = st.st_size;
+        }
+    }
+    ::close(fd);
+
+    ArchiveFileHeader header;
+    if(map_)
+        memcpy(&header, map_, sizeof(header));
+    if(!map_ || memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || header.version != ARCHIVE_VERSION)
+    {
+        if(map_)
+            munmap(const_cast<uint8_t*>(map_), size_);
+        throw std::runtime_error(path + " is not a version " + std::to_string(ARCHIVE_VERSION) + " log archive");
+    }
+
+    if(!loadIndex())
+    {
+        scan();
+        recovered_ = true;
+    }
+}
+
+ArchiveReader::~ArchiveReader()
+{
+    munmap(const_cast<uint8_t*>(map_), size_);
+}
+
+bool ArchiveReader::loadIndex()
+{
+    if(size_ < sizeof(ArchiveFileHeader) + sizeof(ArchiveTrailer))
+        return false;
+
+    ArchiveTrailer trailer;
+    memcpy(&trailer, map_ + size_ - sizeof(trailer), sizeof(trailer));
+    if(memcmp(trailer.magic, ARCHIVE_INDEX_MAGIC, sizeof(ARCHIVE_INDEX_MAGIC)) != 0 ||
+       trailer.index_offset + trailer.entries*sizeof(ArchiveIndexEntry) + sizeof(trailer) != size_)
+        return false;
+
+    index_.resize(trailer.entries);
+    if(!index_.empty())
+        memcpy(&index_[0], map_ + trailer.index_offset, index_.size()*sizeof(ArchiveIndexEntry));
+    for(size_t i = 0; i < index_.size(); ++i)
+        if(index_[i].table >= ARCHIVE_TABLES || index_[i].offset + sizeof(ArchiveChunkHeader) > trailer.index_offset)
+        {
+            index_.clear();
+            return false;
+        }
+    return true;
+}
+
+// Walks the chunks from the start up to the first one cut short or corrupt
+void ArchiveReader::scan()
+{
+    size_t pos = sizeof(ArchiveFileHeader);
+    while(pos + sizeof(ArchiveChunkHeader) <= size_)
+    {
+        ArchiveChunkHeader header;
+        memcpy(&header, map_ + pos, sizeof(header));
+        if(header.magic != ARCHIVE_CHUNK_MAGIC || header.table >= ARCHIVE_TABLES ||
+           header.columns != SCHEMAS[header.table].columns ||
+           header.size < sizeof(header) + header.columns*sizeof(uint32_t) || pos + header.size > size_ ||
+           CalculateBlockCRC32(header.size - sizeof(header), map_ + pos + sizeof(header)) != header.crc)
+            break;
+
+        ArchiveIndexEntry entry;
+        entry.offset = pos;
+        entry.table = header.table;
+        entry.rows = header.rows;
+        entry.first_ms = header.first_ms;
+        entry.last_ms = header.last_ms;
+        memcpy(entry.satellite_mask, header.satellite_mask, sizeof(entry.satellite_mask));
+        index_.push_back(entry);
+        pos += header.size;
+    }
+}
+
+/* --------------------------------------------------------------------------
+Chunks outside the time range, or whose satellite mask has none of the
+satellites asked for, are skipped from the index alone. Of the others only
+the time column (unless the chunk is wholly inside the range), the PRN and
+status columns (when filtering on them) and the projected columns are
+decoded.
+-------------------------------------------------------------------------- */
+size_t ArchiveReader::query(const ArchiveQuery& query, ArchiveResult* result) const
+{
+    const ArchiveSchema& schema = SCHEMAS[query.table];
+    bool by_prn = schema.satellites && query.prn >= 0;
+    bool by_system = schema.satellites && query.system >= 0;
+    int status_column = StatusColumn(schema);
+    uint64_t wanted[ARCHIVE_SATELLITE_WORDS];
+    QueryMask(query, wanted);
+    // Without a status column every row is GPS
+    bool by_status = by_system && status_column >= 0;
+    result->columns.resize(query.columns.size());
+    if(by_system && status_column < 0 && query.system != SYSTEM_GPS)
+        return 0;
+
+    std::vector<double> time, prn, status, values;
+    std::vector<uint32_t> selected;
+    size_t added = 0;
+    for(size_t e = 0; e < index_.size(); ++e)
+    {
+        const ArchiveIndexEntry& entry = index_[e];
+        if(static_cast<int>(entry.table) != query.table)
+            continue;
+        if(entry.last_ms < query.first_ms || entry.first_ms > query.last_ms ||
+           ((by_prn || by_system) && !MaskIntersects(entry.satellite_mask, wanted)))
+        {
+            result->chunks_skipped++;
+            continue;
+        }
+
+        ArchiveChunkHeader header;
+        memcpy(&header, map_ + entry.offset, sizeof(header));
+        if(header.magic != ARCHIVE_CHUNK_MAGIC || header.columns != schema.columns ||
+           entry.offset + header.size > size_)
+            continue;
+        uint32_t ends[ARCHIVE_MAX_COLUMNS];
+        memcpy(ends, map_ + entry.offset + sizeof(header), schema.columns*sizeof(uint32_t));
+        const uint8_t* data = map_ + entry.offset + sizeof(header) + schema.columns*sizeof(uint32_t);
+        const uint8_t* chunk_end = map_ + entry.offset + header.size;
+        result->chunks_read++;
+
+        size_t rows = header.rows;
+        bool inside = entry.first_ms >= query.first_ms && entry.last_ms <= query.last_ms;
+        if(!inside && !DecodeChunkColumn(schema.column[0].type, 0, data, ends, chunk_end, rows, &time))
+            continue;
+        if(by_prn && !DecodeChunkColumn(schema.column[1].type, 1, data, ends, chunk_end, rows, &prn))
+            continue;
+        if(by_status && !DecodeChunkColumn(schema.column[status_column].type, status_column, data, ends, chunk_end,
+                                           rows, &status))
+            continue;
+
+        selected.clear();
+        for(size_t i = 0; i < rows; ++i)
+            if((inside || (time[i] >= query.first_ms && time[i] <= query.last_ms)) &&
+               (!by_prn || static_cast<int>(prn[i]) == query.prn) &&
+               (!by_status || SatelliteSystem(static_cast<uint32_t>(status[i])) == query.system))
+                selected.push_back(i);
+        if(selected.empty())
+            continue;
+
+        bool malformed = false;
+        for(size_t k = 0; k < query.columns.size() && !malformed; ++k)
+        {
+            int c = query.columns[k];
+            malformed = !DecodeChunkColumn(schema.column[c].type, c, data, ends, chunk_end, rows, &values);
+            std::vector<double>& out = result->columns[k];
+            for(size_t i = 0; i < selected.size() && !malformed; ++i)
+                out.push_back(values[selected[i]]);
+        }
+        if(malformed)
+        {
+            // Keep the projected columns the same length
+            for(size_t k = 0; k < query.columns.size(); ++k)
+                result->columns[k].resize(result->rows + added);
+            continue;
+        }
+        added += selected.size();
+    }
+    result->rows += added;
+    return added;
+}
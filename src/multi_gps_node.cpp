@@ -0,0 +1,533 @@
+// Several receivers in one process: one epoll thread reads every port
+// (non-blocking) and hands the bytes to a small worker pool that decodes and
+// publishes. Each receiver is bound to one worker, so its frames stay in order.
+// Worker queues are bounded; when a worker falls behind, new reads for it are
+// dropped (the parser resynchronizes on the next frame) and counted.
+
+// ROS
+#include <ros/ros.h>
+#include <sensor_msgs/NavSatFix.h>
+#include <sensor_msgs/Imu.h>
+#include <nav_msgs/Odometry.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <novatel_gps/GpsXYZ.h>
+#include <novatel_gps/SatelliteStateArray.h>
+
+#include <deque>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <mutex>
+#include <condition_variable>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "novatel_gps.h"
+
+#define MAX_EVENTS      16
+#define READ_CHUNK      4096
+#define QUEUE_DEPTH     256
+
+struct Receiver
+{
+    std::string name;
+    std::string port;
+    std::string frame_id;
+    int log_id;
+    double rate;
+    int worker;
+    std::atomic<bool> open;
+
+    GPS gps;
+    ros::Publisher cart_pub, fix_pub, sats_pub, odom_pub, imu_pub;
+    novatel_gps::GpsXYZ xyz;
+    sensor_msgs::NavSatFix fix;
+    novatel_gps::SatelliteStateArray satellites;
+    nav_msgs::Odometry odom;
+    sensor_msgs::Imu imu;
+
+    // Reads dropped on a full worker queue
+    std::atomic<uint64_t> dropped;
+
+    // Diagnostics
+    uint64_t last_frames;
+    uint64_t last_bytes;
+    uint32_t last_crc_errors;
+    uint64_t last_dropped;
+};
+
+struct Chunk
+{
+    Receiver* receiver;
+    int64_t stamp_ns;
+    std::vector<uint8_t> data;
+};
+
+// Fixed set of threads, each with its own queue of at most depth chunks.
+// Chunk buffers are recycled, so steady-state posting does not allocate.
+class WorkerPool
+{
+public:
+    typedef std::function<void(Chunk&)> Handler;
+
+    void start(int workers, size_t depth, Handler handler)
+    {
+        handler_ = handler;
+        depth_ = depth;
+        running_ = true;
+        queues_.resize(workers);
+        for(int i = 0; i < workers; ++i)
+            threads_.push_back(std::thread(&WorkerPool::run, this, i));
+    }
+
+    void stop()
+    {
+        running_ = false;
+        for(size_t i = 0; i < queues_.size(); ++i)
+            queues_[i].cv.notify_all();
+        for(size_t i = 0; i < threads_.size(); ++i)
+            threads_[i].join();
+        threads_.clear();
+    }
+
+    // Copies size bytes to worker's queue; false if the queue is full
+    bool post(int worker, Receiver* receiver, int64_t stamp_ns, const uint8_t* data, size_t size)
+    {
+        Queue& q = queues_[worker];
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if(q.chunks.size() >= depth_)
+                return false;
+
+            q.chunks.push_back(Chunk());
+            Chunk& chunk = q.chunks.back();
+            chunk.receiver = receiver;
+            chunk.stamp_ns = stamp_ns;
+            if(!q.free.empty())
+            {
+                chunk.data.swap(q.free.back());
+                q.free.pop_back();
+            }
+            chunk.data.assign(data, data + size);
+        }
+        q.cv.notify_one();
+        return true;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<Chunk> chunks;
+        std::vector<std::vector<uint8_t> > free;
+    };
+
+    void run(int worker)
+    {
+        Queue& q = queues_[worker];
+        Chunk chunk;
+        while(true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(q.mutex);
+                // Hand the previous buffer back for the next post()
+                if(chunk.data.capacity() > 0)
+                {
+                    q.free.push_back(std::vector<uint8_t>());
+                    q.free.back().swap(chunk.data);
+                }
+                while(q.chunks.empty() && running_)
+                    q.cv.wait(lock);
+                if(q.chunks.empty())
+                    return;
+                chunk.receiver = q.chunks.front().receiver;
+                chunk.stamp_ns = q.chunks.front().stamp_ns;
+                chunk.data.swap(q.chunks.front().data);
+                q.chunks.pop_front();
+            }
+            handler_(chunk);
+        }
+    }
+
+    Handler handler_;
+    size_t depth_;
+    std::atomic<bool> running_;
+    std::deque<Queue> queues_;
+    std::vector<std::thread> threads_;
+};
+
+class MultiGpsNode
+{
+private:
+    ros::NodeHandle node_handle_;
+    ros::NodeHandle private_node_handle_;
+    ros::Publisher diagnostics_pub_;
+    ros::Timer diagnostics_timer_;
+
+    std::vector<std::unique_ptr<Receiver> > receivers_;
+    WorkerPool workers_;
+    std::thread io_thread_;
+    std::atomic<bool> running_;
+    int epoll_fd_;
+    int workers_count_;
+    int queue_depth_;
+    double diagnostics_period_;
+
+public:
+    MultiGpsNode(ros::NodeHandle n) : node_handle_(n), private_node_handle_("~"), running_(false), epoll_fd_(-1)
+    {
+        private_node_handle_.param("workers", workers_count_, 2);
+        private_node_handle_.param("queue_depth", queue_depth_, QUEUE_DEPTH);
+        private_node_handle_.param("diagnostics_period", diagnostics_period_, 1.0);
+        if(workers_count_ < 1)
+            workers_count_ = 1;
+        if(queue_depth_ < 1)
+            queue_depth_ = 1;
+
+        XmlRpc::XmlRpcValue receivers;
+        if(!private_node_handle_.getParam("receivers", receivers) || receivers.getType() != XmlRpc::XmlRpcValue::TypeArray)
+        {
+            ROS_ERROR("parameter receivers must be a list of {name, port, ...}");
+            return;
+        }
+
+        for(int i = 0; i < receivers.size(); ++i)
+            addReceiver(receivers[i], i);
+
+        diagnostics_pub_ = node_handle_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+    }
+
+    ~MultiGpsNode()
+    {
+        stop();
+    }
+
+    void addReceiver(XmlRpc::XmlRpcValue& entry, int index)
+    {
+        if(entry.getType() != XmlRpc::XmlRpcValue::TypeStruct || !entry.hasMember("name") || !entry.hasMember("port"))
+        {
+            ROS_ERROR("receivers[%d] needs a name and a port, skipping", index);
+            return;
+        }
+
+        std::unique_ptr<Receiver> r(new Receiver());
+        r->worker = index % workers_count_;
+        r->open = false;
+        r->dropped = 0;
+        r->last_frames = r->last_bytes = r->last_crc_errors = r->last_dropped = 0;
+
+        // A mistyped value or a capture/segment that cannot be created only
+        // loses this receiver
+        try
+        {
+            r->name = static_cast<std::string>(entry["name"]);
+            r->port = static_cast<std::string>(entry["port"]);
+            r->frame_id = entry.hasMember("frame_id") ? static_cast<std::string>(entry["frame_id"]) : r->name + "_frame";
+            r->log_id = entry.hasMember("log") ? static_cast<int>(entry["log"]) : r->gps.BESTXYZ;
+            r->rate = entry.hasMember("rate") ? ToDouble(entry["rate"]) : 20.0;
+
+            if(entry.hasMember("baud"))
+                r->gps.setBaudRate(static_cast<int>(entry["baud"]));
+            if(entry.hasMember("logs"))
+            {
+                std::vector<LogRequest> requests;
+                if(ParseLogRequests(entry["logs"], &requests))
+                    r->gps.setLogRequests(requests);
+            }
+            if(entry.hasMember("record"))
+                r->gps.startRecording(static_cast<std::string>(entry["record"]));
+            if(entry.hasMember("shm"))
+                r->gps.publishSharedMemory(static_cast<std::string>(entry["shm"]),
+                                           entry.hasMember("shm_capacity") ? static_cast<int>(entry["shm_capacity"]) : 256);
+        }
+        catch(XmlRpc::XmlRpcException& e)
+        {
+            ROS_ERROR("receivers[%d]: %s, skipping", index, e.getMessage().c_str());
+            return;
+        }
+        catch(const std::exception& e)
+        {
+            ROS_ERROR("receivers[%d]: %s, skipping", index, e.what());
+            return;
+        }
+
+        // Every receiver publishes under its own namespace, e.g. gps/rover/cart
+        ros::NodeHandle nh(node_handle_, "gps/" + r->name);
+        r->cart_pub = nh.advertise<novatel_gps::GpsXYZ>("cart", 10);
+        r->fix_pub = nh.advertise<sensor_msgs::NavSatFix>("fix", 10);
+        r->sats_pub = nh.advertise<novatel_gps::SatelliteStateArray>("satellites", 10);
+        r->odom_pub = nh.advertise<nav_msgs::Odometry>("odom", 10);
+        r->imu_pub = nh.advertise<sensor_msgs::Imu>("imu", 10);
+        r->xyz.header.frame_id = r->frame_id;
+        r->fix.header.frame_id = r->frame_id;
+        r->fix.status.service = sensor_msgs::NavSatStatus::SERVICE_GPS;
+        r->satellites.header.frame_id = r->frame_id;
+        r->odom.header.frame_id = "enu";
+        r->odom.child_frame_id = r->frame_id;
+        r->imu.header.frame_id = r->frame_id;
+
+        receivers_.push_back(std::move(r));
+    }
+
+    bool start()
+    {
+        // Receivers need ~11 s to come up, initialize them side by side
+        std::vector<std::thread> init;
+        for(size_t i = 0; i < receivers_.size(); ++i)
+        {
+            Receiver* r = receivers_[i].get();
+            init.push_back(std::thread([r]()
+            {
+                try
+                {
+                    r->gps.init(r->log_id, r->port, r->rate);
+                    r->open = true;
+                    ROS_INFO("%s: initialized on %s", r->name.c_str(), r->port.c_str());
+                }
+                catch(const std::exception& e)
+                {
+                    ROS_ERROR("%s: could not start on %s: %s", r->name.c_str(), r->port.c_str(), e.what());
+                }
+            }));
+        }
+        for(size_t i = 0; i < init.size(); ++i)
+            init[i].join();
+
+        epoll_fd_ = epoll_create1(0);
+        if(epoll_fd_ < 0)
+        {
+            ROS_ERROR("epoll_create1 failed: %s", strerror(errno));
+            return false;
+        }
+
+        for(size_t i = 0; i < receivers_.size(); ++i)
+        {
+            Receiver* r = receivers_[i].get();
+            if(!r->open)
+                continue;
+
+            int flags = fcntl(r->gps.fd(), F_GETFL);
+            fcntl(r->gps.fd(), F_SETFL, flags | O_NONBLOCK);
+
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.ptr = r;
+            if(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, r->gps.fd(), &ev) != 0)
+            {
+                ROS_ERROR("%s: epoll_ctl failed: %s", r->name.c_str(), strerror(errno));
+                r->open = false;
+            }
+        }
+
+        workers_.start(workers_count_, queue_depth_, std::bind(&MultiGpsNode::decode, this, std::placeholders::_1));
+        running_ = true;
+        io_thread_ = std::thread(&MultiGpsNode::ioLoop, this);
+        diagnostics_timer_ = node_handle_.createTimer(ros::Duration(diagnostics_period_), &MultiGpsNode::publishDiagnostics, this);
+        return true;
+    }
+
+    void stop()
+    {
+        if(running_)
+        {
+            running_ = false;
+            io_thread_.join();
+            workers_.stop();
+        }
+        if(epoll_fd_ >= 0)
+            ::close(epoll_fd_);
+        epoll_fd_ = -1;
+
+        // Also the receivers ioLoop() stopped reading after a port error,
+        // their port is still open; close() skips ports never opened
+        for(size_t i = 0; i < receivers_.size(); ++i)
+        {
+            receivers_[i]->open = false;
+            try
+            {
+                receivers_[i]->gps.close();
+            }
+            catch(const std::exception& e)
+            {
+                ROS_WARN("%s: could not close: %s", receivers_[i]->name.c_str(), e.what());
+            }
+        }
+    }
+
+    void spin()
+    {
+        if(receivers_.empty() || !start())
+            return;
+        ros::spin();
+        stop();
+    }
+
+private:
+    void ioLoop()
+    {
+        struct epoll_event events[MAX_EVENTS];
+        std::vector<uint8_t> buffer(READ_CHUNK);
+
+        while(running_)
+        {
+            int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, 100);
+            if(n < 0 && errno != EINTR)
+            {
+                ROS_ERROR("epoll_wait failed: %s", strerror(errno));
+                break;
+            }
+
+            for(int i = 0; i < n; ++i)
+            {
+                Receiver* r = static_cast<Receiver*>(events[i].data.ptr);
+
+                // Drain the port so one wake-up takes everything available
+                while(true)
+                {
+                    ssize_t k = ::read(r->gps.fd(), buffer.data(), buffer.size());
+                    if(k > 0)
+                    {
+                        if(!workers_.post(r->worker, r, CaptureClockNs(), buffer.data(), k))
+                        {
+                            r->dropped++;
+                            ROS_WARN_THROTTLE(1.0, "%s: decode queue full, dropping data", r->name.c_str());
+                        }
+                        continue;
+                    }
+                    if(k < 0 && (errno == EAGAIN || errno == EINTR))
+                        break;
+
+                    ROS_ERROR("%s: port closed (%s)", r->name.c_str(), k < 0 ? strerror(errno) : "end of file");
+                    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, r->gps.fd(), NULL);
+                    r->open = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    void decode(Chunk& chunk)
+    {
+        Receiver* r = chunk.receiver;
+        r->gps.receive(chunk.data.data(), chunk.data.size(), chunk.stamp_ns,
+                       std::bind(&MultiGpsNode::publishFrame, this, r, std::placeholders::_1));
+    }
+
+    void publishFrame(Receiver* r, uint16_t msg_id)
+    {
+        ros::Time stamp = ros::Time::now();
+        GPS& gps = r->gps;
+
+        if(msg_id == gps.BESTXYZ)
+        {
+            gps.getData(&r->xyz);
+            r->xyz.header.stamp = stamp;
+            r->cart_pub.publish(r->xyz);
+        }
+        else if(msg_id == gps.BESTPOS)
+        {
+            gps.getData(&r->fix);
+            r->fix.header.stamp = stamp;
+            r->fix_pub.publish(r->fix);
+        }
+        else if(msg_id == gps.RANGE || msg_id == gps.RANGECMP)
+        {
+            gps.getData(&r->satellites);
+            r->satellites.header.stamp = stamp;
+            r->sats_pub.publish(r->satellites);
+        }
+        else if(msg_id == gps.INSPVA || msg_id == gps.INSPVAS)
+        {
+            gps.getData(&r->odom);
+            r->odom.header.stamp = stamp;
+            r->odom_pub.publish(r->odom);
+        }
+        else if(msg_id == gps.CORRIMUDATA || msg_id == gps.CORRIMUDATAS)
+        {
+            gps.getData(&r->imu);
+            r->imu.header.stamp = stamp;
+            r->imu_pub.publish(r->imu);
+        }
+    }
+
+    static diagnostic_msgs::KeyValue Value(const std::string& key, double value)
+    {
+        diagnostic_msgs::KeyValue kv;
+        std::ostringstream s;
+        s << value;
+        kv.key = key;
+        kv.value = s.str();
+        return kv;
+    }
+
+    void publishDiagnostics(const ros::TimerEvent&)
+    {
+        diagnostic_msgs::DiagnosticArray array;
+        array.header.stamp = ros::Time::now();
+
+        for(size_t i = 0; i < receivers_.size(); ++i)
+        {
+            Receiver& r = *receivers_[i];
+            uint64_t frames = r.gps.frameCount();
+            uint64_t bytes = r.gps.byteCount();
+            uint32_t crc_errors = r.gps.crcErrors();
+            uint64_t dropped = r.dropped;
+
+            diagnostic_msgs::DiagnosticStatus status;
+            status.name = "novatel_gps: " + r.name;
+            status.hardware_id = r.port;
+            if(!r.open)
+            {
+                status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+                status.message = "port closed";
+            }
+            else if(frames == r.last_frames)
+            {
+                status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+                status.message = "no frames";
+            }
+            else if(dropped != r.last_dropped)
+            {
+                status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+                status.message = "decode queue overflow";
+            }
+            else if(crc_errors != r.last_crc_errors)
+            {
+                status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+                status.message = "CRC errors";
+            }
+            else
+            {
+                status.level = diagnostic_msgs::DiagnosticStatus::OK;
+                status.message = "receiving";
+            }
+
+            status.values.push_back(Value("frames", frames));
+            status.values.push_back(Value("bytes", bytes));
+            status.values.push_back(Value("crc_errors", crc_errors));
+            status.values.push_back(Value("dropped_reads", dropped));
+            status.values.push_back(Value("frame_rate", (frames - r.last_frames)/diagnostics_period_));
+            status.values.push_back(Value("byte_rate", (bytes - r.last_bytes)/diagnostics_period_));
+            array.status.push_back(status);
+
+            r.last_frames = frames;
+            r.last_bytes = bytes;
+            r.last_crc_errors = crc_errors;
+            r.last_dropped = dropped;
+        }
+        diagnostics_pub_.publish(array);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    ros::init(argc, argv, "novatel_multi_gps");
+    ros::NodeHandle n;
+
+    MultiGpsNode node(n);
+    node.spin();
+
+    return 0;
+}
@@ -1,64 +1,115 @@
 #include "novatel_gps.h"
+#include "geodesy.h"
+#include "crc32.h"
+#include "novatel_gps/SolStat.h"
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include <climits>
+#include <limits>
+#include <cstdlib>
+#include <fstream>
+
+/*************************** RANGECMP helpers (Firmware Reference Manual, RANGECMP log) ***************************/
+
+#define ADR_ROLLOVER        8388608.0
+
+// RANGECMP pseudorange standard deviation codes (m)
+static const float RANGECMP_PSR_STD[16] = {
+    0.050, 0.075, 0.113, 0.169, 0.253, 0.380, 0.570, 0.854,
+    1.281, 2.375, 4.750, 9.500, 19.000, 38.000, 76.000, 152.000
+};
 
-/*************************** CRC functions (Firmware Reference Manual, p.32 + APN-030 Rev 1 Application Note) ***************************/
-
-inline uint32_t ByteSwap (uint32_t n)
-{ 
-   return ( ((n & 0x000000FF)<<24) + ((n & 0x0000FF00)<<8) + ((n & 0x00FF0000)>>8) + (( n & 0xFF000000)>>24) );
+/* --------------------------------------------------------------------------
+Extracts a len bit field starting at bit start from a record loaded as
+little-endian 64 bit words. Fields may straddle two words.
+-------------------------------------------------------------------------- */
+inline uint64_t ExtractBits(const uint64_t* words, int start, int len)
+{
+    int w = start >> 6;
+    int s = start & 63;
+    uint64_t v = words[w] >> s;
+    if(s + len > 64)
+        v |= words[w + 1] << (64 - s);
+    return v & ((1ULL << len) - 1);
 }
 
-#define CRC32_POLYNOMIAL    0xEDB88320L
-#define MAX_SYNC_FAIL       25
+inline int64_t SignExtend(uint64_t v, int len)
+{
+    uint64_t m = 1ULL << (len - 1);
+    return static_cast<int64_t>((v ^ m) - m);
+}
 
 /* --------------------------------------------------------------------------
-Calculate a CRC value to be used by CRC calculation functions.
+Unpacks the channel tracking status word (shared by RANGE, RANGECMP and TRACKSTAT)
 -------------------------------------------------------------------------- */
-inline uint32_t CRC32Value(int i)
+void DecodeTrackingStatus(uint32_t status, novatel_gps::TrackingStatus& ts)
 {
-    int j;
-    uint32_t ulCRC;
-    ulCRC = i;
+    ts.trck_state          = (status & 0x0000001F);
+    ts.channel_number      = (status & 0x000003E0) >> 5;
+    ts.phase_lock          = (status & 0x00000400) >> 10;
+    ts.parity_known        = (status & 0x00000800) >> 11;
+    ts.code_lock           = (status & 0x00001000) >> 12;
+    ts.correlator_type     = (status & 0x0000E000) >> 13;
+    ts.satellite_system    = (status & 0x00070000) >> 16;
+    ts.grouping            = (status & 0x00100000) >> 20;
+    ts.singal_type         = (status & 0x03E00000) >> 21;
+    ts.fec                 = (status & 0x04000000) >> 26;
+    ts.primary_l1          = (status & 0x08000000) >> 27;
+    ts.half_cycle_added    = (status & 0x10000000) >> 28;
+    ts.prn_lock            = (status & 0x40000000) >> 30;
+    ts.channel_assignment  = (status & 0x80000000) >> 31;
+}
 
-    for ( j = 8 ; j > 0; j-- )
-    {
-        if ( ulCRC & 1 )
-            ulCRC = ( ulCRC >> 1 ) ^ CRC32_POLYNOMIAL;
-        else
-            ulCRC >>= 1;
-    }
-    return ulCRC;
+double ToDouble(XmlRpc::XmlRpcValue& value)
+{
+    if(value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+        return static_cast<int>(value);
+    return static_cast<double>(value);
 }
 
-/* --------------------------------------------------------------------------
-Calculates the CRC-32 of a block of data all at once
--------------------------------------------------------------------------- */
-inline uint32_t CalculateBlockCRC32
-(
-    uint32_t ulCount,  /* Number of bytes in the data block */
-    uint8_t *ucBuffer /* Data block */
-)
+bool ParseLogRequests(XmlRpc::XmlRpcValue& logs, std::vector<LogRequest>* requests)
 {
-    uint32_t ulTemp1;
-    uint32_t ulTemp2;
-    uint32_t ulCRC = 0;
+    if(logs.getType() != XmlRpc::XmlRpcValue::TypeArray)
+    {
+        ROS_ERROR("parameter logs must be a list, using defaults");
+        return false;
+    }
 
-    while ( ulCount-- != 0 )
+    requests->clear();
+    for(int i = 0; i < logs.size(); ++i)
     {
-        ulTemp1 = ( ulCRC >> 8 ) & 0x00FFFFFFL;
-        ulTemp2 = CRC32Value( ((int) ((ulCRC) ^ (*ucBuffer)) ) & 0xff );
-        ucBuffer++;
-        ulCRC = ulTemp1 ^ ulTemp2;
+        XmlRpc::XmlRpcValue& entry = logs[i];
+        if(entry.getType() != XmlRpc::XmlRpcValue::TypeStruct || !entry.hasMember("name"))
+        {
+            ROS_ERROR("logs[%d] has no name, skipping", i);
+            continue;
+        }
+
+        LogRequest request;
+        request.name = static_cast<std::string>(entry["name"]);
+        request.trigger = entry.hasMember("trigger") ? static_cast<std::string>(entry["trigger"]) : std::string("ONTIME");
+        request.period = entry.hasMember("period") ? ToDouble(entry["period"]) : 0.0;
+        request.offset = entry.hasMember("offset") ? ToDouble(entry["offset"]) : 0.0;
+        request.priority = entry.hasMember("priority") ? static_cast<int>(entry["priority"]) : 0;
+        requests->push_back(request);
     }
-    return( ulCRC );
+    return true;
 }
 
-
 // GPS Class methods
 
-GPS::GPS() : GPS_PACKET_SIZE(700),
+GPS::GPS() : GPS_PACKET_SIZE(4096),
     serial_port_("/dev/ttyUSB0"),
+    port_open_(false),
     gps_week_(0),
     gps_week_1024_(0),
     gps_secs_(0),
@@ -66,7 +117,9 @@ GPS::GPS() : GPS_PACKET_SIZE(700),
     D_SYNC0(0xAA),
     D_SYNC1(0x44),
     D_SYNC2(0x12),
+    D_SYNC2_SHORT(0x13),
     D_HDR_LEN(28),
+    D_SHORT_HDR_LEN(12),
 
     // Message Header, Firmware Reference Manual pg. 23
     D_HDR       (3),
@@ -82,91 +135,126 @@ GPS::GPS() : GPS_PACKET_SIZE(700),
     D_RCV_ST    (20),
     D_RCV_SW_V  (26),
 
+    // Short Message Header, Firmware Reference Manual pg. 24
+    D_SHORT_MSG_LEN (3),
+    D_SHORT_G_WEEK  (6),
+    D_SHORT_G_MS    (8),
+
+    // Log fields, offsets are relative to the start of the log body
     // BESTXYZ Log, Firmware Reference Manual pg. 264
-    BXYZ_PSTAT      (D_HDR_LEN),
-    BXYZ_PTYPE      (D_HDR_LEN + 4),
-    BXYZ_PX         (D_HDR_LEN + 8),
-    BXYZ_PY         (D_HDR_LEN + 16),
-    BXYZ_PZ         (D_HDR_LEN + 24),
-    BXYZ_sPX        (D_HDR_LEN + 32),
-    BXYZ_sPY        (D_HDR_LEN + 36),
-    BXYZ_sPZ        (D_HDR_LEN + 40),
-    BXYZ_VSTAT      (D_HDR_LEN + 44),
-    BXYZ_VTYPE      (D_HDR_LEN + 48),
-    BXYZ_VX         (D_HDR_LEN + 52),
-    BXYZ_VY         (D_HDR_LEN + 60),
-    BXYZ_VZ         (D_HDR_LEN + 68),
-    BXYZ_sVX        (D_HDR_LEN + 76),
-    BXYZ_sVY        (D_HDR_LEN + 80),
-    BXYZ_sVZ        (D_HDR_LEN + 84),
-    BXYZ_STNID      (D_HDR_LEN + 88),
-    BXYZ_VLATE      (D_HDR_LEN + 92),
-    BXYZ_DIFFAGE    (D_HDR_LEN + 96),
-    BXYZ_SOLAGE     (D_HDR_LEN + 100),
-    BXYZ_SV         (D_HDR_LEN + 104),
-    BXYZ_SOLSV      (D_HDR_LEN + 106),
+    BXYZ_PSTAT      (0),
+    BXYZ_PTYPE      (4),
+    BXYZ_PX         (8),
+    BXYZ_PY         (16),
+    BXYZ_PZ         (24),
+    BXYZ_sPX        (32),
+    BXYZ_sPY        (36),
+    BXYZ_sPZ        (40),
+    BXYZ_VSTAT      (44),
+    BXYZ_VTYPE      (48),
+    BXYZ_VX         (52),
+    BXYZ_VY         (60),
+    BXYZ_VZ         (68),
+    BXYZ_sVX        (76),
+    BXYZ_sVY        (80),
+    BXYZ_sVZ        (84),
+    BXYZ_STNID      (88),
+    BXYZ_VLATE      (92),
+    BXYZ_DIFFAGE    (96),
+    BXYZ_SOLAGE     (100),
+    BXYZ_SV         (104),
+    BXYZ_SOLSV      (105),
 
     // BESTPOS Log, Firmware Reference Manual pg. 256
-    BESTPOS_SOLSTAT     (D_HDR_LEN),
-    BESTPOS_POSTYPE     (D_HDR_LEN + 4),
-    BESTPOS_LAT         (D_HDR_LEN + 8),
-    BESTPOS_LONG        (D_HDR_LEN + 16),
-    BESTPOS_HGT         (D_HDR_LEN + 24),
-    BESTPOS_UND         (D_HDR_LEN + 32),
-    BESTPOS_DATUMID     (D_HDR_LEN + 36),
-    BESTPOS_SLAT        (D_HDR_LEN + 40),
-    BESTPOS_SLON        (D_HDR_LEN + 44),
-    BESTPOS_SHGT        (D_HDR_LEN + 48),
-    BESTPOS_STNID       (D_HDR_LEN + 52),
-    BESTPOS_DIFFAGE     (D_HDR_LEN + 56),
-    BESTPOS_SOLAGE      (D_HDR_LEN + 60),
-    BESTPOS_SV          (D_HDR_LEN + 64),
-    BESTPOS_SOLNSV      (D_HDR_LEN + 65),
-    BESTPOS_GGL1        (D_HDR_LEN + 66),
-    BESTPOS_GGL1L2      (D_HDR_LEN + 67),
-    BESTPOS_EXTSOLSTAT  (D_HDR_LEN + 69),
-    BESTPOS_SIGMASK     (D_HDR_LEN + 71),
+    BESTPOS_SOLSTAT     (0),
+    BESTPOS_POSTYPE     (4),
+    BESTPOS_LAT         (8),
+    BESTPOS_LONG        (16),
+    BESTPOS_HGT         (24),
+    BESTPOS_UND         (32),
+    BESTPOS_DATUMID     (36),
+    BESTPOS_SLAT        (40),
+    BESTPOS_SLON        (44),
+    BESTPOS_SHGT        (48),
+    BESTPOS_STNID       (52),
+    BESTPOS_DIFFAGE     (56),
+    BESTPOS_SOLAGE      (60),
+    BESTPOS_SV          (64),
+    BESTPOS_SOLNSV      (65),
+    BESTPOS_GGL1        (66),
+    BESTPOS_GGL1L2      (67),
+    BESTPOS_EXTSOLSTAT  (69),
+    BESTPOS_SIGMASK     (71),
 
     // SATXYZ Log, Firmware Reference Manual pg. 562
-    SATXYZ_NSAT         (D_HDR_LEN + 8),
-    SATXYZ_PRN          (D_HDR_LEN + 12),
-    SATXYZ_X            (D_HDR_LEN + 16),
-    SATXYZ_Y            (D_HDR_LEN + 24),
-    SATXYZ_Z            (D_HDR_LEN + 32),
-    SATXYZ_CLKCORR      (D_HDR_LEN + 40),
-    SATXYZ_IONCORR      (D_HDR_LEN + 48),
-    SATXYZ_TRPCORR      (D_HDR_LEN + 56),
+    SATXYZ_NSAT         (8),
+    SATXYZ_PRN          (12),
+    SATXYZ_X            (16),
+    SATXYZ_Y            (24),
+    SATXYZ_Z            (32),
+    SATXYZ_CLKCORR      (40),
+    SATXYZ_IONCORR      (48),
+    SATXYZ_TRPCORR      (56),
     SATXYZ_OFFSET       (68),
 
     // TRACKSTAT Log, Firmware Reference Manual pg. 568
-    TRACKSTAT_SOLSTAT   (D_HDR_LEN),
-    TRACKSTAT_POSTYPE   (D_HDR_LEN + 4),
-    TRACKSTAT_CUTOFF    (D_HDR_LEN + 8),
-    TRACKSTAT_CHAN      (D_HDR_LEN + 12),
-    TRACKSTAT_PRN       (D_HDR_LEN + 16),
-    TRACKSTAT_TRKSTAT   (D_HDR_LEN + 20),
-    TRACKSTAT_PSR       (D_HDR_LEN + 24),
-    TRACKSTAT_DOPPLER   (D_HDR_LEN + 32),
-    TRACKSTAT_CNo       (D_HDR_LEN + 36),
-    TRACKSTAT_LOCKTIME  (D_HDR_LEN + 40),
-    TRACKSTAT_PSRRES    (D_HDR_LEN + 44),
-    TRACKSTAT_REJECT    (D_HDR_LEN + 48),
-    TRACKSTAT_PSRW      (D_HDR_LEN + 52),
+    TRACKSTAT_SOLSTAT   (0),
+    TRACKSTAT_POSTYPE   (4),
+    TRACKSTAT_CUTOFF    (8),
+    TRACKSTAT_CHAN      (12),
+    TRACKSTAT_PRN       (16),
+    TRACKSTAT_TRKSTAT   (20),
+    TRACKSTAT_PSR       (24),
+    TRACKSTAT_DOPPLER   (32),
+    TRACKSTAT_CNo       (36),
+    TRACKSTAT_LOCKTIME  (40),
+    TRACKSTAT_PSRRES    (44),
+    TRACKSTAT_REJECT    (48),
+    TRACKSTAT_PSRW      (52),
     TRACKSTAT_OFFSET    (40),
 
     // RANGE Log, Firmware Reference Manual pg. 403
-    RANGE_OBS       (D_HDR_LEN),
-    RANGE_PRN       (D_HDR_LEN + 4),
-    RANGE_PSR       (D_HDR_LEN + 8),
-    RANGE_PSR_STD   (D_HDR_LEN + 16),
-    RANGE_ADR       (D_HDR_LEN + 20),
-    RANGE_ADR_STD   (D_HDR_LEN + 28),
-    RANGE_DOPPLER   (D_HDR_LEN + 32),
-    RANGE_CNo       (D_HDR_LEN + 36),
-    RANGE_LOCKTIME  (D_HDR_LEN + 40),
-    RANGE_TRKSTART  (D_HDR_LEN + 44),
+    RANGE_OBS       (0),
+    RANGE_PRN       (4),
+    RANGE_PSR       (8),
+    RANGE_PSR_STD   (16),
+    RANGE_ADR       (20),
+    RANGE_ADR_STD   (28),
+    RANGE_DOPPLER   (32),
+    RANGE_CNo       (36),
+    RANGE_LOCKTIME  (40),
+    RANGE_TRKSTART  (44),
     RANGE_OFFSET    (44),
 
+    // RANGECMP Log, Firmware Reference Manual pg. 407
+    RANGECMP_OBS    (0),
+    RANGECMP_REC    (4),
+    RANGECMP_OFFSET (24),
+
+    // INSPVA/INSPVAS Log, SPAN Firmware Reference Manual
+    INSPVA_WEEK     (0),
+    INSPVA_SECONDS  (4),
+    INSPVA_LAT      (12),
+    INSPVA_LON      (20),
+    INSPVA_HGT      (28),
+    INSPVA_NVEL     (36),
+    INSPVA_EVEL     (44),
+    INSPVA_UVEL     (52),
+    INSPVA_ROLL     (60),
+    INSPVA_PITCH    (68),
+    INSPVA_AZIMUTH  (76),
+    INSPVA_STATUS   (84),
+
+    // CORRIMUDATA/CORRIMUDATAS Log, SPAN Firmware Reference Manual
+    CORRIMU_WEEK        (0),
+    CORRIMU_SECONDS     (4),
+    CORRIMU_PITCHRATE   (12),
+    CORRIMU_ROLLRATE    (20),
+    CORRIMU_YAWRATE     (28),
+    CORRIMU_LATACC      (36),
+    CORRIMU_LONACC      (44),
+    CORRIMU_VERTACC     (52),
+
     S_MSG_ID    (2),
     S_MSG_LEN   (2),
     S_SEQ_NUM   (2),
@@ -181,11 +269,53 @@ GPS::GPS() : GPS_PACKET_SIZE(700),
     OLD_BPS   (9600),
     BPS       (115200),
     MAX_BYTES (1000),
+    imu_rate_ (100.0),
+    extrapolate_(false),
+    geodetic_(false),
+    archive_sink_(NULL),
+    geometry_(false),
+    hatch_(false),
+    range_epoch_(0.0),
+    point_fix_(),
+    point_(false),
+    point_threshold_(30.0),
+    range_time_(-1.0),
+    satxyz_time_(-2.0),
+    xyz_time_(-1.0),
+    point_time_(-1.0),
+    point_difference_(std::numeric_limits<double>::quiet_NaN()),
+    point_count_(0),
+    enu_origin_(3, 0),
+    enu_rotation_(9, 0),
+    have_enu_origin_(false),
+    velocity_latency_(0.f),
 
     gps_data_(GPS_PACKET_SIZE, 0),
+    parse_state_(GPS_SYNC_ST),
+    parse_pos_(0),
+    hdr_len_(0),
+    msg_len_(0),
+    crc_errors_(0),
+    frames_(0),
+    bytes_(0),
+    rx_buf_(GPS_PACKET_SIZE, 0),
+    rx_pos_(0),
+    rx_len_(0),
+    replay_done_(false),
+    stream_pos_(0),
+    record_base_(0),
+    rx_stamp_ns_(0),
+    reading_(false),
     velocity_(3, 0),
     sigma_position_(3, 0),
     sigma_velocity_(3, 0),
+    ins_velocity_(3, 0),
+    ins_attitude_(3, 0),
+    imu_angular_(3, 0),
+    imu_linear_(3, 0),
+    ins_origin_(3, 0),
+    ins_enu_rotation_(9, 0),
+    have_ins_origin_(false),
 
     latitude_ (0.0),
     longitude_(0.0),
@@ -195,8 +325,19 @@ GPS::GPS() : GPS_PACKET_SIZE(700),
     stdev_altitude_ (0.),
     covar_latitude_ (0.),
     covar_longitude_(0.),
-    covar_altitude_ (0.)
+    covar_altitude_ (0.),
+    ins_latitude_ (0.),
+    ins_longitude_(0.),
+    ins_height_   (0.),
+    ins_status_   (0)
 {
+    memset(xyz_geodetic_, 0, sizeof(xyz_geodetic_));
+    memset(xyz_geodetic_cov_, 0, sizeof(xyz_geodetic_cov_));
+    memset(xyz_enu_, 0, sizeof(xyz_enu_));
+    memset(xyz_enu_cov_, 0, sizeof(xyz_enu_cov_));
+    memset(&shm_, 0, sizeof(shm_));
+    memset(&shm_solution_, 0, sizeof(shm_solution_));
+    shm_.fd = -1;
 }
 
 GPS::~GPS()
@@ -208,6 +349,10 @@ void GPS::init(int log_id)
 {
     int err;
 
+    // A replayed capture already holds the logs that were requested
+    if(replay_)
+        return;
+
     waitReceiveInit();
 
     // Init serial port at 9600 bps
@@ -216,54 +361,15 @@ void GPS::init(int log_id)
         ROS_ERROR_STREAM("serialcom_init failed " << err);
         throwSerialComException(err);
     }
+    port_open_ = true;
 
     // Configure GPS, set baudrate to 115200 bps and reconnect
     ROS_INFO("Configuring Receiver");
     configure();
 
     // Request GPS data
-    char buf[100];
-    double time_f = static_cast<double>(1.0/rate_);
-    if(log_id == BESTPOS)
-    {
-        sprintf(buf, "LOG BESTPOSB ONTIME %f", time_f);
-        command(buf);
-    }
-    if(log_id == BESTXYZ)
-    {
-        sprintf(buf, "LOG BESTXYZB ONTIME %f", time_f);
-        command(buf);
-    }
-    if(log_id == TRACKSTAT)
-    {
-        sprintf(buf, "LOG TRACKSTATB ONTIME %f", time_f);
-        command(buf);
-    }
-    if(log_id == SATXYZ)
-    {
-        sprintf(buf, "LOG SATXYZB ONTIME %f", time_f);
-        command(buf);
-    }
-    if(log_id == RANGE)
-    {
-        sprintf(buf, "LOG RANGEB ONTIME %f", time_f);
-        command(buf);
-    }
-    if(log_id == -1)
-    {
-        std::this_thread::sleep_for( std::chrono::milliseconds(5) );
-        sprintf(buf, "LOG BESTXYZB ONTIME %f", time_f);
-        command(buf);
-        std::this_thread::sleep_for( std::chrono::milliseconds(5) );
-        sprintf(buf, "LOG TRACKSTATB ONTIME %f", time_f);
-        command(buf);
-        std::this_thread::sleep_for( std::chrono::milliseconds(5) );
-        sprintf(buf, "LOG SATXYZB ONTIME %f", time_f);
-        command(buf);
-        std::this_thread::sleep_for( std::chrono::milliseconds(5) );
-        sprintf(buf, "LOG RANGEB ONTIME %f", time_f);
-        command(buf);
-    }
+    requestLogs(log_id);
+    enableCorrectionInput();
 }
 
 void GPS::init(int log_id, std::string port, double rate = 20)
@@ -277,12 +383,16 @@ void GPS::init(int log_id, std::string port, double rate = 20)
     TIMEOUT_US = ((1.0/rate_)*1e6);
     ROS_INFO_STREAM("TIMEOUT_US = " << TIMEOUT_US);
 
+    if(replay_)
+        return;
+
     // Init serial port at 9600 bps
     if((err = serialcom_init(&gps_SerialPortConfig_, 1, (char*)serial_port_.c_str(), OLD_BPS)) != SERIALCOM_SUCCESS)
     {
         ROS_ERROR_STREAM("serialcom_init failed " << err);
         throwSerialComException(err);
     }
+    port_open_ = true;
 
     waitReceiveInit();
     // Configure GPS, set baudrate to 115200 bps and reconnect
@@ -290,416 +400,736 @@ void GPS::init(int log_id, std::string port, double rate = 20)
     configure();
 
     // Request GPS data
-    char buf[100];
-    double time_f = static_cast<double>(1.0/rate_);
+    requestLogs(log_id);
+    enableCorrectionInput();
+}
+
+void GPS::waitReceiveInit()
+{
+    ROS_INFO("Wainting to Receiver initialize");
+    std::this_thread::sleep_for( std::chrono::seconds(11) );
+}
+
+void GPS::setLogRequests(const std::vector<LogRequest>& logs)
+{
+    log_requests_ = logs;
+}
+
+std::vector<LogRequest> GPS::defaultLogRequests(int log_id)
+{
+    std::vector<LogRequest> logs;
+    LogRequest request;
+    request.trigger = "ONTIME";
+    request.period = 1.0/rate_;
+    request.offset = 0.0;
+    request.priority = 0;
+
     if(log_id == BESTPOS)
     {
-        sprintf(buf, "LOG BESTPOSB ONTIME %f", time_f);
-        command(buf);
+        request.name = "BESTPOS";
+        logs.push_back(request);
     }
-    if(log_id == BESTXYZ)
+    if(log_id == BESTXYZ || log_id == -1)
     {
-        sprintf(buf, "LOG BESTXYZB ONTIME %f", time_f);
-        command(buf);
+        request.name = "BESTXYZ";
+        logs.push_back(request);
     }
-    if(log_id == TRACKSTAT)
+    if(log_id == TRACKSTAT || log_id == -1)
     {
-        sprintf(buf, "LOG TRACKSTATB ONTIME %f", time_f);
-        command(buf);
+        request.name = "TRACKSTAT";
+        logs.push_back(request);
     }
-    if(log_id == SATXYZ)
+    if(log_id == SATXYZ || log_id == -1)
     {
-        sprintf(buf, "LOG SATXYZB ONTIME %f", time_f);
-        command(buf);
+        request.name = "SATXYZ";
+        logs.push_back(request);
     }
-    if(log_id == RANGE)
+    if(log_id == RANGE || log_id == -1)
     {
-        sprintf(buf, "LOG RANGEB ONTIME %f", time_f);
-        command(buf);
+        request.name = "RANGE";
+        logs.push_back(request);
     }
-    if(log_id == -1)
+    return logs;
+}
+
+void GPS::requestLogs(int log_id)
+{
+    std::vector<LogRequest> logs = log_requests_.empty() ? defaultLogRequests(log_id) : log_requests_;
+
+    // Logs due on the same epoch are output in the order they were requested,
+    // so the most latency sensitive ones (lowest priority value) go first
+    std::stable_sort(logs.begin(), logs.end(),
+        [](const LogRequest& a, const LogRequest& b) { return a.priority < b.priority; });
+
+    char buf[100];
+    for(size_t i = 0; i < logs.size(); ++i)
     {
+        const LogRequest& log = logs[i];
+        if(log.trigger == "ONTIME")
+        {
+            double period = (log.period > 0.0) ? log.period : 1.0/rate_;
+            if(log.offset > 0.0)
+                snprintf(buf, sizeof(buf), "LOG %sB ONTIME %f %f", log.name.c_str(), period, log.offset);
+            else
+                snprintf(buf, sizeof(buf), "LOG %sB ONTIME %f", log.name.c_str(), period);
+        }
+        else if(log.trigger == "ONNEW" || log.trigger == "ONCHANGED" || log.trigger == "ONCE")
+        {
+            snprintf(buf, sizeof(buf), "LOG %sB %s", log.name.c_str(), log.trigger.c_str());
+        }
+        else
+        {
+            ROS_ERROR("unknown trigger %s for log %s, skipping", log.trigger.c_str(), log.name.c_str());
+            continue;
+        }
         std::this_thread::sleep_for( std::chrono::milliseconds(5) );
-        sprintf(buf, "LOG BESTXYZB ONTIME %f", time_f);
-        command(buf);
-        std::this_thread::sleep_for( std::chrono::milliseconds(5) );
-        sprintf(buf, "LOG TRACKSTATB ONTIME %f", time_f);
-        command(buf);
-        std::this_thread::sleep_for( std::chrono::milliseconds(5) );
-        sprintf(buf, "LOG SATXYZB ONTIME %f", time_f);
-        command(buf);
-        std::this_thread::sleep_for( std::chrono::milliseconds(5) );
-        sprintf(buf, "LOG RANGEB ONTIME %f", time_f);
         command(buf);
     }
 }
 
-void GPS::waitReceiveInit()
+int GPS::readDataFromReceiver()
 {
-    ROS_INFO("Wainting to Receiver initialize");
-    std::this_thread::sleep_for( std::chrono::seconds(11) );
+    // Read until a frame is decoded, up to MAX_BYTES per call. The parser keeps
+    // its state between calls, so a frame may span several of them.
+    for(int i = 0; i < MAX_BYTES; i++)
+    {
+        // Refill from the serial port in blocks rather than a byte at a time
+        if(rx_pos_ == rx_len_)
+        {
+            rx_pos_ = 0;
+            rx_len_ = readBytes(rx_buf_.data(), rx_buf_.size(), TIMEOUT_US);
+            if(rx_len_ <= 0)
+            {
+                rx_len_ = 0;
+                break;
+            }
+        }
+
+        if(parseByte(rx_buf_[rx_pos_++]))
+            return 1;
+    }
+    return 0;
 }
 
-int GPS::readDataFromReceiver()
+int GPS::readBytes(uint8_t* buffer, int size, int timeout_us)
 {
-    int err;
-    int data_ready = 0;
-    // State machine variables
-    int b = 0, bb = 0, s = GPS_SYNC_ST;
+    if(replay_)
+        return readReplay(buffer, size, timeout_us);
 
-    // Storage for data read from serial port
-    uint8_t data_read;
+    struct pollfd pfd;
+    pfd.fd = gps_SerialPortConfig_.fd;
+    pfd.events = POLLIN;
 
-    // Multi-byte data
-    uint16_t msg_id, msg_len, t_week;
-    uint32_t t_ms, crc_from_packet;
+    int ret = poll(&pfd, 1, timeout_us/1000);
+    if(ret == 0 || (ret < 0 && errno == EINTR))
+        return 0;
+    if(ret < 0)
+    {
+        ROS_ERROR("poll failed: %s", strerror(errno));
+        return -1;
+    }
+
+    ssize_t n = ::read(pfd.fd, buffer, size);
+    if(n < 0)
+    {
+        if(errno == EAGAIN || errno == EINTR)
+            return 0;
+        ROS_ERROR("read failed: %s", strerror(errno));
+        return -1;
+    }
+
+    received(buffer, n, CaptureClockNs());
+    return n;
+}
 
-    // Try to sync with IMU and get latest data packet, up to MAX_BYTES read until failure
-    for(int i = 0; (!data_ready)&&(i < MAX_BYTES); i++)
+void GPS::received(const uint8_t* data, int size, int64_t stamp_ns)
+{
+    rx_stamp_ns_ = stamp_ns;
+    bytes_ += size;
+    if(recorder_ && size > 0 && !recorder_->write(data, size))
     {
-        // Read data from serial port
-        if((err = serialcom_receivebyte(&gps_SerialPortConfig_, &data_read, TIMEOUT_US)) != SERIALCOM_SUCCESS)
+        ROS_ERROR("capture write failed, recording stopped");
+        recorder_.reset();
+    }
+}
+
+int GPS::receive(const uint8_t* data, size_t size, int64_t stamp_ns, const FrameCallback& callback)
+{
+    received(data, size, stamp_ns);
+    return parse(data, size, callback);
+}
+
+int GPS::readReplay(uint8_t* buffer, int size, int timeout_us)
+{
+    int n = replay_->read(buffer, size, timeout_us);
+    if(n < 0)
+    {
+        // End of the capture: idle like a silent port
+        if(!replay_done_)
+            ROS_INFO("replay finished");
+        replay_done_ = true;
+        std::this_thread::sleep_for( std::chrono::microseconds(timeout_us) );
+        return 0;
+    }
+
+    received(buffer, n, CaptureClockNs());
+    return n;
+}
+
+void GPS::startRecording(const std::string& path)
+{
+    recorder_.reset(new CaptureRecorder(path));
+    record_base_ = stream_pos_;
+    ROS_INFO("Recording to %s", path.c_str());
+}
+
+void GPS::openReplay(const std::string& path, double speed)
+{
+    replay_.reset(new CaptureReplay(path, speed));
+    replay_done_ = false;
+    if(replay_->entries() == 0)
+        ROS_INFO("Replaying %s as fast as possible (no index)", path.c_str());
+    else
+        ROS_INFO("Replaying %s (%zu frames, speed %g)", path.c_str(), replay_->entries(), speed);
+}
+
+void GPS::publishSharedMemory(const std::string& name, int capacity)
+{
+    int err = GpsShmCreate(&shm_, name.c_str(), capacity);
+    if(err != 0)
+        throw std::runtime_error("could not create shared memory " + name + ": " + strerror(-err));
+    ROS_INFO("Publishing solutions to shared memory %s (%d slots)", name.c_str(), capacity);
+}
+
+/* --------------------------------------------------------------------------
+Copies the latest BESTXYZ and BESTPOS into the shared-memory ring, once per
+frame of either log
+-------------------------------------------------------------------------- */
+void GPS::publishSolution()
+{
+    GpsShmSolution& s = shm_solution_;
+    s.receive_ns = rx_stamp_ns_;
+    s.gps_week = msg_header_.gps_week;
+    s.gps_ms = msg_header_.gps_ms;
+    s.msg_id = msg_header_.msg_id;
+    s.position_status = (msg_header_.msg_id == BESTPOS) ? solution_status_ : position_status_;
+    s.position_type = position_type_;
+    s.velocity_status = velocity_status_;
+    s.velocity_type = velocity_type_;
+    s.satellites_tracked = number_sat_track_;
+    s.satellites_used = number_sat_sol_;
+
+    s.position[0] = x_;
+    s.position[1] = y_;
+    s.position[2] = z_;
+    for(int i = 0; i < 3; ++i)
+    {
+        s.velocity[i] = velocity_[i];
+        s.position_sigma[i] = sigma_position_[i];
+        s.velocity_sigma[i] = sigma_velocity_[i];
+    }
+
+    s.latitude = latitude_;
+    s.longitude = longitude_;
+    s.height = altitude_;
+    s.latitude_sigma = stdev_latitude_;
+    s.longitude_sigma = stdev_longitude_;
+    s.height_sigma = stdev_altitude_;
+
+    GpsShmPublish(&shm_, &s);
+}
+
+void GPS::setHistory(size_t capacity, double max_gap)
+{
+    history_.resize(capacity);
+    history_.setMaxGap(max_gap);
+}
+
+void GPS::setExtrapolation(double max_age, double accel_noise)
+{
+    extrapolator_.configure(max_age, accel_noise);
+    extrapolate_ = true;
+}
+
+void GPS::recordSolution()
+{
+    // Positions of other statuses are not meaningful
+    if(position_status_ != novatel_gps::SolStat::SOL_COMPUTED)
+    {
+        extrapolator_.invalidate();
+        return;
+    }
+
+    SolutionSample sample;
+    sample.gps_time = msg_header_.gps_week*GPS_SECONDS_IN_WEEK + msg_header_.gps_ms/1000.0;
+    sample.host_time = rx_stamp_ns_/1e9;
+    sample.position[0] = x_;
+    sample.position[1] = y_;
+    sample.position[2] = z_;
+    for(int i = 0; i < 3; ++i)
+    {
+        sample.velocity[i] = velocity_[i];
+        sample.position_var[i] = sigma_position_[i]*sigma_position_[i];
+        sample.velocity_var[i] = sigma_velocity_[i]*sigma_velocity_[i];
+    }
+    sample.position_status = position_status_;
+    sample.position_type = position_type_;
+    if(history_.capacity() > 0)
+        history_.add(sample, rx_stamp_ns_);
+    if(extrapolate_)
+        extrapolator_.addFix(sample, velocity_latency_, rx_stamp_ns_);
+}
+
+void GPS::setGeodetic(bool enable)
+{
+    geodetic_ = enable;
+}
+
+void GPS::setEnuOrigin(double latitude, double longitude, double height)
+{
+    LlaToEcef(latitude*DEG2RAD, longitude*DEG2RAD, height, enu_origin_.data());
+    EnuRotation(latitude*DEG2RAD, longitude*DEG2RAD, enu_rotation_.data());
+    have_enu_origin_ = true;
+}
+
+/* --------------------------------------------------------------------------
+Geodetic and ENU coordinates of the latest BESTXYZ. The ECEF covariance is
+rotated into the ENU frame at the fix for NavSatFix (east, north, up) and
+into the ENU frame at the origin for the pose.
+-------------------------------------------------------------------------- */
+void GPS::convertXYZ()
+{
+    if(position_status_ != novatel_gps::SolStat::SOL_COMPUTED)
+        return;
+
+    double ecef[3] = { x_, y_, z_ };
+    double lat, lon, h;
+    EcefToLla(ecef, &lat, &lon, &h);
+    xyz_geodetic_[0] = lat*RAD2DEG;
+    xyz_geodetic_[1] = lon*RAD2DEG;
+    xyz_geodetic_[2] = h;
+
+    if(!have_enu_origin_)
+        setEnuOrigin(xyz_geodetic_[0], xyz_geodetic_[1], h);
+    EcefToEnu(ecef, enu_origin_.data(), enu_rotation_.data(), xyz_enu_);
+
+    double cov[9] = { 0 };
+    for(int i = 0; i < 3; ++i)
+        cov[4*i] = sigma_position_[i]*sigma_position_[i];
+
+    double R[9];
+    EnuRotation(lat, lon, R);
+    RotateCovariance(R, cov, xyz_geodetic_cov_);
+    RotateCovariance(enu_rotation_.data(), cov, xyz_enu_cov_);
+}
+
+void GPS::setGeometry(double elevation_mask, double tolerance)
+{
+    geometry_engine_.configure(elevation_mask, tolerance);
+    geometry_ = true;
+}
+
+void GPS::updateGeometry()
+{
+    // Receiver from BESTXYZ, or BESTPOS when only that is logged, or our own
+    // point solution when neither is
+    double receiver[3] = { x_, y_, z_ };
+    if(x_ == 0.0 && y_ == 0.0 && z_ == 0.0)
+    {
+        if(latitude_ != 0.0 || longitude_ != 0.0)
+            LlaToEcef(latitude_*DEG2RAD, longitude_*DEG2RAD, altitude_, receiver);
+        else if(point_fix_.valid)
+            memcpy(receiver, point_fix_.position, sizeof(receiver));
+        else
+            return;
+    }
+    geometry_engine_.update(satellite_table_, receiver);
+}
+
+void GPS::setSlipThresholds(double doppler, double geometry_free, double max_gap)
+{
+    slip_detector_.configure(doppler, geometry_free, max_gap);
+}
+
+/* --------------------------------------------------------------------------
+Flags cycle slips in the decoded RANGE/RANGECMP against the previous one,
+then joins the observations into the satellite table. The geometry-free
+check needs every signal of the epoch, hence the second pass.
+-------------------------------------------------------------------------- */
+void GPS::finishRange()
+{
+    double t = msg_header_.gps_week*GPS_SECONDS_IN_WEEK + msg_header_.gps_ms/1000.0;
+    slip_detector_.beginEpoch(t);
+    for(int i = 0; i < pseudorange_.obs; ++i)
+        slip_detector_.update(pseudorange_.ranges[i]);
+    slip_detector_.endEpoch();
+
+    for(int i = 0; i < pseudorange_.obs; ++i)
+    {
+        pseudorange_.ranges[i].slip = slip_detector_.flags(pseudorange_.ranges[i]);
+        satellite_table_.update(pseudorange_.ranges[i]);
+        if(hatch_)
+            hatch_filter_.update(pseudorange_.ranges[i], t);
+    }
+    range_epoch_ = t;
+
+    if(rinex_)
+    {
+        double approx[3] = { x_, y_, z_ };
+        if(x_ == 0.0 && y_ == 0.0 && z_ == 0.0 && point_fix_.valid)
+            memcpy(approx, point_fix_.position, sizeof(approx));
+        rinex_->push(msg_header_.gps_week, msg_header_.gps_ms/1000.0, pseudorange_.ranges.data(), pseudorange_.obs, approx);
+    }
+}
+
+void GPS::writeRinex(const std::string& directory, const std::string& marker)
+{
+    rinex_.reset(new RinexWriter(directory, marker));
+}
+
+void GPS::writeArchive(const std::string& path, int chunk_rows)
+{
+    archive_.reset(new ArchiveWriter(path, chunk_rows));
+    archive_sink_ = archive_.get();
+}
+
+void GPS::setArchiveSink(ArchiveSink* sink)
+{
+    archive_.reset();
+    archive_sink_ = sink;
+}
+
+// One archive row per solution, observation, channel or satellite of the log
+void GPS::archiveLog()
+{
+    uint16_t msg_id = msg_header_.msg_id;
+    double time = msg_header_.gps_week*604800000.0 + msg_header_.gps_ms;
+    bool ok = true;
+
+    if(msg_id == BESTXYZ)
+    {
+        double row[] = { time, double(position_status_), double(position_type_), x_, y_, z_,
+                         sigma_position_[0], sigma_position_[1], sigma_position_[2],
+                         double(velocity_status_), double(velocity_type_), velocity_[0], velocity_[1], velocity_[2],
+                         sigma_velocity_[0], sigma_velocity_[1], sigma_velocity_[2], velocity_latency_,
+                         double(number_sat_track_), double(number_sat_sol_) };
+        ok = archive_sink_->append(ARCHIVE_BESTXYZ, row);
+    }
+    else if(msg_id == RANGE || msg_id == RANGECMP)
+    {
+        for(int i = 0; i < pseudorange_.obs && ok; ++i)
         {
-            ROS_ERROR_STREAM("serialcom_receivebyte failed " << err);
-            break;
+            const novatel_gps::RangeInformation& r = pseudorange_.ranges[i];
+            double row[] = { time, double(r.prn_slot), double(r.ch_tr_status), r.psr, r.psr_std, r.adr, r.adr_std,
+                             r.doppler, r.c_no, r.locktime, double(r.slip) };
+            ok = archive_sink_->append(ARCHIVE_RANGE, row);
+        }
+    }
+    else if(msg_id == TRACKSTAT)
+    {
+        for(uint32_t i = 0; i < tracking_.channels && ok; ++i)
+        {
+            const novatel_gps::TrackStatChannel& c = tracking_.channel[i];
+            double row[] = { time, double(c.prn_slot), double(c.ch_tr_status), c.psr, c.doppler, c.cn0, c.locktime,
+                             c.psr_res, double(c.reject), c.psr_weight };
+            ok = archive_sink_->append(ARCHIVE_TRACKSTAT, row);
         }
+    }
+    else if(msg_id == SATXYZ)
+    {
+        for(size_t i = 0; i < satellites_.satellites.size() && ok; ++i)
+        {
+            const novatel_gps::SatXYZInformation& s = satellites_.satellites[i];
+            double row[] = { time, double(s.prn_slot), s.position.x, s.position.y, s.position.z,
+                             s.clk_corr, s.ion_corr, s.trop_corr };
+            ok = archive_sink_->append(ARCHIVE_SATXYZ, row);
+        }
+    }
 
-        // Parse GPS packet (Firmware Reference Manual, p.22)
-        switch(s)
+    if(!ok)
+    {
+        if(archive_)
+            ROS_ERROR("archive write failed after %.1f MB, archiving stopped", archive_->bytes()/1e6);
+        else
+            ROS_ERROR("archive sink failed, archiving stopped");
+        archive_.reset();
+        archive_sink_ = NULL;
+    }
+}
+
+void GPS::setHatchWindow(int window)
+{
+    hatch_filter_.configure(window);
+    hatch_ = window > 0;
+}
+
+void GPS::setPointSolution(double elevation_mask, double integrity_threshold)
+{
+    point_solver_.configure(elevation_mask);
+    point_threshold_ = integrity_threshold;
+    point_ = true;
+}
+
+/* --------------------------------------------------------------------------
+Solves once per epoch, when the RANGE and the SATXYZ of the same GPS time
+are both in the satellite table, whichever comes last. BESTXYZ only records
+its epoch for the integrity check, so it is compared when it is output ahead
+of RANGE and SATXYZ.
+-------------------------------------------------------------------------- */
+void GPS::solvePoint()
+{
+    double t = msg_header_.gps_week*GPS_SECONDS_IN_WEEK + msg_header_.gps_ms/1000.0;
+    if(msg_header_.msg_id == BESTXYZ)
+    {
+        xyz_time_ = (position_status_ == novatel_gps::SolStat::SOL_COMPUTED) ? t : -1.0;
+        return;
+    }
+
+    if(msg_header_.msg_id == SATXYZ)
+        satxyz_time_ = t;
+    else
+        range_time_ = t;
+    if(range_time_ != satxyz_time_ || t == point_time_)
+        return;
+
+    point_time_ = t;
+    point_solver_.solve(satellite_table_, &point_fix_);
+    point_count_++;
+
+    point_difference_ = std::numeric_limits<double>::quiet_NaN();
+    if(!point_fix_.valid || xyz_time_ != t)
+        return;
+    double d[3] = { point_fix_.position[0] - x_, point_fix_.position[1] - y_, point_fix_.position[2] - z_ };
+    point_difference_ = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    if(point_difference_ > point_threshold_)
+        ROS_WARN_THROTTLE(1.0, "Point solution is %.1f m from BESTXYZ (%d satellites, residual RMS %.1f m)",
+                          point_difference_, point_fix_.satellites, point_fix_.residual_rms);
+}
+
+void GPS::startReading(FrameCallback callback)
+{
+    if(reading_)
+        return;
+
+    frame_callback_ = callback;
+
+    // Size the decoded logs for the largest frame so decoding does not allocate
+    pseudorange_.ranges.reserve(GPS_PACKET_SIZE/RANGECMP_OFFSET);
+    tracking_.channel.reserve(GPS_PACKET_SIZE/TRACKSTAT_OFFSET);
+    satellites_.satellites.reserve(GPS_PACKET_SIZE/SATXYZ_OFFSET);
+
+    reading_ = true;
+    reader_thread_ = std::thread(&GPS::readLoop, this);
+}
+
+void GPS::stopReading()
+{
+    reading_ = false;
+    if(reader_thread_.joinable())
+        reader_thread_.join();
+}
+
+void GPS::readLoop()
+{
+    std::vector<uint8_t> buffer(GPS_PACKET_SIZE);
+
+    if(reader_tuning_.policy != "other" || !reader_tuning_.cpus.empty())
+    {
+        ApplyThreadTuning(reader_tuning_, "reader");
+        PrefaultStack(256*1024);
+        MeasureWakeupLatency(200, 1000000, "reader");
+    }
+
+    // Decode every frame as soon as its last byte arrives and hand it to the callback
+    while(reading_)
+    {
+        int n = readBytes(buffer.data(), buffer.size(), TIMEOUT_US);
+        if(n < 0)
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds(10) );
+            continue;
+        }
+
+        parse(buffer.data(), n, frame_callback_);
+    }
+}
+
+int GPS::parse(const uint8_t* data, size_t size, const FrameCallback& callback)
+{
+    int frames = 0;
+    for(size_t i = 0; i < size; ++i)
+    {
+        if(parseByte(data[i]))
         {
-            case GPS_SYNC_ST:
+            frames++;
+            if(callback)
+                callback(msg_header_.msg_id);
+        }
+    }
+    return frames;
+}
+
+void GPS::resetParser()
+{
+    parse_state_ = GPS_SYNC_ST;
+    parse_pos_ = 0;
+    hdr_len_ = 0;
+    msg_len_ = 0;
+}
+
+bool GPS::parseByte(uint8_t data_read)
+{
+    stream_pos_++;
+
+    // Parse GPS packet (Firmware Reference Manual, p.22)
+    switch(parse_state_)
+    {
+        case GPS_SYNC_ST:
+        {
+            // State logic: Packet starts with 0xAA, 0x44 and 0x12 (long header) or 0x13 (short header)
+            if((parse_pos_ == SYNC0 && data_read == D_SYNC0) ||
+               (parse_pos_ == SYNC1 && data_read == D_SYNC1))
             {
-                // State logic: Packet starts with 3 sync bytes with values 0xAA, 0x44, 0x12
-                switch(b)
-                {
-                    case SYNC0:
-                    {
-                        if(data_read == D_SYNC0)
-                        {
-                            gps_data_[b] = data_read;
-                            b++;
-                        }
-                        else
-                            // Out of sync, reset
-                            b = 0;
-                        break;
-                    }
-
-                    case SYNC1:
-                    {
-                        if(data_read == D_SYNC1)
-                        {
-                            gps_data_[b] = data_read;
-                            b++;
-                        }
-                        else
-                            // Out of sync, reset
-                            b = 0;
-                        break;
-                    }
-
-                    case SYNC2:
-                    {
-                        if(data_read == D_SYNC2)
-                        {
-                            gps_data_[b] = data_read;
-                            b++;
-                        }
-                        else
-                            // Out of sync, reset
-                            b = 0;
-                        break;
-                    }
-                }
-                // State transition: I have reached the HDR_LEN byte without resetting
-                if(b == HDR_LEN)
-                    s = GPS_HEADER_ST;
+                gps_data_[parse_pos_++] = data_read;
             }
-            break;
+            else if(parse_pos_ == SYNC2 && (data_read == D_SYNC2 || data_read == D_SYNC2_SHORT))
+            {
+                gps_data_[parse_pos_++] = data_read;
+                hdr_len_ = (data_read == D_SYNC2) ? D_HDR_LEN : D_SHORT_HDR_LEN;
 
-            case GPS_HEADER_ST:
+                // State transition: sync found, header type known
+                parse_state_ = GPS_HEADER_ST;
+            }
+            else
             {
-                // State logic: HDR_LEN, MSG_ID, MSG_TYPE, PORT_ADDR, MSG_LEN, SEQ_NUM, IDLE_T, T_STATUS, T_WEEK, T_MS, GPS_STATUS, RESERVED, SW_VERS
-                switch(b)
-                {
-                    case HDR_LEN:
-                    {
-                        if(data_read == D_HDR_LEN)
-                        {
-                            gps_data_[b] = data_read;
-                            b++;
-                        }
-                        else
-                        {
-                            // Invalid HDR_LEN, reset
-                            ROS_ERROR("invalid HDR_LEN %d", data_read);
-                            b = 0;
-                            s = GPS_SYNC_ST;
-                        }
-                        break;
-                    }
-
-                    case MSG_ID:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data_[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_MSG_ID)
-                        {
-                            // Merge bytes and process
-                            memcpy(&msg_id, &gps_data_[MSG_ID], sizeof(uint16_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_MSG_ID;
-                        }
-                        break;
-                    }
-
-                    case MSG_TYPE:
-                    {
-                        gps_data_[b] = data_read;
-                        b++;
-                        break;
-                    }
-
-                    case PORT_ADDR:
-                    {
-                        gps_data_[b] = data_read;
-                        b++;
-                        break;
-                    }
-
-                    case MSG_LEN:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data_[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_MSG_LEN)
-                        {
-                            // Merge bytes and process
-                            memcpy(&msg_len, &gps_data_[MSG_LEN], sizeof(uint16_t));
-                            // ROS_INFO("Message Length = %d", msg_len);
-                            // I was having some problems with (msg_len == 0)...
-                            if(msg_len != 0)
-                            {
-                                // Update byte indices
-                                bb = 0;
-                                b += S_MSG_LEN;
-                            }
-                            else
-                            {
-                                // Something wrong, reset
-                                bb = 0;
-                                b = 0;
-                                s = GPS_SYNC_ST;
-                            }
-                        }
-                        break;
-                    }
-
-                    case SEQ_NUM:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data_[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_SEQ_NUM)
-                        {
-                            // Merge bytes and process
-                            //memcpy(&seq_num, &gps_data_[SEQ_NUM], sizeof(uint16_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_SEQ_NUM;
-                        }
-                        break;
-                    }
-
-                    case IDLE_T:
-                    {
-                        gps_data_[b] = data_read;
-                        b++;
-                        break;
-                    }
-
-                    case T_STATUS:
-                    {
-                        gps_data_[b] = data_read;
-                        b++;
-                        break;
-                    }
-
-                    case T_WEEK:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data_[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_T_WEEK)
-                        {
-                            // Merge bytes and process
-                            memcpy(&t_week, &gps_data_[T_WEEK], sizeof(uint16_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_T_WEEK;
-                        }
-                        break;
-                    }
-
-                    case T_MS:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data_[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_T_MS)
-                        {
-                            // Merge bytes and process
-                            memcpy(&t_ms, &gps_data_[T_MS], sizeof(uint32_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_T_MS;
-                        }
-                        break;
-                    }
-
-                    case GPS_STATUS:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data_[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_GPS_STATUS)
-                        {
-                            // Merge bytes and process
-                            memcpy(&(status_), &gps_data_[GPS_STATUS], sizeof(uint32_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_GPS_STATUS;
-                        }
-                        break;
-                    }
-
-                    case RESERVED:
-                    {   
-                        // Index bb is for bytes in multi-byte variables
-                        // Skip this section, no useful data
-                        bb++;
-
-                        if(bb == S_RESERVED)
-                        {
-                            // Update byte indices
-                            bb = 0;
-                            b += S_RESERVED;
-                        }
-                        break;
-                    }
-
-                    case SW_VERS:
-                    {
-                        // Index bb is for bytes in multi-byte variables
-                        gps_data_[b+bb] = data_read;
-                        bb++;
-
-                        if(bb == S_SW_VERS)
-                        {
-                            // Merge bytes and process
-                            //memcpy(&sw_vers, &gps_data_[SW_VERS], sizeof(uint16_t));
-
-                            // Update byte indices
-                            bb = 0;
-                            b += S_SW_VERS;
-                        }
-                        break;
-                    }
-                }
+                // Out of sync, reset (this byte may already start the next packet)
+                parse_pos_ = 0;
+                if(data_read == D_SYNC0)
+                    gps_data_[parse_pos_++] = data_read;
+            }
+        }
+        break;
+
+        case GPS_HEADER_ST:
+        {
+            gps_data_[parse_pos_++] = data_read;
 
-                // State transition: I have reached the DATA bytes without resetting
-                if(b == DATA)
-                    s = GPS_PAYLOAD_ST;  
+            // Long headers carry their own length
+            if(parse_pos_ == HDR_LEN + 1 && hdr_len_ == D_HDR_LEN && data_read != D_HDR_LEN)
+            {
+                // Invalid HDR_LEN, reset
+                ROS_ERROR("invalid HDR_LEN %d", data_read);
+                resetParser();
+                break;
             }
-            break;
 
-            case GPS_PAYLOAD_ST:
+            // State transition: whole header read, payload length known
+            if(parse_pos_ == hdr_len_)
             {
-                // State logic: Grab data until you reach the CRC bytes
-                gps_data_[b+bb] = data_read;
-                bb++;
+                if(hdr_len_ == D_HDR_LEN)
+                    memcpy(&msg_len_, &gps_data_[D_MSG_LEN], sizeof(uint16_t));
+                else
+                    msg_len_ = gps_data_[D_SHORT_MSG_LEN];
 
-                // State transition: I have reached the CRC bytes
-                if(bb == msg_len)
+                if(msg_len_ == 0 || static_cast<size_t>(hdr_len_ + msg_len_ + S_CRC) > gps_data_.size())
                 {
-                    // Bytes are decoded after CRC check
-
-                    // Update byte indices
-                    bb = 0;
-                    b += msg_len;
-                    s = GPS_CRC_ST;
+                    // Something wrong, reset
+                    ROS_ERROR("invalid message length %d", msg_len_);
+                    resetParser();
+                    break;
                 }
+                parse_state_ = GPS_PAYLOAD_ST;
             }
-            break;
+        }
+        break;
+
+        case GPS_PAYLOAD_ST:
+        {
+            // State logic: Grab data until you reach the CRC bytes
+            gps_data_[parse_pos_++] = data_read;
+
+            // State transition: I have reached the CRC bytes
+            if(parse_pos_ == hdr_len_ + msg_len_)
+                parse_state_ = GPS_CRC_ST;
+        }
+        break;
 
-            case GPS_CRC_ST:
+        case GPS_CRC_ST:
+        {
+            gps_data_[parse_pos_++] = data_read;
+            if(parse_pos_ == hdr_len_ + msg_len_ + S_CRC)
             {
-                // Index bb is for bytes in multi-byte variables
-                gps_data_[b+bb] = data_read;
-                bb++;
-                if(bb == S_CRC)
+                int b = hdr_len_ + msg_len_;
+                int hdr_len = hdr_len_;
+                uint32_t msg_len = msg_len_;
+
+                // Grab CRC from packet
+                uint32_t crc_from_packet = static_cast<uint32_t>((gps_data_[b+3] << 24) | (gps_data_[b+2] << 16) | (gps_data_[b+1] << 8) | gps_data_[b]);
+
+                // Calculate CRC from packet (b = packet size)
+                uint32_t crc_calculated = CalculateBlockCRC32(b, gps_data_.data());
+
+                // State transition: Unconditional reset
+                resetParser();
+
+                // Compare them to see if valid packet (the CRC is sent little-endian like every other field)
+                if(crc_from_packet != crc_calculated)
                 {
-                    uint32_t crc_calculated;
-                    // Grab CRC from packet
-                    crc_from_packet = static_cast<uint32_t>((gps_data_[b+3] << 24) | (gps_data_[b+2] << 16) | (gps_data_[b+1] << 8) | gps_data_[b]);
-
-                    // Calculate CRC from packet (b = packet size)
-                    // crc_calculated = CalculateBlockCRC32(b, &gps_data_[0]); // GAMBIARRA
-                    crc_calculated = CalculateBlockCRC32(b, gps_data_.data()); // C++11
-
-                    // Compare them to see if valid packet 
-                    if(crc_from_packet != ByteSwap(crc_calculated))
-                    {
-                        // ROS_ERROR("CRC does not match (%0x != %0x)", crc_from_packet, ByteSwap(crc_calculated));
-                    }
-                    decode(msg_id);
-                    data_ready = 1;
-
-                    // State transition: Unconditional reset
-                    bb = 0;
-                    b = 0;
-                    s = GPS_SYNC_ST;
+                    ROS_ERROR("CRC does not match (%0x != %0x)", crc_from_packet, crc_calculated);
+                    crc_errors_++;
+                    return false;
                 }
+
+                decodeHeader(gps_data_.data());
+                frames_++;
+                if(recorder_)
+                    recorder_->addFrame(stream_pos_ - record_base_ - (b + S_CRC), rx_stamp_ns_, msg_header_.msg_id, b + S_CRC);
+                if(!decode(&gps_data_[hdr_len], msg_len))
+                    return false;
+                if(shm_.header && (msg_header_.msg_id == BESTXYZ || msg_header_.msg_id == BESTPOS))
+                    publishSolution();
+                if(msg_header_.msg_id == BESTXYZ && (history_.capacity() > 0 || extrapolate_))
+                    recordSolution();
+                if(msg_header_.msg_id == BESTXYZ && geodetic_)
+                    convertXYZ();
+                if(msg_header_.msg_id == SATXYZ && geometry_)
+                    updateGeometry();
+                if(point_ && (msg_header_.msg_id == RANGE || msg_header_.msg_id == RANGECMP ||
+                              msg_header_.msg_id == SATXYZ || msg_header_.msg_id == BESTXYZ))
+                    solvePoint();
+                if(archive_sink_)
+                    archiveLog();
+                return true;
             }
-            break;
         }
+        break;
     }
-
-    // Flush port and request more data
-    // tcflush(gps_SerialPortConfig_.fd, TCIOFLUSH);
-    // command("LOG BESTXYZB ONCE");
-    return data_ready;
+    return false;
 }
 
-void GPS::decode(uint16_t msg_id)
+void GPS::decodeHeader(const uint8_t* frame)
 {
-    ROS_INFO("Message ID = %u", msg_id);
-    ROS_ASSERT_MSG(sizeof(double) == 8, "sizeof(double) != 8, check your compiler");
-    ROS_ASSERT_MSG(sizeof(float) == 4, "sizeof(double) != 4, check your compiler");
+    // Short header (0xAA 0x44 0x13): length, id, week and milliseconds only
+    if(frame[SYNC2] == D_SYNC2_SHORT)
+    {
+        msg_header_ = novatel_gps::MsgHeader();
+        msg_header_.msg_len = frame[D_SHORT_MSG_LEN];
+        memcpy(&msg_header_.msg_id, &frame[D_MSG_ID], sizeof(uint16_t));
+        memcpy(&msg_header_.gps_week, &frame[D_SHORT_G_WEEK], sizeof(uint16_t));
+        memcpy(&msg_header_.gps_ms, &frame[D_SHORT_G_MS], sizeof(uint32_t));
+        return;
+    }
 
     // Reading message header
-    memcpy(&msg_header_.msg_id, &gps_data_[D_MSG_ID], sizeof(uint16_t));
-    memcpy(&msg_header_.msg_len, &gps_data_[D_MSG_LEN], sizeof(uint16_t));
-    memcpy(&msg_header_.seq, &gps_data_[D_SEQ], sizeof(uint16_t));
-    memcpy(&msg_header_.idle_t, &gps_data_[D_IDLE_T], sizeof(uint8_t));
-    memcpy(&time_stat_, &gps_data_[D_TIME_ST], sizeof(uint8_t));
-    memcpy(&msg_header_.gps_week, &gps_data_[D_G_WEEK], sizeof(uint16_t));
-    memcpy(&msg_header_.gps_ms, &gps_data_[D_G_MS], sizeof(uint32_t));
-    memcpy(&msg_header_.rcv_stat_n, &gps_data_[D_RCV_ST], sizeof(uint16_t));
-    memcpy(&msg_header_.rcv_sw_v, &gps_data_[D_RCV_SW_V], sizeof(uint16_t));
+    memcpy(&msg_header_.msg_id, &frame[D_MSG_ID], sizeof(uint16_t));
+    memcpy(&msg_header_.msg_len, &frame[D_MSG_LEN], sizeof(uint16_t));
+    memcpy(&msg_header_.seq, &frame[D_SEQ], sizeof(uint16_t));
+    memcpy(&msg_header_.idle_t, &frame[D_IDLE_T], sizeof(uint8_t));
+    memcpy(&time_stat_, &frame[D_TIME_ST], sizeof(uint8_t));
+    memcpy(&msg_header_.gps_week, &frame[D_G_WEEK], sizeof(uint16_t));
+    memcpy(&msg_header_.gps_ms, &frame[D_G_MS], sizeof(uint32_t));
+    memcpy(&msg_header_.rcv_stat_n, &frame[D_RCV_ST], sizeof(uint32_t));
+    memcpy(&msg_header_.rcv_sw_v, &frame[D_RCV_SW_V], sizeof(uint16_t));
 
     // Nible 0
     msg_header_.rcv_stat.error = (msg_header_.rcv_stat_n & 0x00000001);
@@ -745,33 +1175,55 @@ void GPS::decode(uint16_t msg_id)
     //                 "time_stat " << msg_header_.time_stat.time_stat << "\n" << 
     //                 "gps_week_ " << msg_header_.gps_week_ << "\n" <<
     //                 "gps_ms " << msg_header_.gps_ms);
+}
+
+// True when count records of record_size bytes, the first at offset, fit in
+// size bytes of payload
+static bool RecordsFit(uint32_t count, int offset, int record_size, uint32_t size)
+{
+    return offset + static_cast<uint64_t>(count)*record_size <= size;
+}
+
+bool GPS::decode(const uint8_t* data, uint32_t size)
+{
+    uint16_t msg_id = msg_header_.msg_id;
+    ROS_DEBUG("Message ID = %u", msg_id);
+    ROS_ASSERT_MSG(sizeof(double) == 8, "sizeof(double) != 8, check your compiler");
+    ROS_ASSERT_MSG(sizeof(float) == 4, "sizeof(double) != 4, check your compiler");
 
     if(msg_id == BESTXYZ)
     {
-        memcpy(&position_status_, &gps_data_[BXYZ_PSTAT], sizeof(uint16_t));
-        memcpy(&position_type_, &gps_data_[BXYZ_PTYPE], sizeof(uint16_t));
+        memcpy(&position_status_, &data[BXYZ_PSTAT], sizeof(uint16_t));
+        memcpy(&position_type_, &data[BXYZ_PTYPE], sizeof(uint16_t));
+
+        memcpy(&x_, &data[BXYZ_PX], sizeof(double));
+        memcpy(&y_, &data[BXYZ_PY], sizeof(double));
+        memcpy(&z_, &data[BXYZ_PZ], sizeof(double));
 
-        memcpy(&x_, &gps_data_[BXYZ_PX], sizeof(double));
-        memcpy(&y_, &gps_data_[BXYZ_PY], sizeof(double));
-        memcpy(&z_, &gps_data_[BXYZ_PZ], sizeof(double));
+        // Sigmas are floats on the wire, widen them into the double vectors
+        float sigma[6];
+        memcpy(&sigma[0], &data[BXYZ_sPX], sizeof(float));
+        memcpy(&sigma[1], &data[BXYZ_sPY], sizeof(float));
+        memcpy(&sigma[2], &data[BXYZ_sPZ], sizeof(float));
 
-        memcpy(&sigma_position_[0], &gps_data_[BXYZ_sPX], sizeof(float));
-        memcpy(&sigma_position_[1], &gps_data_[BXYZ_sPY], sizeof(float));
-        memcpy(&sigma_position_[2], &gps_data_[BXYZ_sPZ], sizeof(float));
+        memcpy(&velocity_status_, &data[BXYZ_VSTAT], sizeof(uint16_t));
+        memcpy(&velocity_type_, &data[BXYZ_VTYPE], sizeof(uint16_t));
 
-        memcpy(&velocity_status_, &gps_data_[BXYZ_VSTAT], sizeof(uint16_t));
-        memcpy(&velocity_type_, &gps_data_[BXYZ_VTYPE], sizeof(uint16_t));
+        memcpy(&velocity_[0], &data[BXYZ_VX], sizeof(double));
+        memcpy(&velocity_[1], &data[BXYZ_VY], sizeof(double));
+        memcpy(&velocity_[2], &data[BXYZ_VZ], sizeof(double));
 
-        memcpy(&velocity_[0], &gps_data_[BXYZ_VX], sizeof(double));
-        memcpy(&velocity_[1], &gps_data_[BXYZ_VY], sizeof(double));
-        memcpy(&velocity_[2], &gps_data_[BXYZ_VZ], sizeof(double));
+        memcpy(&sigma[3], &data[BXYZ_sVX], sizeof(float));
+        memcpy(&sigma[4], &data[BXYZ_sVY], sizeof(float));
+        memcpy(&sigma[5], &data[BXYZ_sVZ], sizeof(float));
+        sigma_position_.assign(sigma, sigma + 3);
+        sigma_velocity_.assign(sigma + 3, sigma + 6);
 
-        memcpy(&sigma_velocity_[0], &gps_data_[BXYZ_sVX], sizeof(float));
-        memcpy(&sigma_velocity_[1], &gps_data_[BXYZ_sVY], sizeof(float));
-        memcpy(&sigma_velocity_[2], &gps_data_[BXYZ_sVZ], sizeof(float));
+        // Age of the velocity: it is averaged over the last epochs
+        memcpy(&velocity_latency_, &data[BXYZ_VLATE], sizeof(float));
 
-        memcpy(&number_sat_track_, &gps_data_[BXYZ_SV], sizeof(uint8_t));
-        memcpy(&number_sat_sol_, &gps_data_[BXYZ_SOLSV], sizeof(uint8_t));
+        memcpy(&number_sat_track_, &data[BXYZ_SV], sizeof(uint8_t));
+        memcpy(&number_sat_sol_, &data[BXYZ_SOLSV], sizeof(uint8_t));
 
         // ROS_INFO("Position Solution Status = %d", position_status_);
         // ROS_INFO("Velocity Solution Status = %d", velocity_status_);
@@ -781,108 +1233,94 @@ void GPS::decode(uint16_t msg_id)
     }
     if(msg_id == BESTPOS)
     {
-        memcpy(&solution_status_, &gps_data_[BESTPOS_SOLSTAT], sizeof(uint16_t));
-        memcpy(&position_type_, &gps_data_[BESTPOS_POSTYPE], sizeof(uint16_t));
+        memcpy(&solution_status_, &data[BESTPOS_SOLSTAT], sizeof(uint16_t));
+        memcpy(&position_type_, &data[BESTPOS_POSTYPE], sizeof(uint16_t));
 
-        memcpy(&latitude_, &gps_data_[BESTPOS_LAT], sizeof(double));
-        memcpy(&longitude_, &gps_data_[BESTPOS_LONG], sizeof(double));
-        memcpy(&altitude_, &gps_data_[BESTPOS_HGT], sizeof(double));
+        memcpy(&latitude_, &data[BESTPOS_LAT], sizeof(double));
+        memcpy(&longitude_, &data[BESTPOS_LONG], sizeof(double));
+        memcpy(&altitude_, &data[BESTPOS_HGT], sizeof(double));
 
-        memcpy(&stdev_latitude_, &gps_data_[BESTPOS_SLAT], sizeof(float));
-        memcpy(&stdev_longitude_, &gps_data_[BESTPOS_SLON], sizeof(float));
-        memcpy(&stdev_altitude_, &gps_data_[BESTPOS_SHGT], sizeof(float));
+        memcpy(&stdev_latitude_, &data[BESTPOS_SLAT], sizeof(float));
+        memcpy(&stdev_longitude_, &data[BESTPOS_SLON], sizeof(float));
+        memcpy(&stdev_altitude_, &data[BESTPOS_SHGT], sizeof(float));
 
-        memcpy(&number_sat_track_, &gps_data_[BESTPOS_SV], sizeof(uint8_t));
-        memcpy(&number_sat_sol_, &gps_data_[BESTPOS_SOLNSV], sizeof(uint8_t));
+        memcpy(&number_sat_track_, &data[BESTPOS_SV], sizeof(uint8_t));
+        memcpy(&number_sat_sol_, &data[BESTPOS_SOLNSV], sizeof(uint8_t));
 
-        ROS_INFO("Sat = %d", number_sat_track_);
-        ROS_INFO("Sat sol = %d", number_sat_sol_);
+        ROS_DEBUG("Sat = %d", number_sat_track_);
+        ROS_DEBUG("Sat sol = %d", number_sat_sol_);
         covar_latitude_ = stdev_latitude_ * stdev_latitude_;
         covar_longitude_ = stdev_longitude_ * stdev_longitude_;
         covar_altitude_ = stdev_altitude_ * stdev_altitude_;
     }
     if(msg_id == SATXYZ)
     {
-        memcpy(&number_satellites_, &gps_data_[SATXYZ_NSAT], sizeof(uint32_t));
+        uint32_t satellites;
+        memcpy(&satellites, &data[SATXYZ_NSAT], sizeof(uint32_t));
+        if(!RecordsFit(satellites, SATXYZ_PRN, SATXYZ_OFFSET, size))
+        {
+            ROS_ERROR("SATXYZ: %u satellites do not fit in %u bytes", satellites, size);
+            return false;
+        }
+        number_satellites_ = satellites;
         // ROS_INFO("Number of satellites %d", number_satellites_);
         satellites_.satellites.resize(number_satellites_);
+        satellite_table_.beginSatXYZ();
 
-        for(int i = 0; i < number_satellites_; ++i)
+        for(uint32_t i = 0; i < number_satellites_; ++i)
         {
             // PRN
-            memcpy(&satellites_.satellites[i].prn_slot, &gps_data_[SATXYZ_PRN + i*SATXYZ_OFFSET], sizeof(uint32_t));
+            uint32_t prn;
+            memcpy(&prn, &data[SATXYZ_PRN + i*SATXYZ_OFFSET], sizeof(uint32_t));
+            satellites_.satellites[i].prn_slot = prn;
 
             // Satellite position
-            memcpy(&satellites_.satellites[i].position.x, &gps_data_[SATXYZ_X + i*SATXYZ_OFFSET], sizeof(double));
-            memcpy(&satellites_.satellites[i].position.y, &gps_data_[SATXYZ_Y + i*SATXYZ_OFFSET], sizeof(double));
-            memcpy(&satellites_.satellites[i].position.z, &gps_data_[SATXYZ_Z + i*SATXYZ_OFFSET], sizeof(double));
+            memcpy(&satellites_.satellites[i].position.x, &data[SATXYZ_X + i*SATXYZ_OFFSET], sizeof(double));
+            memcpy(&satellites_.satellites[i].position.y, &data[SATXYZ_Y + i*SATXYZ_OFFSET], sizeof(double));
+            memcpy(&satellites_.satellites[i].position.z, &data[SATXYZ_Z + i*SATXYZ_OFFSET], sizeof(double));
 
             // Corrections
-            memcpy(&satellites_.satellites[i].clk_corr, &gps_data_[SATXYZ_CLKCORR + i*SATXYZ_OFFSET], sizeof(double));
-            memcpy(&satellites_.satellites[i].ion_corr, &gps_data_[SATXYZ_IONCORR + i*SATXYZ_OFFSET], sizeof(double));
-            memcpy(&satellites_.satellites[i].trop_corr, &gps_data_[SATXYZ_TRPCORR + i*SATXYZ_OFFSET], sizeof(double));
+            memcpy(&satellites_.satellites[i].clk_corr, &data[SATXYZ_CLKCORR + i*SATXYZ_OFFSET], sizeof(double));
+            memcpy(&satellites_.satellites[i].ion_corr, &data[SATXYZ_IONCORR + i*SATXYZ_OFFSET], sizeof(double));
+            memcpy(&satellites_.satellites[i].trop_corr, &data[SATXYZ_TRPCORR + i*SATXYZ_OFFSET], sizeof(double));
+
+            satellite_table_.update(satellites_.satellites[i]);
         }
     }
     if(msg_id == TRACKSTAT)
     {
-        memcpy(&tracking_.solution_status, &gps_data_[TRACKSTAT_SOLSTAT], sizeof(uint32_t));
-        memcpy(&tracking_.position_type, &gps_data_[TRACKSTAT_POSTYPE], sizeof(uint32_t));
-        memcpy(&tracking_.cutoff, &gps_data_[TRACKSTAT_CUTOFF], sizeof(float));
-        memcpy(&tracking_.channels, &gps_data_[TRACKSTAT_CHAN], sizeof(int32_t));
+        uint32_t channels;
+        memcpy(&channels, &data[TRACKSTAT_CHAN], sizeof(uint32_t));
+        if(!RecordsFit(channels, TRACKSTAT_PRN, TRACKSTAT_OFFSET, size))
+        {
+            ROS_ERROR("TRACKSTAT: %u channels do not fit in %u bytes", channels, size);
+            return false;
+        }
+        memcpy(&tracking_.solution_status, &data[TRACKSTAT_SOLSTAT], sizeof(uint32_t));
+        memcpy(&tracking_.position_type, &data[TRACKSTAT_POSTYPE], sizeof(uint32_t));
+        memcpy(&tracking_.cutoff, &data[TRACKSTAT_CUTOFF], sizeof(float));
+        tracking_.channels = channels;
         // ROS_INFO("Channels = %d", tracking_.channels);
         tracking_.channel.resize(tracking_.channels);
+        satellite_table_.beginTrackStat();
 
-        for(int i = 0; i < tracking_.channels; ++i)
+        for(uint32_t i = 0; i < tracking_.channels; ++i)
         {
-            memcpy(&tracking_.channel[i].prn_slot, &gps_data_[TRACKSTAT_PRN + i*TRACKSTAT_OFFSET], sizeof(int16_t));
-            memcpy(&tracking_.channel[i].ch_tr_status, &gps_data_[TRACKSTAT_TRKSTAT + i*TRACKSTAT_OFFSET], sizeof(uint32_t));
-
-            memcpy(&tracking_.channel[i].psr, &gps_data_[TRACKSTAT_PSR + i*TRACKSTAT_OFFSET], sizeof(double));
-            memcpy(&tracking_.channel[i].doppler, &gps_data_[TRACKSTAT_DOPPLER + i*TRACKSTAT_OFFSET], sizeof(float));
-
-            memcpy(&tracking_.channel[i].cn0, &gps_data_[TRACKSTAT_CNo + i*TRACKSTAT_OFFSET], sizeof(float));
-            memcpy(&tracking_.channel[i].locktime, &gps_data_[TRACKSTAT_LOCKTIME + i*TRACKSTAT_OFFSET], sizeof(float));
-
-            memcpy(&tracking_.channel[i].psr_res, &gps_data_[TRACKSTAT_PSRRES + i*TRACKSTAT_OFFSET], sizeof(float));
-            memcpy(&tracking_.channel[i].psr_weight, &gps_data_[TRACKSTAT_PSRW + i*TRACKSTAT_OFFSET], sizeof(float));
-
-            tracking_.channel[i].tracking_status.trck_state          = (tracking_.channel[i].ch_tr_status & 0x00000001) |
-                                                                       (tracking_.channel[i].ch_tr_status & 0x00000002) |
-                                                                       (tracking_.channel[i].ch_tr_status & 0x00000004) |
-                                                                       (tracking_.channel[i].ch_tr_status & 0x00000008) |
-                                                                       (tracking_.channel[i].ch_tr_status & 0x00000010);
-
-            tracking_.channel[i].tracking_status.channel_number      = ((tracking_.channel[i].ch_tr_status & 0x00000020)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00000040)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00000080)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00000100)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00000200)) >> 5;
-
-            tracking_.channel[i].tracking_status.phase_lock          = ((tracking_.channel[i].ch_tr_status & 0x00000400) >> 10);
-            tracking_.channel[i].tracking_status.parity_known        = ((tracking_.channel[i].ch_tr_status & 0x00000800) >> 11);
-            tracking_.channel[i].tracking_status.code_lock           = ((tracking_.channel[i].ch_tr_status & 0x00001000) >> 12);
-
-            tracking_.channel[i].tracking_status.correlator_type     = ((tracking_.channel[i].ch_tr_status & 0x00002000)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00004000)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00008000)) >> 13;
-
-            tracking_.channel[i].tracking_status.satellite_system    = ((tracking_.channel[i].ch_tr_status & 0x00010000)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00020000)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00040000)) >> 16;
-
-            tracking_.channel[i].tracking_status.grouping            = ((tracking_.channel[i].ch_tr_status & 0x00100000) >> 20);
-
-            tracking_.channel[i].tracking_status.singal_type         = ((tracking_.channel[i].ch_tr_status & 0x00200000)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00400000)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x00800000)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x01000000)  |
-                                                                        (tracking_.channel[i].ch_tr_status & 0x02000000)) >> 21;
-
-            tracking_.channel[i].tracking_status.fec                 = ((tracking_.channel[i].ch_tr_status & 0x04000000) >> 26);
-            tracking_.channel[i].tracking_status.primary_l1          = ((tracking_.channel[i].ch_tr_status & 0x08000000) >> 27);
-            tracking_.channel[i].tracking_status.half_cycle_added    = ((tracking_.channel[i].ch_tr_status & 0x10000000) >> 28);
-            tracking_.channel[i].tracking_status.prn_lock            = ((tracking_.channel[i].ch_tr_status & 0x40000000) >> 30);
-            tracking_.channel[i].tracking_status.channel_assignment  = ((tracking_.channel[i].ch_tr_status & 0x80000000) >> 31);
+            memcpy(&tracking_.channel[i].prn_slot, &data[TRACKSTAT_PRN + i*TRACKSTAT_OFFSET], sizeof(int16_t));
+            memcpy(&tracking_.channel[i].ch_tr_status, &data[TRACKSTAT_TRKSTAT + i*TRACKSTAT_OFFSET], sizeof(uint32_t));
+
+            memcpy(&tracking_.channel[i].psr, &data[TRACKSTAT_PSR + i*TRACKSTAT_OFFSET], sizeof(double));
+            memcpy(&tracking_.channel[i].doppler, &data[TRACKSTAT_DOPPLER + i*TRACKSTAT_OFFSET], sizeof(float));
+
+            memcpy(&tracking_.channel[i].cn0, &data[TRACKSTAT_CNo + i*TRACKSTAT_OFFSET], sizeof(float));
+            memcpy(&tracking_.channel[i].locktime, &data[TRACKSTAT_LOCKTIME + i*TRACKSTAT_OFFSET], sizeof(float));
+
+            memcpy(&tracking_.channel[i].psr_res, &data[TRACKSTAT_PSRRES + i*TRACKSTAT_OFFSET], sizeof(float));
+            memcpy(&tracking_.channel[i].reject, &data[TRACKSTAT_REJECT + i*TRACKSTAT_OFFSET], sizeof(uint32_t));
+            memcpy(&tracking_.channel[i].psr_weight, &data[TRACKSTAT_PSRW + i*TRACKSTAT_OFFSET], sizeof(float));
+
+            DecodeTrackingStatus(tracking_.channel[i].ch_tr_status, tracking_.channel[i].tracking_status);
+            satellite_table_.update(tracking_.channel[i]);
             // ROS_INFO("Satellite: %d", prn_);
             // ROS_INFO("with Pseudorange: %f", psr_);
             // ROS_INFO("with Doppler: %f", doppler_);
@@ -893,65 +1331,105 @@ void GPS::decode(uint16_t msg_id)
     }
     if(msg_id == RANGE)
     {
-        memcpy(&pseudorange_.obs, &gps_data_[RANGE_OBS], sizeof(uint16_t));
-        ROS_INFO("Number of observations: %d", pseudorange_.obs);
+        uint32_t obs;
+        memcpy(&obs, &data[RANGE_OBS], sizeof(uint32_t));
+        if(!RecordsFit(obs, RANGE_PRN, RANGE_OFFSET, size))
+        {
+            ROS_ERROR("RANGE: %u observations do not fit in %u bytes", obs, size);
+            return false;
+        }
+        pseudorange_.obs = obs;
+        ROS_DEBUG("Number of observations: %d", pseudorange_.obs);
         pseudorange_.ranges.resize(pseudorange_.obs);
+        satellite_table_.beginRange();
 
         for(int i = 0; i < pseudorange_.obs; ++i)
         {
-            memcpy(&pseudorange_.ranges[i].prn_slot, &gps_data_[RANGE_PRN + i*RANGE_OFFSET], sizeof(uint16_t));
-
-            memcpy(&pseudorange_.ranges[i].psr, &gps_data_[RANGE_PSR + i*RANGE_OFFSET], sizeof(double));
-            memcpy(&pseudorange_.ranges[i].psr_std, &gps_data_[RANGE_PSR_STD + i*RANGE_OFFSET], sizeof(float));
+            memcpy(&pseudorange_.ranges[i].prn_slot, &data[RANGE_PRN + i*RANGE_OFFSET], sizeof(uint16_t));
 
-            memcpy(&pseudorange_.ranges[i].adr, &gps_data_[RANGE_ADR + i*RANGE_OFFSET], sizeof(double));
-            memcpy(&pseudorange_.ranges[i].adr_std, &gps_data_[RANGE_ADR_STD + i*RANGE_OFFSET], sizeof(float));
+            memcpy(&pseudorange_.ranges[i].psr, &data[RANGE_PSR + i*RANGE_OFFSET], sizeof(double));
+            memcpy(&pseudorange_.ranges[i].psr_std, &data[RANGE_PSR_STD + i*RANGE_OFFSET], sizeof(float));
 
-            memcpy(&pseudorange_.ranges[i].doppler, &gps_data_[RANGE_DOPPLER + i*RANGE_OFFSET], sizeof(float));
+            memcpy(&pseudorange_.ranges[i].adr, &data[RANGE_ADR + i*RANGE_OFFSET], sizeof(double));
+            memcpy(&pseudorange_.ranges[i].adr_std, &data[RANGE_ADR_STD + i*RANGE_OFFSET], sizeof(float));
 
-            memcpy(&pseudorange_.ranges[i].c_no, &gps_data_[RANGE_CNo + i*RANGE_OFFSET], sizeof(float));
-            memcpy(&pseudorange_.ranges[i].locktime, &gps_data_[RANGE_LOCKTIME + i*RANGE_OFFSET], sizeof(float));
-            memcpy(&pseudorange_.ranges[i].ch_tr_status, &gps_data_[RANGE_TRKSTART + i*RANGE_OFFSET], sizeof(uint32_t));
+            memcpy(&pseudorange_.ranges[i].doppler, &data[RANGE_DOPPLER + i*RANGE_OFFSET], sizeof(float));
 
-            pseudorange_.ranges[i].tracking_status.trck_state          = (pseudorange_.ranges[i].ch_tr_status & 0x00000001) |
-                                                                         (pseudorange_.ranges[i].ch_tr_status & 0x00000002) |
-                                                                         (pseudorange_.ranges[i].ch_tr_status & 0x00000004) |
-                                                                         (pseudorange_.ranges[i].ch_tr_status & 0x00000008) |
-                                                                         (pseudorange_.ranges[i].ch_tr_status & 0x00000010);
+            memcpy(&pseudorange_.ranges[i].c_no, &data[RANGE_CNo + i*RANGE_OFFSET], sizeof(float));
+            memcpy(&pseudorange_.ranges[i].locktime, &data[RANGE_LOCKTIME + i*RANGE_OFFSET], sizeof(float));
+            memcpy(&pseudorange_.ranges[i].ch_tr_status, &data[RANGE_TRKSTART + i*RANGE_OFFSET], sizeof(uint32_t));
 
-            pseudorange_.ranges[i].tracking_status.channel_number      = ((pseudorange_.ranges[i].ch_tr_status & 0x00000020)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00000040)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00000080)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00000100)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00000200)) >> 5;
-
-            pseudorange_.ranges[i].tracking_status.phase_lock          = ((pseudorange_.ranges[i].ch_tr_status & 0x00000400) >> 10);
-            pseudorange_.ranges[i].tracking_status.parity_known        = ((pseudorange_.ranges[i].ch_tr_status & 0x00000800) >> 11);
-            pseudorange_.ranges[i].tracking_status.code_lock           = ((pseudorange_.ranges[i].ch_tr_status & 0x00001000) >> 12);
-
-            pseudorange_.ranges[i].tracking_status.correlator_type     = ((pseudorange_.ranges[i].ch_tr_status & 0x00002000)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00004000)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00008000)) >> 13;
+            DecodeTrackingStatus(pseudorange_.ranges[i].ch_tr_status, pseudorange_.ranges[i].tracking_status);
+        }
+        finishRange();
+    }
+    if(msg_id == RANGECMP)
+    {
+        uint32_t obs;
+        memcpy(&obs, &data[RANGECMP_OBS], sizeof(uint32_t));
+        if(!RecordsFit(obs, RANGECMP_REC, RANGECMP_OFFSET, size))
+        {
+            ROS_ERROR("RANGECMP: %u observations do not fit in %u bytes", obs, size);
+            return false;
+        }
+        pseudorange_.obs = obs;
+        pseudorange_.ranges.resize(pseudorange_.obs);
+        satellite_table_.beginRange();
 
-            pseudorange_.ranges[i].tracking_status.satellite_system    = ((pseudorange_.ranges[i].ch_tr_status & 0x00010000)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00020000)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00040000)) >> 16;
+        uint64_t words[3];
+        for(int i = 0; i < pseudorange_.obs; ++i)
+        {
+            novatel_gps::RangeInformation& range = pseudorange_.ranges[i];
+
+            // Load the 24 byte packed record once, then slice fields out of the words
+            memcpy(words, &data[RANGECMP_REC + i*RANGECMP_OFFSET], sizeof(words));
+
+            range.ch_tr_status = static_cast<uint32_t>(ExtractBits(words, 0, 32));
+            range.doppler  = SignExtend(ExtractBits(words, 32, 28), 28) / 256.0;
+            range.psr      = ExtractBits(words, 60, 36) / 128.0;
+            range.psr_std  = RANGECMP_PSR_STD[ExtractBits(words, 128, 4)];
+            range.adr_std  = (ExtractBits(words, 132, 4) + 1) / 512.0;
+            range.prn_slot = static_cast<int16_t>(ExtractBits(words, 136, 8));
+            range.locktime = ExtractBits(words, 144, 21) / 32.0;
+            range.c_no     = ExtractBits(words, 165, 5) + 20;
+
+            // ADR is sent modulo ADR_ROLLOVER cycles, restore it from the pseudorange
+            double adr = SignExtend(ExtractBits(words, 96, 32), 32) / 256.0;
+            double rolls = (range.psr / CarrierWavelength(range.ch_tr_status) + adr) / ADR_ROLLOVER;
+            range.adr = adr - ADR_ROLLOVER * std::floor(rolls + 0.5);
+
+            DecodeTrackingStatus(range.ch_tr_status, range.tracking_status);
+        }
+        finishRange();
+    }
+    if(msg_id == INSPVA || msg_id == INSPVAS)
+    {
+        memcpy(&ins_latitude_, &data[INSPVA_LAT], sizeof(double));
+        memcpy(&ins_longitude_, &data[INSPVA_LON], sizeof(double));
+        memcpy(&ins_height_, &data[INSPVA_HGT], sizeof(double));
 
-            pseudorange_.ranges[i].tracking_status.grouping            = ((pseudorange_.ranges[i].ch_tr_status & 0x00100000) >> 20);
+        memcpy(&ins_velocity_[0], &data[INSPVA_NVEL], sizeof(double));
+        memcpy(&ins_velocity_[1], &data[INSPVA_EVEL], sizeof(double));
+        memcpy(&ins_velocity_[2], &data[INSPVA_UVEL], sizeof(double));
 
-            pseudorange_.ranges[i].tracking_status.singal_type         = ((pseudorange_.ranges[i].ch_tr_status & 0x00200000)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00400000)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x00800000)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x01000000)  |
-                                                                          (pseudorange_.ranges[i].ch_tr_status & 0x02000000)) >> 21;
+        memcpy(&ins_attitude_[0], &data[INSPVA_ROLL], sizeof(double));
+        memcpy(&ins_attitude_[1], &data[INSPVA_PITCH], sizeof(double));
+        memcpy(&ins_attitude_[2], &data[INSPVA_AZIMUTH], sizeof(double));
 
-            pseudorange_.ranges[i].tracking_status.fec                 = ((pseudorange_.ranges[i].ch_tr_status & 0x04000000) >> 26);
-            pseudorange_.ranges[i].tracking_status.primary_l1          = ((pseudorange_.ranges[i].ch_tr_status & 0x08000000) >> 27);
-            pseudorange_.ranges[i].tracking_status.half_cycle_added    = ((pseudorange_.ranges[i].ch_tr_status & 0x10000000) >> 28);
-            pseudorange_.ranges[i].tracking_status.prn_lock            = ((pseudorange_.ranges[i].ch_tr_status & 0x40000000) >> 30);
-            pseudorange_.ranges[i].tracking_status.channel_assignment  = ((pseudorange_.ranges[i].ch_tr_status & 0x80000000) >> 31);
-        }
+        memcpy(&ins_status_, &data[INSPVA_STATUS], sizeof(uint32_t));
     }
+    if(msg_id == CORRIMUDATA || msg_id == CORRIMUDATAS)
+    {
+        // Increments over one IMU sample (rad, m/s)
+        memcpy(&imu_angular_[0], &data[CORRIMU_PITCHRATE], sizeof(double));
+        memcpy(&imu_angular_[1], &data[CORRIMU_ROLLRATE], sizeof(double));
+        memcpy(&imu_angular_[2], &data[CORRIMU_YAWRATE], sizeof(double));
+
+        memcpy(&imu_linear_[0], &data[CORRIMU_LATACC], sizeof(double));
+        memcpy(&imu_linear_[1], &data[CORRIMU_LONACC], sizeof(double));
+        memcpy(&imu_linear_[2], &data[CORRIMU_VERTACC], sizeof(double));
+    }
+    return true;
 }
 /*
 void GPS::print_formatted()
@@ -978,6 +1456,37 @@ void GPS::close()
 {
     int err;
 
+    stopReading();
+
+    if(recorder_)
+        recorder_->close();
+    // Writes out the queued epochs
+    rinex_.reset();
+    // Writes the last chunks and the index
+    if(archive_)
+    {
+        archive_->close();
+        ROS_INFO("archive: %lu rows, %.1f MB, %lu rows dropped", (unsigned long)archive_->rows(),
+                 archive_->bytes()/1e6, (unsigned long)archive_->dropped());
+    }
+    archive_.reset();
+    archive_sink_ = NULL;
+
+    GpsShmClose(&shm_);
+
+    // Replaying, parse() only (gps_decode) or already closed
+    if(replay_ || !port_open_)
+        return;
+
+    // Leave every port taking commands for the next start
+    if(!correction_port_.empty())
+    {
+        std::string mode = "INTERFACEMODE " + correction_port_ + " NOVATEL NOVATEL ON";
+        command(mode.c_str());
+    }
+    command("INTERFACEMODE COM1 NOVATEL NOVATEL ON");
+
+    port_open_ = false;
     if((err = serialcom_close(&gps_SerialPortConfig_)) != SERIALCOM_SUCCESS)
     {
         ROS_ERROR_STREAM("serialcom_close failed " << err);
@@ -990,6 +1499,9 @@ void GPS::configure()
 {
     int err;
 
+    // Undo an input mode a previous run may have left on the command port
+    command("INTERFACEMODE COM1 NOVATEL NOVATEL ON");
+
     // GPS should be configured to 9600 and change to 115200 during execution
     char buffer[100];
     // sprintf(buffer, "COM COM1,%d,N,8,1,N,OFF,ON", OLD_BPS);
@@ -1009,6 +1521,7 @@ void GPS::configure()
         ROS_ERROR_STREAM("serialcom_init failed " << err);
         throwSerialComException(err);
     }
+    tunePort();
 
     // GPS time should be set approximately
     if(!getApproxTime())
@@ -1029,31 +1542,26 @@ void GPS::configure()
 void GPS::receiveDataFromGPS(novatel_gps::LogAll* output_logall, novatel_gps::GpsXYZ *output_xyz)
 {
     readDataFromReceiver();
+    getData(output_logall);
+    getData(output_xyz);
+}
+
+void GPS::getData(novatel_gps::LogAll* output_logall)
+{
     output_logall->msg_header = this->msg_header_;
     output_logall->range_log = pseudorange_;
     output_logall->sat_log = satellites_;
     output_logall->track_log = tracking_;
-
-    output_xyz->position.position.x = x_;
-    output_xyz->position.position.y = y_;
-    output_xyz->position.position.z = z_;
-
-    output_xyz->velocity.velocity.x = velocity_[0];
-    output_xyz->velocity.velocity.y = velocity_[1];
-    output_xyz->velocity.velocity.z = velocity_[2];
-
-    output_xyz->position.covariance[0] = sigma_position_[0];
-    output_xyz->position.covariance[4] = sigma_position_[1];
-    output_xyz->position.covariance[8] = sigma_position_[2];
-
-    output_xyz->velocity.covariance[0] = sigma_velocity_[0];
-    output_xyz->velocity.covariance[4] = sigma_velocity_[1];
-    output_xyz->velocity.covariance[8] = sigma_velocity_[2];
 }
 
 void GPS::receiveDataFromGPS(sensor_msgs::NavSatFix *output)
 {
     readDataFromReceiver();
+    getData(output);
+}
+
+void GPS::getData(sensor_msgs::NavSatFix *output)
+{
     output->latitude  = latitude_;
     output->longitude = longitude_;
     output->altitude  = altitude_;
@@ -1063,8 +1571,9 @@ void GPS::receiveDataFromGPS(sensor_msgs::NavSatFix *output)
     else
         output->status.status = sensor_msgs::NavSatStatus::STATUS_NO_FIX;
 
-    output->position_covariance[0] = covar_latitude_;
-    output->position_covariance[4] = covar_longitude_;
+    // NavSatFix covariance is east, north, up
+    output->position_covariance[0] = covar_longitude_;
+    output->position_covariance[4] = covar_latitude_;
     output->position_covariance[8] = covar_altitude_;
 
     output->position_covariance_type = sensor_msgs::NavSatFix::COVARIANCE_TYPE_DIAGONAL_KNOWN;
@@ -1073,6 +1582,11 @@ void GPS::receiveDataFromGPS(sensor_msgs::NavSatFix *output)
 void GPS::receiveDataFromGPS(novatel_gps::GpsXYZ *output)
 {
     readDataFromReceiver();
+    getData(output);
+}
+
+void GPS::getData(novatel_gps::GpsXYZ *output)
+{
     output->position.position.x = x_;
     output->position.position.y = y_;
     output->position.position.z = z_;
@@ -1090,6 +1604,291 @@ void GPS::receiveDataFromGPS(novatel_gps::GpsXYZ *output)
     output->velocity.covariance[8] = sigma_velocity_[2];
 }
 
+void GPS::getData(novatel_gps::SatelliteStateArray *output)
+{
+    satellite_table_.fill(output);
+}
+
+void GPS::getData(sensor_msgs::Imu *output)
+{
+    double q[4];
+    AttitudeToQuaternion(ins_attitude_[0], ins_attitude_[1], ins_attitude_[2], q);
+    output->orientation.x = q[0];
+    output->orientation.y = q[1];
+    output->orientation.z = q[2];
+    output->orientation.w = q[3];
+
+    // CORRIMUDATA holds increments per IMU sample, scale them to rates
+    output->angular_velocity.x = imu_angular_[0]*imu_rate_;
+    output->angular_velocity.y = imu_angular_[1]*imu_rate_;
+    output->angular_velocity.z = imu_angular_[2]*imu_rate_;
+
+    output->linear_acceleration.x = imu_linear_[0]*imu_rate_;
+    output->linear_acceleration.y = imu_linear_[1]*imu_rate_;
+    output->linear_acceleration.z = imu_linear_[2]*imu_rate_;
+}
+
+void GPS::getGeodetic(sensor_msgs::NavSatFix *output)
+{
+    output->latitude  = xyz_geodetic_[0];
+    output->longitude = xyz_geodetic_[1];
+    // Height above the ellipsoid, as NavSatFix specifies (BESTPOS gives it above MSL)
+    output->altitude  = xyz_geodetic_[2];
+
+    if(position_status_ == novatel_gps::SolStat::SOL_COMPUTED)
+        output->status.status = sensor_msgs::NavSatStatus::STATUS_FIX;
+    else
+        output->status.status = sensor_msgs::NavSatStatus::STATUS_NO_FIX;
+
+    for(int i = 0; i < 9; ++i)
+        output->position_covariance[i] = xyz_geodetic_cov_[i];
+    output->position_covariance_type = sensor_msgs::NavSatFix::COVARIANCE_TYPE_KNOWN;
+}
+
+void GPS::getData(novatel_gps::SatelliteGeometry *output)
+{
+    geometry_engine_.fill(output);
+}
+
+void GPS::getData(novatel_gps::SmoothedRanges *output)
+{
+    uint16_t week = range_epoch_/GPS_SECONDS_IN_WEEK;
+    output->gps_week = week;
+    output->gps_seconds = range_epoch_ - week*GPS_SECONDS_IN_WEEK;
+
+    size_t n = pseudorange_.obs;
+    output->system.resize(n);
+    output->prn_slot.resize(n);
+    output->signal.resize(n);
+    output->psr.resize(n);
+    output->length.resize(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        const novatel_gps::RangeInformation& range = pseudorange_.ranges[i];
+        int length;
+        output->system[i] = SatelliteSystem(range.ch_tr_status);
+        output->prn_slot[i] = range.prn_slot;
+        output->signal[i] = SignalSlot(range.ch_tr_status);
+        output->psr[i] = hatch_filter_.smoothed(range, &length);
+        output->length[i] = length;
+    }
+}
+
+void GPS::getData(novatel_gps::PointSolution *output)
+{
+    uint16_t week = point_time_/GPS_SECONDS_IN_WEEK;
+    output->gps_week = week;
+    output->gps_seconds = point_time_ - week*GPS_SECONDS_IN_WEEK;
+
+    output->valid = point_fix_.valid;
+    output->position.x = point_fix_.position[0];
+    output->position.y = point_fix_.position[1];
+    output->position.z = point_fix_.position[2];
+    for(int i = 0; i < 9; ++i)
+        output->covariance[i] = point_fix_.covariance[i];
+
+    output->clock = point_fix_.clock;
+    output->satellites = point_fix_.satellites;
+    output->iterations = point_fix_.iterations;
+    output->residual_rms = point_fix_.residual_rms;
+    output->bestxyz_difference = point_difference_;
+    output->consistent = !std::isnan(point_difference_) && point_difference_ <= point_threshold_;
+}
+
+void GPS::getData(geometry_msgs::PoseWithCovarianceStamped *output)
+{
+    output->pose.pose.position.x = xyz_enu_[0];
+    output->pose.pose.position.y = xyz_enu_[1];
+    output->pose.pose.position.z = xyz_enu_[2];
+    output->pose.pose.orientation.x = 0.0;
+    output->pose.pose.orientation.y = 0.0;
+    output->pose.pose.orientation.z = 0.0;
+    output->pose.pose.orientation.w = 1.0;
+
+    for(int i = 0; i < 3; ++i)
+        for(int j = 0; j < 3; ++j)
+            output->pose.covariance[6*i + j] = xyz_enu_cov_[3*i + j];
+    // A single antenna does not observe orientation
+    for(int i = 3; i < 6; ++i)
+        output->pose.covariance[7*i] = 1e6;
+}
+
+void GPS::getData(nav_msgs::Odometry *output)
+{
+    double ecef[3], enu[3];
+    LlaToEcef(ins_latitude_*DEG2RAD, ins_longitude_*DEG2RAD, ins_height_, ecef);
+
+    // Local ENU frame anchored at the first INS solution
+    if(!have_ins_origin_)
+    {
+        ins_origin_.assign(ecef, ecef + 3);
+        EnuRotation(ins_latitude_*DEG2RAD, ins_longitude_*DEG2RAD, ins_enu_rotation_.data());
+        have_ins_origin_ = true;
+    }
+    EcefToEnu(ecef, ins_origin_.data(), ins_enu_rotation_.data(), enu);
+
+    output->pose.pose.position.x = enu[0];
+    output->pose.pose.position.y = enu[1];
+    output->pose.pose.position.z = enu[2];
+
+    double q[4];
+    AttitudeToQuaternion(ins_attitude_[0], ins_attitude_[1], ins_attitude_[2], q);
+    output->pose.pose.orientation.x = q[0];
+    output->pose.pose.orientation.y = q[1];
+    output->pose.pose.orientation.z = q[2];
+    output->pose.pose.orientation.w = q[3];
+
+    // Twist is expressed in the vehicle frame: v_body = R(q)^T v_enu
+    double v[3] = { ins_velocity_[1], ins_velocity_[0], ins_velocity_[2] };
+    double x = q[0], y = q[1], z = q[2], w = q[3];
+    double R[9] = { 1 - 2*(y*y + z*z), 2*(x*y - w*z),     2*(x*z + w*y),
+                    2*(x*y + w*z),     1 - 2*(x*x + z*z), 2*(y*z - w*x),
+                    2*(x*z - w*y),     2*(y*z + w*x),     1 - 2*(x*x + y*y) };
+    output->twist.twist.linear.x = R[0]*v[0] + R[3]*v[1] + R[6]*v[2];
+    output->twist.twist.linear.y = R[1]*v[0] + R[4]*v[1] + R[7]*v[2];
+    output->twist.twist.linear.z = R[2]*v[0] + R[5]*v[1] + R[8]*v[2];
+
+    output->twist.twist.angular.x = imu_angular_[0]*imu_rate_;
+    output->twist.twist.angular.y = imu_angular_[1]*imu_rate_;
+    output->twist.twist.angular.z = imu_angular_[2]*imu_rate_;
+}
+
+void GPS::setBaudRate(int baud)
+{
+    BPS = baud;
+}
+
+void GPS::setImuRate(double rate)
+{
+    imu_rate_ = rate;
+}
+
+void GPS::setPortTuning(const PortTuning& tuning)
+{
+    port_tuning_ = tuning;
+}
+
+void GPS::setReaderTuning(const ThreadTuning& tuning)
+{
+    reader_tuning_ = tuning;
+}
+
+void GPS::setCorrectionInput(const std::string& port)
+{
+    if(port == "COM1")
+    {
+        ROS_ERROR("corrections: COM1 is the command port, RTCMV3 input there would lock out commands");
+        correction_port_.clear();
+        return;
+    }
+    correction_port_ = port;
+}
+
+void GPS::enableCorrectionInput()
+{
+    if(correction_port_.empty())
+        return;
+    std::string mode = "INTERFACEMODE " + correction_port_ + " RTCMV3 NONE OFF";
+    command(mode.c_str());
+}
+
+void GPS::tunePort()
+{
+    int fd = gps_SerialPortConfig_.fd;
+    std::string report;
+    char buf[64];
+
+    // Kernel tty side: hand each received byte up without the tty's batching
+    if(port_tuning_.low_latency)
+    {
+        struct serial_struct serial;
+        if(ioctl(fd, TIOCGSERIAL, &serial) == 0)
+        {
+            serial.flags |= ASYNC_LOW_LATENCY;
+            if(ioctl(fd, TIOCSSERIAL, &serial) == 0)
+                report += " low_latency on,";
+            else
+                ROS_WARN("could not set ASYNC_LOW_LATENCY: %s", strerror(errno));
+        }
+        else
+        {
+            ROS_WARN("port does not support TIOCGSERIAL: %s", strerror(errno));
+        }
+    }
+
+    // FTDI adapters hold partial USB packets for latency_timer ms (16 by default)
+    if(port_tuning_.latency_timer >= 0)
+    {
+        char real[PATH_MAX];
+        std::string device = realpath(serial_port_.c_str(), real) ? real : serial_port_;
+        std::string path = "/sys/bus/usb-serial/devices/" + device.substr(device.rfind('/') + 1) + "/latency_timer";
+
+        int before = -1;
+        std::ifstream in(path.c_str());
+        if(in >> before)
+        {
+            std::ofstream out(path.c_str());
+            out << port_tuning_.latency_timer << std::endl;
+            if(out)
+            {
+                snprintf(buf, sizeof(buf), " latency_timer %d -> %d ms,", before, port_tuning_.latency_timer);
+                report += buf;
+            }
+            else
+            {
+                ROS_WARN("could not write %s (latency_timer stays %d ms)", path.c_str(), before);
+            }
+        }
+        else
+        {
+            ROS_WARN("%s not found, not an FTDI adapter?", path.c_str());
+        }
+    }
+
+    // Read semantics: deliver partial frames as soon as bytes arrive
+    if(port_tuning_.vmin >= 0 || port_tuning_.vtime >= 0)
+    {
+        struct termios tio;
+        bool ok = (tcgetattr(fd, &tio) == 0);
+        if(ok)
+        {
+            if(port_tuning_.vmin >= 0)
+                tio.c_cc[VMIN] = port_tuning_.vmin;
+            if(port_tuning_.vtime >= 0)
+                tio.c_cc[VTIME] = port_tuning_.vtime;
+            ok = (tcsetattr(fd, TCSANOW, &tio) == 0);
+        }
+        if(ok)
+        {
+            snprintf(buf, sizeof(buf), " VMIN %d VTIME %d,", tio.c_cc[VMIN], tio.c_cc[VTIME]);
+            report += buf;
+            // A frame shorter than VMIN waits for the next one or the VTIME timer
+            if(tio.c_cc[VMIN] > 1)
+                ROS_WARN("VMIN %d holds back frames shorter than %d bytes, use 1 (or 0 with nonblocking)",
+                         tio.c_cc[VMIN], tio.c_cc[VMIN]);
+        }
+        else
+        {
+            ROS_WARN("could not set VMIN/VTIME: %s", strerror(errno));
+        }
+    }
+
+    if(port_tuning_.nonblocking)
+    {
+        int flags = fcntl(fd, F_GETFL);
+        if(flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0)
+            report += " non-blocking,";
+        else
+            ROS_WARN("could not make the port non-blocking: %s", strerror(errno));
+    }
+
+    if(!report.empty())
+    {
+        report.erase(report.size() - 1);
+        ROS_INFO("Port tuning:%s", report.c_str());
+    }
+}
+
 
 void GPS::throwSerialComException(int err)
 {
@@ -1138,6 +1937,9 @@ void GPS::command(const char* command)
     int i;
     int len = strlen(command);
 
+    if(replay_)
+        return;
+
     // Echo
     ROS_INFO("Sending command: %s", command);
     for(i = 0; i < len; i++)
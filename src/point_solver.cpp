@@ -0,0 +1,232 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "point_solver.h"
+
+#define EARTH_ROTATION      7.2921151467e-5     // rad/s (WGS84)
+
+#define SOLVER_MAX_ITERATIONS   10
+#define SOLVER_CONVERGED        1e-4            // m
+// The elevation mask needs an estimate near the surface (m from the centre)
+#define SOLVER_MASK_RADIUS      6.0e6
+// Lower bound on psr_std so one range cannot take all the weight
+#define SOLVER_MIN_PSR_STD      0.1
+
+/* --------------------------------------------------------------------------
+Cholesky factor L of a symmetric positive definite N of size n (row stride
+SOLVER_UNKNOWNS), in place in the lower triangle. False if N is not
+positive definite.
+-------------------------------------------------------------------------- */
+static bool CholeskyFactor(double N[][SOLVER_UNKNOWNS], int n)
+{
+    for(int j = 0; j < n; ++j)
+    {
+        double d = N[j][j];
+        for(int k = 0; k < j; ++k)
+            d -= N[j][k]*N[j][k];
+        if(d <= 0.0)
+            return false;
+        N[j][j] = std::sqrt(d);
+        for(int i = j + 1; i < n; ++i)
+        {
+            double s = N[i][j];
+            for(int k = 0; k < j; ++k)
+                s -= N[i][k]*N[j][k];
+            N[i][j] = s/N[j][j];
+        }
+    }
+    return true;
+}
+
+// Solves L L^T x = b in place: L y = b, then L^T x = y
+static void CholeskySubstitute(const double L[][SOLVER_UNKNOWNS], double b[], int n)
+{
+    for(int i = 0; i < n; ++i)
+    {
+        for(int k = 0; k < i; ++k)
+            b[i] -= L[i][k]*b[k];
+        b[i] /= L[i][i];
+    }
+    for(int i = n - 1; i >= 0; --i)
+    {
+        for(int k = i + 1; k < n; ++k)
+            b[i] -= L[k][i]*b[k];
+        b[i] /= L[i][i];
+    }
+}
+
+/* --------------------------------------------------------------------------
+Geometric range from x to the satellite, and the unit vector towards it. The
+satellite is rotated with the Earth over the travel time (Sagnac), the
+rotation is small enough for its first order.
+-------------------------------------------------------------------------- */
+static double SatelliteRange(const SolverObservation& o, const double x[3], double los[3])
+{
+    double dx = o.satellite[0] - x[0], dy = o.satellite[1] - x[1], dz = o.satellite[2] - x[2];
+    double theta = EARTH_ROTATION*std::sqrt(dx*dx + dy*dy + dz*dz)/SPEED_OF_LIGHT;
+    double d[3] = { dx + theta*o.satellite[1], dy - theta*o.satellite[0], dz };
+    double range = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    for(int i = 0; i < 3; ++i)
+        los[i] = d[i]/range;
+    return range;
+}
+
+PointSolver::PointSolver() :
+    count_(0),
+    sin_mask_(std::sin(10.0*M_PI/180.0)),
+    have_position_(false)
+{
+    memset(position_, 0, sizeof(position_));
+}
+
+void PointSolver::configure(double elevation_mask)
+{
+    sin_mask_ = std::sin(elevation_mask*M_PI/180.0);
+}
+
+/* --------------------------------------------------------------------------
+Corrected L1 pseudoranges of the GPS satellites in both the latest RANGE and
+the latest SATXYZ, leaving out those TRACKSTAT rejects when it is current.
+-------------------------------------------------------------------------- */
+int PointSolver::collect(const SatelliteTable& table)
+{
+    count_ = 0;
+
+    uint32_t range_generation = table.rangeGeneration();
+    uint32_t satxyz_generation = table.satxyzGeneration();
+    uint32_t trackstat_generation = table.trackstatGeneration();
+    if(range_generation == 0 || satxyz_generation == 0)
+        return 0;
+
+    for(int i = 0; i < MAX_SATELLITES; ++i)
+    {
+        const SatelliteState* s = &table.entry(i);
+        // Only GPS satellites have SATXYZ positions
+        if(s->system != SYSTEM_GPS)
+            continue;
+        const SignalState& l1 = s->signal[SIGNAL_L1];
+        if(l1.generation != range_generation || s->satxyz_generation != satxyz_generation || l1.psr == 0.0)
+            continue;
+        if(trackstat_generation != 0 && s->trackstat_generation == trackstat_generation &&
+           s->reject != novatel_gps::TrackStatChannel::GOOD)
+            continue;
+
+        SolverObservation& o = observations_[count_++];
+        memcpy(o.satellite, s->position, sizeof(o.satellite));
+        o.range = l1.psr + s->clk_corr - s->ion_corr - s->trop_corr;
+        double sigma = (l1.psr_std > SOLVER_MIN_PSR_STD) ? l1.psr_std : SOLVER_MIN_PSR_STD;
+        o.weight = 1.0/(sigma*sigma);
+    }
+    return count_;
+}
+
+bool PointSolver::solve(const SatelliteTable& table, PointFix* fix)
+{
+    fix->valid = false;
+    fix->satellites = 0;
+    fix->iterations = 0;
+    fix->residual_rms = std::numeric_limits<double>::quiet_NaN();
+    fix->clock = std::numeric_limits<double>::quiet_NaN();
+
+    collect(table);
+
+    double x[SOLVER_UNKNOWNS] = { 0 };
+    if(have_position_)
+        memcpy(x, position_, sizeof(position_));
+
+    double N[SOLVER_UNKNOWNS][SOLVER_UNKNOWNS];
+    const int n = SOLVER_UNKNOWNS;
+    int used = 0;
+    bool converged = false;
+    for(int iteration = 1; iteration <= SOLVER_MAX_ITERATIONS && !converged; ++iteration)
+    {
+        double b[SOLVER_UNKNOWNS] = { 0 };
+        memset(N, 0, sizeof(N));
+
+        double radius = std::sqrt(x[0]*x[0] + x[1]*x[1] + x[2]*x[2]);
+        bool mask = radius > SOLVER_MASK_RADIUS;
+
+        used = 0;
+        for(int k = 0; k < count_; ++k)
+        {
+            const SolverObservation& o = observations_[k];
+
+            double los[3];
+            double range = SatelliteRange(o, x, los);
+
+            // Geocentric up is within a fraction of a degree of the geodetic one
+            if(mask && (los[0]*x[0] + los[1]*x[1] + los[2]*x[2])/radius < sin_mask_)
+                continue;
+
+            double h[SOLVER_UNKNOWNS] = { -los[0], -los[1], -los[2], 1.0 };
+            double v = o.range - (range + x[3]);
+
+            for(int i = 0; i < n; ++i)
+            {
+                b[i] += o.weight*h[i]*v;
+                for(int j = 0; j <= i; ++j)
+                    N[i][j] += o.weight*h[i]*h[j];
+            }
+            used++;
+        }
+        if(used < SOLVER_UNKNOWNS)
+            return false;
+        for(int i = 0; i < n; ++i)
+            for(int j = i + 1; j < n; ++j)
+                N[i][j] = N[j][i];
+
+        if(!CholeskyFactor(N, n))
+            return false;
+        CholeskySubstitute(N, b, n);
+
+        double step = 0.0;
+        for(int i = 0; i < n; ++i)
+        {
+            x[i] += b[i];
+            if(i < 3)
+                step += b[i]*b[i];
+        }
+        fix->iterations = iteration;
+        converged = step < SOLVER_CONVERGED*SOLVER_CONVERGED;
+    }
+    if(!converged)
+    {
+        have_position_ = false;
+        return false;
+    }
+
+    // Position covariance: the first three columns of N^-1 from the factor
+    for(int c = 0; c < 3; ++c)
+    {
+        double e[SOLVER_UNKNOWNS] = { 0 };
+        e[c] = 1.0;
+        CholeskySubstitute(N, e, n);
+        for(int r = 0; r < 3; ++r)
+            fix->covariance[3*r + c] = e[r];
+    }
+
+    // Residuals at the solution, over the satellites used
+    double sum = 0.0;
+    double radius = std::sqrt(x[0]*x[0] + x[1]*x[1] + x[2]*x[2]);
+    for(int k = 0; k < count_; ++k)
+    {
+        const SolverObservation& o = observations_[k];
+        double los[3];
+        double range = SatelliteRange(o, x, los);
+        if((los[0]*x[0] + los[1]*x[1] + los[2]*x[2])/radius < sin_mask_)
+            continue;
+        double v = o.range - (range + x[3]);
+        sum += v*v;
+    }
+
+    memcpy(fix->position, x, sizeof(fix->position));
+    fix->clock = x[3];
+    fix->satellites = used;
+    fix->residual_rms = std::sqrt(sum/used);
+    fix->valid = true;
+
+    memcpy(position_, x, sizeof(position_));
+    have_position_ = true;
+    return true;
+}
@@ -0,0 +1,125 @@
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "ros/ros.h"
+#include "realtime.h"
+
+bool ApplyThreadTuning(const ThreadTuning& tuning, const char* name)
+{
+    bool ok = true;
+
+    if(tuning.policy == "fifo" || tuning.policy == "rr")
+    {
+        struct sched_param param;
+        param.sched_priority = tuning.priority;
+        int policy = (tuning.policy == "fifo") ? SCHED_FIFO : SCHED_RR;
+
+        int err = pthread_setschedparam(pthread_self(), policy, &param);
+        if(err == 0)
+        {
+            ROS_INFO("%s thread: SCHED_%s priority %d", name, (policy == SCHED_FIFO) ? "FIFO" : "RR", tuning.priority);
+        }
+        else
+        {
+            ROS_WARN("%s thread: could not set SCHED_%s priority %d (%s), running with normal scheduling",
+                     name, (policy == SCHED_FIFO) ? "FIFO" : "RR", tuning.priority, strerror(err));
+            ok = false;
+        }
+    }
+    else if(tuning.policy != "other")
+    {
+        ROS_WARN("%s thread: unknown scheduling policy %s", name, tuning.policy.c_str());
+        ok = false;
+    }
+
+    if(!tuning.cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        std::string list;
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for(size_t i = 0; i < tuning.cpus.size(); ++i)
+        {
+            // CPU_SET() does not check its argument, an id past CPU_SETSIZE writes past the set
+            int cpu = tuning.cpus[i];
+            if(cpu < 0 || cpu >= CPU_SETSIZE || (online > 0 && cpu >= online))
+            {
+                ROS_WARN("%s thread: CPU %d does not exist (%ld online), ignored", name, cpu, online);
+                ok = false;
+                continue;
+            }
+            CPU_SET(cpu, &set);
+            list += (list.empty() ? "" : ",") + std::to_string(cpu);
+        }
+
+        if(list.empty())
+        {
+            ROS_WARN("%s thread: no valid CPU to pin to, affinity left as is", name);
+            ok = false;
+        }
+        else
+        {
+            int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            if(err == 0)
+            {
+                ROS_INFO("%s thread: pinned to CPU %s", name, list.c_str());
+            }
+            else
+            {
+                ROS_WARN("%s thread: could not pin to CPU %s (%s)", name, list.c_str(), strerror(err));
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+bool LockMemory()
+{
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        ROS_WARN("mlockall failed (%s), memory may be paged out", strerror(errno));
+        return false;
+    }
+    ROS_INFO("Memory locked");
+    return true;
+}
+
+void PrefaultStack(size_t size)
+{
+    volatile char* stack = static_cast<volatile char*>(alloca(size));
+    for(size_t i = 0; i < size; i += 4096)
+        stack[i] = 0;
+}
+
+void MeasureWakeupLatency(int samples, long period_ns, const char* name)
+{
+    std::vector<long> overshoot(samples);
+    struct timespec next, now;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for(int i = 0; i < samples; ++i)
+    {
+        next.tv_nsec += period_ns;
+        while(next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        overshoot[i] = (now.tv_sec - next.tv_sec)*1000000000L + (now.tv_nsec - next.tv_nsec);
+    }
+
+    std::sort(overshoot.begin(), overshoot.end());
+    ROS_INFO("%s thread wake-up latency over %d samples: min %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us",
+             name, samples, overshoot.front()/1e3, overshoot[samples/2]/1e3,
+             overshoot[std::min(samples - 1, samples*99/100)]/1e3, overshoot.back()/1e3);
+}
@@ -0,0 +1,452 @@
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <cerrno>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ros/ros.h"
+#include "rinex_writer.h"
+
+// Buffered text written out in one write() once this large, or this often
+#define RINEX_FLUSH_BYTES       (1024*1024)
+#define RINEX_FLUSH_NS          5000000000LL
+// Room for the largest epoch on top of RINEX_FLUSH_BYTES
+#define RINEX_BUFFER_MARGIN     (128*1024)
+
+#define GPS_EPOCH_UNIX          315964800LL     // 1980-01-06 00:00:00
+#define PHASE_LOCK_FLAG         0x00000400
+#define PARITY_KNOWN_FLAG       0x00000800
+
+/* --------------------------------------------------------------------------
+RINEX observation codes of each NovAtel satellite system (channel tracking
+status bits 16-18). Every code is written as C, L, D and S in this order.
+-------------------------------------------------------------------------- */
+struct RinexSystem
+{
+    char letter;
+    int codes;
+    const char* code[4];
+};
+
+static const RinexSystem RINEX_SYSTEMS[] = {
+    { 'G', 4, { "1C", "2W", "2L", "5Q" } },     // GPS
+    { 'R', 3, { "1C", "2C", "2P" } },           // GLONASS
+    { 'S', 2, { "1C", "5I" } },                 // SBAS
+    { 'E', 4, { "1C", "5Q", "7Q", "8Q" } },     // Galileo
+    { 'C', 2, { "2I", "7I" } },                 // BeiDou
+    { 'J', 3, { "1C", "2L", "5Q" } },           // QZSS
+    { 'I', 1, { "5A" } },                       // NavIC
+};
+#define RINEX_SYSTEM_COUNT  7
+
+static int64_t MonotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec)*1000000000LL + ts.tv_nsec;
+}
+
+// Index of the signal in its system's RINEX_SYSTEMS codes, -1 if not written
+static int ObservationCode(uint32_t ch_tr_status)
+{
+    uint32_t system = (ch_tr_status >> 16) & 0x7;
+    uint32_t signal = (ch_tr_status >> 21) & 0x1F;
+
+    switch(system)
+    {
+        case 0:
+            return (signal == 0) ? 0 : (signal == 5 || signal == 9) ? 1 : (signal == 17) ? 2 : (signal == 14) ? 3 : -1;
+        case 1:
+            return (signal == 0) ? 0 : (signal == 1) ? 1 : (signal == 5) ? 2 : -1;
+        case 2:
+            return (signal == 0) ? 0 : (signal == 6) ? 1 : -1;
+        case 3:
+            return (signal == 2) ? 0 : (signal == 12) ? 1 : (signal == 17) ? 2 : (signal == 20) ? 3 : -1;
+        case 4:
+            return (signal == 0 || signal == 4) ? 0 : (signal == 1 || signal == 5) ? 1 : -1;
+        case 5:
+            return (signal == 0) ? 0 : (signal == 17) ? 1 : (signal == 14) ? 2 : -1;
+        case 6:
+            return (signal == 0) ? 0 : -1;
+    }
+    return -1;
+}
+
+// RINEX satellite number from the NovAtel PRN/slot, 0 if it has none
+static int SatelliteNumber(uint32_t system, int prn_slot)
+{
+    switch(system)
+    {
+        case 1:     // GLONASS slots 38-61
+            return (prn_slot >= 38 && prn_slot <= 61) ? prn_slot - 37 : 0;
+        case 2:     // SBAS 120-158
+            return (prn_slot >= 120 && prn_slot <= 158) ? prn_slot - 100 : 0;
+        case 5:     // QZSS 193-202
+            return (prn_slot >= 193 && prn_slot <= 202) ? prn_slot - 192 : 0;
+    }
+    return (prn_slot >= 1 && prn_slot <= 99) ? prn_slot : 0;
+}
+
+static void GpsCalendar(int64_t gps_whole_seconds, struct tm* t)
+{
+    time_t whole = static_cast<time_t>(GPS_EPOCH_UNIX + gps_whole_seconds);
+    gmtime_r(&whole, t);
+}
+
+RinexWriter::RinexWriter(const std::string& directory, const std::string& marker) :
+    directory_(directory),
+    marker_(marker),
+    ring_(RINEX_QUEUE_EPOCHS),
+    head_(0),
+    tail_(0),
+    running_(true),
+    fd_(-1),
+    hour_(-1),
+    buffer_(RINEX_FLUSH_BYTES + RINEX_BUFFER_MARGIN),
+    used_(0),
+    flushed_ns_(MonotonicNs())
+{
+    if(access(directory.c_str(), W_OK) != 0)
+        throw std::runtime_error("RINEX directory " + directory + " is not writable");
+
+    memset(&stats_, 0, sizeof(stats_));
+    for(size_t i = 0; i < ring_.size(); ++i)
+        ring_[i].observations.resize(RINEX_MAX_OBSERVATIONS);
+    thread_ = std::thread(&RinexWriter::run, this);
+}
+
+RinexWriter::~RinexWriter()
+{
+    running_ = false;
+    cv_.notify_all();
+    thread_.join();
+
+    RinexStats s = stats();
+    ROS_INFO("RINEX: %lu epochs, %.1f MB in %lu files, %lu epochs dropped", (unsigned long)s.epochs,
+             s.bytes/1e6, (unsigned long)s.files, (unsigned long)s.dropped);
+}
+
+void RinexWriter::push(uint16_t gps_week, double gps_seconds, const novatel_gps::RangeInformation* ranges,
+                       int count, const double approx[3])
+{
+    Epoch* epoch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(head_ - tail_ >= ring_.size())
+        {
+            stats_.dropped++;
+            return;
+        }
+        epoch = &ring_[head_ % ring_.size()];
+    }
+
+    // The slot is ours until head_ moves past it
+    epoch->gps_week = gps_week;
+    epoch->gps_seconds = gps_seconds;
+    memcpy(epoch->approx, approx, sizeof(epoch->approx));
+    epoch->count = std::min(count, RINEX_MAX_OBSERVATIONS);
+    for(int i = 0; i < epoch->count; ++i)
+    {
+        Observation& o = epoch->observations[i];
+        o.psr = ranges[i].psr;
+        o.adr = ranges[i].adr;
+        o.doppler = ranges[i].doppler;
+        o.c_no = ranges[i].c_no;
+        o.ch_tr_status = ranges[i].ch_tr_status;
+        o.prn_slot = ranges[i].prn_slot;
+        o.slip = ranges[i].slip;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        head_++;
+    }
+    cv_.notify_one();
+}
+
+RinexStats RinexWriter::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void RinexWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(true)
+    {
+        if(head_ == tail_)
+        {
+            if(!running_)
+                break;
+            cv_.wait_for(lock, std::chrono::seconds(1));
+            if(head_ == tail_ && used_ > 0 && MonotonicNs() - flushed_ns_ > RINEX_FLUSH_NS)
+            {
+                lock.unlock();
+                flush();
+                lock.lock();
+            }
+            continue;
+        }
+
+        Epoch& epoch = ring_[tail_ % ring_.size()];
+        lock.unlock();
+        bool written = writeEpoch(epoch);
+        if(used_ >= RINEX_FLUSH_BYTES || MonotonicNs() - flushed_ns_ > RINEX_FLUSH_NS)
+            flush();
+        lock.lock();
+        tail_++;
+        if(written)
+            stats_.epochs++;
+        else
+            stats_.dropped++;
+    }
+    lock.unlock();
+    closeFile();
+}
+
+/* --------------------------------------------------------------------------
+One epoch record: the observations sorted by system and satellite, one line
+per satellite with every code of its system (blank when not tracked). Until
+the hour's file could be created every epoch tries again, so a directory
+that comes back (remounted, recreated) is written to within the hour.
+-------------------------------------------------------------------------- */
+bool RinexWriter::writeEpoch(Epoch& epoch)
+{
+    int64_t whole = static_cast<int64_t>(epoch.gps_week)*604800 + static_cast<int64_t>(std::floor(epoch.gps_seconds));
+    if((whole/3600 != hour_ || fd_ < 0) && !openFile(epoch))
+        return false;
+
+    // Sort key: system, satellite, code
+    int keys[RINEX_MAX_OBSERVATIONS];
+    int n = 0;
+    for(int i = 0; i < epoch.count; ++i)
+    {
+        const Observation& o = epoch.observations[i];
+        uint32_t system = (o.ch_tr_status >> 16) & 0x7;
+        int number = SatelliteNumber(system, o.prn_slot);
+        int code = ObservationCode(o.ch_tr_status);
+        if(system >= RINEX_SYSTEM_COUNT || number == 0 || code < 0)
+            continue;
+        keys[n++] = ((system*128 + number)*4 + code)*RINEX_MAX_OBSERVATIONS + i;
+    }
+    std::sort(keys, keys + n);
+
+    int satellites = 0;
+    for(int k = 0; k < n; ++k)
+        if(k == 0 || keys[k]/(4*RINEX_MAX_OBSERVATIONS) != keys[k - 1]/(4*RINEX_MAX_OBSERVATIONS))
+            satellites++;
+
+    struct tm t;
+    GpsCalendar(whole, &t);
+    append("> %4d %02d %02d %02d %02d%11.7f  0%3d\n", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min,
+           t.tm_sec + (epoch.gps_seconds - std::floor(epoch.gps_seconds)), satellites);
+
+    for(int k = 0; k < n; )
+    {
+        int satellite = keys[k]/(4*RINEX_MAX_OBSERVATIONS);
+        const RinexSystem& system = RINEX_SYSTEMS[satellite/128];
+        const Observation* signal[4] = { NULL, NULL, NULL, NULL };
+        for(; k < n && keys[k]/(4*RINEX_MAX_OBSERVATIONS) == satellite; ++k)
+            signal[(keys[k]/RINEX_MAX_OBSERVATIONS) % 4] = &epoch.observations[keys[k] % RINEX_MAX_OBSERVATIONS];
+
+        append("%c%02d", system.letter, satellite % 128);
+        for(int c = 0; c < system.codes; ++c)
+        {
+            const Observation* o = signal[c];
+            if(!o)
+            {
+                append("%64s", "");
+                continue;
+            }
+
+            append("%14.3f  ", o->psr);
+            if((o->ch_tr_status & PHASE_LOCK_FLAG) && o->adr != 0.0)
+            {
+                int lli = (o->slip ? 1 : 0) | ((o->ch_tr_status & PARITY_KNOWN_FLAG) ? 0 : 2);
+                int ssi = std::min(9, std::max(1, static_cast<int>(o->c_no/6.0)));
+                append("%14.3f%c%d", -o->adr, lli ? '0' + lli : ' ', ssi);
+            }
+            else
+                append("%16s", "");
+            append("%14.3f  %14.3f  ", o->doppler, o->c_no);
+        }
+
+        // No trailing blanks
+        while(used_ > 0 && buffer_[used_ - 1] == ' ')
+            used_--;
+        append("\n");
+    }
+    return true;
+}
+
+bool RinexWriter::openFile(const Epoch& epoch)
+{
+    closeFile();
+
+    int64_t whole = static_cast<int64_t>(epoch.gps_week)*604800 + static_cast<int64_t>(std::floor(epoch.gps_seconds));
+    int64_t hour = whole/3600;
+
+    // Long file name: 4 character marker, monument/receiver 00, unknown country
+    std::string station = marker_.substr(0, 4);
+    station.resize(4, 'X');
+    for(size_t i = 0; i < station.size(); ++i)
+        station[i] = toupper(station[i]);
+
+    struct tm t;
+    GpsCalendar(hour*3600, &t);
+    char name[64];
+    snprintf(name, sizeof(name), "%s00XXX_R_%04d%03d%02d00_01H_00U_MO", station.c_str(),
+             t.tm_year + 1900, t.tm_yday + 1, t.tm_hour);
+
+    // Never overwrite: a restart within the hour gets a numbered file
+    std::string path = directory_ + "/" + name + ".rnx";
+    for(int i = 1; (fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0 && errno == EEXIST; ++i)
+        path = directory_ + "/" + name + "_" + std::to_string(i) + ".rnx";
+    if(fd_ < 0)
+    {
+        // Tried again on the next epoch
+        ROS_ERROR_THROTTLE(10.0, "could not create RINEX file %s: %s, epochs are dropped", path.c_str(),
+                           strerror(errno));
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.write_errors++;
+        return false;
+    }
+
+    hour_ = hour;
+    ROS_INFO("writing RINEX observations to %s", path.c_str());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.files++;
+    }
+    writeHeader(epoch);
+    return true;
+}
+
+#define HEADER_LABEL(label) append("%-20s\n", label)
+
+void RinexWriter::writeHeader(const Epoch& epoch)
+{
+    time_t now = time(NULL);
+    struct tm t;
+    gmtime_r(&now, &t);
+
+    append("%9.2f%11s%-20s%-20s", 3.04, "", "OBSERVATION DATA", "M");
+    HEADER_LABEL("RINEX VERSION / TYPE");
+    append("%-20s%-20s%04d%02d%02d %02d%02d%02d UTC ", "novatel_gps", "", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+           t.tm_hour, t.tm_min, t.tm_sec);
+    HEADER_LABEL("PGM / RUN BY / DATE");
+    append("%-60.60s", marker_.c_str());
+    HEADER_LABEL("MARKER NAME");
+    append("%-60s", "NON_GEODETIC");
+    HEADER_LABEL("MARKER TYPE");
+    append("%-60s", "");
+    HEADER_LABEL("OBSERVER / AGENCY");
+    append("%-20s%-20s%-20s", "", "NOVATEL", "");
+    HEADER_LABEL("REC # / TYPE / VERS");
+    append("%-60s", "");
+    HEADER_LABEL("ANT # / TYPE");
+    append("%14.4f%14.4f%14.4f%18s", epoch.approx[0], epoch.approx[1], epoch.approx[2], "");
+    HEADER_LABEL("APPROX POSITION XYZ");
+    append("%14.4f%14.4f%14.4f%18s", 0.0, 0.0, 0.0, "");
+    HEADER_LABEL("ANTENNA: DELTA H/E/N");
+
+    // Thirteen types per line, continuation lines indented
+    static const char TYPES[] = "CLDS";
+    for(int s = 0; s < RINEX_SYSTEM_COUNT; ++s)
+    {
+        const RinexSystem& system = RINEX_SYSTEMS[s];
+        int types = 4*system.codes;
+        char line[64];
+        int length = snprintf(line, sizeof(line), "%c  %3d", system.letter, types);
+        for(int i = 0; i < types; ++i)
+        {
+            if(i > 0 && i % 13 == 0)
+            {
+                append("%-60s", line);
+                HEADER_LABEL("SYS / # / OBS TYPES");
+                length = snprintf(line, sizeof(line), "%6s", "");
+            }
+            length += snprintf(line + length, sizeof(line) - length, " %c%s", TYPES[i % 4], system.code[i/4]);
+        }
+        append("%-60s", line);
+        HEADER_LABEL("SYS / # / OBS TYPES");
+    }
+
+    append("%-60s", "DBHZ");
+    HEADER_LABEL("SIGNAL STRENGTH UNIT");
+
+    int64_t whole = static_cast<int64_t>(epoch.gps_week)*604800 + static_cast<int64_t>(std::floor(epoch.gps_seconds));
+    GpsCalendar(whole, &t);
+    append("%6d%6d%6d%6d%6d%13.7f%5s%3s%9s", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min,
+           t.tm_sec + (epoch.gps_seconds - std::floor(epoch.gps_seconds)), "", "GPS", "");
+    HEADER_LABEL("TIME OF FIRST OBS");
+
+    // Required from 3.02 with GLONASS; the frequency numbers and biases are
+    // not in RANGE
+    append("%3d%57s", 0, "");
+    HEADER_LABEL("GLONASS SLOT / FRQ #");
+    append("%-60s", "");
+    HEADER_LABEL("GLONASS COD/PHS/BIS");
+    append("%-60s", "");
+    HEADER_LABEL("END OF HEADER");
+}
+
+void RinexWriter::closeFile()
+{
+    if(fd_ < 0)
+        return;
+    flush();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void RinexWriter::flush()
+{
+    size_t done = 0;
+    while(fd_ >= 0 && done < used_)
+    {
+        ssize_t n = ::write(fd_, &buffer_[done], used_ - done);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+        {
+            ROS_ERROR("RINEX write failed: %s", strerror(errno));
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.write_errors++;
+            break;
+        }
+        done += n;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes += done;
+    }
+    used_ = 0;
+    flushed_ns_ = MonotonicNs();
+}
+
+void RinexWriter::append(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(&buffer_[used_], buffer_.size() - used_, format, args);
+    va_end(args);
+
+    if(n >= 0 && used_ + n >= buffer_.size())
+    {
+        // Does not happen with RINEX_BUFFER_MARGIN, but never truncate
+        flush();
+        va_start(args, format);
+        n = vsnprintf(&buffer_[used_], buffer_.size() - used_, format, args);
+        va_end(args);
+    }
+    if(n > 0)
+        used_ += n;
+}
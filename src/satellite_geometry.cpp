@@ -0,0 +1,203 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "satellite_geometry.h"
+#include "geodesy.h"
+
+// Receiver displacement (m) after which every direction is recomputed
+#define GEOMETRY_RECEIVER_MOVE  100.0
+
+/* --------------------------------------------------------------------------
+Inverts a symmetric positive definite 4x4 matrix (row major) by Gauss-Jordan
+elimination. False if it is singular, e.g. all satellites in one plane.
+-------------------------------------------------------------------------- */
+static bool Invert4(const double A[16], double inv[16])
+{
+    double m[4][8];
+    for(int i = 0; i < 4; ++i)
+        for(int j = 0; j < 4; ++j)
+        {
+            m[i][j] = A[4*i + j];
+            m[i][j + 4] = (i == j) ? 1.0 : 0.0;
+        }
+
+    for(int c = 0; c < 4; ++c)
+    {
+        int pivot = c;
+        for(int r = c + 1; r < 4; ++r)
+            if(std::fabs(m[r][c]) > std::fabs(m[pivot][c]))
+                pivot = r;
+        if(std::fabs(m[pivot][c]) < 1e-12)
+            return false;
+        if(pivot != c)
+            for(int j = 0; j < 8; ++j)
+                std::swap(m[c][j], m[pivot][j]);
+
+        double scale = 1.0/m[c][c];
+        for(int j = 0; j < 8; ++j)
+            m[c][j] *= scale;
+        for(int r = 0; r < 4; ++r)
+        {
+            if(r == c || m[r][c] == 0.0)
+                continue;
+            double f = m[r][c];
+            for(int j = 0; j < 8; ++j)
+                m[r][j] -= f*m[c][j];
+        }
+    }
+
+    for(int i = 0; i < 4; ++i)
+        for(int j = 0; j < 4; ++j)
+            inv[4*i + j] = m[i][j + 4];
+    return true;
+}
+
+GeometryEngine::GeometryEngine() :
+    generation_(0),
+    count_(0),
+    used_(0),
+    recomputed_(0),
+    mask_(5.0),
+    tolerance2_(0.0),
+    have_receiver_(false)
+{
+    memset(directions_, 0, sizeof(directions_));
+    memset(receiver_, 0, sizeof(receiver_));
+    memset(rotation_, 0, sizeof(rotation_));
+    computeDop();
+}
+
+void GeometryEngine::configure(double mask, double tolerance)
+{
+    mask_ = mask;
+    tolerance2_ = tolerance*DEG2RAD*tolerance*DEG2RAD;
+}
+
+int GeometryEngine::update(const SatelliteTable& table, const double receiver[3])
+{
+    generation_ = table.satxyzGeneration();
+
+    double dr[3] = { receiver[0] - receiver_[0], receiver[1] - receiver_[1], receiver[2] - receiver_[2] };
+    bool moved = !have_receiver_ ||
+                 dr[0]*dr[0] + dr[1]*dr[1] + dr[2]*dr[2] > GEOMETRY_RECEIVER_MOVE*GEOMETRY_RECEIVER_MOVE;
+    if(moved)
+    {
+        double lat, lon, h;
+        EcefToLla(receiver, &lat, &lon, &h);
+        EnuRotation(lat, lon, rotation_);
+        memcpy(receiver_, receiver, sizeof(receiver_));
+        have_receiver_ = true;
+    }
+
+    count_ = 0;
+    used_ = 0;
+    recomputed_ = 0;
+    for(int i = 0; i < MAX_SATELLITES; ++i)
+    {
+        const SatelliteState& s = table.entry(i);
+        if(generation_ == 0 || s.satxyz_generation != generation_)
+            continue;
+
+        // Keep the cached direction while the satellite has moved less than
+        // the tolerance as seen from the receiver
+        SatelliteDirection& d = directions_[i];
+        double ds[3] = { s.position[0] - d.position[0], s.position[1] - d.position[1], s.position[2] - d.position[2] };
+        if(moved || d.range == 0.0 || ds[0]*ds[0] + ds[1]*ds[1] + ds[2]*ds[2] > tolerance2_*d.range*d.range)
+        {
+            computeDirection(s.position, &d);
+            recomputed_++;
+        }
+
+        d.generation = generation_;
+        count_++;
+        if(d.elevation >= mask_)
+            used_++;
+    }
+
+    computeDop();
+    return used_;
+}
+
+void GeometryEngine::computeDirection(const double position[3], SatelliteDirection* d)
+{
+    double diff[3] = { position[0] - receiver_[0], position[1] - receiver_[1], position[2] - receiver_[2] };
+    d->range = std::sqrt(diff[0]*diff[0] + diff[1]*diff[1] + diff[2]*diff[2]);
+    memcpy(d->position, position, sizeof(d->position));
+
+    for(int i = 0; i < 3; ++i)
+        d->los[i] = (rotation_[3*i]*diff[0] + rotation_[3*i + 1]*diff[1] + rotation_[3*i + 2]*diff[2])/d->range;
+
+    double azimuth = std::atan2(d->los[0], d->los[1])*RAD2DEG;
+    d->azimuth = (azimuth < 0.0) ? azimuth + 360.0 : azimuth;
+    // Not asin(up): rounding can put it just past 1 at the zenith
+    d->elevation = std::atan2(d->los[2], std::sqrt(d->los[0]*d->los[0] + d->los[1]*d->los[1]))*RAD2DEG;
+}
+
+/* --------------------------------------------------------------------------
+DOP from Q = (H^T H)^-1, H rows [-e -n -u 1] for the satellites above the
+mask. The frame is ENU, so HDOP and VDOP come straight from the diagonal.
+-------------------------------------------------------------------------- */
+void GeometryEngine::computeDop()
+{
+    double N[16] = { 0 };
+    for(int i = 0; i < MAX_SATELLITES && used_ >= 4; ++i)
+    {
+        const SatelliteDirection& d = directions_[i];
+        if(d.generation != generation_ || d.elevation < mask_)
+            continue;
+
+        double h[4] = { -d.los[0], -d.los[1], -d.los[2], 1.0 };
+        for(int k = 0; k < 4; ++k)
+            for(int j = k; j < 4; ++j)
+                N[4*k + j] += h[k]*h[j];
+    }
+    for(int i = 0; i < 4; ++i)
+        for(int j = 0; j < i; ++j)
+            N[4*i + j] = N[4*j + i];
+
+    double Q[16];
+    if(used_ < 4 || generation_ == 0 || !Invert4(N, Q))
+    {
+        double nan = std::numeric_limits<double>::quiet_NaN();
+        dop_.gdop = dop_.pdop = dop_.hdop = dop_.vdop = dop_.tdop = nan;
+        return;
+    }
+
+    dop_.gdop = std::sqrt(Q[0] + Q[5] + Q[10] + Q[15]);
+    dop_.pdop = std::sqrt(Q[0] + Q[5] + Q[10]);
+    dop_.hdop = std::sqrt(Q[0] + Q[5]);
+    dop_.vdop = std::sqrt(Q[10]);
+    dop_.tdop = std::sqrt(Q[15]);
+}
+
+void GeometryEngine::fill(novatel_gps::SatelliteGeometry* output) const
+{
+    output->gdop = dop_.gdop;
+    output->pdop = dop_.pdop;
+    output->hdop = dop_.hdop;
+    output->vdop = dop_.vdop;
+    output->tdop = dop_.tdop;
+    output->elevation_mask = mask_;
+
+    output->prn_slot.resize(count_);
+    output->azimuth.resize(count_);
+    output->elevation.resize(count_);
+    output->used.resize(count_);
+
+    int n = 0;
+    for(int i = 0; i < MAX_SATELLITES && n < count_; ++i)
+    {
+        const SatelliteDirection& d = directions_[i];
+        if(generation_ == 0 || d.generation != generation_)
+            continue;
+
+        int system, prn;
+        SatelliteOf(i, &system, &prn);
+        output->prn_slot[n] = prn;
+        output->azimuth[n] = d.azimuth;
+        output->elevation[n] = d.elevation;
+        output->used[n] = (d.elevation >= mask_);
+        n++;
+    }
+}
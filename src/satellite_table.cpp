@@ -0,0 +1,222 @@
+#include <cstring>
+
+#include "satellite_table.h"
+#include "novatel_gps.h"
+
+// PRN/slot range of each system in NovAtel numbering, and where its entries
+// start in the satellite tables
+struct SystemSlots
+{
+    int first;
+    int last;
+    int base;
+};
+
+static const SystemSlots SYSTEM_SLOTS[] =
+{
+    {   1,  32,   0 },      // GPS
+    {  38,  68,  32 },      // GLONASS, slot + 37
+    { 120, 158,  63 },      // SBAS
+    {   1,  36, 102 },      // Galileo
+    {   1,  63, 138 },      // BeiDou
+    { 193, 202, 201 },      // QZSS
+    {   1,  14, 211 },      // NavIC
+};
+
+static_assert(211 + 14 == MAX_SATELLITES, "MAX_SATELLITES does not match SYSTEM_SLOTS");
+
+int SatelliteIndex(int system, int prn_slot)
+{
+    if(system < 0 || system >= SYSTEM_OTHER)
+        return -1;
+    const SystemSlots& slots = SYSTEM_SLOTS[system];
+    if(prn_slot < slots.first || prn_slot > slots.last)
+        return -1;
+    return slots.base + prn_slot - slots.first;
+}
+
+void SatelliteOf(int index, int* system, int* prn_slot)
+{
+    int s = SYSTEM_OTHER - 1;
+    while(s > 0 && index < SYSTEM_SLOTS[s].base)
+        s--;
+    *system = s;
+    *prn_slot = SYSTEM_SLOTS[s].first + index - SYSTEM_SLOTS[s].base;
+}
+
+int SignalSlot(uint32_t ch_tr_status)
+{
+    uint32_t system = (ch_tr_status >> 16) & 0x7;
+    uint32_t signal = (ch_tr_status >> 21) & 0x1F;
+
+    // Galileo E1C and BeiDou B1I (GEO) share the L1 slot with the C/A codes
+    if(signal == 0 || (system == 3 && signal == 2) || (system == 4 && signal == 4))
+        return SIGNAL_L1;
+    if(signal == 5 || signal == 9 || (system == 1 && signal == 1))
+        return SIGNAL_L2;
+    if(signal == 17)
+        return SIGNAL_L2C;
+    return SIGNAL_OTHER;
+}
+
+double CarrierWavelength(uint32_t ch_tr_status)
+{
+    uint32_t system = (ch_tr_status >> 16) & 0x7;
+    uint32_t signal = (ch_tr_status >> 21) & 0x1F;
+
+    switch(system)
+    {
+        case 1:     // GLONASS
+            return SPEED_OF_LIGHT / ((signal == 0) ? 1602.0e6 : 1246.0e6);
+        case 3:     // Galileo E1, E5a, E5b, E5 AltBOC, E6
+            if(signal == 2)
+                return SPEED_OF_LIGHT / 1575.42e6;
+            if(signal == 12)
+                return SPEED_OF_LIGHT / 1176.45e6;
+            if(signal == 17)
+                return SPEED_OF_LIGHT / 1207.14e6;
+            if(signal == 20)
+                return SPEED_OF_LIGHT / 1191.795e6;
+            return SPEED_OF_LIGHT / 1278.75e6;
+        case 4:     // BeiDou B1I, B2I
+            return SPEED_OF_LIGHT / ((signal == 0 || signal == 4) ? 1561.098e6 : 1207.14e6);
+    }
+
+    // GPS, QZSS and SBAS
+    if(signal == 0)
+        return SPEED_OF_LIGHT / 1575.42e6;
+    if(signal == 14)
+        return SPEED_OF_LIGHT / 1176.45e6;
+    return SPEED_OF_LIGHT / 1227.60e6;
+}
+
+SatelliteTable::SatelliteTable() :
+    range_generation_(0),
+    satxyz_generation_(0),
+    trackstat_generation_(0)
+{
+    memset(satellites_, 0, sizeof(satellites_));
+    for(int i = 0; i < MAX_SATELLITES; ++i)
+        SatelliteOf(i, &satellites_[i].system, &satellites_[i].prn_slot);
+}
+
+void SatelliteTable::update(const novatel_gps::RangeInformation& range)
+{
+    int index = SatelliteIndex(SatelliteSystem(range.ch_tr_status), range.prn_slot);
+    if(index < 0)
+        return;
+
+    SignalState& s = satellites_[index].signal[SignalSlot(range.ch_tr_status)];
+    s.psr = range.psr;
+    s.psr_std = range.psr_std;
+    s.adr = range.adr;
+    s.adr_std = range.adr_std;
+    s.doppler = range.doppler;
+    s.c_no = range.c_no;
+    s.locktime = range.locktime;
+    s.ch_tr_status = range.ch_tr_status;
+    s.slip = range.slip;
+    s.generation = range_generation_;
+}
+
+void SatelliteTable::update(const novatel_gps::SatXYZInformation& satellite)
+{
+    // SATXYZ records have no system, the log only covers GPS
+    int index = SatelliteIndex(SYSTEM_GPS, satellite.prn_slot);
+    if(index < 0)
+        return;
+
+    SatelliteState& s = satellites_[index];
+    s.position[0] = satellite.position.x;
+    s.position[1] = satellite.position.y;
+    s.position[2] = satellite.position.z;
+    s.clk_corr = satellite.clk_corr;
+    s.ion_corr = satellite.ion_corr;
+    s.trop_corr = satellite.trop_corr;
+    s.satxyz_generation = satxyz_generation_;
+}
+
+void SatelliteTable::update(const novatel_gps::TrackStatChannel& channel)
+{
+    // Idle channels report PRN 0, and only the L1 channel carries the reject code
+    int index = SatelliteIndex(SatelliteSystem(channel.ch_tr_status), channel.prn_slot);
+    if(index < 0 || SignalSlot(channel.ch_tr_status) != SIGNAL_L1)
+        return;
+
+    SatelliteState& s = satellites_[index];
+    s.ch_tr_status = channel.ch_tr_status;
+    s.cn0 = channel.cn0;
+    s.locktime = channel.locktime;
+    s.psr_res = channel.psr_res;
+    s.psr_weight = channel.psr_weight;
+    s.reject = channel.reject;
+    s.trackstat_generation = trackstat_generation_;
+}
+
+const SatelliteState* SatelliteTable::find(int system, int prn_slot) const
+{
+    int index = SatelliteIndex(system, prn_slot);
+    return (index < 0) ? NULL : &satellites_[index];
+}
+
+void SatelliteTable::fill(novatel_gps::SatelliteStateArray* output) const
+{
+    output->range_generation = range_generation_;
+    output->satxyz_generation = satxyz_generation_;
+    output->trackstat_generation = trackstat_generation_;
+    output->satellites.clear();
+
+    for(int i = 0; i < MAX_SATELLITES; ++i)
+    {
+        const SatelliteState& s = satellites_[i];
+
+        bool current = false;
+        for(int k = 0; k < MAX_SIGNALS; ++k)
+            current |= (s.signal[k].generation == range_generation_);
+        if(!current || range_generation_ == 0)
+            continue;
+
+        output->satellites.resize(output->satellites.size() + 1);
+        novatel_gps::SatelliteState& out = output->satellites.back();
+        out.system = s.system;
+        out.prn_slot = s.prn_slot;
+        out.range_generation = range_generation_;
+
+        for(int k = 0; k < MAX_SIGNALS; ++k)
+        {
+            const SignalState& sig = s.signal[k];
+            if(sig.generation != range_generation_)
+                continue;
+
+            out.ranges.resize(out.ranges.size() + 1);
+            novatel_gps::RangeInformation& range = out.ranges.back();
+            range.prn_slot = s.prn_slot;
+            range.psr = sig.psr;
+            range.psr_std = sig.psr_std;
+            range.adr = sig.adr;
+            range.adr_std = sig.adr_std;
+            range.doppler = sig.doppler;
+            range.c_no = sig.c_no;
+            range.locktime = sig.locktime;
+            range.ch_tr_status = sig.ch_tr_status;
+            range.slip = sig.slip;
+            DecodeTrackingStatus(sig.ch_tr_status, range.tracking_status);
+        }
+
+        out.position.x = s.position[0];
+        out.position.y = s.position[1];
+        out.position.z = s.position[2];
+        out.clk_corr = s.clk_corr;
+        out.ion_corr = s.ion_corr;
+        out.trop_corr = s.trop_corr;
+        out.satxyz_generation = s.satxyz_generation;
+
+        out.ch_tr_status = s.ch_tr_status;
+        out.cn0 = s.cn0;
+        out.locktime = s.locktime;
+        out.psr_res = s.psr_res;
+        out.reject = s.reject;
+        out.psr_weight = s.psr_weight;
+        out.trackstat_generation = s.trackstat_generation;
+    }
+}
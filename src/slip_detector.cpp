@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "slip_detector.h"
+
+#define PHASE_LOCK_FLAG     0x00000400
+#define HALF_CYCLE_FLAG     0x10000000
+// Slack on the locktime comparisons for output rounding (s)
+#define LOCKTIME_TOLERANCE  0.01
+
+typedef novatel_gps::RangeInformation RangeInformation;
+
+SlipDetector::SlipDetector() :
+    epoch_count_(0),
+    epoch_(0),
+    time_(0.0),
+    doppler_threshold_(2.0),
+    gf_threshold_(0.05),
+    max_gap_(5.0)
+{
+    memset(tracks_, 0, sizeof(tracks_));
+    memset(seen_, 0, sizeof(seen_));
+    for(int i = 0; i < MAX_SATELLITES; ++i)
+        geometry_free_[i].signal = -1;
+}
+
+void SlipDetector::configure(double doppler_threshold, double gf_threshold, double max_gap)
+{
+    doppler_threshold_ = doppler_threshold;
+    gf_threshold_ = gf_threshold;
+    max_gap_ = max_gap;
+}
+
+void SlipDetector::beginEpoch(double gps_time)
+{
+    epoch_++;
+    epoch_count_ = 0;
+    time_ = gps_time;
+}
+
+void SlipDetector::update(const RangeInformation& range)
+{
+    int index = SatelliteIndex(SatelliteSystem(range.ch_tr_status), range.prn_slot);
+    if(index < 0)
+        return;
+
+    PhaseTrack& t = tracks_[index][SignalSlot(range.ch_tr_status)];
+    double dt = time_ - t.time;
+    if(t.epoch != 0 && dt == 0.0)
+    {
+        // Same epoch logged twice, keep its flags
+        t.epoch = epoch_;
+        see(index);
+        return;
+    }
+
+    bool locked = (range.ch_tr_status & PHASE_LOCK_FLAG) != 0;
+    uint8_t flags = 0;
+    if(!locked)
+        flags = RangeInformation::SLIP_LOCK_LOST;
+    else if(t.epoch == 0 || !t.locked || dt < 0.0)
+        flags = RangeInformation::SLIP_NEW_ARC;
+    else
+    {
+        if(range.locktime + LOCKTIME_TOLERANCE < t.locktime || range.locktime + LOCKTIME_TOLERANCE < dt)
+            flags |= RangeInformation::SLIP_LOCK_LOST;
+        if((range.ch_tr_status & HALF_CYCLE_FLAG) != (t.ch_tr_status & HALF_CYCLE_FLAG))
+            flags |= RangeInformation::SLIP_HALF_CYCLE;
+
+        double predicted = t.adr + 0.5*(t.doppler + range.doppler)*dt;
+        if(dt <= max_gap_ && std::fabs(range.adr - predicted) > doppler_threshold_*std::max(dt, 1.0))
+            flags |= RangeInformation::SLIP_DOPPLER;
+    }
+
+    t.adr = range.adr;
+    t.time = time_;
+    t.doppler = range.doppler;
+    t.locktime = range.locktime;
+    t.ch_tr_status = range.ch_tr_status;
+    t.epoch = epoch_;
+    t.flags = flags;
+    t.locked = locked;
+    see(index);
+}
+
+void SlipDetector::see(int index)
+{
+    if(seen_[index] != epoch_)
+    {
+        seen_[index] = epoch_;
+        epoch_satellites_[epoch_count_++] = index;
+    }
+}
+
+/* --------------------------------------------------------------------------
+Geometry-free check for the satellites of the epoch with L1 and a second
+frequency (L2, else L2C, else the other slot). The ionosphere moves it by
+centimetres per second at most, while a slip on either frequency, except
+equal slips on both, moves it by at least 5 cm. A jump flags both signals.
+-------------------------------------------------------------------------- */
+void SlipDetector::endEpoch()
+{
+    static const int SECOND[] = { SIGNAL_L2, SIGNAL_L2C, SIGNAL_OTHER };
+
+    for(int i = 0; i < epoch_count_; ++i)
+    {
+        int index = epoch_satellites_[i];
+        GeometryFree& gf = geometry_free_[index];
+        PhaseTrack& l1 = tracks_[index][SIGNAL_L1];
+
+        PhaseTrack* l2 = NULL;
+        int signal = -1;
+        for(int k = 0; k < 3 && !l2; ++k)
+        {
+            PhaseTrack& t = tracks_[index][SECOND[k]];
+            if(t.epoch == epoch_ && t.locked)
+            {
+                l2 = &t;
+                signal = SECOND[k];
+            }
+        }
+        if(l1.epoch != epoch_ || !l1.locked || !l2)
+        {
+            gf.signal = -1;
+            continue;
+        }
+
+        double value = CarrierWavelength(l1.ch_tr_status)*l1.adr - CarrierWavelength(l2->ch_tr_status)*l2->adr;
+        double dt = time_ - gf.time;
+        if(gf.signal == signal && l1.flags == 0 && l2->flags == 0 && dt <= max_gap_ &&
+           std::fabs(value - gf.value) > gf_threshold_*std::max(dt, 1.0))
+        {
+            l1.flags |= RangeInformation::SLIP_GEOMETRY_FREE;
+            l2->flags |= RangeInformation::SLIP_GEOMETRY_FREE;
+        }
+        gf.value = value;
+        gf.time = time_;
+        gf.signal = signal;
+    }
+}
+
+uint8_t SlipDetector::flags(const RangeInformation& range) const
+{
+    int index = SatelliteIndex(SatelliteSystem(range.ch_tr_status), range.prn_slot);
+    if(index < 0)
+        return 0;
+    const PhaseTrack& t = tracks_[index][SignalSlot(range.ch_tr_status)];
+    return (t.epoch == epoch_) ? t.flags : 0;
+}
@@ -0,0 +1,111 @@
+#include <cstring>
+#include <algorithm>
+
+#include "solution_batch.h"
+
+// Diagonal of a row-major 3x3 covariance
+static const int DIAGONAL[3] = { 0, 4, 8 };
+
+SolutionBatch::SolutionBatch() :
+    samples_(0),
+    size_(1),
+    max_latency_(0.0)
+{
+    memset(covariance_, 0, sizeof(covariance_));
+}
+
+void SolutionBatch::configure(int size, double max_latency)
+{
+    // Sample indices are uint16
+    size_ = std::min(std::max(size, 1), 65535);
+    max_latency_ = max_latency;
+
+    batch_.stamp.reserve(size_);
+    batch_.position.reserve(3*size_);
+    batch_.velocity.reserve(3*size_);
+    batch_.covariance_sample.reserve(size_);
+    batch_.covariance.reserve(6*size_);
+}
+
+bool SolutionBatch::add(const novatel_gps::GpsXYZ& fix)
+{
+    batch_.stamp.push_back(fix.header.stamp);
+    batch_.position.push_back(fix.position.position.x);
+    batch_.position.push_back(fix.position.position.y);
+    batch_.position.push_back(fix.position.position.z);
+    batch_.velocity.push_back(fix.velocity.velocity.x);
+    batch_.velocity.push_back(fix.velocity.velocity.y);
+    batch_.velocity.push_back(fix.velocity.velocity.z);
+
+    float covariance[6];
+    for(int i = 0; i < 3; ++i)
+    {
+        covariance[i] = fix.position.covariance[DIAGONAL[i]];
+        covariance[i + 3] = fix.velocity.covariance[DIAGONAL[i]];
+    }
+    if(samples_ == 0 || memcmp(covariance, covariance_, sizeof(covariance)) != 0)
+    {
+        batch_.covariance_sample.push_back(samples_);
+        batch_.covariance.insert(batch_.covariance.end(), covariance, covariance + 6);
+        memcpy(covariance_, covariance, sizeof(covariance_));
+    }
+    return ++samples_ >= size_;
+}
+
+bool SolutionBatch::due(const ros::Time& now) const
+{
+    return samples_ > 0 && max_latency_ > 0.0 && now.toSec() - batch_.stamp[0].toSec() >= max_latency_;
+}
+
+void SolutionBatch::take(novatel_gps::GpsXYZBatch* output)
+{
+    if(samples_ > 0)
+        output->header.stamp = batch_.stamp[0];
+    output->stamp.swap(batch_.stamp);
+    output->position.swap(batch_.position);
+    output->velocity.swap(batch_.velocity);
+    output->covariance_sample.swap(batch_.covariance_sample);
+    output->covariance.swap(batch_.covariance);
+
+    // The previous batch's arrays, capacity kept
+    batch_.stamp.clear();
+    batch_.position.clear();
+    batch_.velocity.clear();
+    batch_.covariance_sample.clear();
+    batch_.covariance.clear();
+    samples_ = 0;
+}
+
+bool BatchSample(const novatel_gps::GpsXYZBatch& batch, size_t i, novatel_gps::GpsXYZ* fix)
+{
+    if(i >= batch.stamp.size() || batch.position.size() < 3*(i + 1) || batch.velocity.size() < 3*(i + 1) ||
+       batch.covariance_sample.empty() || batch.covariance.size() < 6*batch.covariance_sample.size())
+        return false;
+
+    // Latest covariance entry at or before i
+    size_t entry = std::upper_bound(batch.covariance_sample.begin(), batch.covariance_sample.end(), i) -
+                   batch.covariance_sample.begin();
+    if(entry == 0)
+        return false;
+    const float* covariance = &batch.covariance[6*(entry - 1)];
+
+    fix->header.stamp = batch.stamp[i];
+    fix->header.frame_id = batch.header.frame_id;
+    fix->position.position.x = batch.position[3*i];
+    fix->position.position.y = batch.position[3*i + 1];
+    fix->position.position.z = batch.position[3*i + 2];
+    fix->velocity.velocity.x = batch.velocity[3*i];
+    fix->velocity.velocity.y = batch.velocity[3*i + 1];
+    fix->velocity.velocity.z = batch.velocity[3*i + 2];
+    for(int k = 0; k < 9; ++k)
+    {
+        fix->position.covariance[k] = 0.0;
+        fix->velocity.covariance[k] = 0.0;
+    }
+    for(int k = 0; k < 3; ++k)
+    {
+        fix->position.covariance[DIAGONAL[k]] = covariance[k];
+        fix->velocity.covariance[DIAGONAL[k]] = covariance[k + 3];
+    }
+    return true;
+}
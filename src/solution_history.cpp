@@ -0,0 +1,164 @@
+#include <algorithm>
+
+#include "solution_history.h"
+
+// A solution this far before the newest means the receiver time restarted
+#define TIME_JUMP_S     1.0
+
+void HostClockOffset::add(double gps_time, int64_t receive_ns)
+{
+    samples_[count_ % HOST_OFFSET_WINDOW] = receive_ns/1e9 - gps_time;
+    count_++;
+    offset_ = *std::min_element(samples_, samples_ + std::min<size_t>(count_, HOST_OFFSET_WINDOW));
+}
+
+/*************************** SolutionHistory ***************************/
+
+SolutionHistory::SolutionHistory(size_t capacity) :
+    begin_(0),
+    count_(0),
+    max_gap_(1.0)
+{
+    ring_.resize(capacity);
+}
+
+void SolutionHistory::resize(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ring_.assign(capacity, SolutionSample());
+    begin_ = 0;
+    count_ = 0;
+}
+
+void SolutionHistory::setMaxGap(double max_gap)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_gap_ = max_gap;
+}
+
+void SolutionHistory::add(const SolutionSample& sample, int64_t receive_ns)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(ring_.empty())
+        return;
+
+    if(count_ > 0)
+    {
+        double newest = at(count_ - 1).gps_time;
+        if(sample.gps_time <= newest && newest - sample.gps_time < TIME_JUMP_S)
+            return;     // Repeated epoch (e.g. BESTXYZ ONNEW and ONTIME)
+        if(sample.gps_time <= newest)
+        {
+            count_ = 0;
+            host_offset_.reset();
+        }
+    }
+    host_offset_.add(sample.gps_time, receive_ns);
+
+    if(count_ < ring_.size())
+    {
+        ring_[(begin_ + count_) % ring_.size()] = sample;
+        count_++;
+    }
+    else
+    {
+        ring_[begin_] = sample;
+        begin_ = (begin_ + 1) % ring_.size();
+    }
+}
+
+bool SolutionHistory::atGpsTime(double t, SolutionSample* out, const char** reason) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return interpolate(t, out, reason);
+}
+
+bool SolutionHistory::atHostTime(double t, SolutionSample* out, const char** reason) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return interpolate(t - host_offset_.offset(), out, reason);
+}
+
+double SolutionHistory::hostOffset() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return host_offset_.offset();
+}
+
+size_t SolutionHistory::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+/* --------------------------------------------------------------------------
+Cubic Hermite interpolation between the solutions bracketing t, using their
+positions and velocities; the velocity is the derivative of the same curve.
+Variances are interpolated linearly: the errors of consecutive solutions are
+strongly correlated, so they do not average down between epochs.
+-------------------------------------------------------------------------- */
+bool SolutionHistory::interpolate(double t, SolutionSample* out, const char** reason) const
+{
+    const char* why = NULL;
+    if(count_ == 0)
+        why = "no solutions yet";
+    else if(t < at(0).gps_time)
+        why = "older than the history";
+    else if(t > at(count_ - 1).gps_time)
+        why = "newer than the latest solution";
+    if(why)
+    {
+        if(reason)
+            *reason = why;
+        return false;
+    }
+
+    // First solution after t (binary search over the ring)
+    size_t lo = 0, hi = count_;
+    while(lo < hi)
+    {
+        size_t mid = (lo + hi)/2;
+        if(at(mid).gps_time <= t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if(lo == count_)
+    {
+        *out = at(count_ - 1);
+        out->host_time = out->gps_time + host_offset_.offset();
+        return true;
+    }
+
+    const SolutionSample& a = at(lo - 1);
+    const SolutionSample& b = at(lo);
+    double dt = b.gps_time - a.gps_time;
+    if(dt > max_gap_)
+    {
+        if(reason)
+            *reason = "gap between solutions longer than max_gap";
+        return false;
+    }
+
+    double s = (t - a.gps_time)/dt;
+    double s2 = s*s, s3 = s2*s;
+    double h00 = 2*s3 - 3*s2 + 1, h10 = s3 - 2*s2 + s;
+    double h01 = -2*s3 + 3*s2,    h11 = s3 - s2;
+    double d00 = 6*s2 - 6*s,      d10 = 3*s2 - 4*s + 1;
+    double d01 = -6*s2 + 6*s,     d11 = 3*s2 - 2*s;
+
+    for(int i = 0; i < 3; ++i)
+    {
+        out->position[i] = h00*a.position[i] + h10*dt*a.velocity[i] + h01*b.position[i] + h11*dt*b.velocity[i];
+        out->velocity[i] = (d00*a.position[i] + d01*b.position[i])/dt + d10*a.velocity[i] + d11*b.velocity[i];
+        out->position_var[i] = (1 - s)*a.position_var[i] + s*b.position_var[i];
+        out->velocity_var[i] = (1 - s)*a.velocity_var[i] + s*b.velocity_var[i];
+    }
+    out->gps_time = t;
+    out->host_time = t + host_offset_.offset();
+    // Status of the solution before t
+    out->position_status = a.position_status;
+    out->position_type = a.position_type;
+    return true;
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "capture.h"
+
+static std::string TempPath(const char* name)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/%s_%d", name, static_cast<int>(getpid()));
+    return path;
+}
+
+static std::vector<uint8_t> ReadFile(const std::string& path)
+{
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+        return data;
+    uint8_t block[4096];
+    size_t n;
+    while((n = fread(block, 1, sizeof(block), file)) > 0)
+        data.insert(data.end(), block, block + n);
+    fclose(file);
+    return data;
+}
+
+// Blocks of odd sizes over many windows of a small chunk, some spanning two
+TEST(MappedFile, AppendsAcrossWindows)
+{
+    const size_t chunk = 64*1024;
+    std::string path = TempPath("mapped_file");
+    std::vector<uint8_t> expected;
+
+    MappedFile file;
+    ASSERT_TRUE(file.open(path, chunk));
+    uint32_t state = 12345;
+    std::vector<uint8_t> block;
+    while(expected.size() < 10*chunk + 777)
+    {
+        block.resize(1 + (state >> 8) % 5000);
+        for(size_t i = 0; i < block.size(); ++i)
+        {
+            state = state*1103515245u + 12345u;
+            block[i] = state >> 24;
+        }
+        ASSERT_TRUE(file.append(block.data(), block.size()));
+        expected.insert(expected.end(), block.begin(), block.end());
+    }
+    // One larger than a chunk
+    block.assign(3*chunk/2, 0xA5);
+    ASSERT_TRUE(file.append(block.data(), block.size()));
+    expected.insert(expected.end(), block.begin(), block.end());
+    EXPECT_EQ(expected.size(), file.size());
+    file.close();
+
+    EXPECT_TRUE(ReadFile(path) == expected);
+    unlink(path.c_str());
+}
+
+// Ends exactly on a window boundary: the file is not padded
+TEST(MappedFile, ExactChunk)
+{
+    const size_t chunk = 64*1024;
+    std::string path = TempPath("mapped_file_exact");
+    std::vector<uint8_t> block(chunk, 0x3C);
+
+    MappedFile file;
+    ASSERT_TRUE(file.open(path, chunk));
+    ASSERT_TRUE(file.append(block.data(), block.size()));
+    file.close();
+
+    EXPECT_EQ(chunk, ReadFile(path).size());
+    unlink(path.c_str());
+}
+
+TEST(CaptureRecorder, ReplaysWhatWasRecorded)
+{
+    std::string path = TempPath("capture");
+    std::vector<uint8_t> bytes(100000);
+    for(size_t i = 0; i < bytes.size(); ++i)
+        bytes[i] = i*7;
+
+    {
+        CaptureRecorder recorder(path);
+        for(size_t pos = 0; pos < bytes.size(); pos += 1000)
+        {
+            ASSERT_TRUE(recorder.write(&bytes[pos], 1000));
+            ASSERT_TRUE(recorder.addFrame(pos, 1000 + pos, 241, 1000));
+        }
+    }
+
+    CaptureReplay replay(path, 0.0);
+    ASSERT_EQ(bytes.size(), replay.size());
+    EXPECT_EQ(0, memcmp(bytes.data(), replay.data(), bytes.size()));
+    ASSERT_EQ(100u, replay.entries());
+    EXPECT_EQ(99000u, replay.index()[99].offset);
+    EXPECT_EQ(241, replay.index()[99].msg_id);
+
+    unlink(path.c_str());
+    unlink((path + ".idx").c_str());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
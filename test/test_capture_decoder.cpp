@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "capture_decoder.h"
+#include "frame_builder.h"
+
+#define BESTXYZ_ID      241
+#define RANGE_ID        43
+#define SATXYZ_ID       270
+#define TRACKSTAT_ID    83
+#define TEST_EPOCHS     600
+
+static std::string TempPath(const char* name)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/%s_%d", name, static_cast<int>(getpid()));
+    return path;
+}
+
+static std::vector<uint8_t> ReadFile(const std::string& path)
+{
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+        return data;
+    uint8_t block[4096];
+    size_t n;
+    while((n = fread(block, 1, sizeof(block), file)) > 0)
+        data.insert(data.end(), block, block + n);
+    fclose(file);
+    return data;
+}
+
+// 1 Hz epochs of RANGE, TRACKSTAT, SATXYZ and BESTXYZ, with a few bytes of
+// line noise every 50 epochs, indexed as the driver records them
+static void WriteCapture(const std::string& path)
+{
+    CaptureRecorder recorder(path);
+    uint64_t offset = 0;
+    const uint8_t noise[] = { 0x00, 0xAA, 0x44, 0x55, 0xFF };
+    for(int t = 0; t < TEST_EPOCHS; ++t)
+    {
+        uint32_t ms = 345600000 + 1000*t;
+        double position[3] = { 4e6 + 0.1*t, -4.4e6, -1.7e6 }, velocity[3] = { 0.1, 0.0, 0.0 };
+        std::vector<uint8_t> body;
+        std::vector<std::pair<uint16_t, std::vector<uint8_t> > > frames;
+        BuildRangeBody(24, t, &body);
+        frames.push_back(std::make_pair(RANGE_ID, body));
+        BuildTrackStatBody(24, t, &body);
+        frames.push_back(std::make_pair(TRACKSTAT_ID, body));
+        BuildSatXYZBody(12, t, &body);
+        frames.push_back(std::make_pair(SATXYZ_ID, body));
+        BuildBestXYZBody(position, velocity, &body);
+        frames.push_back(std::make_pair(BESTXYZ_ID, body));
+
+        for(size_t i = 0; i < frames.size(); ++i)
+        {
+            std::vector<uint8_t> frame;
+            BuildFrame(frames[i].first, frames[i].second, 2200, ms, &frame);
+            ASSERT_TRUE(recorder.write(frame.data(), frame.size()));
+            int64_t stamp_ns = 1700000000000000000LL + t*1000000000LL + 20000000LL*(i + 1);
+            ASSERT_TRUE(recorder.addFrame(offset, stamp_ns, frames[i].first, frame.size()));
+            offset += frame.size();
+        }
+        if(t % 50 == 25)
+        {
+            ASSERT_TRUE(recorder.write(noise, sizeof(noise)));
+            offset += sizeof(noise);
+        }
+    }
+}
+
+// Everything gps_decode writes for the CSV and archive outputs
+struct Decoded
+{
+    size_t parts;
+    uint64_t frames;
+    std::string csv[ARCHIVE_TABLES];
+    std::vector<uint8_t> archive;
+};
+
+static Decoded Decode(const std::string& capture_path, int threads, size_t part)
+{
+    CaptureDecodeOptions options;
+    options.threads = threads;
+    options.part = part;
+    options.warmup = 16*1024;
+    options.chunk_rows = 256;
+    options.bag = false;
+    options.csv = true;
+    options.archive = true;
+
+    Decoded decoded;
+    decoded.frames = 0;
+    std::string archive_path = TempPath("capture_decoder_archive");
+    CaptureReplay capture(capture_path, 0.0);
+    std::vector<CapturePart> parts = SplitCapture(capture.data(), capture.size(), options);
+    decoded.parts = parts.size();
+    {
+        ArchiveWriter archive(archive_path, options.chunk_rows);
+        bool ok = DecodeCapture(capture, parts, options, [&](const CapturePartOutput& output)
+        {
+            decoded.frames += output.frames;
+            for(int t = 0; t < ARCHIVE_TABLES; ++t)
+                decoded.csv[t] += output.csv->text[t];
+            return archive.appendEncoded(*output.archive);
+        });
+        EXPECT_TRUE(ok);
+        archive.close();
+    }
+    decoded.archive = ReadFile(archive_path);
+    unlink(archive_path.c_str());
+    return decoded;
+}
+
+// The output is byte-identical with one thread and with four, at about 76
+// parts of 24 KB and 10 of 200 KB
+TEST(CaptureDecoder, SameOutputForAnyThreads)
+{
+    std::string path = TempPath("capture_decoder");
+    WriteCapture(path);
+    const size_t part_sizes[] = { 24*1024, 200*1024 };
+    std::string first_csv[ARCHIVE_TABLES];
+
+    for(int s = 0; s < 2; ++s)
+    {
+        Decoded single = Decode(path, 1, part_sizes[s]);
+        EXPECT_GT(single.parts, 1u);
+        EXPECT_EQ(TEST_EPOCHS*4u, single.frames);
+        EXPECT_FALSE(single.archive.empty());
+        for(int t = 0; t < ARCHIVE_TABLES; ++t)
+            EXPECT_FALSE(single.csv[t].empty()) << "table " << t;
+
+        Decoded parallel = Decode(path, 4, part_sizes[s]);
+        EXPECT_EQ(single.parts, parallel.parts);
+        EXPECT_EQ(single.frames, parallel.frames);
+        EXPECT_TRUE(single.archive == parallel.archive) << "part " << part_sizes[s];
+        for(int t = 0; t < ARCHIVE_TABLES; ++t)
+            EXPECT_EQ(single.csv[t], parallel.csv[t]) << "part " << part_sizes[s] << " table " << t;
+
+        // With the warm-up rebuilding the decoder state the rows do not
+        // depend on the part size either; the archive's chunking does
+        if(s == 0)
+        {
+            for(int t = 0; t < ARCHIVE_TABLES; ++t)
+                first_csv[t] = single.csv[t];
+        }
+        else
+        {
+            for(int t = 0; t < ARCHIVE_TABLES; ++t)
+                EXPECT_EQ(first_csv[t], single.csv[t]) << "table " << t;
+        }
+    }
+
+    unlink(path.c_str());
+    unlink((path + ".idx").c_str());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,204 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "compact_observations.h"
+
+#define PHASE_LOCK_FLAG     0x00000400
+#define PARITY_KNOWN_FLAG   0x00000800
+#define GPS_L2P             9
+#define GALILEO_E1C         2
+#define GALILEO_E5A         12
+
+typedef novatel_gps::RangeInformation RangeInformation;
+
+static RangeInformation Observation(int system, int prn, uint32_t signal, int t)
+{
+    RangeInformation obs;
+    obs.prn_slot = prn;
+    obs.ch_tr_status = PHASE_LOCK_FLAG | PARITY_KNOWN_FLAG | (static_cast<uint32_t>(system) << 16) | (signal << 21);
+    double rho = 2.0e7 + 2.5e5*prn + 1.0e5*system + (300.0 + 10.0*prn)*t + 3.0*std::sin(0.1*t + prn);
+    double wavelength = CarrierWavelength(obs.ch_tr_status);
+    obs.psr = rho + 0.3*std::cos(1.7*t + signal);
+    obs.psr_std = static_cast<float>(0.05 + 0.001*prn);
+    obs.adr = -rho/wavelength;
+    obs.adr_std = 0.004f;
+    obs.doppler = static_cast<float>(-(300.0 + 10.0*prn)/wavelength);
+    obs.c_no = static_cast<float>(40.0 + 0.1*prn + std::sin(0.01*t));
+    obs.locktime = static_cast<float>(100.0 + t);
+    obs.slip = 0;
+    return obs;
+}
+
+// GPS PRNs 1-12 on L1 and L2, Galileo PRNs 1-8 on E1 and E5a: Galileo shares
+// its PRN numbers with GPS
+static novatel_gps::Range Epoch(int t)
+{
+    novatel_gps::Range range;
+    for(int prn = 1; prn <= 12; ++prn)
+    {
+        range.ranges.push_back(Observation(SYSTEM_GPS, prn, 0, t));
+        range.ranges.push_back(Observation(SYSTEM_GPS, prn, GPS_L2P, t));
+    }
+    for(int prn = 1; prn <= 8; ++prn)
+    {
+        range.ranges.push_back(Observation(SYSTEM_GALILEO, prn, GALILEO_E1C, t));
+        range.ranges.push_back(Observation(SYSTEM_GALILEO, prn, GALILEO_E5A, t));
+    }
+    range.obs = range.ranges.size();
+    return range;
+}
+
+static novatel_gps::MsgHeader Header(int t)
+{
+    novatel_gps::MsgHeader header;
+    header.gps_week = 2200;
+    header.gps_ms = 345600000 + 1000*t;
+    return header;
+}
+
+static void ExpectSameRange(const novatel_gps::Range& expected, const novatel_gps::Range& range)
+{
+    ASSERT_EQ(expected.ranges.size(), range.ranges.size());
+    EXPECT_EQ(expected.obs, range.obs);
+    for(size_t i = 0; i < expected.ranges.size(); ++i)
+    {
+        const RangeInformation& a = expected.ranges[i];
+        const RangeInformation& b = range.ranges[i];
+        EXPECT_EQ(a.prn_slot, b.prn_slot);
+        EXPECT_EQ(a.ch_tr_status, b.ch_tr_status);
+        EXPECT_EQ(a.psr, b.psr);
+        EXPECT_EQ(a.psr_std, b.psr_std);
+        EXPECT_EQ(a.adr, b.adr);
+        EXPECT_EQ(a.adr_std, b.adr_std);
+        EXPECT_EQ(a.doppler, b.doppler);
+        EXPECT_EQ(a.c_no, b.c_no);
+        EXPECT_EQ(a.locktime, b.locktime);
+        EXPECT_EQ(a.slip, b.slip);
+    }
+}
+
+TEST(CompactObservations, RangeRoundTrip)
+{
+    CompactEncoder encoder(10);
+    CompactDecoder decoder;
+    for(int t = 0; t < 50; ++t)
+    {
+        novatel_gps::Range range = Epoch(t);
+        novatel_gps::CompactRange compact;
+        encoder.encode(Header(t), range, &compact);
+        EXPECT_EQ(t % 10 == 0, compact.key != 0);
+
+        novatel_gps::Range decoded;
+        ASSERT_TRUE(decoder.decode(compact, &decoded)) << "t " << t;
+        ExpectSameRange(range, decoded);
+    }
+}
+
+// GPS and Galileo PRN 5 are predicted from their own history: the log codes
+// to the same size as with Galileo PRNs no GPS satellite uses
+TEST(CompactObservations, GpsAndGalileoSamePrn)
+{
+    CompactEncoder shared(100), separate(100);
+    novatel_gps::CompactRange shared_compact, separate_compact;
+    for(int t = 0; t < 10; ++t)
+    {
+        novatel_gps::Range range = Epoch(t);
+        shared.encode(Header(t), range, &shared_compact);
+        for(size_t i = 24; i < range.ranges.size(); ++i)
+            range.ranges[i].prn_slot += 20;
+        separate.encode(Header(t), range, &separate_compact);
+    }
+    EXPECT_EQ(separate_compact.data.size(), shared_compact.data.size());
+}
+
+TEST(CompactObservations, RefusesUntilKeyAfterGap)
+{
+    CompactEncoder encoder(10);
+    CompactDecoder decoder;
+    for(int t = 0; t < 30; ++t)
+    {
+        novatel_gps::Range range = Epoch(t);
+        novatel_gps::CompactRange compact;
+        encoder.encode(Header(t), range, &compact);
+        if(t == 13)
+            continue;
+
+        novatel_gps::Range decoded;
+        bool decoded_ok = decoder.decode(compact, &decoded);
+        EXPECT_EQ(t < 13 || t >= 20, decoded_ok) << "t " << t;
+        if(decoded_ok)
+            ExpectSameRange(range, decoded);
+    }
+}
+
+TEST(CompactObservations, RefusesTruncated)
+{
+    CompactEncoder encoder(10);
+    CompactDecoder decoder;
+    novatel_gps::CompactRange compact;
+    novatel_gps::Range decoded;
+    encoder.encode(Header(0), Epoch(0), &compact);
+    ASSERT_TRUE(decoder.decode(compact, &decoded));
+
+    encoder.encode(Header(1), Epoch(1), &compact);
+    compact.data.pop_back();
+    EXPECT_FALSE(decoder.decode(compact, &decoded));
+    encoder.encode(Header(2), Epoch(2), &compact);
+    EXPECT_FALSE(decoder.decode(compact, &decoded));
+}
+
+TEST(CompactObservations, TrackStatRoundTrip)
+{
+    CompactEncoder encoder(10);
+    CompactDecoder decoder;
+    for(int t = 0; t < 30; ++t)
+    {
+        novatel_gps::Range range = Epoch(t);
+        novatel_gps::TrackStat tracking;
+        tracking.cutoff = 5.0f;
+        for(size_t i = 0; i < range.ranges.size(); ++i)
+        {
+            novatel_gps::TrackStatChannel channel;
+            channel.prn_slot = range.ranges[i].prn_slot;
+            channel.ch_tr_status = range.ranges[i].ch_tr_status;
+            channel.psr = range.ranges[i].psr;
+            channel.doppler = range.ranges[i].doppler;
+            channel.cn0 = range.ranges[i].c_no;
+            channel.locktime = range.ranges[i].locktime;
+            channel.psr_res = static_cast<float>(0.5*std::sin(t + 1.0*i));
+            channel.psr_weight = (i & 1) ? 0.0f : 1.0f;
+            channel.reject = (i & 1) ? 13 : 0;
+            tracking.channel.push_back(channel);
+        }
+        tracking.channels = tracking.channel.size();
+
+        novatel_gps::CompactTrackStat compact;
+        encoder.encode(Header(t), tracking, &compact);
+        novatel_gps::TrackStat decoded;
+        ASSERT_TRUE(decoder.decode(compact, &decoded)) << "t " << t;
+        ASSERT_EQ(tracking.channel.size(), decoded.channel.size());
+        EXPECT_EQ(tracking.cutoff, decoded.cutoff);
+        for(size_t i = 0; i < tracking.channel.size(); ++i)
+        {
+            const novatel_gps::TrackStatChannel& a = tracking.channel[i];
+            const novatel_gps::TrackStatChannel& b = decoded.channel[i];
+            EXPECT_EQ(a.prn_slot, b.prn_slot);
+            EXPECT_EQ(a.ch_tr_status, b.ch_tr_status);
+            EXPECT_EQ(a.reject, b.reject);
+            EXPECT_EQ(a.psr, b.psr);
+            EXPECT_EQ(a.doppler, b.doppler);
+            EXPECT_EQ(a.cn0, b.cn0);
+            EXPECT_EQ(a.locktime, b.locktime);
+            EXPECT_EQ(a.psr_res, b.psr_res);
+            EXPECT_EQ(a.psr_weight, b.psr_weight);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
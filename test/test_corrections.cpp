@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "corrections.h"
+
+// RTCM 10403 example message 1005 (stationary reference station ARP)
+static const uint8_t MESSAGE_1005[] = {
+    0xD3, 0x00, 0x13, 0x3E, 0xD7, 0xD3, 0x02, 0x02, 0x98, 0x0E, 0xDE, 0xEF, 0x34,
+    0xB4, 0xBD, 0x62, 0xAC, 0x09, 0x41, 0x98, 0x6F, 0x33, 0x36, 0x0B, 0x98 };
+
+// Collects the messages a framer passes on
+struct Messages
+{
+    std::vector<std::vector<uint8_t> > list;
+
+    RtcmFramer::MessageCallback callback()
+    {
+        return [this](const uint8_t* message, size_t size) { list.push_back(std::vector<uint8_t>(message, message + size)); };
+    }
+};
+
+static std::vector<uint8_t> Frame()
+{
+    return std::vector<uint8_t>(MESSAGE_1005, MESSAGE_1005 + sizeof(MESSAGE_1005));
+}
+
+TEST(Corrections, Crc24q)
+{
+    // Check value of CRC-24Q
+    EXPECT_EQ(0xCDE703u, CalculateCRC24Q(reinterpret_cast<const uint8_t*>("123456789"), 9));
+    EXPECT_EQ(0x360B98u, CalculateCRC24Q(MESSAGE_1005, sizeof(MESSAGE_1005) - 3));
+}
+
+TEST(Corrections, KnownFrame)
+{
+    RtcmFramer framer;
+    Messages messages;
+    framer.feed(MESSAGE_1005, sizeof(MESSAGE_1005), messages.callback());
+    ASSERT_EQ(1u, messages.list.size());
+    EXPECT_EQ(Frame(), messages.list[0]);
+    EXPECT_EQ(0u, framer.crcErrors());
+}
+
+// A preamble inside the corrupted message can claim up to 1029 bytes: the
+// frames behind it come through once that many have arrived
+TEST(Corrections, CorruptedCrc)
+{
+    std::vector<uint8_t> stream = Frame();
+    stream[10] ^= 0x01;
+    std::vector<uint8_t> frame = Frame();
+    for(int i = 0; i < 45; ++i)
+        stream.insert(stream.end(), frame.begin(), frame.end());
+
+    RtcmFramer framer;
+    Messages messages;
+    framer.feed(stream.data(), stream.size(), messages.callback());
+    ASSERT_EQ(45u, messages.list.size());
+    for(size_t i = 0; i < messages.list.size(); ++i)
+        EXPECT_EQ(frame, messages.list[i]);
+    EXPECT_GE(framer.crcErrors(), 1u);
+}
+
+TEST(Corrections, ResyncAfterGarbage)
+{
+    // Noise with false preambles before and between the frames: 0xD3 0x55 and
+    // 0xD3 0xD3 have reserved bits set, 0xD3 0x00 0x13 fails its CRC
+    std::vector<uint8_t> stream = { 0x00, 0xD3, 0x00, 0x13, 0xFF, 0x12, 0xD3, 0x55 };
+    std::vector<uint8_t> frame = Frame();
+    stream.insert(stream.end(), frame.begin(), frame.end());
+    stream.push_back(0xAA);
+    stream.push_back(0xD3);
+    stream.insert(stream.end(), frame.begin(), frame.end());
+
+    RtcmFramer framer;
+    Messages messages;
+    framer.feed(stream.data(), stream.size(), messages.callback());
+    ASSERT_EQ(2u, messages.list.size());
+    EXPECT_EQ(frame, messages.list[0]);
+    EXPECT_EQ(frame, messages.list[1]);
+}
+
+TEST(Corrections, SplitAcrossReads)
+{
+    std::vector<uint8_t> stream = Frame();
+    std::vector<uint8_t> frame = Frame();
+    stream.insert(stream.end(), frame.begin(), frame.end());
+
+    for(size_t split = 1; split < stream.size(); ++split)
+    {
+        RtcmFramer framer;
+        Messages messages;
+        framer.feed(stream.data(), split, messages.callback());
+        EXPECT_EQ(split >= frame.size() ? 1u : 0u, messages.list.size()) << "split " << split;
+        framer.feed(stream.data() + split, stream.size() - split, messages.callback());
+        ASSERT_EQ(2u, messages.list.size()) << "split " << split;
+        EXPECT_EQ(frame, messages.list[1]);
+        EXPECT_EQ(0u, framer.crcErrors());
+    }
+}
+
+// A regular file is read once, not re-injected each time its end is reached
+TEST(Corrections, FileReadOnce)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/corrections_%d.rtcm", static_cast<int>(getpid()));
+    FILE* file = fopen(path, "wb");
+    ASSERT_TRUE(file != NULL);
+    for(int i = 0; i < 3; ++i)
+        fwrite(MESSAGE_1005, 1, sizeof(MESSAGE_1005), file);
+    fclose(file);
+
+    int port[2];
+    ASSERT_EQ(0, pipe(port));
+    fcntl(port[0], F_SETFL, O_NONBLOCK);
+    {
+        CorrectionWriter writer(port[1], 10.0, 8192);
+        CorrectionSource source(std::string("file://") + path, &writer);
+        usleep(500000);
+        CorrectionStats stats = writer.stats();
+        EXPECT_EQ(3u, stats.messages);
+        EXPECT_EQ(3*sizeof(MESSAGE_1005), stats.bytes);
+    }
+
+    uint8_t buffer[1024];
+    EXPECT_EQ(static_cast<ssize_t>(3*sizeof(MESSAGE_1005)), read(port[0], buffer, sizeof(buffer)));
+    close(port[0]);
+    close(port[1]);
+    unlink(path);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "novatel_gps.h"
+#include "frame_builder.h"
+
+#define RANGE_ID        43
+#define RANGECMP_ID     140
+#define SATXYZ_ID       270
+#define TRACKSTAT_ID    83
+
+// Body of msg_id with count records and where the count is
+static void Body(uint16_t msg_id, int count, std::vector<uint8_t>* body, int* count_offset)
+{
+    body->clear();
+    if(msg_id == RANGE_ID)
+    {
+        BuildRangeBody(count, 1, body);
+        *count_offset = 0;
+    }
+    else if(msg_id == RANGECMP_ID)
+    {
+        BuildRangeCmpBody(count, 1, body);
+        *count_offset = 0;
+    }
+    else if(msg_id == SATXYZ_ID)
+    {
+        BuildSatXYZBody(count, 1, body);
+        *count_offset = 8;
+    }
+    else
+    {
+        BuildTrackStatBody(count, 1, body);
+        *count_offset = 12;
+    }
+}
+
+// Frames decoded and their ids
+static int Parse(GPS* gps, const std::vector<uint8_t>& stream, std::vector<uint16_t>* ids)
+{
+    return gps->parse(stream.data(), stream.size(), [ids](uint16_t msg_id) { ids->push_back(msg_id); });
+}
+
+// A count of one record more than the body holds, or one that overflows
+// 32 bits when multiplied by the record size, is refused; the frame after it
+// decodes
+TEST(Decode, RefusesCountsPastThePayload)
+{
+    const uint16_t logs[] = { RANGE_ID, RANGECMP_ID, SATXYZ_ID, TRACKSTAT_ID };
+    const uint32_t counts[] = { 9, 0x10000000, 0xFFFFFFFF };
+    for(size_t l = 0; l < sizeof(logs)/sizeof(logs[0]); ++l)
+        for(size_t c = 0; c < sizeof(counts)/sizeof(counts[0]); ++c)
+        {
+            std::vector<uint8_t> body, stream;
+            int count_offset;
+            Body(logs[l], 8, &body, &count_offset);
+            std::vector<uint8_t> good = body;
+            memcpy(&body[count_offset], &counts[c], sizeof(uint32_t));
+            BuildFrame(logs[l], body, 2200, 1000, &stream);
+            BuildFrame(logs[l], good, 2200, 2000, &stream);
+
+            GPS gps;
+            std::vector<uint16_t> ids;
+            EXPECT_EQ(1, Parse(&gps, stream, &ids)) << "log " << logs[l] << " count " << counts[c];
+            ASSERT_EQ(1u, ids.size());
+            EXPECT_EQ(logs[l], ids[0]);
+            EXPECT_EQ(2000u, gps.header().gps_ms);
+            EXPECT_EQ(0u, gps.crcErrors());
+        }
+}
+
+TEST(Decode, AcceptsCountsThatFit)
+{
+    const uint16_t logs[] = { RANGE_ID, RANGECMP_ID, SATXYZ_ID, TRACKSTAT_ID };
+    for(size_t l = 0; l < sizeof(logs)/sizeof(logs[0]); ++l)
+        for(int count = 0; count <= 24; count += 8)
+        {
+            std::vector<uint8_t> body, stream;
+            int count_offset;
+            Body(logs[l], count, &body, &count_offset);
+            BuildFrame(logs[l], body, 2200, 1000, &stream);
+
+            GPS gps;
+            std::vector<uint16_t> ids;
+            EXPECT_EQ(1, Parse(&gps, stream, &ids)) << "log " << logs[l] << " count " << count;
+        }
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
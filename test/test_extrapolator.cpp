@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "extrapolator.h"
+#include "novatel_gps.h"
+#include "frame_builder.h"
+
+// GPS time of the first fix, GPS week 2200
+#define TEST_START_S    (2200*GPS_SECONDS_IN_WEEK)
+// Receive latency of every fix
+#define TEST_LATENCY_S  0.02
+#define BESTXYZ_ID      241
+
+static SolutionSample Fix(double tau, double vx)
+{
+    SolutionSample fix;
+    memset(&fix, 0, sizeof(fix));
+    fix.gps_time = TEST_START_S + tau;
+    fix.position[0] = 4e6 + tau;
+    fix.position[1] = -4.4e6;
+    fix.position[2] = -1.7e6;
+    fix.velocity[0] = vx;
+    for(int i = 0; i < 3; ++i)
+    {
+        fix.position_var[i] = 1.0;
+        fix.velocity_var[i] = 0.01;
+    }
+    fix.position_type = 16;
+    return fix;
+}
+
+static int64_t ReceiveNs(double tau)
+{
+    return static_cast<int64_t>((TEST_START_S + tau + TEST_LATENCY_S)*1e9);
+}
+
+// Host time tau seconds after the fix at fix_tau was received
+static int64_t StampNs(double fix_tau, double tau)
+{
+    return ReceiveNs(fix_tau) + static_cast<int64_t>(tau*1e9);
+}
+
+TEST(HostClockOffset, SmallestOverWindow)
+{
+    HostClockOffset offset;
+    EXPECT_EQ(0.0, offset.offset());
+    offset.add(100.0, static_cast<int64_t>(118.05e9));
+    offset.add(101.0, static_cast<int64_t>(119.02e9));
+    offset.add(102.0, static_cast<int64_t>(120.09e9));
+    EXPECT_NEAR(18.02, offset.offset(), 1e-9);
+
+    // The least-delayed sample leaves the window
+    for(int i = 0; i < HOST_OFFSET_WINDOW; ++i)
+        offset.add(103.0 + i, static_cast<int64_t>((121.04 + i)*1e9));
+    EXPECT_NEAR(18.04, offset.offset(), 1e-6);
+}
+
+// A velocity 50 ms old, accelerating at 10 m/s^2, is brought forward by 0.5 m/s
+TEST(PoseExtrapolator, VelocityBroughtForward)
+{
+    PoseExtrapolator extrapolator;
+    extrapolator.configure(1.0, 0.0);
+    extrapolator.addFix(Fix(0.0, 1.0), 0.05, ReceiveNs(0.0));
+
+    ExtrapolatedPose pose;
+    ASSERT_TRUE(extrapolator.at(StampNs(0.0, 0.0), &pose));
+    EXPECT_NEAR(1.0, pose.velocity[0], 1e-9);
+
+    extrapolator.addFix(Fix(0.1, 2.0), 0.05, ReceiveNs(0.1));
+    ASSERT_TRUE(extrapolator.at(StampNs(0.1, 0.2), &pose));
+    EXPECT_NEAR(2.5, pose.velocity[0], 1e-5);
+    EXPECT_NEAR(0.2, pose.age, 1e-6);
+    EXPECT_NEAR(4e6 + 0.1 + 2.5*0.2, pose.position[0], 1e-5);
+    EXPECT_EQ(16, pose.position_type);
+}
+
+// Constant velocity model with white acceleration noise, the velocity
+// latency adding to the velocity variance
+TEST(PoseExtrapolator, VarianceGrowth)
+{
+    const double accel_var = 0.25, latency = 0.1, tau = 0.4;
+    PoseExtrapolator extrapolator;
+    extrapolator.configure(1.0, 0.5);
+    extrapolator.addFix(Fix(0.0, 1.0), latency, ReceiveNs(0.0));
+
+    ExtrapolatedPose pose;
+    ASSERT_TRUE(extrapolator.at(StampNs(0.0, 0.0), &pose));
+    double velocity_var = 0.01 + accel_var*latency*latency;
+    EXPECT_NEAR(1.0, pose.position_var[0], 1e-9);
+    EXPECT_NEAR(velocity_var, pose.velocity_var[0], 1e-9);
+
+    ASSERT_TRUE(extrapolator.at(StampNs(0.0, tau), &pose));
+    EXPECT_NEAR(1.0 + velocity_var*tau*tau + accel_var*tau*tau*tau*tau/4.0, pose.position_var[0], 1e-6);
+    EXPECT_NEAR(velocity_var + accel_var*tau*tau, pose.velocity_var[0], 1e-6);
+}
+
+TEST(PoseExtrapolator, CutOffAtMaxAge)
+{
+    PoseExtrapolator extrapolator;
+    ExtrapolatedPose pose;
+    EXPECT_FALSE(extrapolator.at(StampNs(0.0, 0.0), &pose));
+
+    extrapolator.configure(0.5, 1.0);
+    extrapolator.addFix(Fix(0.0, 1.0), 0.0, ReceiveNs(0.0));
+    EXPECT_TRUE(extrapolator.at(StampNs(0.0, 0.49), &pose));
+    EXPECT_FALSE(extrapolator.at(StampNs(0.0, 0.51), &pose));
+
+    extrapolator.invalidate();
+    EXPECT_FALSE(extrapolator.at(StampNs(0.0, 0.1), &pose));
+
+    // The next fix restarts output without an acceleration across the gap
+    extrapolator.addFix(Fix(0.2, 3.0), 0.05, ReceiveNs(0.2));
+    ASSERT_TRUE(extrapolator.at(StampNs(0.2, 0.0), &pose));
+    EXPECT_NEAR(3.0, pose.velocity[0], 1e-9);
+}
+
+// Through the driver: a BESTXYZ whose position was not computed stops the output
+TEST(PoseExtrapolator, StopsAfterSolutionNotComputed)
+{
+    const double position[3] = { 4e6, -4.4e6, -1.7e6 }, velocity[3] = { 1.0, 0.0, 0.0 };
+    GPS gps;
+    gps.setExtrapolation(1.0, 1.0);
+
+    std::vector<uint8_t> body, frame;
+    BuildBestXYZBody(position, velocity, &body);
+    BuildFrame(BESTXYZ_ID, body, 2200, 0, &frame);
+    ASSERT_EQ(1, gps.receive(frame.data(), frame.size(), ReceiveNs(0.0), GPS::FrameCallback()));
+    ExtrapolatedPose pose;
+    EXPECT_TRUE(gps.extrapolator().at(StampNs(0.0, 0.1), &pose));
+
+    uint32_t insufficient_obs = 1;
+    memcpy(&body[0], &insufficient_obs, sizeof(insufficient_obs));
+    frame.clear();
+    BuildFrame(BESTXYZ_ID, body, 2200, 100, &frame);
+    ASSERT_EQ(1, gps.receive(frame.data(), frame.size(), ReceiveNs(0.1), GPS::FrameCallback()));
+    EXPECT_FALSE(gps.extrapolator().at(StampNs(0.1, 0.0), &pose));
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
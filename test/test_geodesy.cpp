@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "geodesy.h"
+
+#define WGS84_B     (WGS84_A*(1.0 - WGS84_F))
+
+// Round trip from the surface to above GPS orbits: the closed form must stay
+// well under a millimetre, the level BESTXYZ sigmas start at
+TEST(Geodesy, EcefToLlaRoundTrip)
+{
+    const double heights[] = { -430.0, 0.0, 1024.0, 8848.0, 4.0e5, 2.02e7, 3.6e7 };
+    double worst_horizontal = 0.0, worst_height = 0.0;
+
+    for(double lat = -90.0; lat <= 90.0; lat += 2.5)
+    {
+        for(double lon = -180.0; lon < 180.0; lon += 7.5)
+        {
+            for(size_t k = 0; k < sizeof(heights)/sizeof(heights[0]); ++k)
+            {
+                double ecef[3], lat2, lon2, h2;
+                LlaToEcef(lat*DEG2RAD, lon*DEG2RAD, heights[k], ecef);
+                EcefToLla(ecef, &lat2, &lon2, &h2);
+
+                double radius = WGS84_A + heights[k];
+                double dlon = std::remainder(lon2 - lon*DEG2RAD, 2.0*M_PI);
+                double horizontal = radius*std::hypot(lat2 - lat*DEG2RAD, dlon*std::cos(lat*DEG2RAD));
+                worst_horizontal = std::max(worst_horizontal, horizontal);
+                worst_height = std::max(worst_height, std::fabs(h2 - heights[k]));
+            }
+        }
+    }
+    EXPECT_LT(worst_horizontal, 1e-6);
+    EXPECT_LT(worst_height, 1e-6);
+}
+
+TEST(Geodesy, ReferencePoints)
+{
+    double ecef[3];
+    LlaToEcef(0.0, 0.0, 0.0, ecef);
+    EXPECT_NEAR(WGS84_A, ecef[0], 1e-9);
+    EXPECT_NEAR(0.0, ecef[1], 1e-9);
+    EXPECT_NEAR(0.0, ecef[2], 1e-9);
+
+    LlaToEcef(90.0*DEG2RAD, 0.0, 0.0, ecef);
+    EXPECT_NEAR(0.0, ecef[0], 1e-6);
+    EXPECT_NEAR(WGS84_B, ecef[2], 1e-6);
+
+    double lat, lon, h;
+    const double pole[3] = { 0.0, 0.0, WGS84_B + 100.0 };
+    EcefToLla(pole, &lat, &lon, &h);
+    EXPECT_NEAR(90.0, lat*RAD2DEG, 1e-9);
+    EXPECT_NEAR(100.0, h, 1e-6);
+}
+
+// 0.001 deg of latitude and longitude at the default SETAPPROXPOS, against
+// the meridian and parallel arc lengths
+TEST(Geodesy, EnuOffsets)
+{
+    const double lat = -15.765824*DEG2RAD, lon = -47.872109*DEG2RAD, h = 1024.0;
+    double origin[3], R[9], point[3], enu[3];
+    LlaToEcef(lat, lon, h, origin);
+    EnuRotation(lat, lon, R);
+
+    double s = std::sin(lat);
+    double w = std::sqrt(1.0 - WGS84_E2*s*s);
+    double meridian = WGS84_A*(1.0 - WGS84_E2)/(w*w*w) + h;
+    double normal = WGS84_A/w + h;
+
+    LlaToEcef(lat + 0.001*DEG2RAD, lon, h, point);
+    EcefToEnu(point, origin, R, enu);
+    EXPECT_NEAR(0.0, enu[0], 1e-6);
+    EXPECT_NEAR(meridian*0.001*DEG2RAD, enu[1], 1e-3);
+    EXPECT_NEAR(0.0, enu[2], 0.02);
+
+    LlaToEcef(lat, lon + 0.001*DEG2RAD, h, point);
+    EcefToEnu(point, origin, R, enu);
+    EXPECT_NEAR(normal*std::cos(lat)*0.001*DEG2RAD, enu[0], 1e-3);
+    EXPECT_NEAR(0.0, enu[1], 1e-3);
+
+    // Straight up
+    LlaToEcef(lat, lon, h + 10.0, point);
+    EcefToEnu(point, origin, R, enu);
+    EXPECT_NEAR(0.0, enu[0], 1e-9);
+    EXPECT_NEAR(0.0, enu[1], 1e-9);
+    EXPECT_NEAR(10.0, enu[2], 1e-9);
+}
+
+// An isotropic covariance is unchanged by the rotation, its trace always
+TEST(Geodesy, RotateCovariance)
+{
+    double R[9];
+    EnuRotation(-15.765824*DEG2RAD, -47.872109*DEG2RAD, R);
+
+    const double isotropic[9] = { 4, 0, 0, 0, 4, 0, 0, 0, 4 };
+    double out[9];
+    RotateCovariance(R, isotropic, out);
+    for(int i = 0; i < 9; ++i)
+        EXPECT_NEAR(isotropic[i], out[i], 1e-12);
+
+    const double C[9] = { 1.0, 0.2, 0.1, 0.2, 2.0, 0.3, 0.1, 0.3, 3.0 };
+    RotateCovariance(R, C, out);
+    EXPECT_NEAR(6.0, out[0] + out[4] + out[8], 1e-12);
+    EXPECT_NEAR(out[1], out[3], 1e-12);
+}
+
+// Vehicle axes (x right, y forward, z up) in ENU for a SPAN attitude
+static void VehicleToEnu(double roll, double pitch, double azimuth, const double v[3], double out[3])
+{
+    double q[4];
+    AttitudeToQuaternion(roll, pitch, azimuth, q);
+    double x = q[0], y = q[1], z = q[2], w = q[3];
+    double R[9] = { 1 - 2*(y*y + z*z), 2*(x*y - w*z),     2*(x*z + w*y),
+                    2*(x*y + w*z),     1 - 2*(x*x + z*z), 2*(y*z - w*x),
+                    2*(x*z - w*y),     2*(y*z + w*x),     1 - 2*(x*x + y*y) };
+    for(int i = 0; i < 3; ++i)
+        out[i] = R[3*i]*v[0] + R[3*i + 1]*v[1] + R[3*i + 2]*v[2];
+}
+
+TEST(Geodesy, Attitude)
+{
+    const double forward[3] = { 0, 1, 0 }, right[3] = { 1, 0, 0 };
+    double v[3];
+
+    // Azimuth 90: forward points east
+    VehicleToEnu(0, 0, 90, forward, v);
+    EXPECT_NEAR(1.0, v[0], 1e-12);
+    EXPECT_NEAR(0.0, v[1], 1e-12);
+
+    // Pitch up 10: forward climbs
+    VehicleToEnu(0, 10, 0, forward, v);
+    EXPECT_NEAR(std::sin(10*DEG2RAD), v[2], 1e-12);
+
+    // Roll 10 (right wing down): right points down
+    VehicleToEnu(10, 0, 0, right, v);
+    EXPECT_NEAR(-std::sin(10*DEG2RAD), v[2], 1e-12);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "hatch_filter.h"
+
+#define PHASE_LOCK_FLAG     0x00000400
+#define GALILEO_E1C         2
+
+typedef novatel_gps::RangeInformation RangeInformation;
+
+// L1 observation of a satellite at range rho (m), the pseudorange off by
+// noise (m), ADR the negative carrier phase in cycles as NovAtel logs it
+static RangeInformation Observation(int system, int prn, double rho, double noise)
+{
+    RangeInformation range;
+    range.prn_slot = prn;
+    uint32_t signal = (system == SYSTEM_GALILEO) ? GALILEO_E1C : 0;
+    range.ch_tr_status = PHASE_LOCK_FLAG | (static_cast<uint32_t>(system) << 16) | (signal << 21);
+    range.psr = rho + noise;
+    range.adr = -rho/CarrierWavelength(range.ch_tr_status);
+    range.slip = 0;
+    return range;
+}
+
+// 1 m pseudorange noise averaged over a 100-epoch window
+TEST(HatchFilter, SmoothsNoise)
+{
+    std::mt19937 rng(11);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    HatchFilter filter;
+    filter.configure(100);
+
+    double raw2 = 0.0, smoothed2 = 0.0;
+    int count = 0;
+    for(int t = 0; t < 1000; ++t)
+    {
+        double rho = 2.2e7 + 500.0*t;
+        RangeInformation range = Observation(SYSTEM_GPS, 5, rho, noise(rng));
+        filter.update(range, t);
+
+        int length;
+        double psr = filter.smoothed(range, &length);
+        EXPECT_EQ(std::min(t + 1, 100), length);
+        if(t >= 200)
+        {
+            raw2 += (range.psr - rho)*(range.psr - rho);
+            smoothed2 += (psr - rho)*(psr - rho);
+            count++;
+        }
+    }
+    // sqrt((2n - 1)/n^2) of the raw noise once the window is full: 0.14
+    EXPECT_LT(std::sqrt(smoothed2/count), 0.2*std::sqrt(raw2/count));
+}
+
+TEST(HatchFilter, RestartsOnSlip)
+{
+    HatchFilter filter;
+    filter.configure(100);
+    for(int t = 0; t < 10; ++t)
+        filter.update(Observation(SYSTEM_GPS, 5, 2.2e7 + 500.0*t, 0.0), t);
+
+    RangeInformation range = Observation(SYSTEM_GPS, 5, 2.2e7 + 5000.0, 3.0);
+    range.slip = RangeInformation::SLIP_DOPPLER;
+    filter.update(range, 10);
+    int length;
+    EXPECT_EQ(range.psr, filter.smoothed(range, &length));
+    EXPECT_EQ(1, length);
+}
+
+TEST(HatchFilter, RepeatedEpochIgnored)
+{
+    HatchFilter filter;
+    filter.configure(100);
+    RangeInformation range = Observation(SYSTEM_GPS, 5, 2.2e7, 0.0);
+    filter.update(range, 0);
+    filter.update(range, 0);
+    int length;
+    filter.smoothed(range, &length);
+    EXPECT_EQ(1, length);
+}
+
+// GPS and Galileo PRN 5 in the same log are different satellites, each
+// smoothed on its own
+TEST(HatchFilter, GpsAndGalileoSamePrn)
+{
+    HatchFilter filter;
+    filter.configure(100);
+    RangeInformation gps, galileo;
+    for(int t = 0; t < 20; ++t)
+    {
+        gps = Observation(SYSTEM_GPS, 5, 2.2e7 + 500.0*t, 0.0);
+        galileo = Observation(SYSTEM_GALILEO, 5, 2.6e7 - 300.0*t, 0.0);
+        filter.update(gps, t);
+        filter.update(galileo, t);
+    }
+
+    int length;
+    EXPECT_NEAR(gps.psr, filter.smoothed(gps, &length), 1e-6);
+    EXPECT_EQ(20, length);
+    EXPECT_NEAR(galileo.psr, filter.smoothed(galileo, &length), 1e-6);
+    EXPECT_EQ(20, length);
+}
+
+TEST(HatchFilter, OutsideTablePassesThrough)
+{
+    HatchFilter filter;
+    RangeInformation range = Observation(SYSTEM_OTHER, 5, 2.2e7, 0.0);
+    filter.update(range, 0);
+    int length;
+    EXPECT_EQ(range.psr, filter.smoothed(range, &length));
+    EXPECT_EQ(0, length);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "log_archive.h"
+#include "satellite_table.h"
+
+// GPS week 2200 in ms since the GPS epoch
+#define TEST_START_MS   (2200*604800000.0)
+
+static std::string TempPath(const char* name)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/%s_%d.arc", name, static_cast<int>(getpid()));
+    return path;
+}
+
+// RANGE row of PRN prn at second t, values that exercise the XOR coding
+static void RangeRow(int t, int prn, double* row)
+{
+    row[0] = TEST_START_MS + t*1000.0;
+    row[1] = prn;
+    row[2] = 0x00000C04 | (prn & 1) << 21;
+    row[3] = 2.2e7 + 1000.0*prn + 0.731*t;
+    row[4] = static_cast<float>(0.05 + 0.001*prn);
+    row[5] = -1.15e8 - 3.84*t + prn;
+    row[6] = static_cast<float>(0.004);
+    row[7] = static_cast<float>(-1234.5 + 0.01*t);
+    row[8] = static_cast<float>(40.0 + 0.1*prn + std::sin(t*0.01));
+    row[9] = static_cast<float>(t);
+    row[10] = (t % 100 == 0) ? 8 : 0;
+}
+
+// 20 minutes at 1 Hz of PRNs 1-20, chunks of 1000 rows. Encoded up front
+// and written with appendEncoded(), as gps_decode does: append() faster than
+// real time would drop chunks once the writer's ring is full.
+static void WriteArchive(const std::string& path)
+{
+    ArchiveEncoder encoder(1000);
+    double row[11];
+    for(int t = 0; t < 1200; ++t)
+        for(int prn = 1; prn <= 20; ++prn)
+        {
+            RangeRow(t, prn, row);
+            ASSERT_TRUE(encoder.append(ARCHIVE_RANGE, row));
+        }
+    encoder.flush();
+
+    ArchiveWriter writer(path, 1000);
+    ASSERT_TRUE(writer.appendEncoded(encoder));
+    writer.close();
+    EXPECT_EQ(24000u, writer.rows());
+}
+
+// C/N0 and psr of PRN 12 over 5 minutes, exactly as written
+static void CheckQuery(const ArchiveReader& reader)
+{
+    ArchiveQuery query;
+    query.table = ARCHIVE_RANGE;
+    query.first_ms = TEST_START_MS + 600*1000.0;
+    query.last_ms = TEST_START_MS + 899*1000.0;
+    query.prn = 12;
+    query.system = -1;
+    query.columns.push_back(0);
+    query.columns.push_back(ArchiveFindColumn(ARCHIVE_RANGE, "c_no"));
+    query.columns.push_back(ArchiveFindColumn(ARCHIVE_RANGE, "psr"));
+
+    ArchiveResult result;
+    ASSERT_EQ(300u, reader.query(query, &result));
+    ASSERT_EQ(3u, result.columns.size());
+    double row[11];
+    for(int i = 0; i < 300; ++i)
+    {
+        RangeRow(600 + i, 12, row);
+        EXPECT_EQ(row[0], result.columns[0][i]);
+        EXPECT_EQ(row[8], result.columns[1][i]);
+        EXPECT_EQ(row[3], result.columns[2][i]);
+    }
+    // 20 rows a second in 1000-row chunks: 50 s each, 24 chunks
+    EXPECT_LE(result.chunks_read, 7u);
+    EXPECT_GE(result.chunks_skipped, 17u);
+}
+
+TEST(LogArchive, RoundTrip)
+{
+    std::string path = TempPath("log_archive");
+    WriteArchive(path);
+
+    ArchiveReader reader(path);
+    EXPECT_FALSE(reader.recovered());
+    EXPECT_EQ(24u, reader.index().size());
+    CheckQuery(reader);
+
+    unlink(path.c_str());
+}
+
+// Rows through append() and the writer thread
+TEST(LogArchive, PrnMaskSkipsChunks)
+{
+    std::string path = TempPath("log_archive_prn");
+    {
+        ArchiveWriter writer(path, 100);
+        double row[11];
+        for(int t = 0; t < 100; ++t)
+        {
+            RangeRow(t, (t < 50) ? 3 : 4, row);
+            ASSERT_TRUE(writer.append(ARCHIVE_RANGE, row));
+        }
+    }
+
+    ArchiveReader reader(path);
+    ArchiveQuery query;
+    query.table = ARCHIVE_RANGE;
+    query.first_ms = TEST_START_MS;
+    query.last_ms = TEST_START_MS + 1e6;
+    query.prn = 7;
+    query.system = -1;
+    query.columns.push_back(0);
+    ArchiveResult result;
+    EXPECT_EQ(0u, reader.query(query, &result));
+    EXPECT_EQ(0u, result.chunks_read);
+
+    query.prn = 4;
+    EXPECT_EQ(50u, reader.query(query, &result));
+
+    unlink(path.c_str());
+}
+
+// GPS and Galileo PRN 5 in chunks of their own: the mask tells them apart
+TEST(LogArchive, SatelliteMaskBySystem)
+{
+    std::string path = TempPath("log_archive_system");
+    {
+        ArchiveEncoder encoder(100);
+        double row[11];
+        for(int t = 0; t < 200; ++t)
+        {
+            RangeRow(t, 5, row);
+            if(t >= 100)
+                row[2] = static_cast<double>(static_cast<uint32_t>(row[2]) | SYSTEM_GALILEO << 16);
+            ASSERT_TRUE(encoder.append(ARCHIVE_RANGE, row));
+        }
+        encoder.flush();
+        ArchiveWriter writer(path, 100);
+        ASSERT_TRUE(writer.appendEncoded(encoder));
+    }
+
+    ArchiveReader reader(path);
+    ArchiveQuery query;
+    query.table = ARCHIVE_RANGE;
+    query.first_ms = TEST_START_MS;
+    query.last_ms = TEST_START_MS + 1e6;
+    query.prn = 5;
+    query.system = SYSTEM_GALILEO;
+    query.columns.push_back(0);
+    ArchiveResult result;
+    EXPECT_EQ(100u, reader.query(query, &result));
+    EXPECT_EQ(1u, result.chunks_read);
+    EXPECT_EQ(TEST_START_MS + 100*1000.0, result.columns[0][0]);
+
+    query.system = SYSTEM_GPS;
+    result = ArchiveResult();
+    EXPECT_EQ(100u, reader.query(query, &result));
+    EXPECT_EQ(1u, result.chunks_read);
+    EXPECT_EQ(TEST_START_MS, result.columns[0][0]);
+
+    query.system = -1;
+    EXPECT_EQ(200u, reader.query(query, &result));
+
+    // The whole system, and a PRN the system does not have
+    query.prn = -1;
+    query.system = SYSTEM_GALILEO;
+    EXPECT_EQ(100u, reader.query(query, &result));
+    query.system = SYSTEM_GLONASS;
+    result = ArchiveResult();
+    EXPECT_EQ(0u, reader.query(query, &result));
+    EXPECT_EQ(0u, result.chunks_read);
+
+    unlink(path.c_str());
+}
+
+// Killed writer: no index or trailer, the reader walks the chunks
+TEST(LogArchive, RecoversWithoutTrailer)
+{
+    std::string path = TempPath("log_archive_killed");
+    WriteArchive(path);
+
+    uint64_t index_offset;
+    {
+        ArchiveReader reader(path);
+        ArchiveTrailer trailer;
+        FILE* file = fopen(path.c_str(), "rb");
+        ASSERT_TRUE(file != NULL);
+        fseek(file, -static_cast<long>(sizeof(trailer)), SEEK_END);
+        ASSERT_EQ(1u, fread(&trailer, sizeof(trailer), 1, file));
+        fclose(file);
+        index_offset = trailer.index_offset;
+        ASSERT_LT(index_offset, reader.size());
+    }
+    ASSERT_EQ(0, truncate(path.c_str(), index_offset));
+
+    ArchiveReader reader(path);
+    EXPECT_TRUE(reader.recovered());
+    EXPECT_EQ(24u, reader.index().size());
+    CheckQuery(reader);
+
+    unlink(path.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
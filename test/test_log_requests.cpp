@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include "novatel_gps.h"
+
+// The logs parameter: periods as ints or doubles, entries without a name skipped
+TEST(LogRequests, Parse)
+{
+    XmlRpc::XmlRpcValue logs;
+    logs[0]["name"] = std::string("INSPVAS");
+    logs[0]["trigger"] = std::string("ONTIME");
+    logs[0]["period"] = 0.005;
+    logs[1]["name"] = std::string("BESTXYZ");
+    logs[1]["trigger"] = std::string("ONTIME");
+    logs[1]["period"] = 1;
+    logs[1]["offset"] = 0.5;
+    logs[1]["priority"] = 2;
+    logs[2]["trigger"] = std::string("ONNEW");
+
+    std::vector<LogRequest> requests;
+    ASSERT_TRUE(ParseLogRequests(logs, &requests));
+    ASSERT_EQ(2u, requests.size());
+    EXPECT_EQ("INSPVAS", requests[0].name);
+    EXPECT_EQ("ONTIME", requests[0].trigger);
+    EXPECT_DOUBLE_EQ(0.005, requests[0].period);
+    EXPECT_EQ("BESTXYZ", requests[1].name);
+    EXPECT_DOUBLE_EQ(1.0, requests[1].period);
+    EXPECT_DOUBLE_EQ(0.5, requests[1].offset);
+    EXPECT_EQ(2, requests[1].priority);
+}
+
+// A name alone is ONTIME at the node rate, no offset, priority 0
+TEST(LogRequests, Defaults)
+{
+    XmlRpc::XmlRpcValue logs;
+    logs[0]["name"] = std::string("TRACKSTAT");
+    logs[1]["name"] = std::string("RANGECMP");
+    logs[1]["trigger"] = std::string("ONCHANGED");
+
+    std::vector<LogRequest> requests;
+    ASSERT_TRUE(ParseLogRequests(logs, &requests));
+    ASSERT_EQ(2u, requests.size());
+    EXPECT_EQ("ONTIME", requests[0].trigger);
+    EXPECT_DOUBLE_EQ(0.0, requests[0].period);
+    EXPECT_DOUBLE_EQ(0.0, requests[0].offset);
+    EXPECT_EQ(0, requests[0].priority);
+    EXPECT_EQ("ONCHANGED", requests[1].trigger);
+}
+
+// Not a list: false, the caller keeps its defaults
+TEST(LogRequests, NotAList)
+{
+    XmlRpc::XmlRpcValue logs;
+    logs["name"] = std::string("BESTXYZ");
+
+    std::vector<LogRequest> requests(1);
+    requests[0].name = "BESTPOS";
+    EXPECT_FALSE(ParseLogRequests(logs, &requests));
+    ASSERT_EQ(1u, requests.size());
+    EXPECT_EQ("BESTPOS", requests[0].name);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
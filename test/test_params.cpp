@@ -0,0 +1,18 @@
+#include <gtest/gtest.h>
+
+#include "novatel_gps.h"
+
+// YAML `rate: 20` arrives as an int, `period: 0.05` as a double
+TEST(Params, ToDoubleTakesIntsAndDoubles)
+{
+    XmlRpc::XmlRpcValue whole(20);
+    XmlRpc::XmlRpcValue fraction(0.05);
+    EXPECT_DOUBLE_EQ(20.0, ToDouble(whole));
+    EXPECT_DOUBLE_EQ(0.05, ToDouble(fraction));
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "geodesy.h"
+#include "point_solver.h"
+
+#define ORBIT_RADIUS    26560e3
+#define ORBIT_PERIOD    43082.0
+#define EARTH_ROTATION  7.2921151467e-5
+#define RECEIVER_CLOCK  1234.5
+
+// Phase-locked L1 channel of a system: GPS L1 C/A, Galileo E1C
+static uint32_t L1Status(int system)
+{
+    uint32_t signal = (system == SYSTEM_GALILEO) ? 2 : 0;
+    return 0x00000400 | (static_cast<uint32_t>(system) << 16) | (signal << 21);
+}
+
+static void Receiver(double ecef[3])
+{
+    LlaToEcef(-15.765824*DEG2RAD, -47.872109*DEG2RAD, 1050.0, ecef);
+}
+
+static double Distance(const double a[3], const double b[3])
+{
+    return std::sqrt((a[0] - b[0])*(a[0] - b[0]) + (a[1] - b[1])*(a[1] - b[1]) + (a[2] - b[2])*(a[2] - b[2]));
+}
+
+// Sine of the elevation above the geocentric horizon, as the solver's mask
+static double SinElevation(const double satellite[3], const double receiver[3])
+{
+    double centre[3] = { 0.0, 0.0, 0.0 };
+    double d[3] = { satellite[0] - receiver[0], satellite[1] - receiver[1], satellite[2] - receiver[2] };
+    return (d[0]*receiver[0] + d[1]*receiver[1] + d[2]*receiver[2])/
+           (Distance(satellite, receiver)*Distance(receiver, centre));
+}
+
+/* --------------------------------------------------------------------------
+One epoch of SATXYZ and RANGE for the GPS satellites above the horizon,
+pseudoranges from the exact Sagnac rotation plus the receiver clock, the
+SATXYZ corrections and noise (m, 1 sigma). The satellite bad gets an ion_corr
+200 m off. With galileo, Galileo ranges with the same PRNs and no position.
+-------------------------------------------------------------------------- */
+static void Epoch(double t, const double receiver[3], double noise, int bad, bool galileo,
+                  std::mt19937* rng, SatelliteTable* table)
+{
+    std::normal_distribution<double> normal(0.0, 1.0);
+    table->beginSatXYZ();
+    table->beginRange();
+
+    for(int i = 0; i < 32; ++i)
+    {
+        double inclination = 55.0*DEG2RAD;
+        double node = (i % 6)*60.0*DEG2RAD;
+        double u = (i/6)*0.8 + i*0.37 + t*2.0*M_PI/ORBIT_PERIOD;
+        double x = ORBIT_RADIUS*std::cos(u);
+        double y = ORBIT_RADIUS*std::sin(u);
+        double position[3] = { x*std::cos(node) - y*std::cos(inclination)*std::sin(node),
+                               x*std::sin(node) + y*std::cos(inclination)*std::cos(node),
+                               y*std::sin(inclination) };
+
+        if(SinElevation(position, receiver) < 0.0)
+            continue;
+
+        double rho = Distance(position, receiver);
+        for(int k = 0; k < 5; ++k)
+        {
+            double theta = EARTH_ROTATION*rho/SPEED_OF_LIGHT;
+            double rotated[3] = { std::cos(theta)*position[0] + std::sin(theta)*position[1],
+                                  -std::sin(theta)*position[0] + std::cos(theta)*position[1],
+                                  position[2] };
+            rho = Distance(rotated, receiver);
+        }
+
+        novatel_gps::SatXYZInformation satellite;
+        satellite.prn_slot = i + 1;
+        satellite.position.x = position[0];
+        satellite.position.y = position[1];
+        satellite.position.z = position[2];
+        satellite.clk_corr = -30.0 + i;
+        satellite.ion_corr = 3.0 + 0.1*i;
+        satellite.trop_corr = 2.5;
+
+        novatel_gps::RangeInformation range;
+        range.prn_slot = i + 1;
+        range.ch_tr_status = L1Status(SYSTEM_GPS);
+        range.psr_std = 1.0;
+        range.psr = rho + RECEIVER_CLOCK - satellite.clk_corr + satellite.ion_corr + satellite.trop_corr +
+                    noise*normal(*rng);
+        if(i + 1 == bad)
+            satellite.ion_corr += 200.0;
+        table->update(satellite);
+        table->update(range);
+
+        if(galileo)
+        {
+            range.ch_tr_status = L1Status(SYSTEM_GALILEO);
+            range.psr += 1e5;
+            table->update(range);
+        }
+    }
+}
+
+TEST(PointSolver, NoiseFree)
+{
+    double receiver[3];
+    Receiver(receiver);
+    std::mt19937 rng(1);
+    SatelliteTable table;
+    Epoch(1000.0, receiver, 0.0, 0, false, &rng, &table);
+
+    PointSolver solver;
+    PointFix fix;
+    ASSERT_TRUE(solver.solve(table, &fix));
+    EXPECT_TRUE(fix.valid);
+    EXPECT_GE(fix.satellites, 4);
+    EXPECT_LT(Distance(fix.position, receiver), 0.01);
+    EXPECT_NEAR(RECEIVER_CLOCK, fix.clock, 0.01);
+    EXPECT_LT(fix.residual_rms, 0.01);
+
+    // From the previous fix, as every epoch after the first
+    Epoch(1001.0, receiver, 0.0, 0, false, &rng, &table);
+    ASSERT_TRUE(solver.solve(table, &fix));
+    EXPECT_LT(Distance(fix.position, receiver), 0.01);
+    EXPECT_LE(fix.iterations, 3);
+}
+
+// Galileo ranges with the same PRNs as the GPS satellites have no SATXYZ
+// position and must not be paired with the GPS ones
+TEST(PointSolver, GalileoSamePrnIgnored)
+{
+    double receiver[3];
+    Receiver(receiver);
+    std::mt19937 rng(1);
+    SatelliteTable gps, mixed;
+    Epoch(1000.0, receiver, 0.0, 0, false, &rng, &gps);
+    Epoch(1000.0, receiver, 0.0, 0, true, &rng, &mixed);
+
+    PointSolver a, b;
+    PointFix expected, fix;
+    ASSERT_TRUE(a.solve(gps, &expected));
+    ASSERT_TRUE(b.solve(mixed, &fix));
+    EXPECT_EQ(expected.satellites, fix.satellites);
+    EXPECT_LT(Distance(fix.position, receiver), 0.01);
+}
+
+TEST(PointSolver, TrackStatRejectLeftOut)
+{
+    double receiver[3];
+    Receiver(receiver);
+    std::mt19937 rng(1);
+    SatelliteTable table;
+    Epoch(1000.0, receiver, 0.0, 0, false, &rng, &table);
+
+    // A satellite well above the mask
+    int bad = 0;
+    for(int prn = 1; prn <= 32 && bad == 0; ++prn)
+    {
+        const SatelliteState* s = table.find(SYSTEM_GPS, prn);
+        if(s->signal[SIGNAL_L1].generation != 0 && SinElevation(s->position, receiver) > std::sin(30.0*DEG2RAD))
+            bad = prn;
+    }
+    ASSERT_NE(0, bad);
+
+    Epoch(1000.0, receiver, 0.0, bad, false, &rng, &table);
+    PointSolver solver;
+    PointFix fix;
+    ASSERT_TRUE(solver.solve(table, &fix));
+    EXPECT_GT(Distance(fix.position, receiver), 1.0);
+
+    table.beginTrackStat();
+    novatel_gps::TrackStatChannel channel;
+    channel.prn_slot = bad;
+    channel.ch_tr_status = L1Status(SYSTEM_GPS);
+    channel.reject = 7;
+    table.update(channel);
+    int used = fix.satellites;
+    ASSERT_TRUE(solver.solve(table, &fix));
+    EXPECT_EQ(used - 1, fix.satellites);
+    EXPECT_LT(Distance(fix.position, receiver), 0.01);
+}
+
+// 1 m noise over many epochs: the error matches the covariance
+TEST(PointSolver, ErrorWithinCovariance)
+{
+    double receiver[3];
+    Receiver(receiver);
+    std::mt19937 rng(7);
+    SatelliteTable table;
+    PointSolver solver;
+    PointFix fix;
+
+    double error2 = 0.0, variance = 0.0;
+    const int epochs = 500;
+    for(int i = 0; i < epochs; ++i)
+    {
+        Epoch(2000.0 + i, receiver, 1.0, 0, false, &rng, &table);
+        ASSERT_TRUE(solver.solve(table, &fix));
+        double e = Distance(fix.position, receiver);
+        error2 += e*e;
+        variance += fix.covariance[0] + fix.covariance[4] + fix.covariance[8];
+    }
+    double rms = std::sqrt(error2/epochs);
+    double sigma = std::sqrt(variance/epochs);
+    EXPECT_GT(rms, 0.8*sigma);
+    EXPECT_LT(rms, 1.2*sigma);
+}
+
+TEST(PointSolver, TooFewSatellites)
+{
+    SatelliteTable table;
+    table.beginSatXYZ();
+    table.beginRange();
+    for(int prn = 1; prn <= 3; ++prn)
+    {
+        novatel_gps::SatXYZInformation satellite;
+        satellite.prn_slot = prn;
+        satellite.position.x = 2e7*prn;
+        satellite.position.y = 1e7;
+        satellite.position.z = 1e7;
+        table.update(satellite);
+
+        novatel_gps::RangeInformation range;
+        range.prn_slot = prn;
+        range.ch_tr_status = L1Status(SYSTEM_GPS);
+        range.psr = 2e7;
+        range.psr_std = 1.0;
+        table.update(range);
+    }
+
+    PointSolver solver;
+    PointFix fix;
+    EXPECT_FALSE(solver.solve(table, &fix));
+    EXPECT_FALSE(fix.valid);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
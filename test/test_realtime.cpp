@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "realtime.h"
+
+// First CPU the process may run on: CPU 0 can be outside a container's or
+// taskset's mask
+static int AllowedCpu()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if(CPU_ISSET(cpu, &allowed))
+                return cpu;
+    return 0;
+}
+
+// Ids past the online CPUs or CPU_SETSIZE are skipped, the valid ones applied
+TEST(ThreadTuning, InvalidCpusIgnored)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int cpu = AllowedCpu();
+    bool ok = true;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    std::thread thread([&]
+    {
+        ThreadTuning tuning;
+        tuning.cpus.push_back(-1);
+        tuning.cpus.push_back(online);
+        tuning.cpus.push_back(CPU_SETSIZE + 100);
+        tuning.cpus.push_back(cpu);
+        ok = ApplyThreadTuning(tuning, "test");
+        pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+    });
+    thread.join();
+
+    EXPECT_FALSE(ok);
+    EXPECT_EQ(1, CPU_COUNT(&set));
+    EXPECT_TRUE(CPU_ISSET(cpu, &set));
+}
+
+TEST(ThreadTuning, NoValidCpuLeavesAffinity)
+{
+    cpu_set_t before, after;
+    bool ok = true;
+
+    std::thread thread([&]
+    {
+        pthread_getaffinity_np(pthread_self(), sizeof(before), &before);
+        ThreadTuning tuning;
+        tuning.cpus.push_back(CPU_SETSIZE);
+        ok = ApplyThreadTuning(tuning, "test");
+        pthread_getaffinity_np(pthread_self(), sizeof(after), &after);
+    });
+    thread.join();
+
+    EXPECT_FALSE(ok);
+    EXPECT_TRUE(CPU_EQUAL(&before, &after));
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
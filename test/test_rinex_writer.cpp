@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rinex_writer.h"
+
+#define PHASE_LOCK_FLAG     0x00000400
+#define PARITY_KNOWN_FLAG   0x00000800
+// 2022-03-06 00:00:00 GPS
+#define TEST_WEEK           2200
+
+static std::string TempDirectory()
+{
+    char path[] = "/tmp/rinex_writer_XXXXXX";
+    return mkdtemp(path) ? path : "";
+}
+
+static std::vector<std::string> Files(const std::string& directory)
+{
+    std::vector<std::string> names;
+    DIR* dir = opendir(directory.c_str());
+    if(!dir)
+        return names;
+    while(struct dirent* entry = readdir(dir))
+        if(entry->d_name[0] != '.')
+            names.push_back(entry->d_name);
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static void RemoveDirectory(const std::string& directory)
+{
+    std::vector<std::string> names = Files(directory);
+    for(size_t i = 0; i < names.size(); ++i)
+        unlink((directory + "/" + names[i]).c_str());
+    rmdir(directory.c_str());
+}
+
+static std::vector<std::string> Lines(const std::string& path)
+{
+    std::vector<std::string> lines;
+    FILE* file = fopen(path.c_str(), "r");
+    if(!file)
+        return lines;
+    char line[1024];
+    while(fgets(line, sizeof(line), file))
+        lines.push_back(line);
+    fclose(file);
+    return lines;
+}
+
+// GPS PRN 5 on L1 C/A and L2 P, Galileo PRN 5 on E1C
+static std::vector<novatel_gps::RangeInformation> Observations(double t)
+{
+    static const uint32_t STATUS[] = { 0, 9u << 21, (3u << 16) | (2u << 21) };
+    std::vector<novatel_gps::RangeInformation> ranges(3);
+    for(size_t i = 0; i < ranges.size(); ++i)
+    {
+        ranges[i].prn_slot = 5;
+        ranges[i].ch_tr_status = PHASE_LOCK_FLAG | PARITY_KNOWN_FLAG | STATUS[i];
+        ranges[i].psr = 22000000.0 + 1000.0*i + t;
+        ranges[i].adr = -115000000.0 - t;
+        ranges[i].doppler = -1234.5;
+        ranges[i].c_no = 45.0;
+        ranges[i].slip = 0;
+    }
+    return ranges;
+}
+
+// 20 s across the top of the hour: one file per GPS hour, named by it
+TEST(RinexWriter, HourlyFiles)
+{
+    std::string directory = TempDirectory();
+    ASSERT_FALSE(directory.empty());
+    double approx[3] = { 4115000.0, -4550000.0, -1722000.0 };
+    {
+        RinexWriter writer(directory, "test");
+        for(int t = 3590; t < 3610; ++t)
+        {
+            std::vector<novatel_gps::RangeInformation> ranges = Observations(t);
+            writer.push(TEST_WEEK, t, ranges.data(), ranges.size(), approx);
+        }
+        RinexStats stats = writer.stats();
+        for(int i = 0; i < 500 && stats.epochs < 20; ++i)
+        {
+            usleep(10000);
+            stats = writer.stats();
+        }
+        EXPECT_EQ(20u, stats.epochs);
+        EXPECT_EQ(0u, stats.dropped);
+        EXPECT_EQ(2u, stats.files);
+    }
+
+    std::vector<std::string> files = Files(directory);
+    ASSERT_EQ(2u, files.size());
+    EXPECT_EQ("TEST00XXX_R_20220650000_01H_00U_MO.rnx", files[0]);
+    EXPECT_EQ("TEST00XXX_R_20220650100_01H_00U_MO.rnx", files[1]);
+
+    std::vector<std::string> lines = Lines(directory + "/" + files[0]);
+    ASSERT_FALSE(lines.empty());
+    EXPECT_NE(std::string::npos, lines[0].find("RINEX VERSION / TYPE"));
+    int epochs = 0, gps = 0, galileo = 0;
+    bool header = true;
+    for(size_t i = 0; i < lines.size(); ++i)
+    {
+        if(header)
+        {
+            header = lines[i].find("END OF HEADER") == std::string::npos;
+            continue;
+        }
+        epochs += lines[i].compare(0, 2, "> ") == 0;
+        gps += lines[i].compare(0, 3, "G05") == 0;
+        galileo += lines[i].compare(0, 3, "E05") == 0;
+    }
+    EXPECT_FALSE(header);
+    EXPECT_EQ(10, epochs);
+    EXPECT_EQ(10, gps);
+    EXPECT_EQ(10, galileo);
+    EXPECT_EQ("> 2022 03 06 00 59 50.0000000  0  2\n", lines[lines.size() - 30]);
+
+    RemoveDirectory(directory);
+}
+
+// A restart within the hour gets a numbered file
+TEST(RinexWriter, NeverOverwrites)
+{
+    std::string directory = TempDirectory();
+    ASSERT_FALSE(directory.empty());
+    double approx[3] = { 0.0, 0.0, 0.0 };
+    for(int run = 0; run < 2; ++run)
+    {
+        RinexWriter writer(directory, "test");
+        std::vector<novatel_gps::RangeInformation> ranges = Observations(0);
+        writer.push(TEST_WEEK, 60 + run, ranges.data(), ranges.size(), approx);
+    }
+
+    std::vector<std::string> files = Files(directory);
+    ASSERT_EQ(2u, files.size());
+    EXPECT_EQ("TEST00XXX_R_20220650000_01H_00U_MO.rnx", files[0]);
+    EXPECT_EQ("TEST00XXX_R_20220650000_01H_00U_MO_1.rnx", files[1]);
+
+    RemoveDirectory(directory);
+}
+
+// Epochs of the same hour after a failed create open the file once the
+// directory is back; the ones before it are counted as dropped
+TEST(RinexWriter, RetriesAfterFailedCreate)
+{
+    std::string directory = TempDirectory();
+    ASSERT_FALSE(directory.empty());
+    double approx[3] = { 0.0, 0.0, 0.0 };
+    RinexStats stats;
+    {
+        RinexWriter writer(directory, "test");
+        rmdir(directory.c_str());
+        for(int t = 0; t < 5; ++t)
+        {
+            std::vector<novatel_gps::RangeInformation> ranges = Observations(t);
+            writer.push(TEST_WEEK, 60 + t, ranges.data(), ranges.size(), approx);
+        }
+        for(int wait = 0; wait < 500 && writer.stats().dropped < 5; ++wait)
+            usleep(10000);
+
+        ASSERT_EQ(0, mkdir(directory.c_str(), 0755));
+        for(int t = 5; t < 10; ++t)
+        {
+            std::vector<novatel_gps::RangeInformation> ranges = Observations(t);
+            writer.push(TEST_WEEK, 60 + t, ranges.data(), ranges.size(), approx);
+        }
+        for(int wait = 0; wait < 500 && writer.stats().epochs < 5; ++wait)
+            usleep(10000);
+        stats = writer.stats();
+    }
+
+    EXPECT_EQ(5u, stats.epochs);
+    EXPECT_EQ(5u, stats.dropped);
+    EXPECT_EQ(1u, stats.files);
+    EXPECT_GE(stats.write_errors, 5u);
+    std::vector<std::string> files = Files(directory);
+    ASSERT_EQ(1u, files.size());
+    std::vector<std::string> lines = Lines(directory + "/" + files[0]);
+    int epochs = 0;
+    for(size_t i = 0; i < lines.size(); ++i)
+        epochs += lines[i][0] == '>';
+    EXPECT_EQ(5, epochs);
+
+    RemoveDirectory(directory);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "geodesy.h"
+#include "satellite_geometry.h"
+
+#define ORBIT_RADIUS    26560e3
+#define ORBIT_PERIOD    43082.0
+
+// Receiver at 45N 10E, 100 m
+static void Receiver(double ecef[3], double R[9])
+{
+    LlaToEcef(45.0*DEG2RAD, 10.0*DEG2RAD, 100.0, ecef);
+    EnuRotation(45.0*DEG2RAD, 10.0*DEG2RAD, R);
+}
+
+// SATXYZ of count satellites on circular orbits in six 55 deg planes, t
+// seconds into the pass
+static void Constellation(int count, double t, SatelliteTable* table)
+{
+    table->beginSatXYZ();
+    for(int i = 0; i < count; ++i)
+    {
+        double inclination = 55.0*DEG2RAD;
+        double node = (i % 6)*60.0*DEG2RAD;
+        double u = (i/6)*45.0*DEG2RAD + i*0.3 + t*2.0*M_PI/ORBIT_PERIOD;
+        double x = ORBIT_RADIUS*std::cos(u);
+        double y = ORBIT_RADIUS*std::sin(u);
+
+        novatel_gps::SatXYZInformation satellite;
+        satellite.prn_slot = i + 1;
+        satellite.position.x = x*std::cos(node) - y*std::cos(inclination)*std::sin(node);
+        satellite.position.y = x*std::sin(node) + y*std::cos(inclination)*std::cos(node);
+        satellite.position.z = y*std::sin(inclination);
+        table->update(satellite);
+    }
+}
+
+// Satellite range from the receiver along an ENU direction
+static void AddDirection(const double receiver[3], const double R[9], int prn, double azimuth,
+                         double elevation, SatelliteTable* table)
+{
+    double e = std::cos(elevation*DEG2RAD)*std::sin(azimuth*DEG2RAD);
+    double n = std::cos(elevation*DEG2RAD)*std::cos(azimuth*DEG2RAD);
+    double u = std::sin(elevation*DEG2RAD);
+    double range = 2e7;
+
+    novatel_gps::SatXYZInformation satellite;
+    satellite.prn_slot = prn;
+    satellite.position.x = receiver[0] + range*(R[0]*e + R[3]*n + R[6]*u);
+    satellite.position.y = receiver[1] + range*(R[1]*e + R[4]*n + R[7]*u);
+    satellite.position.z = receiver[2] + range*(R[2]*e + R[5]*n + R[8]*u);
+    table->update(satellite);
+}
+
+TEST(GeometryEngine, AzimuthElevationMatchEnu)
+{
+    double receiver[3], R[9];
+    Receiver(receiver, R);
+    SatelliteTable table;
+    Constellation(32, 0.0, &table);
+
+    GeometryEngine engine;
+    engine.configure(5.0, 0.0);
+    int used = engine.update(table, receiver);
+    novatel_gps::SatelliteGeometry geometry;
+    engine.fill(&geometry);
+    ASSERT_EQ(32u, geometry.prn_slot.size());
+    EXPECT_GE(used, 4);
+
+    for(size_t k = 0; k < geometry.prn_slot.size(); ++k)
+    {
+        const SatelliteState* s = table.find(SYSTEM_GPS, geometry.prn_slot[k]);
+        ASSERT_TRUE(s != NULL);
+        double enu[3];
+        EcefToEnu(s->position, receiver, R, enu);
+        double elevation = std::atan2(enu[2], std::hypot(enu[0], enu[1]))*RAD2DEG;
+        double azimuth = std::atan2(enu[0], enu[1])*RAD2DEG;
+        if(azimuth < 0.0)
+            azimuth += 360.0;
+        EXPECT_NEAR(elevation, geometry.elevation[k], 1e-4) << "prn " << geometry.prn_slot[k];
+        EXPECT_NEAR(azimuth, geometry.azimuth[k], 1e-4) << "prn " << geometry.prn_slot[k];
+        EXPECT_EQ(elevation >= 5.0, geometry.used[k] != 0);
+    }
+}
+
+// Zenith and three on the horizon 120 deg apart: H^T H is diag(1.5, 1.5) in
+// the horizontal and [[1 -1] [-1 4]] in up and clock, so HDOP = VDOP =
+// sqrt(4/3), TDOP = sqrt(1/3) and GDOP = sqrt(3)
+TEST(GeometryEngine, DopClosedForm)
+{
+    double receiver[3], R[9];
+    Receiver(receiver, R);
+    SatelliteTable table;
+    table.beginSatXYZ();
+    AddDirection(receiver, R, 1, 0.0, 90.0, &table);
+    AddDirection(receiver, R, 2, 0.0, 0.0, &table);
+    AddDirection(receiver, R, 3, 120.0, 0.0, &table);
+    AddDirection(receiver, R, 4, 240.0, 0.0, &table);
+
+    GeometryEngine engine;
+    engine.configure(-1.0, 0.0);
+    ASSERT_EQ(4, engine.update(table, receiver));
+    const Dop& dop = engine.dop();
+    EXPECT_NEAR(std::sqrt(4.0/3.0), dop.hdop, 1e-6);
+    EXPECT_NEAR(std::sqrt(4.0/3.0), dop.vdop, 1e-6);
+    EXPECT_NEAR(std::sqrt(1.0/3.0), dop.tdop, 1e-6);
+    EXPECT_NEAR(std::sqrt(8.0/3.0), dop.pdop, 1e-6);
+    EXPECT_NEAR(std::sqrt(3.0), dop.gdop, 1e-6);
+}
+
+TEST(GeometryEngine, TooFewSatellites)
+{
+    double receiver[3], R[9];
+    Receiver(receiver, R);
+    SatelliteTable table;
+    table.beginSatXYZ();
+    AddDirection(receiver, R, 1, 0.0, 90.0, &table);
+    AddDirection(receiver, R, 2, 0.0, 30.0, &table);
+    AddDirection(receiver, R, 3, 120.0, 30.0, &table);
+
+    GeometryEngine engine;
+    EXPECT_EQ(3, engine.update(table, receiver));
+    EXPECT_TRUE(std::isnan(engine.dop().pdop));
+}
+
+// Ten minutes of 1 Hz SATXYZ: the incremental engine recomputes a fraction of
+// the directions and stays within the tolerance of recomputing them all
+TEST(GeometryEngine, IncrementalMatchesFull)
+{
+    double receiver[3], R[9];
+    Receiver(receiver, R);
+    SatelliteTable table;
+    GeometryEngine incremental, full;
+    incremental.configure(5.0, 0.05);
+    full.configure(5.0, 0.0);
+
+    long recomputed = 0, directions = 0;
+    for(int t = 1; t <= 600; ++t)
+    {
+        Constellation(32, t, &table);
+        int used = incremental.update(table, receiver);
+        recomputed += incremental.recomputed();
+        directions += 32;
+        if(used != full.update(table, receiver))
+            continue;   // A satellite crossing the mask, an epoch late
+        EXPECT_NEAR(full.dop().pdop, incremental.dop().pdop, 1e-3*full.dop().pdop) << "t " << t;
+    }
+    EXPECT_LT(recomputed, directions/4);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
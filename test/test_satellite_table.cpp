@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "satellite_table.h"
+
+// Phase-locked L1 channel of a system: GPS L1 C/A, Galileo E1C
+static uint32_t L1Status(int system)
+{
+    uint32_t signal = (system == SYSTEM_GALILEO) ? 2 : 0;
+    return 0x00000400 | (static_cast<uint32_t>(system) << 16) | (signal << 21);
+}
+
+static novatel_gps::RangeInformation Range(int system, int prn, double psr)
+{
+    novatel_gps::RangeInformation range;
+    range.prn_slot = prn;
+    range.ch_tr_status = L1Status(system);
+    range.psr = psr;
+    return range;
+}
+
+TEST(SatelliteTable, IndexRoundTrip)
+{
+    bool used[MAX_SATELLITES] = { false };
+    for(int system = SYSTEM_GPS; system <= SYSTEM_OTHER; ++system)
+    {
+        for(int prn = -1; prn < MAX_PRN_SLOT; ++prn)
+        {
+            int index = SatelliteIndex(system, prn);
+            if(index < 0)
+                continue;
+            ASSERT_LT(index, MAX_SATELLITES);
+            EXPECT_FALSE(used[index]) << "system " << system << " prn " << prn;
+            used[index] = true;
+
+            int s, p;
+            SatelliteOf(index, &s, &p);
+            EXPECT_EQ(system, s);
+            EXPECT_EQ(prn, p);
+        }
+    }
+    for(int i = 0; i < MAX_SATELLITES; ++i)
+        EXPECT_TRUE(used[i]) << "entry " << i;
+
+    EXPECT_EQ(-1, SatelliteIndex(SYSTEM_GPS, 0));
+    EXPECT_EQ(-1, SatelliteIndex(SYSTEM_GLONASS, 5));
+    EXPECT_EQ(-1, SatelliteIndex(SYSTEM_OTHER, 5));
+}
+
+TEST(SatelliteTable, SamePrnDifferentSystems)
+{
+    SatelliteTable table;
+    table.beginRange();
+    table.update(Range(SYSTEM_GPS, 5, 21000000.0));
+    table.update(Range(SYSTEM_GALILEO, 5, 25000000.0));
+
+    table.beginTrackStat();
+    novatel_gps::TrackStatChannel channel;
+    channel.prn_slot = 5;
+    channel.ch_tr_status = L1Status(SYSTEM_GALILEO);
+    channel.cn0 = 45.0f;
+    channel.reject = novatel_gps::TrackStatChannel::GOOD;
+    table.update(channel);
+
+    table.beginSatXYZ();
+    novatel_gps::SatXYZInformation satellite;
+    satellite.prn_slot = 5;
+    satellite.position.x = 1.0e7;
+    table.update(satellite);
+
+    const SatelliteState* gps = table.find(SYSTEM_GPS, 5);
+    const SatelliteState* galileo = table.find(SYSTEM_GALILEO, 5);
+    ASSERT_TRUE(gps != NULL);
+    ASSERT_TRUE(galileo != NULL);
+    ASSERT_NE(gps, galileo);
+
+    EXPECT_EQ(21000000.0, gps->signal[SIGNAL_L1].psr);
+    EXPECT_EQ(25000000.0, galileo->signal[SIGNAL_L1].psr);
+
+    // TRACKSTAT goes by the system of its channel, SATXYZ only has GPS
+    EXPECT_EQ(0u, gps->trackstat_generation);
+    EXPECT_EQ(1u, galileo->trackstat_generation);
+    EXPECT_EQ(45.0f, galileo->cn0);
+    EXPECT_EQ(1u, gps->satxyz_generation);
+    EXPECT_EQ(1.0e7, gps->position[0]);
+    EXPECT_EQ(0u, galileo->satxyz_generation);
+
+    novatel_gps::SatelliteStateArray array;
+    table.fill(&array);
+    ASSERT_EQ(2u, array.satellites.size());
+    for(size_t i = 0; i < array.satellites.size(); ++i)
+    {
+        const novatel_gps::SatelliteState& s = array.satellites[i];
+        EXPECT_EQ(5, s.prn_slot);
+        ASSERT_EQ(1u, s.ranges.size());
+        EXPECT_EQ(s.system, SatelliteSystem(s.ranges[0].ch_tr_status));
+        EXPECT_EQ(s.system == SYSTEM_GPS ? 21000000.0 : 25000000.0, s.ranges[0].psr);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "slip_detector.h"
+
+#define PHASE_LOCK_FLAG     0x00000400
+#define HALF_CYCLE_FLAG     0x10000000
+#define GPS_L2P             9
+#define GALILEO_E1C         2
+
+typedef novatel_gps::RangeInformation RangeInformation;
+
+// Phase-locked observation of a satellite range rho (m) changing at rate
+// (m/s), ADR and Doppler in cycles of the signal's carrier
+static RangeInformation Observation(int system, int prn, uint32_t signal, double rho, double rate, float locktime)
+{
+    RangeInformation range;
+    range.prn_slot = prn;
+    range.ch_tr_status = PHASE_LOCK_FLAG | (static_cast<uint32_t>(system) << 16) | (signal << 21);
+    double wavelength = CarrierWavelength(range.ch_tr_status);
+    range.psr = rho;
+    range.adr = rho/wavelength;
+    range.doppler = rate/wavelength;
+    range.locktime = locktime;
+    return range;
+}
+
+// One RANGE log through the detector, the flags of each observation
+static std::vector<uint8_t> Epoch(SlipDetector* detector, double gps_time, const std::vector<RangeInformation>& ranges)
+{
+    detector->beginEpoch(gps_time);
+    for(size_t i = 0; i < ranges.size(); ++i)
+        detector->update(ranges[i]);
+    detector->endEpoch();
+
+    std::vector<uint8_t> flags;
+    for(size_t i = 0; i < ranges.size(); ++i)
+        flags.push_back(detector->flags(ranges[i]));
+    return flags;
+}
+
+// GPS PRN 5 on L1 and L2 over a minute, range rate 500 m/s
+static std::vector<RangeInformation> GpsEpoch(double t)
+{
+    std::vector<RangeInformation> ranges;
+    double rho = 2.2e7 + 500.0*t;
+    ranges.push_back(Observation(SYSTEM_GPS, 5, 0, rho, 500.0, 100.0 + t));
+    ranges.push_back(Observation(SYSTEM_GPS, 5, GPS_L2P, rho, 500.0, 100.0 + t));
+    return ranges;
+}
+
+TEST(SlipDetector, CleanArc)
+{
+    SlipDetector detector;
+    for(int t = 0; t < 60; ++t)
+    {
+        std::vector<uint8_t> flags = Epoch(&detector, t, GpsEpoch(t));
+        uint8_t expected = (t == 0) ? RangeInformation::SLIP_NEW_ARC : 0;
+        EXPECT_EQ(expected, flags[0]) << "t " << t;
+        EXPECT_EQ(expected, flags[1]) << "t " << t;
+    }
+}
+
+TEST(SlipDetector, DopplerJump)
+{
+    SlipDetector detector;
+    for(int t = 0; t < 10; ++t)
+    {
+        std::vector<RangeInformation> ranges = GpsEpoch(t);
+        if(t >= 5)
+            ranges[0].adr += 10.0;
+        std::vector<uint8_t> flags = Epoch(&detector, t, ranges);
+        if(t == 5)
+        {
+            EXPECT_TRUE(flags[0] & RangeInformation::SLIP_DOPPLER);
+        }
+        else if(t > 0)
+        {
+            EXPECT_EQ(0, flags[0]) << "t " << t;
+        }
+    }
+}
+
+// One L1 cycle, below the Doppler threshold, moves L1 - L2 by 19 cm
+TEST(SlipDetector, GeometryFreeJump)
+{
+    SlipDetector detector;
+    for(int t = 0; t < 10; ++t)
+    {
+        std::vector<RangeInformation> ranges = GpsEpoch(t);
+        if(t >= 5)
+            ranges[0].adr += 1.0;
+        std::vector<uint8_t> flags = Epoch(&detector, t, ranges);
+        if(t == 5)
+        {
+            EXPECT_EQ(RangeInformation::SLIP_GEOMETRY_FREE, flags[0]);
+            EXPECT_EQ(RangeInformation::SLIP_GEOMETRY_FREE, flags[1]);
+        }
+        else if(t > 0)
+        {
+            EXPECT_EQ(0, flags[0]) << "t " << t;
+        }
+    }
+}
+
+TEST(SlipDetector, LocktimeAndHalfCycle)
+{
+    SlipDetector detector;
+    for(int t = 0; t < 10; ++t)
+    {
+        std::vector<RangeInformation> ranges = GpsEpoch(t);
+        if(t >= 4)
+            ranges[0].locktime = t - 4;
+        if(t >= 7)
+            ranges[1].ch_tr_status |= HALF_CYCLE_FLAG;
+        std::vector<uint8_t> flags = Epoch(&detector, t, ranges);
+        if(t == 4)
+        {
+            EXPECT_TRUE(flags[0] & RangeInformation::SLIP_LOCK_LOST);
+        }
+        if(t == 7)
+        {
+            EXPECT_TRUE(flags[1] & RangeInformation::SLIP_HALF_CYCLE);
+        }
+    }
+}
+
+// GPS and Galileo PRN 5 in the same log are different satellites with
+// their own phase, not the same one logged twice
+TEST(SlipDetector, GpsAndGalileoSamePrn)
+{
+    SlipDetector detector;
+    for(int t = 0; t < 30; ++t)
+    {
+        std::vector<RangeInformation> ranges = GpsEpoch(t);
+        double rho = 2.5e7 - 300.0*t;
+        ranges.push_back(Observation(SYSTEM_GALILEO, 5, GALILEO_E1C, rho, -300.0, 50.0 + t));
+        if(t >= 20)
+            ranges[2].adr += 10.0;
+
+        std::vector<uint8_t> flags = Epoch(&detector, t, ranges);
+        if(t == 0)
+        {
+            EXPECT_EQ(RangeInformation::SLIP_NEW_ARC, flags[2]);
+            continue;
+        }
+        EXPECT_EQ(0, flags[0]) << "t " << t;
+        EXPECT_EQ(0, flags[1]) << "t " << t;
+        if(t == 20)
+        {
+            EXPECT_EQ(RangeInformation::SLIP_DOPPLER, flags[2]);
+        }
+        else
+        {
+            EXPECT_EQ(0, flags[2]) << "t " << t;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "solution_batch.h"
+
+typedef novatel_gps::GpsXYZ GpsXYZ;
+
+// Fix i of a 100 Hz stream, the sigmas changing every sigma_every fixes
+static GpsXYZ Fix(int i, int sigma_every)
+{
+    GpsXYZ fix;
+    fix.header.frame_id = "gps_frame";
+    fix.header.stamp.fromSec(1.7e9 + i*0.01);
+    fix.position.position.x = 4e6 + i*0.013;
+    fix.position.position.y = -4.4e6 + std::sin(i*0.01);
+    fix.position.position.z = -1.7e6 + i*1e-3;
+    fix.velocity.velocity.x = 1.3;
+    fix.velocity.velocity.y = std::cos(i*0.01);
+    fix.velocity.velocity.z = -0.01*i;
+    int k = i/sigma_every;
+    for(int j = 0; j < 3; ++j)
+    {
+        // Single precision, as the receiver sends them
+        fix.position.covariance[4*j] = static_cast<float>(0.01 + 0.001*((k + j) % 7));
+        fix.velocity.covariance[4*j] = static_cast<float>(0.002 + 0.0001*((k + j) % 5));
+    }
+    return fix;
+}
+
+static void ExpectSameFix(const GpsXYZ& expected, const GpsXYZ& fix)
+{
+    EXPECT_EQ(expected.header.frame_id, fix.header.frame_id);
+    EXPECT_EQ(expected.header.stamp.sec, fix.header.stamp.sec);
+    EXPECT_EQ(expected.header.stamp.nsec, fix.header.stamp.nsec);
+    EXPECT_EQ(expected.position.position.x, fix.position.position.x);
+    EXPECT_EQ(expected.position.position.y, fix.position.position.y);
+    EXPECT_EQ(expected.position.position.z, fix.position.position.z);
+    EXPECT_EQ(expected.velocity.velocity.x, fix.velocity.velocity.x);
+    EXPECT_EQ(expected.velocity.velocity.y, fix.velocity.velocity.y);
+    EXPECT_EQ(expected.velocity.velocity.z, fix.velocity.velocity.z);
+    for(int k = 0; k < 9; ++k)
+    {
+        EXPECT_EQ(expected.position.covariance[k], fix.position.covariance[k]);
+        EXPECT_EQ(expected.velocity.covariance[k], fix.velocity.covariance[k]);
+    }
+}
+
+// Every fix unpacked from the batches is the fix that went in
+TEST(SolutionBatch, RoundTrip)
+{
+    for(int sigma_every = 1; sigma_every <= 1000; sigma_every *= 10)
+    {
+        SolutionBatch batch;
+        batch.configure(10, 0.0);
+        novatel_gps::GpsXYZBatch message;
+        message.header.frame_id = "gps_frame";
+        int batches = 0;
+        for(int i = 0; i < 1000; ++i)
+        {
+            if(!batch.add(Fix(i, sigma_every)))
+                continue;
+            batch.take(&message);
+            ASSERT_EQ(10u, message.stamp.size());
+            for(int j = 0; j < 10; ++j)
+            {
+                GpsXYZ fix;
+                ASSERT_TRUE(BatchSample(message, j, &fix));
+                ExpectSameFix(Fix(i - 9 + j, sigma_every), fix);
+            }
+            GpsXYZ fix;
+            EXPECT_FALSE(BatchSample(message, 10, &fix));
+            batches++;
+        }
+        EXPECT_EQ(100, batches);
+        EXPECT_EQ(0u, batch.size());
+    }
+}
+
+// A covariance entry for the first sample and then only on change
+TEST(SolutionBatch, CovarianceOnChange)
+{
+    SolutionBatch batch;
+    batch.configure(50, 0.0);
+    novatel_gps::GpsXYZBatch message;
+    for(int i = 0; i < 50; ++i)
+        batch.add(Fix(i, 20));
+    batch.take(&message);
+    ASSERT_EQ(3u, message.covariance_sample.size());
+    EXPECT_EQ(0, message.covariance_sample[0]);
+    EXPECT_EQ(20, message.covariance_sample[1]);
+    EXPECT_EQ(40, message.covariance_sample[2]);
+    EXPECT_EQ(18u, message.covariance.size());
+
+    // The next batch starts with an entry of its own
+    for(int i = 50; i < 55; ++i)
+        batch.add(Fix(i, 20));
+    batch.take(&message);
+    ASSERT_EQ(1u, message.covariance_sample.size());
+    EXPECT_EQ(0, message.covariance_sample[0]);
+}
+
+TEST(SolutionBatch, DueAfterMaxLatency)
+{
+    SolutionBatch batch;
+    batch.configure(100, 0.05);
+    EXPECT_FALSE(batch.due(ros::Time(1.7e9 + 1.0)));
+    EXPECT_FALSE(batch.add(Fix(0, 1)));
+    EXPECT_FALSE(batch.due(ros::Time(1.7e9 + 0.04)));
+    EXPECT_TRUE(batch.due(ros::Time(1.7e9 + 0.06)));
+
+    novatel_gps::GpsXYZBatch message;
+    batch.take(&message);
+    EXPECT_EQ(1u, message.stamp.size());
+    EXPECT_EQ(message.stamp[0].sec, message.header.stamp.sec);
+    EXPECT_EQ(message.stamp[0].nsec, message.header.stamp.nsec);
+    EXPECT_FALSE(batch.due(ros::Time(1.7e9 + 1.0)));
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "solution_history.h"
+
+// GPS time of the first solution
+#define TEST_START_S    1.3e9
+
+// A cubic trajectory, which the Hermite interpolation reproduces exactly, at
+// tau seconds after TEST_START_S
+static SolutionSample Sample(double tau)
+{
+    SolutionSample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.gps_time = TEST_START_S + tau;
+    for(int i = 0; i < 3; ++i)
+    {
+        double a = 1.0 + i, b = 0.5*i - 0.2, c = 0.03*(i + 1);
+        sample.position[i] = 4e6*(i + 1) + a*tau + b*tau*tau + c*tau*tau*tau;
+        sample.velocity[i] = a + 2*b*tau + 3*c*tau*tau;
+        sample.position_var[i] = 0.01 + 0.001*tau;
+        sample.velocity_var[i] = 0.0004;
+    }
+    sample.position_type = 16;
+    return sample;
+}
+
+// Solutions at 10 Hz received 50 ms after their GPS time
+static void AddSamples(SolutionHistory* history, int first, int count)
+{
+    for(int k = first; k < first + count; ++k)
+    {
+        SolutionSample sample = Sample(0.1*k);
+        history->add(sample, static_cast<int64_t>((sample.gps_time + 0.05)*1e9));
+    }
+}
+
+// After the ring has wrapped twice, between and at the kept solutions. GPS
+// seconds near 1.3e9 resolve to 0.24 us, which bounds the agreement.
+TEST(SolutionHistory, HermiteAfterWrap)
+{
+    SolutionHistory history(10);
+    AddSamples(&history, 0, 25);
+    ASSERT_EQ(10u, history.size());
+
+    for(double tau = 1.5; tau <= 2.4; tau += 0.025)
+    {
+        SolutionSample expected = Sample(tau), sample;
+        ASSERT_TRUE(history.atGpsTime(TEST_START_S + tau, &sample)) << "tau " << tau;
+        for(int i = 0; i < 3; ++i)
+        {
+            EXPECT_NEAR(expected.position[i], sample.position[i], 1e-5) << "tau " << tau;
+            EXPECT_NEAR(expected.velocity[i], sample.velocity[i], 1e-4) << "tau " << tau;
+            EXPECT_NEAR(expected.position_var[i], sample.position_var[i], 1e-9) << "tau " << tau;
+        }
+        EXPECT_EQ(16, sample.position_type);
+    }
+
+    // Host time maps through the 50 ms latency
+    SolutionSample sample;
+    ASSERT_TRUE(history.atHostTime(TEST_START_S + 2.0 + 0.05, &sample));
+    EXPECT_NEAR(TEST_START_S + 2.0, sample.gps_time, 1e-6);
+}
+
+TEST(SolutionHistory, OutOfRangeRefused)
+{
+    SolutionHistory history(10);
+    SolutionSample sample;
+    const char* reason = NULL;
+    EXPECT_FALSE(history.atGpsTime(TEST_START_S, &sample, &reason));
+    EXPECT_STREQ("no solutions yet", reason);
+
+    AddSamples(&history, 0, 25);
+    EXPECT_FALSE(history.atGpsTime(TEST_START_S + 1.45, &sample, &reason));
+    EXPECT_STREQ("older than the history", reason);
+    EXPECT_FALSE(history.atGpsTime(TEST_START_S + 2.45, &sample, &reason));
+    EXPECT_STREQ("newer than the latest solution", reason);
+    EXPECT_TRUE(history.atGpsTime(TEST_START_S + 2.4, &sample));
+}
+
+TEST(SolutionHistory, GapRefused)
+{
+    SolutionHistory history(10);
+    history.setMaxGap(0.5);
+    AddSamples(&history, 0, 3);
+    AddSamples(&history, 20, 3);
+
+    SolutionSample sample;
+    const char* reason = NULL;
+    EXPECT_FALSE(history.atGpsTime(TEST_START_S + 1.0, &sample, &reason));
+    EXPECT_STREQ("gap between solutions longer than max_gap", reason);
+    EXPECT_TRUE(history.atGpsTime(TEST_START_S + 0.15, &sample));
+    EXPECT_TRUE(history.atGpsTime(TEST_START_S + 2.05, &sample));
+
+    history.setMaxGap(2.0);
+    EXPECT_TRUE(history.atGpsTime(TEST_START_S + 1.0, &sample));
+}
+
+// The receiver time restarting: the history starts over from that solution
+TEST(SolutionHistory, ClearedOnBackwardsJump)
+{
+    SolutionHistory history(10);
+    AddSamples(&history, 50, 10);
+    ASSERT_EQ(10u, history.size());
+
+    AddSamples(&history, 0, 1);
+    EXPECT_EQ(1u, history.size());
+    SolutionSample sample;
+    EXPECT_FALSE(history.atGpsTime(TEST_START_S + 5.5, &sample));
+    ASSERT_TRUE(history.atGpsTime(TEST_START_S, &sample));
+    EXPECT_EQ(Sample(0.0).position[0], sample.position[0]);
+}
+
+// The same epoch twice (BESTXYZ ONNEW and ONTIME): the first one is kept
+TEST(SolutionHistory, DuplicateEpochIgnored)
+{
+    SolutionHistory history(10);
+    AddSamples(&history, 0, 5);
+
+    SolutionSample repeat = Sample(0.4);
+    repeat.position[0] += 100.0;
+    history.add(repeat, static_cast<int64_t>((repeat.gps_time + 0.05)*1e9));
+    EXPECT_EQ(5u, history.size());
+
+    SolutionSample sample;
+    ASSERT_TRUE(history.atGpsTime(TEST_START_S + 0.4, &sample));
+    EXPECT_EQ(Sample(0.4).position[0], sample.position[0]);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}